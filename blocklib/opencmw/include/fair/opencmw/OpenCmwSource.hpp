@@ -6,10 +6,17 @@
 #include <RestClient.hpp>
 #include <URI.hpp>
 #include <fair/opencmw/cmwlight/CmwLightClient.hpp>
+#include <fair/thread/ThreadPlacement.hpp>
+#include <fair/trace/Trace.hpp>
 #include <gnuradio-4.0/Block.hpp>
 #include <gnuradio-4.0/BlockRegistry.hpp>
 
 namespace fair::opencmw {
+static ::opencmw::client::cmwlight::CmwLightClientCtx*& globalCmwLightClient() {
+    static ::opencmw::client::cmwlight::CmwLightClientCtx* client = nullptr; // owned by the global client context
+    return client;
+}
+
 static ::opencmw::client::ClientContext initGlobalClientContext(::opencmw::zmq::Context& zctx) {
     using namespace ::opencmw::client;
     std::string nameserver = "http://localhost:7500";
@@ -19,7 +26,9 @@ static ::opencmw::client::ClientContext initGlobalClientContext(::opencmw::zmq::
     std::vector<std::unique_ptr<ClientBase>> clients{};
     clients.emplace_back(std::make_unique<RestClient>());
     clients.emplace_back(std::make_unique<MDClientCtx>(zctx, 100ms, "OpenCmwMajordomoClient"));
-    clients.emplace_back(std::make_unique<cmwlight::CmwLightClientCtx>(zctx, nameserver, 100ms, "OpenCmwRda3Client"));
+    auto cmwLight          = std::make_unique<cmwlight::CmwLightClientCtx>(zctx, nameserver, 100ms, "OpenCmwRda3Client");
+    globalCmwLightClient() = cmwLight.get();
+    clients.emplace_back(std::move(cmwLight));
     return ClientContext{std::move(clients)};
 }
 
@@ -42,8 +51,10 @@ struct OpenCmwSource : gr::Block<OpenCmwSource> {
     gr::Annotated<bool, "verbose console", gr::Doc<"For debugging">>                                                   verbose_console   = false;
     gr::Annotated<float, "reconnect timeout", gr::Doc<"reconnect timeout in sec">>                                     reconnect_timeout = 5.f;
     gr::Annotated<std::string, "nameserver", gr::Doc<"Nameserver to use for device lookup">>                           nameserver        = "http://localhost:7500";
+    gr::Annotated<std::string, "poller CPU affinity", gr::Doc<"CPU list of the shared CMW poller, e.g. `2,4-6`">>      cpu_affinity      = "";
+    gr::Annotated<int, "poller RT priority", gr::Doc<"SCHED_FIFO priority (1..99) of the CMW poller, 0: off">>         rt_priority       = 0;
 
-    GR_MAKE_REFLECTABLE(OpenCmwSource, out, url, signal_name, signal_unit, signal_quantity, signal_min, signal_max, verbose_console, reconnect_timeout);
+    GR_MAKE_REFLECTABLE(OpenCmwSource, out, url, signal_name, signal_unit, signal_quantity, signal_min, signal_max, verbose_console, reconnect_timeout, cpu_affinity, rt_priority);
 
     std::mutex                 mutex;
     std::queue<gr::pmt::Value> updates;
@@ -53,7 +64,11 @@ struct OpenCmwSource : gr::Block<OpenCmwSource> {
             std::println("OpenCmwSource: subscribe to {}", url);
         }
         auto& clientContext = getGloablClientContext();
+        if (const ::fair::thread::ThreadPlacement placement{.cpuAffinity = cpu_affinity, .rtPriority = rt_priority}; !placement.empty() && globalCmwLightClient() != nullptr) {
+            globalCmwLightClient()->setPollerPlacement(placement); // the poller is shared by all sources, the last one started wins
+        }
         clientContext.subscribe(::opencmw::URI(url), [this](const ::opencmw::mdp::Message& response) {
+            FAIR_TRACE_SPAN("OpenCmwSource::receive", "opencmw");
             if (verbose_console) {
                 std::println("OpenCmwSource: received update");
             }
@@ -101,6 +116,7 @@ struct OpenCmwSource : gr::Block<OpenCmwSource> {
     }
 
     auto processBulk(gr::OutputSpanLike auto& output) noexcept {
+        FAIR_TRACE_SPAN("OpenCmwSource::processBulk", "opencmw");
         size_t          written = 0;
         std::lock_guard guard{mutex};
         while (written < output.size() && !updates.empty()) {
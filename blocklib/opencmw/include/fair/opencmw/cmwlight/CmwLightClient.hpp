@@ -2,8 +2,10 @@
 #define OPENCMW_CPP_CMWLIGHTCLIENT_HPP
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <format>
+#include <mutex>
 #include <string_view>
 
 #include "DirectoryLightClient.hpp"
@@ -15,6 +17,9 @@
 #include <opencmw.hpp>
 #include <zmq/ZmqUtils.hpp>
 
+#include <fair/thread/ThreadPlacement.hpp>
+#include <fair/trace/Trace.hpp>
+
 namespace opencmw::client::cmwlight {
 
 struct Request {
@@ -594,7 +599,9 @@ public:
                 if (!zmq::invoke(zmq_getsockopt, con._socket, ZMQ_RCVMORE, &more, &moreSize)) {
                     throw std::runtime_error("error checking rcvmore");
                 } else if (more == 0) { // the message is complete
-                    const bool received = handleMessage(output, con);
+                    [[maybe_unused]] const auto handleStart = std::chrono::steady_clock::now();
+                    const bool                  received    = handleMessage(output, con);
+                    FAIR_TRACE_EVENT("CmwLightClient::handleMessage", "opencmw", handleStart, std::chrono::steady_clock::now());
                     con._frames.clear();
                     if (received) {
                         return true;
@@ -773,6 +780,10 @@ class CmwLightClientCtx : public ClientBase {
     timeUnit                                                       _timeout;
     std::string                                                    _clientId;
     std::size_t                                                    _request_id = 1;
+    std::mutex                                                     _placementMutex;
+    ::fair::thread::ThreadPlacement                                _requestedPlacement{}; // applied by the poller thread on its next iteration
+    ::fair::thread::EffectivePlacement                             _pollerPlacement{};
+    std::atomic_bool                                               _placementPending{false};
 
 public:
     explicit CmwLightClientCtx(const zmq::Context& zeromq_context, std::string nameserver, const timeUnit timeout = 100ms, std::string clientId = "") : _zctx{zeromq_context}, _nameserver{DirectoryLightClient{std::move(nameserver)}}, _control_socket_send(zeromq_context, ZMQ_PAIR), _control_socket_recv(zeromq_context, ZMQ_PAIR), _timeout(timeout), _clientId(std::move(clientId)) {
@@ -781,6 +792,18 @@ public:
         _poller = std::jthread([this](const std::stop_token& stoken) { this->poll(stoken); });
     }
 
+    // CPU affinity and SCHED_FIFO priority of the poller thread shared by all subscriptions, best-effort, applied within one poll period (200 ms)
+    void setPollerPlacement(::fair::thread::ThreadPlacement placement) {
+        std::lock_guard lock(_placementMutex);
+        _requestedPlacement = std::move(placement);
+        _placementPending.store(true, std::memory_order_release);
+    }
+
+    [[nodiscard]] ::fair::thread::EffectivePlacement pollerPlacement() {
+        std::lock_guard lock(_placementMutex);
+        return _pollerPlacement;
+    }
+
     std::vector<std::string> protocols() override {
         return {"rda3", "rda3tcp"}; // rda3 protocol, if transport is unspecified, tcp is used if authority contains a port
     }
@@ -882,9 +905,18 @@ private:
     void poll(const std::stop_token& stoken) {
         using enum mdp::Command;
         thread::setThreadName("CmwLightPollerThread");
+        {
+            std::lock_guard lock(_placementMutex);
+            _pollerPlacement = ::fair::thread::currentPlacement();
+        }
         auto nextHousekeeping = std::chrono::system_clock::now();
         zmq::invoke(zmq_connect, _control_socket_recv, "inproc://cmwlightclientControlSocket").assertSuccess();
         while (!stoken.stop_requested() && zmq::invoke(zmq_poll, _pollitems.data(), static_cast<int>(_pollitems.size()), 200)) {
+            if (_placementPending.exchange(false, std::memory_order_acq_rel)) {
+                std::lock_guard lock(_placementMutex);
+                _pollerPlacement = ::fair::thread::applyToCurrentThread(_requestedPlacement);
+                ::fair::thread::report("CmwLightClient", "poller", _requestedPlacement, _pollerPlacement, false);
+            }
             if (auto now = std::chrono::system_clock::now(); nextHousekeeping < now) {
                 nextHousekeeping = housekeeping(now);
                 // expire old subscriptions/requests/connections
@@ -0,0 +1,143 @@
+#ifndef FAIR_PICOSCOPE_ACQUISITIONHEALTH_HPP
+#define FAIR_PICOSCOPE_ACQUISITIONHEALTH_HPP
+
+#include <fair/picoscope/TimingMatcher.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace fair::picoscope {
+
+/**
+ * Health counters of an acquisition block, counted since the block was created, i.e. they survive stop()/start() and re-opening the driver. The
+ * acquisition thread updates them with relaxed atomics once per driver chunk, any thread may read them while acquiring. Exported by `Picoscope` via the
+ * `Health` property and as a Prometheus text snapshot (`metrics_path`, e.g. for the node exporter textfile collector).
+ */
+struct AcquisitionHealth {
+    using Counter = std::atomic<std::uint64_t>;
+
+    Counter                                                     samplesAcquired{0UZ};  // per channel, as delivered by the driver (before decimation)
+    Counter                                                     samplesPublished{0UZ}; // per channel, Streaming: output samples, RapidBlock: samples of all captures
+    Counter                                                     samplesDropped{0UZ};   // per channel, output buffers full
+    Counter                                                     overflowEvents{0UZ};   // driver chunks or captures with an over-range flag set
+    Counter                                                     retries{0UZ};          // failed driver calls, retried after PicoscopeWrapper::retryPeriod
+    Counter                                                     errorCountResets{0UZ}; // successful driver calls after failed ones, resetting PicoscopeWrapper::errorCount
+    Counter                                                     restarts{0UZ};         // acquisition restarts after channel or trigger changes
+    Counter                                                     unknownEvents{0UZ};    // UNKNOWN_EVENT tags: trigger edges without timing tag
+    Counter                                                     burstAllocations{0UZ}; // RapidBlock burst layout: recycled output slots without storage for an acquisition
+    std::array<Counter, timingmatcher::kDropReasonNames.size()> matcherDrops{};        // dropped timing tags per timingmatcher::DropReason
+    std::atomic<double>                                         bufferFill{0.0};       // Streaming: fill level of the fullest output buffer, 0..1
+
+    struct CounterInfo {
+        std::string_view            name;
+        std::string_view            help;
+        Counter AcquisitionHealth::* counter;
+    };
+    static constexpr std::array kCounters{
+        CounterInfo{"samples_acquired", "Samples per channel delivered by the driver", &AcquisitionHealth::samplesAcquired},
+        CounterInfo{"samples_published", "Samples per channel published on the outputs", &AcquisitionHealth::samplesPublished},
+        CounterInfo{"samples_dropped", "Samples per channel dropped because the output buffers were full", &AcquisitionHealth::samplesDropped},
+        CounterInfo{"overflow_events", "Driver chunks or captures with an over-range flag", &AcquisitionHealth::overflowEvents},
+        CounterInfo{"retries", "Failed driver calls which are retried", &AcquisitionHealth::retries},
+        CounterInfo{"error_count_resets", "Successful driver calls after failed ones", &AcquisitionHealth::errorCountResets},
+        CounterInfo{"restarts", "Acquisition restarts after configuration changes", &AcquisitionHealth::restarts},
+        CounterInfo{"unknown_events", "Trigger edges without timing tag, published as UNKNOWN_EVENT", &AcquisitionHealth::unknownEvents},
+        CounterInfo{"burst_allocations", "RapidBlock burst DataSets allocated because the recycled output buffer slot had no storage", &AcquisitionHealth::burstAllocations},
+    };
+
+    static void increment(Counter& counter, std::uint64_t n = 1UZ) noexcept { counter.fetch_add(n, std::memory_order_relaxed); }
+
+    void addMatcherResult(const timingmatcher::MatcherResult& result) noexcept {
+        for (std::size_t reason = 0UZ; reason < matcherDrops.size(); ++reason) {
+            if (result.dropped[reason] > 0UZ) {
+                increment(matcherDrops[reason], result.dropped[reason]);
+            }
+        }
+        if (result.unknownEvents > 0UZ) {
+            increment(unknownEvents, result.unknownEvents);
+        }
+    }
+
+    [[nodiscard]] gr::property_map toPropertyMap() const {
+        gr::property_map map;
+        for (const auto& [name, help, counter] : kCounters) {
+            map.emplace(std::string(name), (this->*counter).load(std::memory_order_relaxed));
+        }
+        gr::property_map drops;
+        for (const auto& [reason, count] : std::views::zip(timingmatcher::kDropReasonNames, matcherDrops)) {
+            drops.emplace(std::string(reason), count.load(std::memory_order_relaxed));
+        }
+        map.emplace("matcher_drops", std::move(drops));
+        map.emplace("buffer_fill", bufferFill.load(std::memory_order_relaxed));
+        return map;
+    }
+
+    /**
+     * Prometheus text exposition format, metrics named `picoscope_<counter>_total` (counters) and `picoscope_buffer_fill` (gauge). `labels` are attached
+     * to every sample, e.g. {{"block", name}, {"serial", serial}}.
+     */
+    [[nodiscard]] std::string toPrometheus(std::span<const std::pair<std::string_view, std::string_view>> labels) const {
+        std::string labelText;
+        for (const auto& [key, value] : labels) {
+            labelText += std::format("{}{}=\"{}\"", labelText.empty() ? "" : ",", key, escapeLabelValue(value));
+        }
+        std::string text;
+        for (const auto& [name, help, counter] : kCounters) {
+            text += std::format("# HELP picoscope_{0}_total {1}\n# TYPE picoscope_{0}_total counter\npicoscope_{0}_total{{{2}}} {3}\n", name, help, labelText, (this->*counter).load(std::memory_order_relaxed));
+        }
+        text += "# HELP picoscope_matcher_dropped_tags_total Timing tags dropped by the tag matcher\n# TYPE picoscope_matcher_dropped_tags_total counter\n";
+        for (const auto& [reason, count] : std::views::zip(timingmatcher::kDropReasonNames, matcherDrops)) {
+            text += std::format("picoscope_matcher_dropped_tags_total{{{}{}reason=\"{}\"}} {}\n", labelText, labelText.empty() ? "" : ",", reason, count.load(std::memory_order_relaxed));
+        }
+        text += std::format("# HELP picoscope_buffer_fill Fill level of the fullest output buffer (0..1)\n# TYPE picoscope_buffer_fill gauge\npicoscope_buffer_fill{{{}}} {}\n", labelText, bufferFill.load(std::memory_order_relaxed));
+        return text;
+    }
+
+    // writes `text` to `<path>.tmp` and renames it to `path`, so readers never see a partially written snapshot
+    static std::expected<void, std::string> writeSnapshot(const std::filesystem::path& path, std::string_view text) {
+        std::filesystem::path tmpPath = path;
+        tmpPath += ".tmp";
+        {
+            std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!file || !file.write(text.data(), static_cast<std::streamsize>(text.size())) || !file.flush()) {
+                return std::unexpected(std::format("cannot write {}", tmpPath.string()));
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmpPath, path, ec);
+        if (ec) {
+            return std::unexpected(std::format("cannot rename {} to {}: {}", tmpPath.string(), path.string(), ec.message()));
+        }
+        return {};
+    }
+
+private:
+    static std::string escapeLabelValue(std::string_view value) {
+        std::string escaped;
+        escaped.reserve(value.size());
+        for (const char c : value) {
+            switch (c) {
+            case '\\': escaped += "\\\\"; break;
+            case '"': escaped += "\\\""; break;
+            case '\n': escaped += "\\n"; break;
+            default: escaped += c;
+            }
+        }
+        return escaped;
+    }
+};
+
+} // namespace fair::picoscope
+
+#endif // FAIR_PICOSCOPE_ACQUISITIONHEALTH_HPP
@@ -0,0 +1,99 @@
+#ifndef FAIR_PICOSCOPE_CALIBRATION_HPP
+#define FAIR_PICOSCOPE_CALIBRATION_HPP
+
+#include <gnuradio-4.0/Message.hpp>
+
+#include <cmath>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fair::picoscope {
+
+/**
+ * Per-unit calibration tables: gain/offset and INL correction polynomials for each serial number, channel and range.
+ *
+ * File format, one entry per line, `#` starts a comment:
+ *
+ *   # serial    channel  range[V]  c0      c1     [c2 ...]        v_cal = c0 + c1 v + c2 v^2 + ..., v: nominal voltage
+ *   JO123/0045  A        5         0.0012  1.0021 -0.0003
+ *   *           B        0.5       0       0.998                  `*` matches any serial number
+ *
+ * Entries with the exact serial number take precedence over `*` entries. The polynomial is applied by kernel::Calibration.
+ */
+struct CalibrationTable {
+    struct Entry {
+        std::string        serial;
+        std::string        channel;
+        float              range = 0.f;
+        std::vector<float> coefficients{};
+    };
+
+    std::vector<Entry> _entries{};
+
+    [[nodiscard]] bool empty() const noexcept { return _entries.empty(); }
+
+    [[nodiscard]] static std::expected<CalibrationTable, gr::Error> parse(std::string_view text, std::string_view source = "") {
+        CalibrationTable   table;
+        std::istringstream lines{std::string(text)};
+        std::size_t        lineNumber = 0UZ;
+        for (std::string line; std::getline(lines, line);) {
+            ++lineNumber;
+            if (const auto comment = line.find('#'); comment != std::string::npos) {
+                line.resize(comment);
+            }
+            std::istringstream fields{line};
+            Entry              entry;
+            if (!(fields >> entry.serial)) {
+                continue; // empty line
+            }
+            if (!(fields >> entry.channel >> entry.range)) {
+                return std::unexpected(gr::Error(std::format("{}:{}: expected `<serial> <channel> <range> <c0> [c1 ...]`", source, lineNumber)));
+            }
+            for (float coefficient; fields >> coefficient;) {
+                entry.coefficients.push_back(coefficient);
+            }
+            if (!fields.eof() || entry.coefficients.empty()) {
+                return std::unexpected(gr::Error(std::format("{}:{}: invalid calibration coefficients", source, lineNumber)));
+            }
+            table._entries.push_back(std::move(entry));
+        }
+        return table;
+    }
+
+    [[nodiscard]] static std::expected<CalibrationTable, gr::Error> load(const std::filesystem::path& path) {
+        std::ifstream file(path);
+        if (!file) {
+            return std::unexpected(gr::Error(std::format("Cannot open calibration file: {}", path.string())));
+        }
+        std::stringstream content;
+        content << file.rdbuf();
+        return parse(content.str(), path.string());
+    }
+
+    // nullptr if there is no calibration for the given unit, channel and range
+    [[nodiscard]] const Entry* find(std::string_view serial, std::string_view channel, float range) const noexcept {
+        const Entry* wildcard = nullptr;
+        for (const Entry& entry : _entries) {
+            if (entry.channel != channel || std::abs(entry.range - range) > 1e-3f * std::abs(range)) {
+                continue;
+            }
+            if (entry.serial == serial) {
+                return &entry;
+            }
+            if (entry.serial == "*" && wildcard == nullptr) {
+                wildcard = &entry;
+            }
+        }
+        return wildcard;
+    }
+};
+
+} // namespace fair::picoscope
+
+#endif // FAIR_PICOSCOPE_CALIBRATION_HPP
@@ -0,0 +1,446 @@
+#ifndef FAIR_PICOSCOPE_CONVERSIONKERNEL_HPP
+#define FAIR_PICOSCOPE_CONVERSIONKERNEL_HPP
+
+#include <fair/picoscope/PicoscopeAPI.hpp>
+
+#include <gnuradio-4.0/Tag.hpp>
+#include <gnuradio-4.0/meta/UncertainValue.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if __has_include(<stdfloat>)
+#include <stdfloat>
+#endif
+#if defined(__F16C__) && defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace fair::picoscope {
+
+#if defined(__STDCPP_FLOAT16_T__) && defined(__STDCPP_BFLOAT16_T__)
+#define FAIR_PICOSCOPE_HALF_PRECISION 1
+template<typename T>
+concept HalfPrecision = std::disjunction_v<std::is_same<T, std::float16_t>, std::is_same<T, std::bfloat16_t>>;
+#else
+template<typename T>
+concept HalfPrecision = false;
+#endif
+
+} // namespace fair::picoscope
+
+namespace fair::picoscope::kernel {
+
+// number of samples processed per tile: raw int16 input + converted output of one tile stay well within a 32 kB L1 data cache
+inline constexpr std::size_t kTileSize = 1024UZ;
+
+/**
+ * Non-linear calibration (gain, offset and INL correction) of one channel and range, fused into the conversion from ADC counts.
+ *
+ * The calibration polynomial P maps the nominal voltage v = range * raw / maxValue to the calibrated voltage: v_cal = c0 + c1 v + c2 v^2 + ...
+ * It is combined with the signal scale and offset into a single polynomial Q(u) of the normalised ADC count u = raw / maxValue, evaluated
+ *  - with Horner's scheme (one FMA per degree, vectorised across samples) for low orders, or
+ *  - through a 65536 entry int16 -> float look-up table if the polynomial would cost more than the (cache-missing) table access.
+ */
+struct Calibration {
+    static constexpr std::size_t kMaxHornerDegree = 5UZ; // estimated break-even of the vectorised polynomial vs. the scalar 256 kB LUT access
+    static constexpr std::size_t kLutSize         = 1UZ << 16UZ;
+
+    std::vector<float> coefficients{}; // as loaded: voltage domain, c0, c1, ...
+    std::vector<float> polynomial{};   // Q(u), including signal scale and offset
+    std::vector<float> lut{};          // Q(raw / maxValue) indexed by raw + 32768, only if the degree exceeds kMaxHornerDegree
+    float              invMaxValue = 1.f;
+
+    [[nodiscard]] bool        empty() const noexcept { return polynomial.empty(); }
+    [[nodiscard]] bool        usesLut() const noexcept { return !lut.empty(); }
+    [[nodiscard]] std::string method() const { return empty() ? "none" : (usesLut() ? "lut" : "polynomial"); }
+
+    /**
+     * @param voltageCoefficients calibration polynomial in the voltage domain, empty: no calibration
+     * @param signalScale, signalOffset applied to the calibrated voltage: value = signalOffset + signalScale * v_cal
+     */
+    [[nodiscard]] static Calibration create(std::span<const float> voltageCoefficients, float range, float signalScale, float signalOffset, std::int16_t maxValue) {
+        Calibration calibration;
+        if (voltageCoefficients.empty()) {
+            return calibration;
+        }
+        calibration.coefficients.assign(voltageCoefficients.begin(), voltageCoefficients.end());
+        calibration.invMaxValue = 1.f / static_cast<float>(maxValue);
+        calibration.polynomial.resize(voltageCoefficients.size());
+        double rangePower = 1.0;
+        for (std::size_t j = 0UZ; j < voltageCoefficients.size(); ++j) {
+            calibration.polynomial[j] = static_cast<float>(static_cast<double>(signalScale) * static_cast<double>(voltageCoefficients[j]) * rangePower);
+            rangePower *= static_cast<double>(range);
+        }
+        calibration.polynomial[0] += signalOffset;
+        if (calibration.polynomial.size() - 1UZ > kMaxHornerDegree) {
+            calibration.lut.resize(kLutSize);
+            for (std::size_t i = 0UZ; i < kLutSize; ++i) {
+                const double u   = static_cast<double>(static_cast<std::int32_t>(i) - 32768) / static_cast<double>(maxValue);
+                double       acc = 0.0;
+                for (const float q : calibration.polynomial | std::views::reverse) {
+                    acc = acc * u + static_cast<double>(q);
+                }
+                calibration.lut[i] = static_cast<float>(acc);
+            }
+        }
+        return calibration;
+    }
+
+    // single, possibly fractional (e.g. filtered) ADC count, always evaluates the polynomial
+    [[nodiscard]] float evaluate(float raw) const noexcept {
+        const float u   = raw * invMaxValue;
+        float       acc = 0.f;
+        for (const float q : polynomial | std::views::reverse) {
+            acc = acc * u + q;
+        }
+        return acc;
+    }
+
+    void apply(std::span<const std::int16_t> raw, std::span<float> out) const noexcept {
+        assert(out.size() >= raw.size() && !empty());
+        if (usesLut()) {
+            for (std::size_t i = 0UZ; i < raw.size(); ++i) {
+                out[i] = lut[static_cast<std::size_t>(static_cast<std::int32_t>(raw[i]) + 32768)];
+            }
+            return;
+        }
+        [&]<std::size_t... degree>(std::index_sequence<degree...>) { // dispatch to a fixed degree, so that the sample loop gets vectorised
+            std::ignore = ((polynomial.size() == degree + 1UZ ? (applyHorner<degree>(raw, out), true) : false) || ...);
+        }(std::make_index_sequence<kMaxHornerDegree + 1UZ>{});
+    }
+
+    template<std::size_t degree>
+    void applyHorner(std::span<const std::int16_t> raw, std::span<float> out) const noexcept {
+        std::array<float, degree + 1UZ> q{};
+        std::ranges::copy_n(polynomial.begin(), static_cast<std::ptrdiff_t>(q.size()), q.begin());
+        const float scale = invMaxValue;
+        for (std::size_t i = 0UZ; i < raw.size(); ++i) {
+            const float u   = scale * static_cast<float>(raw[i]);
+            float       acc = q[degree];
+            for (std::size_t j = degree; j-- > 0UZ;) {
+                acc = acc * u + q[j];
+            }
+            out[i] = acc;
+        }
+    }
+};
+
+/**
+ * Affine conversion from ADC counts to physical values: value = offset + scale * raw
+ *
+ * Raw (`std::int16_t`) outputs publish these parameters in their signal info tag (`adc_scale`, `adc_offset`, `adc_uncertainty`, `adc_max_value`), so that the
+ * conversion can be deferred to the consumers which actually need physical units, see RawScale.
+ */
+struct ConversionParameters {
+    static constexpr std::string_view kScale       = "adc_scale";
+    static constexpr std::string_view kOffset      = "adc_offset";
+    static constexpr std::string_view kUncertainty = "adc_uncertainty";
+    static constexpr std::string_view kMaxValue    = "adc_max_value";
+
+    float              scale       = 1.f; // complete conversion factor from ADC counts: signal_scale * channel_range / maxValue
+    float              offset      = 0.f;
+    float              uncertainty = 0.f;                                       // only used for gr::UncertainValue<float> outputs
+    std::int16_t       maxValue    = std::numeric_limits<std::int16_t>::max(); // ADC counts at the limit of the range, samples at ±maxValue are over-range
+    const Calibration* calibration = nullptr;                                   // optional, replaces scale and offset for non-raw outputs
+
+    void addTo(gr::property_map& map) const { // the map must not contain the entries yet
+        map.emplace(std::string(kScale), scale);
+        map.emplace(std::string(kOffset), offset);
+        map.emplace(std::string(kUncertainty), uncertainty);
+        map.emplace(std::string(kMaxValue), static_cast<std::int32_t>(maxValue));
+    }
+
+    // nullopt if the map does not contain the conversion, missing optional entries keep their defaults
+    template<typename TMap>
+    [[nodiscard]] static std::optional<ConversionParameters> fromTagMap(const TMap& map) {
+        const auto* maybeScale = map.template get_if<float>(kScale);
+        if (maybeScale == nullptr) {
+            return std::nullopt;
+        }
+        ConversionParameters params{.scale = *maybeScale};
+        if (const auto* maybeOffset = map.template get_if<float>(kOffset)) {
+            params.offset = *maybeOffset;
+        }
+        if (const auto* maybeUncertainty = map.template get_if<float>(kUncertainty)) {
+            params.uncertainty = *maybeUncertainty;
+        }
+        if (const auto* maybeMaxValue = map.template get_if<std::int32_t>(kMaxValue)) {
+            params.maxValue = static_cast<std::int16_t>(*maybeMaxValue);
+        }
+        return params;
+    }
+};
+
+template<typename TOut>
+[[nodiscard]] constexpr float toFloat(const TOut& value) noexcept {
+    if constexpr (std::is_same_v<TOut, gr::UncertainValue<float>>) {
+        return value.value;
+    } else {
+        return static_cast<float>(value);
+    }
+}
+
+#ifdef FAIR_PICOSCOPE_HALF_PRECISION
+/**
+ * int16 -> float16/bfloat16 conversion via float, rounding to nearest even. float16 uses the F16C instructions 8 samples at a time if available, bfloat16
+ * rounds the upper half of the float bit pattern with integer operations, which the compiler vectorises for any SIMD instruction set.
+ * The ADC range of at most 16 bits is well represented by the 11 (float16) or 8 (bfloat16) bits of mantissa for display and spectral processing.
+ */
+template<HalfPrecision TOut>
+void convertHalf(std::span<const std::int16_t> raw, std::span<TOut> out, const ConversionParameters& params) noexcept {
+    std::size_t i = 0UZ;
+    if constexpr (std::is_same_v<TOut, std::float16_t>) {
+#if defined(__F16C__) && defined(__AVX2__)
+        const __m256 scale  = _mm256_set1_ps(params.scale);
+        const __m256 offset = _mm256_set1_ps(params.offset);
+        for (; i + 8UZ <= raw.size(); i += 8UZ) {
+            const __m256i counts = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(raw.data() + i)));
+            const __m256  values = _mm256_add_ps(offset, _mm256_mul_ps(scale, _mm256_cvtepi32_ps(counts)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out.data() + i), _mm256_cvtps_ph(values, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+        }
+#endif
+        for (; i < raw.size(); ++i) {
+            out[i] = static_cast<std::float16_t>(params.offset + params.scale * static_cast<float>(raw[i]));
+        }
+    } else {
+        for (; i < raw.size(); ++i) { // finite inputs only, no NaN handling needed
+            const auto bits = std::bit_cast<std::uint32_t>(params.offset + params.scale * static_cast<float>(raw[i]));
+            out[i]          = std::bit_cast<std::bfloat16_t>(static_cast<std::uint16_t>((bits + 0x7FFFU + ((bits >> 16U) & 1U)) >> 16U));
+        }
+    }
+}
+#endif
+
+/**
+ * Converts raw ADC counts to the output type, branch free and vectorisable. For `std::int16_t` outputs the samples are copied as-is.
+ */
+template<typename TOut>
+void convert(std::span<const std::int16_t> raw, std::span<TOut> out, const ConversionParameters& params) noexcept {
+    assert(out.size() >= raw.size());
+    if constexpr (!std::is_same_v<TOut, std::int16_t>) { // raw outputs only publish the calibration
+        if (params.calibration != nullptr && !params.calibration->empty()) {
+            if constexpr (std::is_same_v<TOut, float>) {
+                params.calibration->apply(raw, out);
+            } else {
+                std::array<float, kTileSize> calibrated; // NOLINT(cppcoreguidelines-pro-type-member-init) fully written before use
+                for (std::size_t first = 0UZ; first < raw.size(); first += kTileSize) {
+                    const std::size_t n = std::min(kTileSize, raw.size() - first);
+                    params.calibration->apply(raw.subspan(first, n), calibrated);
+                    for (std::size_t i = 0UZ; i < n; ++i) {
+                        if constexpr (std::is_same_v<TOut, gr::UncertainValue<float>>) {
+                            out[first + i] = gr::UncertainValue(calibrated[i], params.uncertainty);
+                        } else {
+                            out[first + i] = static_cast<TOut>(calibrated[i]);
+                        }
+                    }
+                }
+            }
+            return;
+        }
+    }
+    if constexpr (HalfPrecision<TOut>) {
+#ifdef FAIR_PICOSCOPE_HALF_PRECISION
+        convertHalf(raw, out, params);
+#endif
+    } else {
+        for (std::size_t i = 0; i < raw.size(); ++i) {
+            if constexpr (std::is_same_v<TOut, float>) {
+                out[i] = params.offset + params.scale * static_cast<float>(raw[i]);
+            } else if constexpr (std::is_same_v<TOut, gr::UncertainValue<float>>) {
+                out[i] = gr::UncertainValue(params.offset + params.scale * static_cast<float>(raw[i]), params.uncertainty);
+            } else if constexpr (std::is_same_v<TOut, std::int16_t>) {
+                out[i] = raw[i];
+            } else {
+                static_assert(gr::meta::always_false<TOut>, "This type is not supported.");
+            }
+        }
+    }
+}
+
+/**
+ * Running statistics of a channel, accumulated in the output domain (i.e. ADC counts for int16 outputs). Reset by the caller, e.g. per chunk or per capture.
+ */
+struct ChannelStatistics {
+    float       min        = std::numeric_limits<float>::max();
+    float       max        = std::numeric_limits<float>::lowest();
+    double      sum        = 0.0;
+    double      sumSquares = 0.0;
+    std::size_t count      = 0UZ;
+    std::size_t overRange  = 0UZ; // number of samples at the limits of the ADC range
+
+    void reset() noexcept { *this = ChannelStatistics{}; }
+
+    [[nodiscard]] double mean() const noexcept { return count > 0UZ ? sum / static_cast<double>(count) : 0.0; }
+    [[nodiscard]] double rms() const noexcept { return count > 0UZ ? std::sqrt(sumSquares / static_cast<double>(count)) : 0.0; }
+
+    template<typename TOut>
+    void accumulate(std::span<const TOut> values) noexcept {
+        float  tileMin = min;
+        float  tileMax = max;
+        double tileSum = 0.0;
+        double tileSq  = 0.0;
+        for (const TOut& sample : values) {
+            const float value = toFloat(sample);
+            tileMin           = std::min(tileMin, value);
+            tileMax           = std::max(tileMax, value);
+            tileSum += static_cast<double>(value);
+            tileSq += static_cast<double>(value) * static_cast<double>(value);
+        }
+        min = tileMin;
+        max = tileMax;
+        sum += tileSum;
+        sumSquares += tileSq;
+        count += values.size();
+    }
+};
+
+/**
+ * Edge detection with hysteresis, equivalent to a comparator on the converted samples. The state is kept across tiles and chunks, so edges at chunk
+ * boundaries are found without re-scanning already processed samples.
+ */
+struct EdgeDetector {
+    float               threshold = 0.f;
+    float               band      = 0.f; // hysteresis
+    TriggerDirection    direction = TriggerDirection::Rising;
+    std::optional<bool> state{};         // unknown until the first sample
+
+    void reset() noexcept { state.reset(); }
+
+    template<typename TOut>
+    void process(std::span<const TOut> values, std::size_t firstIndex, std::vector<std::size_t>& edges) {
+        using enum TriggerDirection;
+        if (values.empty()) {
+            return;
+        }
+        bool triggerState = state.value_or(toFloat(values[0]) >= threshold);
+        if (direction == Rising || direction == High) {
+            for (std::size_t i = 0; i < values.size(); i++) {
+                if (const float value = toFloat(values[i]); !triggerState && (value >= threshold)) {
+                    triggerState = true;
+                    edges.push_back(firstIndex + i);
+                } else if (triggerState && (value <= threshold - band)) {
+                    triggerState = false;
+                }
+            }
+        } else if (direction == Falling || direction == Low) {
+            for (std::size_t i = 0; i < values.size(); i++) {
+                if (const float value = toFloat(values[i]); triggerState && (value <= threshold)) {
+                    triggerState = false;
+                    edges.push_back(firstIndex + i);
+                } else if (!triggerState && (value >= threshold + band)) {
+                    triggerState = true;
+                }
+            }
+        }
+        state = triggerState;
+    }
+};
+
+/**
+ * Coalesces clipped samples (raw counts at ±maxValue) into [start, end) intervals at exact sample indices. Tiles are first scanned with a branch free
+ * (vectorisable) count, only tiles containing clipped samples or continuing an open interval are scanned for the interval boundaries.
+ * Intervals still open at the end of a tile are kept open across tiles and chunks until the signal returns into the range.
+ */
+struct OverRangeDetector {
+    struct Interval {
+        std::size_t start = 0UZ; // first clipped sample
+        std::size_t end   = 0UZ; // one past the last clipped sample
+    };
+
+    std::size_t                indexOffset = 0UZ; // added to the indices passed to process(), e.g. to report absolute stream indices
+    std::optional<std::size_t> openStart{};       // start of the interval clipping at the end of the last processed tile
+    std::vector<Interval>      intervals{};       // closed intervals, to be taken by the caller
+    std::size_t                totalSamples   = 0UZ; // counters since the last reset()
+    std::size_t                totalIntervals = 0UZ;
+
+    void reset() noexcept {
+        openStart.reset();
+        intervals.clear();
+        totalSamples   = 0UZ;
+        totalIntervals = 0UZ;
+    }
+
+    // closes the open interval, e.g. at the end of a capture or before a gap in the data
+    void close(std::size_t end) {
+        if (openStart) {
+            intervals.push_back({*openStart, indexOffset + end});
+            ++totalIntervals;
+            openStart.reset();
+        }
+    }
+
+    [[nodiscard]] static std::size_t count(std::span<const std::int16_t> raw, std::int16_t maxValue) noexcept {
+        const auto  minValue = static_cast<std::int16_t>(-maxValue);
+        std::size_t n        = 0UZ;
+        for (const std::int16_t value : raw) {
+            n += static_cast<std::size_t>((value >= maxValue) | (value <= minValue));
+        }
+        return n;
+    }
+
+    // @return number of clipped samples in raw
+    std::size_t process(std::span<const std::int16_t> raw, std::int16_t maxValue, std::size_t firstIndex) {
+        const std::size_t nClipped = count(raw, maxValue);
+        totalSamples += nClipped;
+        if (nClipped == 0UZ && !openStart) {
+            return 0UZ;
+        }
+        const auto minValue = static_cast<std::int16_t>(-maxValue);
+        for (std::size_t i = 0UZ; i < raw.size(); ++i) {
+            const bool clipped = raw[i] >= maxValue || raw[i] <= minValue;
+            if (clipped && !openStart) {
+                openStart = indexOffset + firstIndex + i;
+            } else if (!clipped && openStart) {
+                close(firstIndex + i);
+            }
+        }
+        return nClipped;
+    }
+};
+
+/**
+ * Fused single pass over the raw driver buffer of one channel: converts the samples, detects trigger edges and accumulates the statistics tile by tile,
+ * so that the second and third stage read the freshly converted tile from L1 instead of the full output buffer.
+ *
+ * @param firstIndex index of out[0] used for the reported edges
+ * @param edgeDetector nullptr if the channel is not the trigger source
+ * @param overRangeDetector optional, reports the over-range intervals in addition to the over-range count of the statistics
+ */
+template<typename TOut>
+void convertChannel(std::span<const std::int16_t> raw, std::span<TOut> out, const ConversionParameters& params, EdgeDetector* edgeDetector, std::size_t firstIndex, std::vector<std::size_t>& edges, ChannelStatistics& stats, OverRangeDetector* overRangeDetector = nullptr) {
+    assert(out.size() >= raw.size());
+    for (std::size_t tileStart = 0UZ; tileStart < raw.size(); tileStart += kTileSize) {
+        const std::size_t                   tileSize = std::min(kTileSize, raw.size() - tileStart);
+        const std::span<const std::int16_t> rawTile  = raw.subspan(tileStart, tileSize);
+        const std::span<TOut>               outTile  = out.subspan(tileStart, tileSize);
+
+        // 1. conversion
+        convert(rawTile, outTile, params);
+
+        // 2. statistics and over-range counts on the L1-resident tile
+        stats.accumulate(std::span<const TOut>(outTile));
+        stats.overRange += overRangeDetector ? overRangeDetector->process(rawTile, params.maxValue, firstIndex + tileStart) : OverRangeDetector::count(rawTile, params.maxValue);
+
+        // 3. edge detection
+        if (edgeDetector) {
+            edgeDetector->process(std::span<const TOut>(outTile), firstIndex + tileStart, edges);
+        }
+    }
+}
+
+} // namespace fair::picoscope::kernel
+
+#endif // FAIR_PICOSCOPE_CONVERSIONKERNEL_HPP
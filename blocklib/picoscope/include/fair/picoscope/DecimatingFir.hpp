@@ -0,0 +1,132 @@
+#ifndef FAIR_PICOSCOPE_DECIMATINGFIR_HPP
+#define FAIR_PICOSCOPE_DECIMATINGFIR_HPP
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <numeric>
+#include <ranges>
+#include <span>
+#include <vector>
+
+namespace fair::picoscope::kernel {
+
+/**
+ * Decimating FIR low-pass running directly on the raw ADC counts, so that no full rate float buffer is needed between the driver and the decimated output.
+ *
+ * Only every `decimation`-th output of the filter is computed (polyphase decimation): each output is a single contiguous int16 x float dot product over the
+ * last taps.size() raw samples, which the compiler vectorises. The linear ADC conversion is folded into the taps (scale) and into a constant (offset), for
+ * unity DC gain taps the output is the filtered physical value.
+ *
+ *  raw:     ... | historySize() | new chunk ....................... |
+ *  outputs:                       ^ every decimation-th sample, after `pending` samples carried over from the last chunk
+ */
+struct DecimatingFir {
+    static constexpr std::size_t kLanes = 8UZ; // independent partial sums, so that the dot product vectorises without re-association of the float sum
+
+    std::size_t               decimation = 1UZ;
+    std::vector<float>        taps{};       // as configured, unity DC gain
+    std::vector<float>        scaledTaps{}; // reversed and multiplied by the conversion scale
+    float                     offset     = 0.f;
+    std::size_t               pending    = 0UZ; // raw samples since the last output, [0, decimation)
+    std::vector<std::int16_t> work{};           // history followed by the current chunk, capacity kept between calls
+
+    [[nodiscard]] bool enabled() const noexcept { return decimation > 1UZ; }
+
+    // windowed-sinc (Blackman) low-pass with the cut-off at 80% of the decimated Nyquist frequency and unity DC gain
+    [[nodiscard]] static std::vector<float> designLowPass(std::size_t decimation, std::size_t tapsPerPhase = 16UZ) {
+        const std::size_t   nTaps  = tapsPerPhase * decimation + 1UZ;
+        const double        cutoff = 0.8 * 0.5 / static_cast<double>(decimation); // normalised to the input sample rate
+        const double        centre = static_cast<double>(nTaps - 1UZ) / 2.0;
+        std::vector<double> taps(nTaps);
+        for (std::size_t k = 0UZ; k < nTaps; ++k) {
+            const double x      = static_cast<double>(k) - centre;
+            const double sinc   = x == 0.0 ? 2.0 * cutoff : std::sin(2.0 * std::numbers::pi * cutoff * x) / (std::numbers::pi * x);
+            const double phase  = 2.0 * std::numbers::pi * static_cast<double>(k) / static_cast<double>(nTaps - 1UZ);
+            const double window = 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase);
+            taps[k]             = sinc * window;
+        }
+        const double        sum = std::accumulate(taps.begin(), taps.end(), 0.0);
+        std::vector<float> result(nTaps);
+        std::ranges::transform(taps, result.begin(), [sum](double tap) { return static_cast<float>(tap / sum); });
+        return result;
+    }
+
+    void configure(std::size_t decimation_, std::span<const float> taps_, float scale, float offset_) {
+        decimation = std::max(decimation_, 1UZ);
+        if (!enabled()) {
+            taps.clear();
+        } else if (taps_.empty()) {
+            taps = designLowPass(decimation);
+        } else {
+            taps.assign(taps_.begin(), taps_.end());
+        }
+        scaledTaps.resize(taps.size());
+        std::ranges::transform(taps | std::views::reverse, scaledTaps.begin(), [scale](float tap) { return tap * scale; });
+        offset = offset_ * std::accumulate(taps.begin(), taps.end(), 0.f);
+        reset();
+    }
+
+    // raw samples kept between chunks: the filter history, but at least the samples since the last output
+    [[nodiscard]] std::size_t historySize() const noexcept { return std::max(scaledTaps.size(), decimation) - 1UZ; }
+
+    // forgets the filter history, e.g. after dropped samples
+    void reset() {
+        pending = 0UZ;
+        work.assign(historySize(), std::int16_t{0});
+    }
+
+    [[nodiscard]] std::size_t outputCount(std::size_t nInput) const noexcept { return enabled() ? (pending + nInput) / decimation : nInput; }
+    [[nodiscard]] std::size_t inputCount(std::size_t nOutput) const noexcept { return enabled() ? (nOutput == 0UZ ? 0UZ : nOutput * decimation - pending) : nOutput; }
+
+    // advances the decimation phase without filtering, keeps outputCount() consistent if no channel is processed
+    void skip(std::size_t nInput) noexcept { pending = enabled() ? (pending + nInput) % decimation : 0UZ; }
+
+    /**
+     * Filters and decimates raw, writing outputCount(raw.size()) samples to out. Every output is also flagged as over-range in overRange (if not empty)
+     * if one of the raw samples since the previous output was at ±maxValue, so that over-range intervals can be reported in the decimated time base.
+     */
+    std::size_t process(std::span<const std::int16_t> raw, std::span<float> out, std::span<std::int16_t> overRange = {}, std::int16_t maxValue = std::numeric_limits<std::int16_t>::max()) {
+        assert(enabled());
+        const std::size_t nOutput = outputCount(raw.size());
+        assert(out.size() >= nOutput && (overRange.empty() || overRange.size() >= nOutput));
+        const std::size_t history = historySize();
+        work.resize(history);
+        work.insert(work.end(), raw.begin(), raw.end());
+
+        const auto  minValue = static_cast<std::int16_t>(-maxValue);
+        std::size_t last     = history + (decimation - pending) - 1UZ; // index in work of the newest sample of the first output
+        for (std::size_t m = 0UZ; m < nOutput; ++m, last += decimation) {
+            const std::int16_t* window = work.data() + (last + 1UZ - scaledTaps.size());
+            std::array<float, kLanes> partial{};
+            std::size_t               k = 0UZ;
+            for (; k + kLanes <= scaledTaps.size(); k += kLanes) {
+                for (std::size_t lane = 0UZ; lane < kLanes; ++lane) {
+                    partial[lane] += scaledTaps[k + lane] * static_cast<float>(window[k + lane]);
+                }
+            }
+            for (; k < scaledTaps.size(); ++k) {
+                partial[0] += scaledTaps[k] * static_cast<float>(window[k]);
+            }
+            out[m] = offset + std::accumulate(partial.begin(), partial.end(), 0.f);
+            if (!overRange.empty()) {
+                std::size_t clipped = 0UZ;
+                for (std::size_t k = last + 1UZ - decimation; k <= last; ++k) {
+                    clipped += static_cast<std::size_t>((work[k] >= maxValue) | (work[k] <= minValue));
+                }
+                overRange[m] = clipped > 0UZ ? maxValue : std::int16_t{0};
+            }
+        }
+        pending = (pending + raw.size()) % decimation;
+        work.erase(work.begin(), work.end() - static_cast<std::ptrdiff_t>(history)); // keep the history for the next chunk
+        return nOutput;
+    }
+};
+
+} // namespace fair::picoscope::kernel
+
+#endif // FAIR_PICOSCOPE_DECIMATINGFIR_HPP
@@ -0,0 +1,208 @@
+#ifndef FAIR_PICOSCOPE_DRIVERBUFFER_HPP
+#define FAIR_PICOSCOPE_DRIVERBUFFER_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace fair::picoscope {
+
+enum class DriverBufferPages {
+    Normal,      // regular pages
+    Transparent, // transparent huge pages via madvise(MADV_HUGEPAGE), effective if /sys/kernel/mm/transparent_hugepage/enabled is `madvise` or `always`
+    Explicit     // MAP_HUGETLB from the pages reserved with `vm.nr_hugepages`, falls back to Transparent if there are not enough
+};
+
+struct DriverBufferOptions {
+    DriverBufferPages pages    = DriverBufferPages::Transparent;
+    bool              lock     = false; // mlock(), needs CAP_IPC_LOCK or a sufficient RLIMIT_MEMLOCK
+    bool              prefault = true;  // fault in all pages when the buffer is allocated instead of on the first write of the driver
+
+    bool operator==(const DriverBufferOptions&) const = default;
+};
+
+// what was applied to the current allocation, may be less than requested
+struct DriverBufferPlacement {
+    std::size_t       bytes      = 0UZ; // mapped, a multiple of DriverBuffer::kHugePageSize
+    DriverBufferPages pages      = DriverBufferPages::Normal;
+    bool              locked     = false;
+    bool              prefaulted = false;
+    std::string       degraded{}; // why requested options were not applied, empty if all were
+};
+
+/**
+ * Acquisition memory the driver writes into (PicoscopeWrapper::data). An anonymous mapping aligned to 2 MB huge pages, optionally locked and pre-faulted
+ * when the acquisition is configured, so the first chunks after arming do not run into the page fault path and TLB misses of freshly allocated memory.
+ * resize() keeps the mapping as long as the size does not grow, e.g. for restarts after configuration changes; unlike std::vector the contents are not
+ * preserved. Options which need privileges or reserved huge pages degrade to what is possible, see placement().
+ */
+template<typename T>
+class DriverBuffer {
+    static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>);
+
+public:
+    using value_type = T;
+
+    static constexpr std::size_t kHugePageSize = 2UZ << 20UZ;
+
+private:
+    void*                 _mapping = nullptr;
+    std::size_t           _size    = 0UZ;
+    bool                  _stale   = false; // the options changed, re-allocate on the next resize()
+    DriverBufferOptions   _options{};
+    DriverBufferPlacement _placement{};
+
+public:
+    DriverBuffer() = default;
+    explicit DriverBuffer(DriverBufferOptions options) : _options(options) {}
+    DriverBuffer(const DriverBuffer&)            = delete;
+    DriverBuffer& operator=(const DriverBuffer&) = delete;
+    DriverBuffer(DriverBuffer&& other) noexcept : _mapping(std::exchange(other._mapping, nullptr)), _size(std::exchange(other._size, 0UZ)), _stale(other._stale), _options(other._options), _placement(std::exchange(other._placement, {})) {}
+
+    DriverBuffer& operator=(DriverBuffer&& other) noexcept {
+        if (this != &other) {
+            release();
+            _mapping   = std::exchange(other._mapping, nullptr);
+            _size      = std::exchange(other._size, 0UZ);
+            _stale     = other._stale;
+            _options   = other._options;
+            _placement = std::exchange(other._placement, {});
+        }
+        return *this;
+    }
+
+    ~DriverBuffer() { release(); }
+
+    // applies from the next resize() on, which then re-allocates; the current memory stays valid until then, the driver may still be writing to it
+    void setOptions(DriverBufferOptions options) {
+        if (options != _options) {
+            _options = options;
+            _stale   = _mapping != nullptr;
+        }
+    }
+
+    [[nodiscard]] const DriverBufferOptions&   options() const noexcept { return _options; }
+    [[nodiscard]] const DriverBufferPlacement& placement() const noexcept { return _placement; }
+
+    /**
+     * Sets the size to `n` elements. Returns true if the memory was (re-)allocated, i.e. data() and placement() changed. The contents are unspecified
+     * afterwards. Throws std::bad_alloc if no memory can be mapped at all.
+     */
+    bool resize(std::size_t n) {
+        if (!_stale && n * sizeof(T) <= _placement.bytes) {
+            _size = n;
+            return false;
+        }
+        release();
+        if (n > 0UZ) {
+            allocate(n * sizeof(T));
+            _size = n;
+        }
+        return true;
+    }
+
+    [[nodiscard]] T*          data() noexcept { return static_cast<T*>(_mapping); }
+    [[nodiscard]] const T*    data() const noexcept { return static_cast<const T*>(_mapping); }
+    [[nodiscard]] std::size_t size() const noexcept { return _size; }
+    [[nodiscard]] bool        empty() const noexcept { return _size == 0UZ; }
+    [[nodiscard]] T*          begin() noexcept { return data(); }
+    [[nodiscard]] T*          end() noexcept { return data() + _size; }
+    [[nodiscard]] const T*    begin() const noexcept { return data(); }
+    [[nodiscard]] const T*    end() const noexcept { return data() + _size; }
+    [[nodiscard]] T&          operator[](std::size_t i) noexcept { return data()[i]; }
+    [[nodiscard]] const T&    operator[](std::size_t i) const noexcept { return data()[i]; }
+
+private:
+    void release() noexcept {
+        if (_mapping != nullptr) {
+            ::munmap(_mapping, _placement.bytes); // also unlocks
+        }
+        _mapping   = nullptr;
+        _size      = 0UZ;
+        _stale     = false;
+        _placement = {};
+    }
+
+    static void addReason(DriverBufferPlacement& placement, std::string_view what) { placement.degraded += std::format("{}{}: {}", placement.degraded.empty() ? "" : "; ", what, std::strerror(errno)); }
+
+    // regular anonymous mapping starting at a huge page boundary, so transparent huge pages can back all of it
+    static void* mapAligned(std::size_t bytes) {
+        const std::size_t reserved = bytes + kHugePageSize;
+        void*             mapping  = ::mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        const auto        address = reinterpret_cast<std::uintptr_t>(mapping);
+        const auto        aligned = (address + kHugePageSize - 1UZ) & ~(kHugePageSize - 1UZ);
+        const std::size_t head    = aligned - address;
+        if (head > 0UZ) {
+            ::munmap(mapping, head);
+        }
+        ::munmap(reinterpret_cast<void*>(aligned + bytes), kHugePageSize - head);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    static void prefault(void* mapping, std::size_t bytes) noexcept {
+#ifdef MADV_POPULATE_WRITE
+        if (::madvise(mapping, bytes, MADV_POPULATE_WRITE) == 0) { // Linux >= 5.14
+            return;
+        }
+#endif
+        const auto     pageSize = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        volatile auto* memory   = static_cast<std::byte*>(mapping);
+        for (std::size_t offset = 0UZ; offset < bytes; offset += pageSize) {
+            memory[offset] = std::byte{0};
+        }
+    }
+
+    void allocate(std::size_t minBytes) {
+        DriverBufferPlacement placement{.bytes = (minBytes + kHugePageSize - 1UZ) / kHugePageSize * kHugePageSize};
+        void*                 mapping = MAP_FAILED;
+        if (_options.pages == DriverBufferPages::Explicit) {
+            mapping = ::mmap(nullptr, placement.bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (mapping != MAP_FAILED) {
+                placement.pages = DriverBufferPages::Explicit;
+            } else {
+                addReason(placement, "no explicit huge pages");
+            }
+        }
+        if (mapping == MAP_FAILED) {
+            mapping = mapAligned(placement.bytes);
+            if (_options.pages != DriverBufferPages::Normal) {
+                if (::madvise(mapping, placement.bytes, MADV_HUGEPAGE) == 0) {
+                    placement.pages = DriverBufferPages::Transparent;
+                } else {
+                    addReason(placement, "no transparent huge pages");
+                }
+            }
+        }
+        if (_options.lock) {
+            if (::mlock(mapping, placement.bytes) == 0) {
+                placement.locked     = true;
+                placement.prefaulted = true; // mlock faults in all pages
+            } else {
+                addReason(placement, "cannot lock the buffer");
+            }
+        }
+        if (_options.prefault && !placement.prefaulted) {
+            prefault(mapping, placement.bytes);
+            placement.prefaulted = true;
+        }
+        _mapping   = mapping;
+        _placement = std::move(placement);
+    }
+};
+
+} // namespace fair::picoscope
+
+#endif // FAIR_PICOSCOPE_DRIVERBUFFER_HPP
@@ -0,0 +1,318 @@
+#ifndef GR_DIGITIZERS_INTERVALTIMINGMATCHER_HPP
+#define GR_DIGITIZERS_INTERVALTIMINGMATCHER_HPP
+
+#include <fair/picoscope/TimingMatcher.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace fair::picoscope::timingmatcher {
+
+/**
+ * Alternative to the greedy `TimingMatcher` for dense and overlapping trigger pulses. Can be selected per block via the `TTagMatcher` template parameter
+ * of `Picoscope`, e.g. `Picoscope<float, Picoscope5000a, timingmatcher::IntervalTimingMatcher>`, and provides the same `MatcherResult` contract.
+ *
+ * Instead of walking tags and edges pairwise, the matcher works on the whole time window of the current chunk:
+ *  1. all hw-trigger tags and hw edges are indexed by their local time and every tag only considers the edges within `±timeout` of its local time
+ *  2. tags and edges are assigned by an order-preserving min-cost assignment (cost: |t_tag - t_edge|, leaving a tag or an edge unassigned costs `timeout`)
+ *  3. every assignment becomes an anchor (sample index <-> WR time). Tags without edge are realigned relative to the anchor which is closest in WR time,
+ *     up to `maxAnchors` anchors are retained across chunks.
+ *
+ *  idx                  123456789012345678901234567890
+ *                             ┌─┐┌─┐    ┌─┐      ┌──┐
+ *  pulse                ──────┘ └┘ └────┘ └──────┘  └─
+ *  tag                        x  x      x        xx
+ *  evt1 ──────────────────────┘  │      │        ││    greedy and interval matcher: regular match
+ *  evt2 ─────────────────────────┘      │        ││    dense pulses: each tag gets the edge closest in time instead of the next unconsumed one
+ *                                       !        ││    spurious edge without tag -> UNKNOWN_EVENT, but does not shift the assignment of the following tags
+ *  evt4 ─────────────────────────────────────────┘│    first of two overlapping hardware pulses gets the edge
+ *  evt5 ──────────────────────────────────────────┘    second one is realigned relative to the closest anchor (here: evt4)
+ */
+struct IntervalTimingMatcher {
+    std::chrono::nanoseconds timeout;
+    float                    sampleRate = 1000.f;
+    std::size_t              maxAnchors = 8UZ; // number of matched tags retained across chunks for realignment
+
+    struct Anchor {
+        std::ptrdiff_t index; // idx relative to the next unprocessed chunk
+        std::uint64_t  time;  // WR time of the matched tag in ns
+    };
+    std::vector<Anchor> _anchors; // ordered by index, oldest first
+
+private:
+    struct TagEntry {
+        std::chrono::nanoseconds localTime{};
+        std::chrono::nanoseconds wrTime{};
+        std::chrono::nanoseconds offset{};
+        bool                     valid     = false;
+        bool                     hwTrigger = false;
+    };
+
+    static constexpr std::size_t kUnassigned = std::numeric_limits<std::size_t>::max();
+
+    enum class Choice : std::uint8_t { Match, SkipTag, SkipEdge };
+
+    // scratch buffers, kept to avoid re-allocations for every chunk
+    std::vector<TagEntry>     _entries;
+    std::vector<std::size_t>  _hwTags;      // indices into `_entries` which take part in the assignment
+    std::vector<std::size_t>  _edgeForTag;  // per entry: assigned index into triggerSampleIndices or kUnassigned
+    std::vector<bool>         _edgeUsed;    // per edge: assigned to any tag
+    std::vector<std::int64_t> _best;        // nEdges + 1 best assignment values, updated in place tag by tag
+    std::vector<Choice>       _choices;     // per hw tag and edge within its window: decision of the assignment, for the backtracking
+    std::vector<std::size_t>  _windowBegin; // per hw tag: first edge within ±timeout
+    std::vector<std::size_t>  _windowEnd;   // per hw tag: one past the last edge within ±timeout
+
+    [[nodiscard]] std::chrono::nanoseconds sampleTime(std::size_t index, std::chrono::nanoseconds localAcqTime) const { return localAcqTime + std::chrono::nanoseconds(static_cast<std::int64_t>(1e9 / static_cast<double>(sampleRate) * static_cast<double>(index))); }
+
+    [[nodiscard]] static TagEntry parseTag(const gr::property_map& tag) {
+        if (!TimingMatcher::checkValidTimingTag(tag)) {
+            return {};
+        }
+        const auto* metaMap            = tag.get_if<gr::property_map>(gr::tag::TRIGGER_META_INFO.shortKey());
+        const auto* maybeLocalTime     = metaMap->get_if<unsigned long>("LOCAL-TIME");
+        const auto* maybeHwTrigger     = metaMap->get_if<bool>("HW-TRIGGER");
+        const auto* maybeTriggerTime   = tag.get_if<unsigned long>(gr::tag::TRIGGER_TIME.shortKey());
+        const auto* maybeTriggerOffset = tag.get_if<float>(gr::tag::TRIGGER_OFFSET.shortKey());
+        if (!maybeLocalTime || !maybeHwTrigger || !maybeTriggerTime || !maybeTriggerOffset) {
+            return {};
+        }
+        return {.localTime = std::chrono::nanoseconds(*maybeLocalTime), .wrTime = std::chrono::nanoseconds(*maybeTriggerTime), .offset = std::chrono::nanoseconds(static_cast<std::int64_t>(*maybeTriggerOffset)), .valid = true, .hwTrigger = *maybeHwTrigger};
+    }
+
+    /**
+     * order preserving min-cost assignment between the hw tags and the edges, both are sorted in time. Only pairs within the ±timeout window are
+     * considered for an assignment, leaving a tag or an edge unassigned costs `timeout` each, so any pair inside the window is preferred over skipping both.
+     *
+     * Equivalent to maximising the sum of `2 * timeout - |t_tag - t_edge|` over the assigned pairs. The dynamic programme only visits the window of each
+     * tag: left of it a tag cannot add to the best value, right of it the value is the one at the window end. As the windows slide monotonically, a single
+     * row of best values is updated in place, the cost per chunk is O(nTags + nEdges + sum of the window sizes) instead of O(nTags * nEdges).
+     */
+    void assign(const std::span<const std::size_t> edges, const std::chrono::nanoseconds localAcqTime) {
+        const std::size_t nTags  = _hwTags.size();
+        const std::size_t nEdges = edges.size();
+        const auto        skip   = static_cast<std::int64_t>(timeout.count());
+
+        _windowBegin.assign(nTags, 0UZ);
+        _windowEnd.assign(nTags, 0UZ);
+        std::size_t lo = 0UZ;
+        std::size_t hi = 0UZ;
+        for (std::size_t i = 0UZ; i < nTags; ++i) { // sliding window over the edges, the tags are ordered by local time
+            const auto tagTime = _entries[_hwTags[i]].localTime;
+            while (lo < nEdges && sampleTime(edges[lo], localAcqTime) + timeout < tagTime) {
+                ++lo;
+            }
+            hi = std::max(hi, lo);
+            while (hi < nEdges && sampleTime(edges[hi], localAcqTime) <= tagTime + timeout) {
+                ++hi;
+            }
+            _windowBegin[i] = lo;
+            _windowEnd[i]   = hi;
+        }
+
+        // _best[j]: best value of the tags processed so far using the first j edges, exact for j <= `materialized`, equal to _best[materialized] beyond
+        _best.assign(nEdges + 1UZ, 0);
+        _choices.clear();
+        std::size_t materialized = 0UZ;
+        for (std::size_t i = 0UZ; i < nTags; ++i) {
+            const std::size_t begin = _windowBegin[i];
+            const std::size_t end   = _windowEnd[i];
+            for (; materialized < end; ++materialized) {
+                _best[materialized + 1UZ] = _best[materialized];
+            }
+            const auto   tagTime  = _entries[_hwTags[i]].localTime;
+            std::int64_t diagonal = _best[begin]; // best value of the previous tags with one edge less
+            for (std::size_t j = begin + 1UZ; j <= end; ++j) {
+                const std::int64_t up     = _best[j];
+                const std::int64_t left   = _best[j - 1UZ];
+                const std::int64_t match  = diagonal + 2 * skip - std::abs((tagTime - sampleTime(edges[j - 1UZ], localAcqTime)).count());
+                const Choice       choice = match >= std::max(up, left) ? Choice::Match : (up >= left ? Choice::SkipTag : Choice::SkipEdge);
+                diagonal                  = up;
+                _best[j]                  = std::max({match, up, left});
+                _choices.push_back(choice);
+            }
+        }
+
+        // backtrack the optimal assignment, _choices holds the window of every tag back to back
+        std::size_t i          = nTags;
+        std::size_t j          = nEdges;
+        std::size_t choicesEnd = _choices.size();
+        while (i > 0UZ && j > 0UZ) {
+            const std::size_t begin = _windowBegin[i - 1UZ];
+            const std::size_t end   = _windowEnd[i - 1UZ];
+            if (j > end) { // right of the window: the best value is the one at the window end
+                j = end;
+                continue;
+            }
+            if (j <= begin) { // left of the window: the tag stays unassigned
+                choicesEnd -= end - begin;
+                --i;
+                continue;
+            }
+            switch (_choices[choicesEnd - (end - begin) + (j - begin - 1UZ)]) {
+            case Choice::Match:
+                _edgeForTag[_hwTags[i - 1UZ]] = j - 1UZ;
+                _edgeUsed[j - 1UZ]            = true;
+                choicesEnd -= end - begin;
+                --i;
+                --j;
+                break;
+            case Choice::SkipTag:
+                choicesEnd -= end - begin;
+                --i;
+                break;
+            case Choice::SkipEdge: --j; break;
+            }
+        }
+    }
+
+    [[nodiscard]] const Anchor* closestAnchor(std::chrono::nanoseconds wrTime) const {
+        const Anchor* best = nullptr;
+        for (const Anchor& anchor : _anchors) {
+            if (!best || std::abs(static_cast<std::int64_t>(anchor.time) - wrTime.count()) < std::abs(static_cast<std::int64_t>(best->time) - wrTime.count())) {
+                best = &anchor;
+            }
+        }
+        return best;
+    }
+
+    [[nodiscard]] std::pair<std::ptrdiff_t, gr::property_map> alignTagRelativeTo(const Anchor& anchor, const TagEntry& entry, const gr::property_map& tag) const {
+        const float Ts          = 1e9f / sampleRate;
+        const auto  deltaTime   = entry.wrTime + entry.offset - std::chrono::nanoseconds(anchor.time);
+        const auto  delta       = static_cast<float>(deltaTime.count()) / Ts;
+        const auto  deltaIdx    = static_cast<std::ptrdiff_t>(std::floor(delta));
+        const auto  deltaOffset = (delta - static_cast<float>(deltaIdx)) / sampleRate;
+        gr::property_map alignedTag = tag;
+        alignedTag.insert_or_assign(gr::tag::TRIGGER_OFFSET.shortKey(), deltaOffset);
+        return {anchor.index + deltaIdx, std::move(alignedTag)};
+    }
+
+    [[nodiscard]] gr::Tag getOffsetAdjustedTag(std::size_t flankIndex, std::chrono::nanoseconds tagOffset, const gr::property_map& tag) const {
+        gr::property_map matchedTag = tag;
+        const float      deltaT     = static_cast<float>(tagOffset.count()) * (sampleRate / 1e9f);
+        auto             offsetIdx  = static_cast<std::ptrdiff_t>(deltaT);
+        float            offset     = deltaT - static_cast<float>(offsetIdx);
+        if (offset < 0.0f) {
+            --offsetIdx;
+            offset += 1.0f;
+        }
+        matchedTag.insert_or_assign(gr::tag::TRIGGER_OFFSET.shortKey(), offset);
+        return {static_cast<std::size_t>(std::max<std::ptrdiff_t>(0, static_cast<std::ptrdiff_t>(flankIndex) + offsetIdx)), std::move(matchedTag)};
+    }
+
+public:
+    MatcherResult match(const std::span<const gr::property_map> tags, const std::span<const std::size_t>& triggerSampleIndices, const std::size_t nSamples, const std::chrono::nanoseconds localAcqTime) {
+        MatcherResult result;
+        match(tags, triggerSampleIndices, nSamples, localAcqTime, result);
+        return result;
+    }
+
+    // as above, but re-uses the vectors of `result` (e.g. a member of the caller), so chunks without tags do not allocate
+    void match(const std::span<const gr::property_map> tags, const std::span<const std::size_t>& triggerSampleIndices, const std::size_t nSamples, const std::chrono::nanoseconds localAcqTime, MatcherResult& result) {
+        FAIR_TRACE_SPAN("IntervalTimingMatcher::match", "matcher");
+        result.clear();
+        const auto        maxDelaySamples = static_cast<std::size_t>(static_cast<float>(std::chrono::nanoseconds(timeout).count()) * 1e-9f * sampleRate);
+        const std::size_t safeSamples     = nSamples > maxDelaySamples ? nSamples - maxDelaySamples : 0;
+        const auto        chunkEndTime    = sampleTime(nSamples, localAcqTime);
+
+        // index all tags and select the ones taking part in the assignment
+        _entries.clear();
+        _hwTags.clear();
+        for (const gr::property_map& tag : tags) {
+            const TagEntry& entry = _entries.emplace_back(parseTag(tag));
+            if (entry.valid && entry.hwTrigger && entry.localTime + timeout >= localAcqTime) {
+                _hwTags.push_back(_entries.size() - 1UZ);
+            }
+        }
+        _edgeForTag.assign(_entries.size(), kUnassigned);
+        _edgeUsed.assign(triggerSampleIndices.size(), false);
+        assign(triggerSampleIndices, localAcqTime);
+
+        // every assignment serves as an anchor for the realignment of tags without hw edge (also the ones located before the anchor)
+        const std::size_t nHistoricAnchors = _anchors.size();
+        for (std::size_t k = 0UZ; k < _entries.size(); ++k) {
+            if (_edgeForTag[k] != kUnassigned) {
+                _anchors.push_back({static_cast<std::ptrdiff_t>(triggerSampleIndices[_edgeForTag[k]]), static_cast<std::uint64_t>(_entries[k].wrTime.count())});
+            }
+        }
+
+        // resolve tags in order, stop at the first tag which cannot be resolved with the data available so far
+        std::size_t processedSampleLimit = nSamples; // edges which belong to tags that are kept for the next chunk must not be consumed
+        std::size_t nAnchorsConsumed     = nHistoricAnchors;
+        std::size_t maxPublishedIndex    = 0UZ;
+        for (; result.processedTags < _entries.size(); ++result.processedTags) {
+            const std::size_t       k     = result.processedTags;
+            const TagEntry&         entry = _entries[k];
+            const gr::property_map& tag   = tags[k];
+            if (!entry.valid) {
+                result.messages.emplace_back(std::format("Invalid timing tag at index {}: {}", k, tag));
+                result.drop(DropReason::InvalidTag);
+                continue;
+            }
+            if (_edgeForTag[k] != kUnassigned) { // regular match
+                gr::Tag matched   = getOffsetAdjustedTag(triggerSampleIndices[_edgeForTag[k]], entry.offset, tag);
+                maxPublishedIndex = std::max(maxPublishedIndex, triggerSampleIndices[_edgeForTag[k]]);
+                result.tags.push_back(std::move(matched));
+                ++nAnchorsConsumed;
+                continue;
+            }
+            if (entry.hwTrigger && entry.localTime + timeout >= chunkEndTime) { // hw edge may still arrive with the next chunk
+                const auto earliestEdgeTime = entry.localTime - timeout - localAcqTime;
+                processedSampleLimit        = std::min(processedSampleLimit, static_cast<std::size_t>(std::max<std::int64_t>(0, static_cast<std::int64_t>(static_cast<double>(earliestEdgeTime.count()) * 1e-9 * static_cast<double>(sampleRate)))));
+                break;
+            }
+            const Anchor* anchor = closestAnchor(entry.wrTime);
+            if (!anchor) {                                              // no reference yet, keep the tag unless it is outdated
+                if (entry.localTime + 2 * timeout < chunkEndTime) { // needs twice the timeout, since it is already contained once in the unpublished samples
+                    result.messages.emplace_back(std::format("dropping outdated(chunkEndTime={}, timeout={}) tag without reference: {}", chunkEndTime, timeout, tag));
+                    result.drop(DropReason::Outdated);
+                    continue;
+                }
+                break;
+            }
+            auto [index, alignedTag] = alignTagRelativeTo(*anchor, entry, tag);
+            if (index < 0) {
+                result.messages.emplace_back(std::format("dropping tag which realigns before the current chunk (index={}): {}", index, tag));
+                result.drop(DropReason::BeforeChunk);
+                continue;
+            }
+            if (static_cast<std::size_t>(index) >= nSamples) { // tag belongs to a future chunk
+                break;
+            }
+            maxPublishedIndex = std::max(maxPublishedIndex, static_cast<std::size_t>(index));
+            result.tags.emplace_back(static_cast<std::size_t>(index), std::move(alignedTag));
+        }
+
+        // edges assigned to tags which are retained for the next chunk limit the number of samples that can be consumed
+        for (std::size_t k = result.processedTags; k < _entries.size(); ++k) {
+            if (_edgeForTag[k] != kUnassigned) {
+                processedSampleLimit = std::min(processedSampleLimit, triggerSampleIndices[_edgeForTag[k]]);
+            }
+        }
+        result.processedSamples = std::max(std::min(safeSamples, processedSampleLimit), maxPublishedIndex);
+
+        // edges without tag and past the deadline -> UNKNOWN_EVENT
+        for (std::size_t edgeIdx = 0UZ; edgeIdx < triggerSampleIndices.size(); ++edgeIdx) {
+            if (!_edgeUsed[edgeIdx] && triggerSampleIndices[edgeIdx] < result.processedSamples) {
+                result.tags.push_back(TimingMatcher::createUnknownEventTag(triggerSampleIndices[edgeIdx], sampleTime(triggerSampleIndices[edgeIdx], localAcqTime)));
+                result.unknownEvents++;
+            }
+        }
+        std::ranges::stable_sort(result.tags, std::less{}, &gr::Tag::index);
+
+        // retain the newest anchors of consumed tags and re-adjust them relative to the start of the next chunk
+        _anchors.resize(nAnchorsConsumed);
+        if (_anchors.size() > maxAnchors) {
+            _anchors.erase(_anchors.begin(), _anchors.end() - static_cast<std::ptrdiff_t>(maxAnchors));
+        }
+        for (Anchor& anchor : _anchors) {
+            anchor.index -= static_cast<std::ptrdiff_t>(result.processedSamples);
+        }
+    }
+
+    void reset() { _anchors.clear(); }
+};
+
+} // namespace fair::picoscope::timingmatcher
+
+#endif // GR_DIGITIZERS_INTERVALTIMINGMATCHER_HPP
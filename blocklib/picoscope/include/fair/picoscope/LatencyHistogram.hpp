@@ -0,0 +1,138 @@
+#ifndef FAIR_PICOSCOPE_LATENCYHISTOGRAM_HPP
+#define FAIR_PICOSCOPE_LATENCYHISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <utility>
+
+namespace fair::picoscope {
+
+/**
+ * Fixed size log-linear (HDR style) histogram of durations in [ns]: values below 64 are exact, above that each power of two is split into 32
+ * buckets, i.e. percentiles are accurate to about 3% over the full 64 bit range. Recording is wait-free and allocation free (one writer thread), the
+ * counters can be read concurrently, e.g. to publish percentiles while acquiring.
+ */
+class LatencyHistogram {
+public:
+    static constexpr std::size_t kSubBucketBits = 5UZ;
+    static constexpr std::size_t kSubBuckets    = 1UZ << kSubBucketBits;
+    static constexpr std::size_t kBuckets       = (64UZ - kSubBucketBits + 1UZ) * kSubBuckets;
+
+private:
+    std::array<std::atomic<std::uint64_t>, kBuckets> _counts{};
+    std::atomic<std::uint64_t>                       _total{0UZ};
+    std::atomic<std::uint64_t>                       _sum{0UZ}; // [ns]
+    std::atomic<std::uint64_t>                       _max{0UZ}; // [ns]
+
+public:
+    [[nodiscard]] static constexpr std::size_t bucketIndex(std::uint64_t value) noexcept {
+        if (value < 2UZ * kSubBuckets) {
+            return static_cast<std::size_t>(value);
+        }
+        const auto width = static_cast<std::size_t>(std::bit_width(value)); // >= kSubBucketBits + 2
+        const auto shift = width - kSubBucketBits - 1UZ;
+        return (shift + 1UZ) * kSubBuckets + static_cast<std::size_t>((value >> shift) - kSubBuckets);
+    }
+
+    // smallest value of the bucket
+    [[nodiscard]] static constexpr std::uint64_t bucketValue(std::size_t index) noexcept {
+        if (index < 2UZ * kSubBuckets) {
+            return index;
+        }
+        const std::size_t shift = index / kSubBuckets - 1UZ;
+        return (static_cast<std::uint64_t>(kSubBuckets + index % kSubBuckets)) << shift;
+    }
+
+    // single writer: the read-modify-write is split into relaxed loads and stores, readers may see a slightly inconsistent snapshot
+    void record(std::uint64_t ns) noexcept {
+        auto& count = _counts[bucketIndex(ns)];
+        count.store(count.load(std::memory_order_relaxed) + 1UZ, std::memory_order_relaxed);
+        _sum.store(_sum.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+        if (ns > _max.load(std::memory_order_relaxed)) {
+            _max.store(ns, std::memory_order_relaxed);
+        }
+        _total.store(_total.load(std::memory_order_relaxed) + 1UZ, std::memory_order_release);
+    }
+
+    template<typename Rep, typename Period>
+    void record(std::chrono::duration<Rep, Period> duration) noexcept {
+        record(static_cast<std::uint64_t>(std::max<std::int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), 0)));
+    }
+
+    void reset() noexcept {
+        for (auto& count : _counts) {
+            count.store(0UZ, std::memory_order_relaxed);
+        }
+        _sum.store(0UZ, std::memory_order_relaxed);
+        _max.store(0UZ, std::memory_order_relaxed);
+        _total.store(0UZ, std::memory_order_release);
+    }
+
+    [[nodiscard]] std::uint64_t count() const noexcept { return _total.load(std::memory_order_acquire); }
+    [[nodiscard]] std::uint64_t bucketCount(std::size_t index) const noexcept { return _counts[index].load(std::memory_order_relaxed); }
+    [[nodiscard]] std::uint64_t max() const noexcept { return _max.load(std::memory_order_relaxed); }
+    [[nodiscard]] double        mean() const noexcept {
+        const auto n = count();
+        return n > 0UZ ? static_cast<double>(_sum.load(std::memory_order_relaxed)) / static_cast<double>(n) : 0.0;
+    }
+
+    // value below which the fraction `quantile` (0..1) of the recorded durations lie, 0 if empty
+    [[nodiscard]] std::uint64_t percentile(double quantile) const noexcept {
+        std::uint64_t total = 0UZ;
+        for (const auto& c : _counts) {
+            total += c.load(std::memory_order_relaxed);
+        }
+        if (total == 0UZ) {
+            return 0UZ;
+        }
+        const auto    rank       = static_cast<std::uint64_t>(std::clamp(quantile, 0.0, 1.0) * static_cast<double>(total - 1UZ));
+        std::uint64_t cumulative = 0UZ;
+        for (std::size_t i = 0UZ; i < kBuckets; ++i) {
+            cumulative += _counts[i].load(std::memory_order_relaxed);
+            if (cumulative > rank) {
+                const std::uint64_t upper = i + 1UZ < kBuckets ? bucketValue(i + 1UZ) - 1UZ : std::numeric_limits<std::uint64_t>::max();
+                return std::min(bucketValue(i) + (upper - bucketValue(i)) / 2UZ, max()); // bucket centre
+            }
+        }
+        return max();
+    }
+};
+
+/**
+ * Stages of the acquisition path, timestamped in `Picoscope::processBulk` and the driver callback of `PicoscopeWrapper::poll`:
+ *  - driver:     poll() call -> driver delivered the data (waiting for and copying out of the driver)
+ *  - conversion: driver ready -> converted samples (raw recording, digital port merge, ADC conversion, decimation)
+ *  - poll:       end of the data handler -> poll() returned
+ *  - match:      timing tag matching (Streaming: incl. trigger edge collection)
+ *  - publish:    matched -> samples and tags published (snapshots, spectra, tag publishing)
+ *  - total:      driver ready -> published
+ */
+enum class LatencyStage : std::size_t { Driver, Conversion, Poll, Match, Publish, Total };
+
+struct AcquisitionLatencies {
+    static constexpr std::array<std::string_view, 6UZ> kStageNames{"driver", "conversion", "poll", "match", "publish", "total"};
+
+    std::array<LatencyHistogram, kStageNames.size()> stages{};
+
+    [[nodiscard]] LatencyHistogram&       operator[](LatencyStage stage) noexcept { return stages[std::to_underlying(stage)]; }
+    [[nodiscard]] const LatencyHistogram& operator[](LatencyStage stage) const noexcept { return stages[std::to_underlying(stage)]; }
+
+    void record(LatencyStage stage, std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) noexcept { (*this)[stage].record(to - from); }
+
+    void reset() noexcept {
+        for (auto& stage : stages) {
+            stage.reset();
+        }
+    }
+};
+
+} // namespace fair::picoscope
+
+#endif // FAIR_PICOSCOPE_LATENCYHISTOGRAM_HPP
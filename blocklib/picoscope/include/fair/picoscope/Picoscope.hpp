@@ -1,16 +1,27 @@
 #ifndef FAIR_PICOSCOPE_PICOSCOPE_HPP
 #define FAIR_PICOSCOPE_PICOSCOPE_HPP
 
+#include <fair/picoscope/Calibration.hpp>
+#include <fair/picoscope/ConversionKernel.hpp>
+#include <fair/picoscope/DecimatingFir.hpp>
+#include <fair/picoscope/LatencyHistogram.hpp>
 #include <fair/picoscope/PicoscopeAPI.hpp>
+#include <fair/picoscope/SampleHistory.hpp>
+#include <fair/picoscope/Spectrum.hpp>
+#include <fair/picoscope/TriggerFilter.hpp>
+#include <fair/thread/ThreadPlacement.hpp>
+#include <fair/trace/Trace.hpp>
 
 #include <gnuradio-4.0/Block.hpp>
-#include <gnuradio-4.0/HistoryBuffer.hpp>
 #include <gnuradio-4.0/algorithm/dataset/DataSetUtils.hpp>
 
 #include <format>
 
 #include <chrono>
+#include <deque>
+#include <memory>
 #include <string_view>
+#include <thread>
 
 namespace fair::picoscope {
 using namespace std::literals;
@@ -38,45 +49,6 @@ namespace detail {
     return static_cast<uint>(value);
 }
 
-struct TriggerNameAndCtx {
-    std::string                triggerName{};
-    std::optional<std::string> ctx{};
-};
-
-[[nodiscard]] static TriggerNameAndCtx createTriggerNameAndCtx(const std::string& triggerNameAndCtx) {
-    if (triggerNameAndCtx.empty()) {
-        return {};
-    }
-    if (const std::size_t pos = triggerNameAndCtx.find('/'); pos != std::string::npos) { // trigger_name and ctx
-        return {triggerNameAndCtx.substr(0, pos), (pos < triggerNameAndCtx.size() - 1) ? triggerNameAndCtx.substr(pos + 1) : ""};
-    }
-    return {triggerNameAndCtx, std::nullopt}; // only trigger_name
-}
-
-[[nodiscard, maybe_unused]] static bool tagContainsTrigger(const gr::property_map& map, const TriggerNameAndCtx& triggerNameAndCtx) { // unused if only streaming acq is used
-    if (triggerNameAndCtx.ctx) {                                                                                                      // trigger_name and ctx
-        if (map.contains(gr::tag::TRIGGER_NAME.shortKey()) && map.contains(gr::tag::CONTEXT.shortKey())) {
-            auto triggerNameValue = map.find_value(gr::tag::TRIGGER_NAME.shortKey());
-            auto contextValue     = map.find_value(gr::tag::CONTEXT.shortKey());
-            if (triggerNameValue && contextValue && triggerNameValue->is_string() && contextValue->is_string()) {
-                std::string_view tagTriggerName = triggerNameValue->value_or(std::string_view{});
-                return !tagTriggerName.empty() && tagTriggerName == triggerNameAndCtx.triggerName && contextValue.value_or(std::string_view{}) == *triggerNameAndCtx.ctx;
-            } else {
-                assert(false && "Invalid triggername or context type, expected string for both");
-            }
-        }
-    } else { // only trigger_name
-        if (map.contains(gr::tag::TRIGGER_NAME.shortKey())) {
-            auto triggerNameValue = map.find_value(gr::tag::TRIGGER_NAME.shortKey());
-            if (triggerNameValue && triggerNameValue->is_string()) {
-                std::string_view tagTriggerName = triggerNameValue->value_or(std::string_view{});
-                return !tagTriggerName.empty() && tagTriggerName == triggerNameAndCtx.triggerName;
-            }
-        }
-    }
-    return false;
-}
-
 template<typename TEnum>
 [[nodiscard]] constexpr TEnum convertToEnum(std::string_view strEnum) {
     auto enumType = magic_enum::enum_cast<TEnum>(strEnum, magic_enum::case_insensitive);
@@ -93,27 +65,44 @@ using A = gr::Annotated<T, description, Arguments...>;
 
 /**
  * We allow only a small set of sample types (SampleType) to be used as the output type for the Picoscope block:
- * - `std::int16_t`: Outputs raw values as-is, without any scaling. Also used for 8-bit native ADC.
+ * - `std::int16_t`: Outputs raw values as-is, without any scaling. Also used for 8-bit native ADC. The signal info tag carries the conversion to physical
+ *   units (see kernel::ConversionParameters), `RawScale` applies it downstream where needed.
  * - `float`: Outputs the physically gain-scaled values of the measurements.
  * - `gr::UncertainValue<float>`: Similar to `float`, but also includes an estimated measurement error as an additional component.
+ * - `std::float16_t`, `std::bfloat16_t`: Like `float` with half the buffer memory and inter-block bandwidth, if supported by the compiler
+ *   (FAIR_PICOSCOPE_HALF_PRECISION). The conversion uses F16C if enabled, e.g. with `-march=native`.
  *
  * The output type also determines the acquisition mode:
  * - For `DataSet<SampleType>`, the acquisition mode is **RapidBlock**.
  * - For `SampleType`, the acquisition mode is **Streaming**.
+ *
+ * The timing tag matcher is selected by `TTagMatcher`: `timingmatcher::TimingMatcher` (default, greedy) or `timingmatcher::IntervalTimingMatcher` for dense
+ * or overlapping trigger pulses.
  */
 template<typename T>
 concept PicoscopeOutput = std::disjunction_v<std::is_same<T, std::int16_t>, std::is_same<T, float>, std::is_same<T, gr::UncertainValue<float>>, //
-    std::is_same<T, gr::DataSet<std::int16_t>>, std::is_same<T, gr::DataSet<float>>, std::is_same<T, gr::DataSet<gr::UncertainValue<float>>>>;
+                              std::is_same<T, gr::DataSet<std::int16_t>>, std::is_same<T, gr::DataSet<float>>, std::is_same<T, gr::DataSet<gr::UncertainValue<float>>>> //
+                          || HalfPrecision<T> || (gr::DataSetLike<T> && HalfPrecision<typename T::value_type>);
+
+#ifdef FAIR_PICOSCOPE_HALF_PRECISION
+using PicoscopeSupportedTypes = gr::SupportedTypes<int16_t, float, gr::UncertainValue<float>, std::float16_t, std::bfloat16_t, //
+    gr::DataSet<int16_t>, gr::DataSet<float>, gr::DataSet<gr::UncertainValue<float>>, gr::DataSet<std::float16_t>, gr::DataSet<std::bfloat16_t>>;
+#else
+using PicoscopeSupportedTypes = gr::SupportedTypes<int16_t, float, gr::UncertainValue<float>, gr::DataSet<int16_t>, gr::DataSet<float>, gr::DataSet<gr::UncertainValue<float>>>;
+#endif
 
 template<PicoscopeOutput T, PicoscopeImplementationLike TPSImpl, typename TTagMatcher = timingmatcher::TimingMatcher>
-struct Picoscope : gr::Block<Picoscope<T, TPSImpl, TTagMatcher>, gr::SupportedTypes<int16_t, float, gr::UncertainValue<float>, gr::DataSet<int16_t>, gr::DataSet<float>, gr::DataSet<gr::UncertainValue<float>>>> {
-    using SuperT                                     = gr::Block<Picoscope, gr::SupportedTypes<int16_t, float, gr::UncertainValue<float>, gr::DataSet<int16_t>, gr::DataSet<float>, gr::DataSet<gr::UncertainValue<float>>>>;
-    static constexpr AcquisitionMode acquisitionMode = gr::DataSetLike<T> ? AcquisitionMode::RapidBlock : AcquisitionMode::Streaming;
+struct Picoscope : gr::Block<Picoscope<T, TPSImpl, TTagMatcher>, PicoscopeSupportedTypes> {
+    using SuperT                                          = gr::Block<Picoscope, PicoscopeSupportedTypes>;
+    static constexpr AcquisitionMode acquisitionMode      = gr::DataSetLike<T> ? AcquisitionMode::RapidBlock : AcquisitionMode::Streaming;
+    static constexpr float           kDefaultChannelRange = 5.f; // [V] channels without `channel_ranges` entry are configured and converted with ±5 V
 
     A<std::string, "serial number, empty selects first available device">            serial_number;
     A<float, "sample rate", gr::Visible>                                             sample_rate  = 10000.f;
-    A<gr::Size_t, "pre-samples">                                                     pre_samples  = 1000;  // RapidBlock mode only
-    A<gr::Size_t, "post-samples">                                                    post_samples = 1000;  // RapidBlock mode only
+    A<gr::Size_t, "decimation factor (streaming mode)">                              decimation   = 1;     // Streaming mode only, output rate: sample_rate / decimation
+    A<std::vector<float>, "decimation FIR taps, empty: windowed-sinc low-pass">      decimation_taps;      // Streaming mode only, unity DC gain
+    A<gr::Size_t, "pre-samples">                                                     pre_samples  = 1000;  // RapidBlock mode and streaming snapshots
+    A<gr::Size_t, "post-samples">                                                    post_samples = 1000;  // RapidBlock mode and streaming snapshots
     A<gr::Size_t, "no. captures (rapid block mode)">                                 n_captures   = 1;     // RapidBlock mode only
     A<bool, "trigger once (rapid block mode)">                                       trigger_once = false; // RapidBlock mode only
     A<bool, "do arm at start?">                                                      auto_arm     = true;
@@ -124,17 +113,35 @@ struct Picoscope : gr::Block<Picoscope<T, TPSImpl, TTagMatcher>, gr::SupportedTy
     A<std::vector<std::string>, "Signal names of enabled channels">                  signal_names;
     A<std::vector<std::string>, "Signal units of enabled channels">                  signal_units;
     A<std::vector<std::string>, "Signal quantity of enabled channels">               signal_quantities;
-    A<std::vector<float>, "Signal scales of the enabled channels">                   signal_scales;  // only for floats and UncertainValues
-    A<std::vector<float>, "Analog offsets of the channels">                          signal_offsets; // only for floats and UncertainValues
+    A<std::vector<float>, "Signal scales of the enabled channels">                   signal_scales;  // applied for floats and UncertainValues, published in the signal info tag for int16
+    A<std::vector<float>, "Analog offsets of the channels">                          signal_offsets; // applied for floats and UncertainValues, published in the signal info tag for int16
+    A<std::string, "calibration file, empty: nominal conversion">                    calibration_file; // per serial/channel/range polynomials, see CalibrationTable
     A<std::string, "trigger channel (A, B, C, ... or DI1, DI2, DI3, ... EXTERNAL)">  trigger_source;
     A<float, "trigger threshold, analog only">                                       trigger_threshold          = 0.f;
     A<TriggerDirection, "trigger direction">                                         trigger_direction          = TriggerDirection::Rising;
-    A<std::string, "trigger filter: `<trigger_name>[/<ctx>]`">                       trigger_filter             = "";
-    A<std::string, "arm trigger: `<trigger_name>[/<ctx>]`, if empty not used">       trigger_arm                = "";    // RapidBlock mode only
-    A<std::string, "disarm trigger: `<trigger_name>[/<ctx>]`, if empty not used">    trigger_disarm             = "";    // RapidBlock mode only
+    A<std::string, "trigger filter: `<trigger_name>[/<ctx>]`">                       trigger_filter             = "";    // Streaming mode: snapshots around matching timing tags on snapshotOut, syntax see TriggerFilter
+    A<std::string, "arm trigger: `<trigger_name>[/<ctx>]`, if empty not used">       trigger_arm                = "";    // RapidBlock mode only, syntax as trigger_filter
+    A<std::string, "disarm trigger: `<trigger_name>[/<ctx>]`, if empty not used">    trigger_disarm             = "";    // RapidBlock mode only, syntax as trigger_filter
+    A<RapidBlockLayout, "DataSet layout (rapid block mode)">                         rapid_block_layout         = RapidBlockLayout::PerChannel; // RapidBlock mode only
     A<bool, "Enable digital inputs">                                                 digital_port_enable        = false; // only used if digital ports are available: 3000a, 5000a series
     A<bool, "invert digital port output">                                            digital_port_invert_output = false; // only used if digital ports are available: 3000a, 5000a series
     A<gr::Size_t, "Timeout after which to not match trigger pulses", gr::Unit<"ns">> matcher_timeout            = 10'000'000z;
+    A<bool, "publish immediately, late matched tags are sent as messages">           low_latency                = false;     // Streaming mode only
+    A<gr::Size_t, "max. age of late tags", gr::Unit<"samples">>                      late_tag_horizon           = 1'000'000; // Streaming mode only, if low_latency is enabled
+    A<TimingTagPorts, "output ports carrying the matched timing tags">               timing_tag_ports           = TimingTagPorts::All;
+    A<gr::Size_t, "spectrum length (power of two), 0: disabled">                     spectrum_length            = 0;      // Streaming mode only: averaged power spectra on spectrumOut
+    A<float, "spectrum update rate", gr::Unit<"Hz">>                                 spectrum_update_rate       = 1.f;    // Streaming mode only, <= 0: one spectrum per segment
+    A<std::string, "spectrum window: rectangular, hann, hamming, blackman">          spectrum_window            = "hann"; // Streaming mode only
+    A<std::string, "align spectra to trigger: `<trigger_name>[/<ctx>]`">             spectrum_trigger           = "";     // Streaming mode only, restarts the averaging at matching timing tags
+    A<float, "sample history depth", gr::Unit<"s">>                                  history_depth              = 0.f;    // Streaming mode only: recent samples kept for `SampleHistory` requests
+    A<std::string, "raw recording archive, empty: disabled">                         record_path                = "";     // int16 driver data and `<record_path>.idx` timing index, see RawRecorder, applied at start()
+    A<std::string, "Prometheus metrics file, empty: disabled">                       metrics_path               = "";     // health counters (see AcquisitionHealth) as Prometheus text, rewritten every metrics_interval
+    A<float, "metrics file update interval", gr::Unit<"s">>                          metrics_interval           = 10.f;
+    A<DriverBufferPages, "pages of the driver buffers">                              driver_buffer_pages        = DriverBufferPages::Transparent; // 2 MB huge pages, Explicit needs reserved pages (vm.nr_hugepages) and falls back to Transparent
+    A<bool, "lock the driver buffers in memory">                                     driver_buffer_lock         = false;                          // mlock, needs CAP_IPC_LOCK or a sufficient RLIMIT_MEMLOCK, otherwise the buffers stay swappable
+    A<bool, "pre-fault the driver buffers when arming">                              driver_buffer_prefault     = true;                           // the driver buffer options apply when the acquisition is (re)started
+    A<std::string, "CPUs of the acquisition thread, empty: any">                     cpu_affinity               = "";                             // CPU list, e.g. `2,4-6`: applied to the scheduler worker while it runs processBulk, best-effort, see ThreadPlacement
+    A<int, "SCHED_FIFO priority of the acquisition thread, 0: off">                  rt_priority                = 0;                              // 1..99, needs CAP_SYS_NICE or RLIMIT_RTPRIO, otherwise best-effort with a warning
     A<bool, "verbose console">                                                       verbose_console            = false;
 
     gr::PortIn<std::uint8_t, gr::Async> timingIn;
@@ -145,14 +152,52 @@ struct Picoscope : gr::Block<Picoscope<T, TPSImpl, TTagMatcher>, gr::SupportedTy
     using TDigitalOutput = std::conditional_t<gr::DataSetLike<T>, gr::DataSet<uint16_t>, uint16_t>;
     gr::PortOut<TDigitalOutput> digitalOut;
 
+    // Streaming mode only: DataSet snapshots [-pre_samples, post_samples) around every matched timing tag passing `trigger_filter`
+    using TSnapshotOutput = std::conditional_t<gr::DataSetLike<T>, T, gr::DataSet<T>>;
+    std::array<gr::PortOut<TSnapshotOutput, gr::Async, gr::Optional>, TPSImpl::N_ANALOG_CHANNELS> snapshotOut;
+
+    // Streaming mode only: averaged power spectra of every channel, computed from the converted samples if `spectrum_length` > 0
+    std::array<gr::PortOut<gr::DataSet<float>, gr::Async, gr::Optional>, TPSImpl::N_ANALOG_CHANNELS> spectrumOut;
+
     float       _actualSampleRate  = 0; // todo: find a way to properly update this property and make it reflectable
     std::size_t _nSamplesPublished = 0; // for debugging purposes
 
-    detail::TriggerNameAndCtx _armTriggerNameAndCtx; // store parsed information to optimise performance
-    detail::TriggerNameAndCtx _disarmTriggerNameAndCtx;
-
-    GR_MAKE_REFLECTABLE(Picoscope, timingIn, out, digitalOut, serial_number, sample_rate, pre_samples, post_samples, n_captures, auto_arm, trigger_once, channel_ids, signal_names, signal_units, signal_quantities, //
-        channel_ranges, channel_analog_offsets, signal_scales, signal_offsets, channel_couplings, trigger_source, trigger_threshold, trigger_direction, digital_port_enable, digital_port_invert_output, trigger_arm, trigger_disarm, matcher_timeout, verbose_console);
+    TriggerFilter _armTriggerFilter; // compiled at settings time to optimise performance
+    TriggerFilter _disarmTriggerFilter;
+    TriggerFilter _triggerFilter;
+    TriggerFilter _spectrumTriggerFilter;
+
+    GR_MAKE_REFLECTABLE(Picoscope, timingIn, out, digitalOut, snapshotOut, spectrumOut, serial_number, sample_rate, decimation, decimation_taps, pre_samples, post_samples, n_captures, auto_arm, trigger_once, rapid_block_layout, channel_ids, signal_names, signal_units, signal_quantities, //
+        channel_ranges, channel_analog_offsets, signal_scales, signal_offsets, calibration_file, channel_couplings, trigger_source, trigger_threshold, trigger_direction, digital_port_enable, digital_port_invert_output, trigger_arm, trigger_disarm, matcher_timeout, low_latency, late_tag_horizon, timing_tag_ports, //
+        spectrum_length, spectrum_update_rate, spectrum_window, spectrum_trigger, history_depth, record_path, metrics_path, metrics_interval, //
+        driver_buffer_pages, driver_buffer_lock, driver_buffer_prefault, cpu_affinity, rt_priority, verbose_console);
+
+    /**
+     * Streaming mode: request/response access to the sample histories (see `history_depth`) via the message port. Request (Get) data:
+     *  - reference, one of: `index` (absolute sample index, std::uint64_t), `time` (ns, time base of the timing tags' `trigger_time`) or `trigger`
+     *    (`<trigger_name>[/<ctx>]`, the most recent matching timing tag)
+     *  - `pre`, `post`: seconds before and after the reference (float), windows longer than the history capacity are rejected
+     *  - `channels`: optional subset of `channel_ids`
+     * Reply data: `index` (absolute index of the first sample), `reference_index`, `sample_rate`, `channel_ids`, `values` (channel id -> std::vector<float>
+     * in physical units) and `trigger` if the reference is a timing tag.
+     */
+    static constexpr std::string_view kHistoryProperty = "SampleHistory";
+
+    /**
+     * Latency of the acquisition path per stage (see `LatencyStage`), accumulated since start() or the last reset. Get reply data: one map per stage
+     * (`driver`, `conversion`, `poll`, `match`, `publish`, `total`) with `count`, `mean`, `p50`, `p99`, `p999` and `max` in [ns] and the non-empty
+     * histogram buckets as `bucket_values` (lower bound in [ns]) and `bucket_counts`. Set with `reset = true` starts a new window, e.g. to poll the
+     * latencies of the last interval periodically.
+     */
+    static constexpr std::string_view kLatencyProperty = "Latency";
+
+    /**
+     * Health counters since the block was created (see `AcquisitionHealth`), read-only. Get reply data: `samples_acquired`, `samples_published`,
+     * `samples_dropped`, `overflow_events`, `retries`, `error_count_resets`, `restarts`, `unknown_events`, `burst_allocations` (std::uint64_t),
+     * `matcher_drops` (reason -> count), `buffer_fill` (double, 0..1) and `thread_placement` (`cpus`, `policy`, `priority`, `degraded`: effective placement
+     * of the acquisition thread, see `cpu_affinity` and `rt_priority`).
+     */
+    static constexpr std::string_view kHealthProperty = "Health";
 
 private:
     std::optional<PicoscopeWrapper<TPSImpl>> _picoscope;
@@ -165,109 +210,232 @@ private:
 
     std::size_t unpublishedSamples = 0; // The number of unpublished samples already written to the output buffer but not published. Since streaming ports are single producer, we can publish these on the next iteration.
 
+    // fused conversion: analog trigger edges are detected while converting, so the converted samples do not have to be scanned again
+    std::optional<std::size_t>                                        _analogTriggerChannel{}; // index into channel_ids if the trigger source is an enabled analog channel
+    kernel::EdgeDetector                                              _edgeDetector{};
+    std::vector<std::size_t>                                          _analogTriggerEdges{};   // Streaming: edges within the unpublished + new samples, relative to the output span
+    std::vector<std::size_t>                                          _triggerEdges{};         // scratch: the edges passed to the tag matcher, keeps its capacity so steady-state polls do not allocate
+    std::vector<std::size_t>                                          _digitalTriggerEdges{};  // Streaming with decimation: edges detected at the raw rate, relative to the output span
+    std::optional<bool>                                               _digitalTriggerLevel{};  // Streaming with decimation: level of the trigger bit in the last raw sample
+    std::vector<gr::property_map>                                     _timingTagsScratch{};    // Streaming scratch: the timing tags passed to the tag matcher
+    timingmatcher::MatcherResult                                      _matchedTags{};          // result of the last match, re-used so polls without tags do not allocate
+    std::vector<gr::Tag>                                              _replayedTags{};         // replayed archives: the recorded timing tags of the data, relative to the output span (Streaming) or capture
+    CalibrationTable                                                  _calibrationTable;
+    std::array<kernel::Calibration, TPSImpl::N_ANALOG_CHANNELS>       _calibrations{};         // empty if the channel is not calibrated
+    std::array<kernel::ChannelStatistics, TPSImpl::N_ANALOG_CHANNELS> _channelStatistics{};    // statistics of the last chunk (Streaming) or capture (RapidBlock)
+    std::array<kernel::OverRangeDetector, TPSImpl::N_ANALOG_CHANNELS> _overRange{};            // Streaming: absolute indices, RapidBlock: indices within the signal, counters since start()
+    std::array<std::int16_t, TPSImpl::N_ANALOG_CHANNELS>              _overflowMasks{};        // bit of the device channel in the driver's overflow word, set in start()
+
+    // Streaming mode with decimation > 1: the FIR runs on the raw counts, all channels share the decimation phase of _decimators[0]
+    std::array<kernel::DecimatingFir, TPSImpl::N_ANALOG_CHANNELS> _decimators{};
+    std::vector<float>                                           _decimatedTile{};      // FIR output for non-float output types and calibrated channels
+    std::vector<std::int16_t>                                    _decimatedOverRange{}; // over-range flags of the decimated samples
+
+    // RapidBlock burst layout: DataSets being filled with the captures of the current acquisition. Swapped with the output buffer slot on publish, so the
+    // storage of previously published bursts is recycled instead of re-allocated for every acquisition. This relies on the output ring keeping the consumed
+    // DataSets in its slots: the storage in use is bounded by one burst per ring slot plus the pool, slots which were never written (first pass through the
+    // ring) or whose samples a consumer moved out are re-reserved on publish and counted in `burst_allocations`, see reserveBurstDataset().
+    std::array<T, TPSImpl::N_ANALOG_CHANNELS>                _burstPool{};
+    std::array<gr::property_map, TPSImpl::N_ANALOG_CHANNELS> _burstSignalInfo{}; // channelToTagMap() of the burst DataSets, updated with the settings
+
+    // low_latency mode: samples which are already published but not yet processed by the tag matcher, tags matched to them are emitted as late tags
+    std::size_t              _speculativeSamples = 0UZ;
+    std::vector<std::size_t> _speculativeEdges{}; // trigger edges within the speculative samples, relative to their start
+
+    // streaming snapshots: recent samples per channel and the matched tags waiting for their post-trigger samples, indices are absolute sample indices
+    std::array<SampleHistory<typename TSnapshotOutput::value_type>, TPSImpl::N_ANALOG_CHANNELS> _history{};
+    std::vector<gr::Tag>                                                                       _pendingSnapshots{};
+    std::deque<gr::Tag>                                                                        _timingReferences{}; // matched timing tags within the history, absolute indices
+
+    // streaming spectra: the output DataSets are swapped with the buffer slots on publish, so their storage is recycled like _burstPool
+    std::array<kernel::SpectrumAccumulator, TPSImpl::N_ANALOG_CHANNELS>                                  _spectra{};
+    std::array<gr::DataSet<float>, TPSImpl::N_ANALOG_CHANNELS>                                           _spectrumPool{};
+    std::array<std::optional<std::pair<std::ptrdiff_t, gr::property_map>>, TPSImpl::N_ANALOG_CHANNELS> _spectrumTrigger{}; // trigger the current average is aligned to, index relative to its first sample
+
+    // raw recording, Streaming mode: archive sample index of an output sample, as (position within the unpublished + new samples, archive index) of the
+    // first output sample of each driver chunk, later samples follow every decimation-th archive sample
+    std::vector<std::pair<std::size_t, std::size_t>> _rawAnchors{};
+
+    std::unique_ptr<AcquisitionLatencies> _latencies = std::make_unique<AcquisitionLatencies>(); // on the heap, the histograms take ~90 kB which need not be part of the block
+    std::unique_ptr<AcquisitionHealth>    _health    = std::make_unique<AcquisitionHealth>();    // shared with the driver wrapper, which counts retries and restarts
+    std::chrono::steady_clock::time_point _nextMetricsWrite{};
+    fair::thread::ResolvedPlacement       _acquisitionPlacement{};          // cpu_affinity and rt_priority, parsed by the first processBulk after a change
+    fair::thread::EffectivePlacement      _threadPlacement{};               // reported by the Health property
+    bool                                  _threadPlacementResolved = false; // reset by settingsChanged()
+
     TTagMatcher tagMatcher{.timeout = std::chrono::nanoseconds(matcher_timeout.value), .sampleRate = sample_rate.value};
 
 public:
+    explicit Picoscope(gr::property_map initParameters = {}) : SuperT(std::move(initParameters)) { //
+        this->propertyCallbacks[std::string(kHistoryProperty)] = std::mem_fn(&Picoscope::propertyCallbackHistory);
+        this->propertyCallbacks[std::string(kLatencyProperty)] = std::mem_fn(&Picoscope::propertyCallbackLatency);
+        this->propertyCallbacks[std::string(kHealthProperty)]  = std::mem_fn(&Picoscope::propertyCallbackHealth);
+    }
     ~Picoscope() { stop(); }
-    using SuperT::SuperT; // inherit Block constructor
 
-    template<gr::OutputSpanLike TOutSpan>
+    template<gr::OutputSpanLike TOutSpan, gr::OutputSpanLike TSnapshotSpan, gr::OutputSpanLike TSpectrumSpan>
     requires(acquisitionMode == AcquisitionMode::Streaming)
-    gr::work::Status processBulk(gr::InputSpanLike auto& timingInSpan, std::span<TOutSpan>& outputs, gr::OutputSpanLike auto& digitalOutSpan) {
+    gr::work::Status processBulk(gr::InputSpanLike auto& timingInSpan, std::span<TOutSpan>& outputs, gr::OutputSpanLike auto& digitalOutSpan, std::span<TSnapshotSpan>& snapshotOutputs, std::span<TSpectrumSpan>& spectrumOutputs) {
+        FAIR_TRACE_SPAN("Picoscope::processBulk", "picoscope");
+        const auto placement = placeAcquisitionThread(); // for the duration of this call
         std::size_t       nSamples        = 0UZ;
         std::size_t       samplesDropped  = 0UZ;
         const std::size_t availableBuffer = std::min(std::ranges::min(outputs | std::views::transform(&TOutSpan::size)), digitalOutSpan.size());
+        writeMetrics();
+        if (const std::size_t bufferSize = std::min(std::ranges::min(out | std::views::transform([](const auto& port) { return port.bufferSize(); })), digitalOut.bufferSize()); bufferSize > 0UZ) {
+            _health->bufferFill.store(1.0 - static_cast<double>(std::min(availableBuffer, bufferSize)) / static_cast<double>(bufferSize), std::memory_order_relaxed);
+        }
         // Make acq time a member field and only update if there is new data?
         std::chrono::system_clock::time_point acquisitionTime = std::chrono::system_clock::now();
-        const auto                            pollResult      = _picoscope->poll([&](std::span<std::span<const std::int16_t>> data, std::int16_t overflow) {
-            nSamples = data[0].size();
+        const auto                            pollStart       = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point converted{}; // stays default if the driver had no new data
+        const auto                            pollResult = _picoscope->poll([&](std::span<std::span<const std::int16_t>> data, std::int16_t overflow) {
+            const kernel::DecimatingFir& phase = _decimators[0];
+            nSamples                           = phase.outputCount(data[0].size()); // decimated samples if decimating
+            AcquisitionHealth::increment(_health->samplesAcquired, data[0].size());
+            if (overflow != 0) {
+                AcquisitionHealth::increment(_health->overflowEvents);
+            }
             if (verbose_console) {
                 const auto  thisAcquisitionTime = std::chrono::high_resolution_clock::now();
                 static auto lastAcquisitionTime = thisAcquisitionTime;
-                std::println("Streaming Update: {}; {}; {}; {}; {}", std::chrono::duration_cast<std::chrono::nanoseconds>(thisAcquisitionTime.time_since_epoch()).count(), nSamples, static_cast<float>(nSamples) * 1e9f / sample_rate.value, std::chrono::duration_cast<std::chrono::nanoseconds>(thisAcquisitionTime - lastAcquisitionTime).count(), std::this_thread::get_id());
+                std::println("Streaming Update: {}; {}; {}; {}; {}", std::chrono::duration_cast<std::chrono::nanoseconds>(thisAcquisitionTime.time_since_epoch()).count(), nSamples, static_cast<float>(nSamples) * 1e9f / outputSampleRate(), std::chrono::duration_cast<std::chrono::nanoseconds>(thisAcquisitionTime - lastAcquisitionTime).count(), std::this_thread::get_id());
                 lastAcquisitionTime = thisAcquisitionTime;
             }
+            if (nSamples + unpublishedSamples > availableBuffer) {
+                samplesDropped = nSamples + unpublishedSamples - availableBuffer;
+                nSamples       = availableBuffer - unpublishedSamples; // we don't want to publish more data than the output buffer can hold
+            }
+            assert(unpublishedSamples + nSamples <= availableBuffer);
+            // the whole chunk is filtered, raw samples after the last output are carried over as the decimation phase. Only if the output is full the
+            // chunk is cut after the last output that fits, the rest is counted as dropped and the filter is reset below
+            const std::size_t nRaw        = samplesDropped > 0UZ ? phase.inputCount(nSamples) : data[0].size();
+            const std::size_t firstOutput = phase.enabled() ? phase.decimation - phase.pending - 1UZ : 0UZ; // raw index of the first (decimated) output sample
+            if (_picoscope->isRecording()) { // the wrapper has recorded the chunk before calling this handler
+                addRawAnchor(unpublishedSamples, _picoscope->recordedSamples() - data[0].size() + firstOutput);
+            }
+            collectReplayedTags(0UZ, firstOutput, phase.enabled() ? phase.decimation : 1UZ, nRaw, unpublishedSamples);
             for (const auto& [channelIdx, channelId, output] : std::views::zip(std::views::iota(0UZ), channel_ids.value, outputs)) {
                 // copy and publish all analog channel data
-                const float voltageMultiplier = channel_ranges[channelIdx] / static_cast<float>(_maxValue);
-                if (nSamples + unpublishedSamples > availableBuffer) {
-                    samplesDropped = nSamples + unpublishedSamples - availableBuffer;
-                    nSamples       = availableBuffer - unpublishedSamples; // we don't want to publish more data than the output buffer can hold
-                }
-                const auto offset = getChannelSetting(std::span(channel_analog_offsets.value), channelIdx, 0.0f);
-                const auto scale  = getChannelSetting(std::span(signal_scales.value), channelIdx, 1.0f);
-                for (std::size_t i = 0; i < nSamples; ++i) {
-                    assert(i + unpublishedSamples < availableBuffer);
-                    if constexpr (std::is_same_v<T, float>) {
-                        output[i + unpublishedSamples] = offset + scale * voltageMultiplier * static_cast<float>(data[channelIdx][i]);
-                    } else if constexpr (std::is_same_v<T, gr::UncertainValue<float>>) {
-                        output[i + unpublishedSamples] = gr::UncertainValue(offset + scale * voltageMultiplier * static_cast<float>(data[channelIdx][i]), TPSImpl::uncertainty());
-                    } else if constexpr (std::is_same_v<T, int16_t>) {
-                        output[i + unpublishedSamples] = data[channelIdx][i]; // std::ranges::copy(driverData, output.begin() + static_cast<std::ptrdiff_t>(channel.unpublished.size()));
-                    }
+                _channelStatistics[channelIdx].reset();
+                _overRange[channelIdx].indexOffset = _nSamplesPublished;
+                if (phase.enabled()) {
+                    convertDecimated(channelIdx, data[channelIdx].first(nRaw), std::span(output).subspan(unpublishedSamples, nSamples));
+                } else {
+                    kernel::convertChannel(data[channelIdx].first(nSamples), std::span(output).subspan(unpublishedSamples, nSamples), conversionParameters(channelIdx), //
+                        _analogTriggerChannel == channelIdx ? &_edgeDetector : nullptr, unpublishedSamples, _analogTriggerEdges, _channelStatistics[channelIdx], &_overRange[channelIdx]);
                 }
-                if (overflow & (1 << channelIdx)) {                               // picoscope overrange
-                    output.publishTag(gr::property_map{{"over-range", true}}, 0); // todo: correct tag
+                if ((overflow & _overflowMasks[channelIdx]) && _channelStatistics[channelIdx].overRange == 0UZ) { // driver over-range without samples at ±_maxValue (e.g. lower ADC resolution): chunk granularity only
+                    output.publishTag(gr::property_map{{"over-range", true}}, unpublishedSamples);
                 }
             }
+            if (channel_ids.value.empty()) {
+                _decimators[0].skip(nRaw);
+            }
             if constexpr (TPSImpl::N_DIGITAL_CHANNELS > 0) {
+                const std::size_t step = phase.enabled() ? phase.decimation : 1UZ; // decimation: the digital sample coinciding with the analog output sample
                 for (std::size_t i = 0; i < nSamples; ++i) {
                     assert(i + unpublishedSamples < digitalOutSpan.size());
-                    digitalOutSpan[i + unpublishedSamples] = static_cast<std::uint16_t>(data.back()[i]);
+                    digitalOutSpan[i + unpublishedSamples] = static_cast<std::uint16_t>(data.back()[firstOutput + i * step]);
+                }
+                if (const auto digitalTriggerBit = detail::parseDigitalTriggerSource(trigger_source); phase.enabled() && detail::isDigitalTrigger(trigger_source) && digitalTriggerBit) {
+                    findDecimatedDigitalTriggers(digitalTriggerBit.value(), data.back().first(nRaw), firstOutput, step, unpublishedSamples);
                 }
             }
+            converted = std::chrono::steady_clock::now();
         });
-        const auto                            acqStartTime    = acquisitionTime - std::chrono::nanoseconds(static_cast<long>(1e9f / sample_rate * static_cast<float>(nSamples)));
-        acquisitionTime                                       = acquisitionTime - std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(static_cast<long>(1e9f / sample_rate * static_cast<float>(nSamples + unpublishedSamples))));
+        const auto                            pollReturned    = std::chrono::steady_clock::now();
+        const auto                            acqStartTime    = acquisitionTime - std::chrono::nanoseconds(static_cast<long>(1e9f / outputSampleRate() * static_cast<float>(nSamples)));
+        acquisitionTime                                       = acquisitionTime - std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(static_cast<long>(1e9f / outputSampleRate() * static_cast<float>(nSamples + unpublishedSamples + _speculativeSamples))));
         if (!pollResult) {
             if (verbose_console) {
                 std::println("Error polling: {}@{}L{}", pollResult.error().getDescription(), pollResult.error().location.file_name(), pollResult.error().location.line());
             }
             // TODO: forward error to scheduler and stop the block
         }
+        if (_history[0].capacity() > 0UZ && nSamples > 0) { // keep the new samples for the snapshot pre-trigger windows and history requests
+            for (std::size_t channelIdx = 0; channelIdx < channel_ids.value.size(); ++channelIdx) {
+                _history[channelIdx].push(std::span(outputs[channelIdx]).subspan(unpublishedSamples, nSamples));
+            }
+        }
         if (nSamples + unpublishedSamples == 0) {
             for (auto& output : outputs) {
                 output.publish(0);
             }
             digitalOutSpan.publish(0);
+            for (auto& snapshotOutput : snapshotOutputs) {
+                snapshotOutput.publish(0);
+            }
+            for (auto& spectrumOutput : spectrumOutputs) {
+                spectrumOutput.publish(0);
+            }
             return gr::work::Status::INSUFFICIENT_INPUT_ITEMS; // no new data to be processed
         }
         // find triggers and match
-        auto tagsDriver         = timingInSpan.rawTags() | std::views::transform([](const auto& t) { return t.map; }) | std::ranges::to<std::vector<gr::property_map>>();
-        auto triggerEdgesDriver = [&]() -> std::vector<std::size_t> {
-            if (trigger_source == "") { // no trigger configured
-                return {};
-            } else if (detail::isAnalogTrigger(trigger_source)) {
-                for (const auto& channelIdx : std::views::iota(0UZ, channel_ids->size())) {
-                    if (channel_ids[channelIdx] == std::string_view{trigger_source}) {
-                        assert(outputs[channelIdx].size() >= unpublishedSamples + nSamples);
-                        auto result = findAnalogTriggers(channelIdx, std::span(outputs[channelIdx]).subspan(0UZ, unpublishedSamples + nSamples));
-                        return result;
-                    }
-                }
-                return {}; // the trigger is not one of the enabled channels
-            } else if (const auto digitalTriggerBit = detail::parseDigitalTriggerSource(trigger_source); digitalTriggerBit && static_cast<std::size_t>(digitalTriggerBit.value()) < TPSImpl::N_DIGITAL_CHANNELS * 8) {
-                if constexpr (TPSImpl::N_DIGITAL_CHANNELS > 0) {
-                    const auto result = findDigitalTriggers(digitalTriggerBit.value(), std::span(digitalOutSpan).subspan(0UZ, unpublishedSamples + nSamples));
-                    return result;
+        _timingTagsScratch.clear();
+        std::ranges::copy(timingInSpan.rawTags() | std::views::transform([](const auto& t) { return t.map; }), std::back_inserter(_timingTagsScratch));
+        _triggerEdges.clear();
+        if (_speculativeSamples > 0UZ) { // the edges of the already published samples which are still considered by the matcher come first
+            _triggerEdges.assign(_speculativeEdges.begin(), _speculativeEdges.end());
+        }
+        const std::size_t nSpeculativeEdges = _triggerEdges.size();
+        if (trigger_source == "") {
+            // no trigger configured
+        } else if (detail::isAnalogTrigger(trigger_source)) {
+            _triggerEdges.insert(_triggerEdges.end(), _analogTriggerEdges.begin(), _analogTriggerEdges.end()); // already detected during conversion, empty if the trigger is not one of the enabled channels
+        } else if (const auto digitalTriggerBit = detail::parseDigitalTriggerSource(trigger_source); digitalTriggerBit && static_cast<std::size_t>(digitalTriggerBit.value()) < TPSImpl::N_DIGITAL_CHANNELS * 8) {
+            if constexpr (TPSImpl::N_DIGITAL_CHANNELS > 0) {
+                if (_decimators[0].enabled()) { // already detected at the raw rate during conversion, edges in the carried-over decimation phase follow later
+                    std::ranges::copy_if(_digitalTriggerEdges, std::back_inserter(_triggerEdges), [&](std::size_t edge) { return edge < unpublishedSamples + nSamples; });
+                } else {
+                    findDigitalTriggers(digitalTriggerBit.value(), std::span(digitalOutSpan).subspan(0UZ, unpublishedSamples + nSamples), _triggerEdges);
                 }
-                throw gr::exception(std::format("This picoscope model does not support digital triggers: {}", trigger_source.value));
             } else {
-                throw gr::exception(std::format("Invalid Trigger Source configured: {}", trigger_source.value));
+                throw gr::exception(std::format("This picoscope model does not support digital triggers: {}", trigger_source.value));
             }
-        }();
-        auto matchedTags = tagMatcher.match(tagsDriver, triggerEdgesDriver, unpublishedSamples + nSamples, acquisitionTime.time_since_epoch());
+        } else {
+            throw gr::exception(std::format("Invalid Trigger Source configured: {}", trigger_source.value));
+        }
+        for (auto& edge : std::span(_triggerEdges).subspan(nSpeculativeEdges)) {
+            edge += _speculativeSamples;
+        }
+        eraseReplayedEdges(_speculativeSamples);
+        const std::span<const std::size_t> triggerEdgesDriver = _triggerEdges;
+        tagMatcher.match(_timingTagsScratch, triggerEdgesDriver, _speculativeSamples + unpublishedSamples + nSamples, acquisitionTime.time_since_epoch(), _matchedTags);
+        timingmatcher::MatcherResult& matchedTags = _matchedTags;
+        const auto                    matched     = std::chrono::steady_clock::now();
+        _health->addMatcherResult(matchedTags);
         if (samplesDropped > 0UZ) {
+            AcquisitionHealth::increment(_health->samplesDropped, samplesDropped);
             tagMatcher.reset(); // reset the tag matcher whenever we drop samples
+            _edgeDetector.reset();
+            _digitalTriggerLevel.reset();
+            for (auto& overRange : _overRange) { // over-range intervals do not extend across the gap
+                overRange.close(unpublishedSamples + nSamples);
+            }
+            for (auto& decimator : _decimators) { // neither does the filter history
+                decimator.reset();
+            }
+        }
+        if (low_latency) {
+            publishLateTags(matchedTags, triggerEdgesDriver, unpublishedSamples + nSamples, samplesDropped > 0UZ);
+        }
+        mergeReplayedTags(matchedTags.tags, matchedTags.processedSamples);
+        publishSpectra(outputs, matchedTags.tags, matchedTags.processedSamples, spectrumOutputs);
+        if (samplesDropped > 0UZ) {
+            for (auto& spectrum : _spectra) { // segments must not span the gap
+                spectrum.restart();
+            }
         }
 
         for (const auto& [channelIdx, output] : std::views::zip(std::views::iota(0UZ), outputs)) {
             if (!signalInfoTagPublished[channelIdx] && matchedTags.processedSamples > 0) {
-                output.publishTag(channelToTagMap(channelIdx, sample_rate), 0);
+                output.publishTag(channelToTagMap(channelIdx, outputSampleRate()), 0);
                 signalInfoTagPublished[channelIdx] = true;
             }
-            bool chunkStartPublished = false;
-            for (auto& [index, map] : matchedTags.tags) {
+            bool       chunkStartPublished = false;
+            const auto channelTags         = hasTimingTags(channelIdx) ? std::span<const gr::Tag>(matchedTags.tags) : std::span<const gr::Tag>{};
+            for (const auto& [index, map] : channelTags) {
                 if (verbose_console && !chunkStartPublished && index > unpublishedSamples && nSamples > 0 && matchedTags.processedSamples > unpublishedSamples) {
                     output.publishTag(gr::property_map{{"chunk-start-time", static_cast<gr::Size_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(acqStartTime.time_since_epoch()).count())}}, unpublishedSamples);
                     chunkStartPublished = true;
@@ -280,20 +448,62 @@ public:
             if (samplesDropped > 0UZ) {
                 output.publishTag(gr::property_map{{"droppedSamples", samplesDropped}}, unpublishedSamples + nSamples); // todo: correct tag
             }
+            publishOverRangeTags(output, _overRange[channelIdx], matchedTags.processedSamples);
             output.publish(matchedTags.processedSamples);
         }
 
-        for (auto& [index, map] : matchedTags.tags) {
-            digitalOutSpan.publishTag(map, index);
+        if (hasTimingTagsDigital()) {
+            for (auto& [index, map] : matchedTags.tags) {
+                digitalOutSpan.publishTag(map, index);
+            }
         }
         if (samplesDropped > 0UZ) {
             digitalOutSpan.publishTag(gr::property_map{{"droppedSamples", samplesDropped}}, unpublishedSamples + nSamples); // todo: correct tag
         }
 
         digitalOutSpan.publish(matchedTags.processedSamples);
+        if (!_triggerFilter.empty()) {
+            for (const auto& [index, map] : matchedTags.tags) {
+                if (_triggerFilter.matches(map)) {
+                    _pendingSnapshots.emplace_back(_nSamplesPublished + index, map);
+                }
+            }
+        }
+        if (history_depth > 0.f) {
+            for (const auto& [index, map] : matchedTags.tags) {
+                addTimingReference(_nSamplesPublished + index, map);
+            }
+        }
+        if (_picoscope->isRecording()) {
+            for (const auto& [index, map] : matchedTags.tags) {
+                recordTimingReference(rawIndex(index), map);
+            }
+            advanceRawAnchors(matchedTags.processedSamples);
+        }
+        publishSnapshots(snapshotOutputs);
         _nSamplesPublished += matchedTags.processedSamples;
+        AcquisitionHealth::increment(_health->samplesPublished, matchedTags.processedSamples);
         assert(unpublishedSamples + nSamples >= matchedTags.processedSamples);
         unpublishedSamples = unpublishedSamples + nSamples - matchedTags.processedSamples;
+        for (auto* edges : {&_analogTriggerEdges, &_digitalTriggerEdges}) {
+            std::erase_if(*edges, [&](std::size_t edge) { return edge < matchedTags.processedSamples; });
+            for (auto& edge : *edges) {
+                edge -= matchedTags.processedSamples;
+            }
+        }
+
+        if (converted != std::chrono::steady_clock::time_point{}) { // iterations without new driver data only publish the remaining samples
+            const auto published   = std::chrono::steady_clock::now();
+            const auto driverReady = _picoscope->driverReady;
+            _latencies->record(LatencyStage::Driver, pollStart, driverReady);
+            _latencies->record(LatencyStage::Conversion, driverReady, converted);
+            _latencies->record(LatencyStage::Poll, converted, pollReturned);
+            _latencies->record(LatencyStage::Match, pollReturned, matched);
+            _latencies->record(LatencyStage::Publish, matched, published);
+            _latencies->record(LatencyStage::Total, driverReady, published);
+            FAIR_TRACE_EVENT("conversion", "picoscope", driverReady, converted);
+            FAIR_TRACE_EVENT("publish", "picoscope", matched, published);
+        }
 
         // consume timing tags
         if (matchedTags.processedTags > 0) {
@@ -314,11 +524,512 @@ public:
         return gr::work::Status::OK;
     }
 
-    template<gr::OutputSpanLike TOutSpan>
+    /**
+     * Publishes one tag per closed over-range interval starting within the samples published now: `over-range`, `over_range_start` and `over_range_end`
+     * (absolute stream indices, [start, end)). The tag is placed on the first clipped sample, or on the first sample of the chunk if the interval started
+     * in an already published chunk. Intervals starting in the unpublished samples are kept for the next iteration.
+     */
+    void publishOverRangeTags(auto& output, kernel::OverRangeDetector& overRange, std::size_t nPublished) {
+        const std::size_t publishEnd = _nSamplesPublished + nPublished;
+        std::erase_if(overRange.intervals, [&](const kernel::OverRangeDetector::Interval& interval) {
+            if (interval.start >= publishEnd) {
+                return false;
+            }
+            const std::size_t index = interval.start > _nSamplesPublished ? interval.start - _nSamplesPublished : 0UZ;
+            output.publishTag(gr::property_map{{"over-range", true}, {"over_range_start", static_cast<std::uint64_t>(interval.start)}, {"over_range_end", static_cast<std::uint64_t>(interval.end)}}, index);
+            return true;
+        });
+    }
+
+    /**
+     * low_latency mode: all samples of the current chunk are published immediately, while the matcher still gets to see the last samples again in the next
+     * iteration. Tags matched to samples which were already published are emitted as late tags on the message port ("LateTimingTag" endpoint) with their
+     * absolute sample index. Like in-chunk tags they are recorded and restart the spectrum averages, at their position before the current chunk.
+     * Rewrites `matchedTags` such that `tags` and `processedSamples` refer to the current chunk only.
+     */
+    void publishLateTags(auto& matchedTags, std::span<const std::size_t> triggerEdges, std::size_t nSamples, bool samplesDropped) {
+        const std::size_t chunkStart      = _speculativeSamples; // start of the current chunk relative to the samples seen by the matcher
+        const std::size_t speculativeBase = _nSamplesPublished - _speculativeSamples;
+        const std::size_t totalSamples    = chunkStart + nSamples;
+
+        std::erase_if(matchedTags.tags, [&](gr::Tag& tag) {
+            if (tag.index >= chunkStart) {
+                tag.index -= chunkStart;
+                return false;
+            }
+            if (const std::size_t lag = chunkStart - tag.index; lag <= late_tag_horizon) {
+                if (_triggerFilter.matches(tag.map)) {
+                    _pendingSnapshots.emplace_back(speculativeBase + tag.index, tag.map);
+                }
+                if (history_depth > 0.f) {
+                    addTimingReference(speculativeBase + tag.index, tag.map);
+                }
+                if (_picoscope->isRecording()) {
+                    recordTimingReference(publishedRawIndex(lag), tag.map);
+                }
+                if (_spectrumTriggerFilter.matches(tag.map)) { // the averages restart with the current chunk, `lag` samples after the trigger
+                    for (std::size_t channelIdx = 0UZ; channelIdx < channel_ids.value.size(); ++channelIdx) {
+                        if (_spectra[channelIdx].enabled()) {
+                            _spectra[channelIdx].restart();
+                            _spectrumTrigger[channelIdx].emplace(-static_cast<std::ptrdiff_t>(lag), tag.map);
+                        }
+                    }
+                }
+                this->emitMessage("LateTimingTag", gr::property_map{{"index", static_cast<gr::Size_t>(speculativeBase + tag.index)}, {"tag", std::move(tag.map)}});
+            } else {
+                matchedTags.messages.emplace_back(std::format("dropping late tag beyond horizon ({} > {} samples)", lag, late_tag_horizon.value));
+            }
+            return true;
+        });
+
+        // retain everything the matcher did not process yet, but publish the full chunk
+        _speculativeSamples = totalSamples - matchedTags.processedSamples;
+        _speculativeEdges.clear();
+        for (const std::size_t edge : triggerEdges) {
+            if (edge >= matchedTags.processedSamples) {
+                _speculativeEdges.push_back(edge - matchedTags.processedSamples);
+            }
+        }
+        if (samplesDropped || _speculativeSamples > late_tag_horizon) { // no late tags possible anymore, restart matching from the current position
+            tagMatcher.reset();
+            _speculativeSamples = 0UZ;
+            _speculativeEdges.clear();
+        }
+        matchedTags.processedSamples = nSamples;
+    }
+
+    /**
+     * Streaming mode: cuts the snapshots of all pending triggers whose post-trigger samples are available from the channel histories. Triggers whose
+     * pre-trigger samples are already evicted from the history are dropped, if the output buffer is full the snapshots are retried in the next iteration.
+     */
+    template<gr::OutputSpanLike TSnapshotSpan>
+    void publishSnapshots(std::span<TSnapshotSpan>& snapshotOutputs) {
+        using TSample                  = typename TSnapshotOutput::value_type;
+        const std::size_t maxSnapshots = std::ranges::min(snapshotOutputs | std::views::transform(&TSnapshotSpan::size));
+        const std::size_t nChannels    = channel_ids.value.size();
+        std::size_t       nSnapshots   = 0UZ;
+        std::erase_if(_pendingSnapshots, [&](const gr::Tag& trigger) {
+            if (nChannels == 0UZ || trigger.index + post_samples > _history[0].endIndex() || nSnapshots >= maxSnapshots) {
+                return false; // post-trigger samples not yet acquired or no space left in the output buffer
+            }
+            if (trigger.index < pre_samples || !_history[0].contains(trigger.index - pre_samples, pre_samples + post_samples)) {
+                if (verbose_console) {
+                    std::println("dropping snapshot at sample {}: pre-trigger samples are no longer available", trigger.index);
+                }
+                return true;
+            }
+            for (std::size_t channelIdx = 0; channelIdx < nChannels; ++channelIdx) {
+                TSnapshotOutput snapshot = createDataset<TSnapshotOutput>(channelIdx, pre_samples + post_samples);
+                std::ignore              = _history[channelIdx].copy(trigger.index - pre_samples, std::span(snapshot.signal_values));
+                snapshot.timing_events[0].push_back({static_cast<std::ptrdiff_t>(pre_samples.value), trigger.map});
+                kernel::ChannelStatistics stats;
+                stats.accumulate(std::span<const TSample>(snapshot.signal_values));
+                snapshot.signal_ranges[0] = {toSample<TSample>(stats.min), toSample<TSample>(stats.max)};
+                snapshotOutputs[channelIdx][nSnapshots] = std::move(snapshot);
+            }
+            ++nSnapshots;
+            return true;
+        });
+        for (auto& snapshotOutput : snapshotOutputs) {
+            snapshotOutput.publish(nSnapshots);
+        }
+    }
+
+    void resetSnapshotHistory() {
+        _pendingSnapshots.clear();
+        _timingReferences.clear();
+        const std::size_t snapshotDepth = _triggerFilter.empty() ? 0UZ : pre_samples + post_samples;
+        const auto        historyDepth  = static_cast<std::size_t>(std::max(0.f, history_depth.value) * outputSampleRate());
+        const std::size_t depth         = std::max(snapshotDepth, historyDepth);
+        const std::size_t capacity      = depth == 0UZ ? 0UZ : depth + out[0].bufferSize(); // the newest chunk has to fit on top of the window
+        for (auto& history : _history) {
+            history.reset(capacity, _nSamplesPublished + unpublishedSamples);
+        }
+    }
+
+    void addRawAnchor(std::size_t position, std::size_t archiveIndex) {
+        if (!_rawAnchors.empty() && _rawAnchors.back().first == position) { // no output sample since the last chunk
+            _rawAnchors.back().second = archiveIndex;
+        } else {
+            _rawAnchors.emplace_back(position, archiveIndex);
+        }
+    }
+
+    [[nodiscard]] std::optional<std::size_t> rawIndex(std::size_t position) const {
+        const auto anchor = std::ranges::find_if(_rawAnchors | std::views::reverse, [position](const auto& a) { return a.first <= position; });
+        if (anchor == _rawAnchors.rend()) {
+            return std::nullopt;
+        }
+        const std::size_t step = _decimators[0].enabled() ? _decimators[0].decimation : 1UZ;
+        return anchor->second + (position - anchor->first) * step;
+    }
+
+    // the first `processed` output samples were published, positions are relative to the remaining ones. The anchors up to `processed` collapse into one
+    // at position 0, which replaces the last of them in place, so the vector never grows here
+    void advanceRawAnchors(std::size_t processed) {
+        const auto kept = std::ranges::find_if(_rawAnchors, [processed](const auto& a) { return a.first > processed; });
+        if (kept != _rawAnchors.begin()) {
+            const auto last = std::prev(kept);
+            *last           = {processed, *rawIndex(processed)};
+            _rawAnchors.erase(_rawAnchors.begin(), last);
+        }
+        for (auto& anchor : _rawAnchors) {
+            anchor.first -= processed;
+        }
+    }
+
+    /**
+     * Replayed archives (see PicoscopeReplay): the timing tags recorded with the driver data of `segment` were matched when it was acquired, so they are
+     * published at their recorded sample instead of being matched again. `firstOutput` and `step` map the driver data index to the output sample at
+     * `position` onwards. Tags between two decimated outputs are placed on the next output sample, tags after `nRaw` (dropped samples) are skipped.
+     */
+    void collectReplayedTags(std::size_t segment, std::size_t firstOutput, std::size_t step, std::size_t nRaw, std::size_t position) {
+        for (const RawIndexEntry& reference : _picoscope->replayedTimingReferences(segment)) {
+            if (reference.sampleIndex >= nRaw) {
+                continue;
+            }
+            gr::property_map map{{gr::tag::TRIGGER_NAME.shortKey(), std::string(reference.triggerName())}, {gr::tag::TRIGGER_TIME.shortKey(), static_cast<unsigned long>(reference.time)}, {gr::tag::TRIGGER_OFFSET.shortKey(), reference.offset}};
+            if (!reference.triggerContext().empty()) {
+                map.insert_or_assign(gr::tag::CONTEXT.shortKey(), std::string(reference.triggerContext()));
+            }
+            const std::size_t offset = reference.sampleIndex > firstOutput ? (reference.sampleIndex - firstOutput + step - 1UZ) / step : 0UZ;
+            _replayedTags.emplace_back(position + offset, std::move(map));
+        }
+    }
+
+    // the trigger edges at the replayed tags were matched to them during the recording, they must not be published as UNKNOWN_EVENT
+    void eraseReplayedEdges(std::size_t offset) {
+        if (!_replayedTags.empty()) {
+            std::erase_if(_triggerEdges, [&](std::size_t edge) { return std::ranges::any_of(_replayedTags, [&](const gr::Tag& tag) { return tag.index + offset == edge; }); });
+        }
+    }
+
+    // moves the replayed tags within the first `processed` samples to `tags`, the remaining ones are kept for the next iteration
+    void mergeReplayedTags(std::vector<gr::Tag>& tags, std::size_t processed) {
+        if (_replayedTags.empty()) {
+            return;
+        }
+        const auto split = std::ranges::stable_partition(_replayedTags, [processed](const gr::Tag& tag) { return tag.index < processed; });
+        std::move(_replayedTags.begin(), split.begin(), std::back_inserter(tags));
+        _replayedTags.erase(_replayedTags.begin(), split.begin());
+        std::ranges::stable_sort(tags, {}, &gr::Tag::index);
+        for (gr::Tag& tag : _replayedTags) {
+            tag.index -= processed;
+        }
+    }
+
+    // archive sample index of the output sample `lag` samples before the current unpublished + new samples, low_latency late tags only. Their anchors
+    // have been collapsed into the one at position 0 on publish
+    [[nodiscard]] std::optional<std::size_t> publishedRawIndex(std::size_t lag) const {
+        const std::size_t step = _decimators[0].enabled() ? _decimators[0].decimation : 1UZ;
+        if (_rawAnchors.empty() || _rawAnchors.front().first != 0UZ || _rawAnchors.front().second < lag * step) {
+            return std::nullopt;
+        }
+        return _rawAnchors.front().second - lag * step;
+    }
+
+    void recordTimingReference(std::optional<std::size_t> archiveIndex, const gr::property_map& map) {
+        const auto* time = map.get_if<unsigned long>(gr::tag::TRIGGER_TIME.shortKey());
+        if (time == nullptr || !archiveIndex) {
+            return;
+        }
+        RawIndexEntry entry{.time = *time, .sampleIndex = *archiveIndex};
+        if (const auto* offset = map.get_if<float>(gr::tag::TRIGGER_OFFSET.shortKey())) {
+            entry.offset = *offset;
+        }
+        const auto name    = map.find_value(gr::tag::TRIGGER_NAME.shortKey()); // keep the values alive while copying
+        const auto context = map.find_value(gr::tag::CONTEXT.shortKey());
+        entry.setText(name && name->is_string() ? name->value_or(std::string_view{}) : std::string_view{}, context && context->is_string() ? context->value_or(std::string_view{}) : std::string_view{});
+        _picoscope->recordTimingReference(entry);
+    }
+
+    void addTimingReference(std::size_t index, const gr::property_map& map) {
+        if (map.get_if<unsigned long>(gr::tag::TRIGGER_TIME.shortKey()) == nullptr && !map.contains(gr::tag::TRIGGER_NAME.shortKey())) {
+            return;
+        }
+        _timingReferences.emplace_back(index, map);
+        const std::size_t begin = _history[0].beginIndex();
+        while (!_timingReferences.empty() && _timingReferences.front().index < begin) {
+            _timingReferences.pop_front();
+        }
+    }
+
+    /**
+     * Copies the converted samples [first, first + out.size()) of a channel from the sample history, false if they are not (or no longer) available.
+     * Lock-free and safe to call from any thread while the block is running.
+     */
+    [[nodiscard]] bool readHistory(std::size_t channelIdx, std::size_t first, std::span<typename TSnapshotOutput::value_type> out) const { //
+        return channelIdx < _history.size() && _history[channelIdx].copy(first, out);
+    }
+
+    // absolute sample index acquired at `time` (ns), extrapolated from the most recent timing tag with a `trigger_time` at or before it
+    [[nodiscard]] std::optional<std::size_t> sampleIndexAt(std::uint64_t time) const {
+        for (const gr::Tag& reference : _timingReferences | std::views::reverse) {
+            const auto* referenceTime = reference.map.get_if<unsigned long>(gr::tag::TRIGGER_TIME.shortKey());
+            if (referenceTime == nullptr || *referenceTime > time) {
+                continue;
+            }
+            return reference.index + static_cast<std::size_t>(std::llround(static_cast<double>(time - *referenceTime) * 1e-9 * static_cast<double>(outputSampleRate())));
+        }
+        return std::nullopt;
+    }
+
+    std::optional<gr::Message> propertyCallbackHistory(std::string_view /*propertyName*/, gr::Message message) {
+        message.data = [&]() -> std::expected<gr::property_map, gr::Error> {
+            if (!message.data.has_value()) {
+                return std::unexpected(gr::Error("SampleHistory: request without data"));
+            }
+            const gr::property_map& request = message.data.value();
+
+            // reference sample
+            std::optional<std::size_t>      reference;
+            std::optional<gr::property_map> trigger;
+            if (const auto* index = request.get_if<std::uint64_t>("index")) {
+                reference = static_cast<std::size_t>(*index);
+            } else if (const auto* time = request.get_if<std::uint64_t>("time")) {
+                reference = sampleIndexAt(*time);
+            } else if (const auto* triggerName = request.get_if<std::string>("trigger")) {
+                const TriggerFilter filter = TriggerFilter::compile(*triggerName);
+                if (const auto it = std::ranges::find_if(_timingReferences | std::views::reverse, [&](const gr::Tag& tag) { return filter.matches(tag.map); }); it != std::ranges::end(_timingReferences | std::views::reverse)) {
+                    reference = it->index;
+                    trigger   = it->map;
+                }
+            } else {
+                return std::unexpected(gr::Error("SampleHistory: one of `index`, `time` or `trigger` is required"));
+            }
+            if (!reference) {
+                return std::unexpected(gr::Error("SampleHistory: no timing reference for the requested time or trigger"));
+            }
+
+            // window, rejected before anything is allocated if it cannot be in the history
+            const float       rate     = outputSampleRate();
+            const std::size_t capacity = _history[0].capacity();
+            const double      pre      = std::max(0.0, static_cast<double>(request.value_or<float>("pre", 0.f)) * static_cast<double>(rate));
+            const double      post     = std::max(0.0, static_cast<double>(request.value_or<float>("post", 0.f)) * static_cast<double>(rate));
+            if (pre + post > static_cast<double>(capacity)) {
+                return std::unexpected(gr::Error(std::format("SampleHistory: window of {:.0f} samples exceeds the history capacity of {} samples", pre + post, capacity)));
+            }
+            const auto        nPre  = static_cast<std::size_t>(pre);
+            const auto        nPost = static_cast<std::size_t>(post);
+            const std::size_t first = *reference - std::min(*reference, nPre);
+            const std::size_t count = *reference - first + nPost;
+
+            std::vector<std::string> channels = channel_ids.value;
+            if (const auto* requested = request.get_if<std::vector<std::string>>("channels")) {
+                channels = *requested;
+            }
+            gr::property_map                                  values;
+            std::vector<typename TSnapshotOutput::value_type> buffer(count);
+            std::vector<float>                                converted(count);
+            for (const std::string& channel : channels) {
+                const auto it = std::ranges::find(channel_ids.value, channel);
+                if (it == channel_ids.value.end()) {
+                    return std::unexpected(gr::Error(std::format("SampleHistory: unknown channel {}", channel)));
+                }
+                const auto channelIdx = static_cast<std::size_t>(std::distance(channel_ids.value.begin(), it));
+                if (!readHistory(channelIdx, first, buffer)) {
+                    return std::unexpected(gr::Error(std::format("SampleHistory: samples [{}, {}) are not in the history [{}, {})", first, first + count, _history[channelIdx].beginIndex(), _history[channelIdx].endIndex())));
+                }
+                const auto params = conversionParameters(channelIdx); // raw outputs are converted, the others are already in physical units
+                std::ranges::transform(buffer, converted.begin(), [&params](const auto& value) { return std::is_same_v<T, std::int16_t> ? params.offset + params.scale * kernel::toFloat(value) : kernel::toFloat(value); });
+                values.emplace(channel, converted);
+            }
+            gr::property_map reply{{"index", static_cast<std::uint64_t>(first)}, {"reference_index", static_cast<std::uint64_t>(*reference)}, {gr::tag::SAMPLE_RATE.shortKey(), rate}, {"channel_ids", channels}, {"values", std::move(values)}};
+            if (trigger) {
+                reply.emplace("trigger", std::move(*trigger));
+            }
+            return reply;
+        }();
+        return message;
+    }
+
+    std::optional<gr::Message> propertyCallbackLatency(std::string_view /*propertyName*/, gr::Message message) {
+        message.data = [&]() -> std::expected<gr::property_map, gr::Error> {
+            if (message.cmd == gr::message::Command::Set) {
+                if (!message.data.has_value() || !message.data.value().value_or<bool>("reset", false)) {
+                    return std::unexpected(gr::Error("Latency: read-only, only `reset = true` can be set"));
+                }
+                _latencies->reset();
+            }
+            gr::property_map reply;
+            for (const auto& [name, histogram] : std::views::zip(AcquisitionLatencies::kStageNames, _latencies->stages)) {
+                std::vector<std::uint64_t> bucketValues;
+                std::vector<std::uint64_t> bucketCounts;
+                for (std::size_t bucket = 0UZ; bucket < LatencyHistogram::kBuckets; ++bucket) {
+                    if (const std::uint64_t n = histogram.bucketCount(bucket); n > 0UZ) {
+                        bucketValues.push_back(LatencyHistogram::bucketValue(bucket));
+                        bucketCounts.push_back(n);
+                    }
+                }
+                reply.emplace(std::string(name), gr::property_map{{"count", histogram.count()}, {"mean", histogram.mean()}, {"p50", histogram.percentile(0.5)}, {"p99", histogram.percentile(0.99)}, {"p999", histogram.percentile(0.999)}, {"max", histogram.max()}, //
+                                                     {"bucket_values", std::move(bucketValues)}, {"bucket_counts", std::move(bucketCounts)}});
+            }
+            return reply;
+        }();
+        return message;
+    }
+
+    std::optional<gr::Message> propertyCallbackHealth(std::string_view /*propertyName*/, gr::Message message) {
+        if (message.cmd == gr::message::Command::Set) {
+            message.data = std::unexpected(gr::Error("Health: read-only property"));
+        } else {
+            gr::property_map reply = _health->toPropertyMap();
+            reply.emplace("thread_placement", gr::property_map{{"cpus", _threadPlacement.cpus}, {"policy", _threadPlacement.policy}, {"priority", _threadPlacement.priority}, {"degraded", _threadPlacement.degraded}});
+            message.data = std::move(reply);
+        }
+        return message;
+    }
+
+    /**
+     * Applies cpu_affinity and rt_priority to the scheduler worker calling processBulk until the returned object is destroyed at the end of the call, the
+     * worker gets its own placement back before it runs other blocks. The first call after a settings change resolves and reports the placement, later
+     * calls apply the resolved placement without allocating (a few syscalls, ~2 µs, see ScopedThreadPlacement) and cost nothing if neither setting is
+     * used. A priority which was denied is not retried on every call.
+     */
+    [[nodiscard]] fair::thread::ScopedThreadPlacement placeAcquisitionThread() {
+        if (_threadPlacementResolved) {
+            return fair::thread::ScopedThreadPlacement(_acquisitionPlacement);
+        }
+        _threadPlacementResolved = true;
+        const fair::thread::ThreadPlacement requested{.cpuAffinity = cpu_affinity, .rtPriority = rt_priority};
+        _acquisitionPlacement = fair::thread::resolve(requested);
+        fair::thread::ScopedThreadPlacement placement(requested);
+        _threadPlacement = requested.empty() ? fair::thread::currentPlacement() : placement.effective();
+        if (_threadPlacement.policy != "SCHED_FIFO") {
+            _acquisitionPlacement.priority = 0;
+        }
+        fair::thread::report(this->name.value, "acquisition", requested, _threadPlacement, verbose_console);
+        return placement;
+    }
+
+    // rewrites the Prometheus snapshot at `metrics_path` if `metrics_interval` has passed since the last write (or if forced)
+    void writeMetrics(bool force = false) {
+        if (metrics_path.value.empty()) {
+            return;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (!force && now < _nextMetricsWrite) {
+            return;
+        }
+        _nextMetricsWrite = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(std::max(metrics_interval.value, 0.1f)));
+        const std::array<std::pair<std::string_view, std::string_view>, 2UZ> labels{{{"block", this->name.value}, {"serial", serial_number.value}}};
+        if (auto result = AcquisitionHealth::writeSnapshot(metrics_path.value, _health->toPrometheus(labels)); !result) {
+            this->emitErrorMessage(std::format("{}::writeMetrics()", this->name), gr::Error(result.error()));
+        }
+    }
+
+    /**
+     * Streaming mode: feeds the samples published now into the spectrum accumulators and publishes every completed spectrum. Timing tags passing
+     * `spectrum_trigger` restart the averaging at their sample, the next spectrum carries the tag in its timing events. Spectra are dropped if the
+     * output buffer is full.
+     */
+    template<gr::OutputSpanLike TOutSpan, gr::OutputSpanLike TSpectrumSpan>
+    void publishSpectra(std::span<TOutSpan>& outputs, std::span<const gr::Tag> tags, std::size_t nSamples, std::span<TSpectrumSpan>& spectrumOutputs) {
+        for (std::size_t channelIdx = 0UZ; channelIdx < spectrumOutputs.size(); ++channelIdx) {
+            auto&       spectrum = _spectra[channelIdx];
+            std::size_t nSpectra = 0UZ;
+            if (!spectrum.enabled() || channelIdx >= channel_ids.value.size()) {
+                spectrumOutputs[channelIdx].publish(0UZ);
+                continue;
+            }
+            const auto  params = conversionParameters(channelIdx); // raw outputs are scaled, converted outputs are already in physical units
+            const float scale  = std::is_same_v<T, std::int16_t> ? params.scale : 1.f;
+            const float offset = std::is_same_v<T, std::int16_t> ? params.offset : 0.f;
+            const auto  values = std::span<const T>(outputs[channelIdx]).first(nSamples);
+            std::size_t first  = 0UZ;
+            const auto  feed   = [&](std::size_t end) {
+                spectrum.push(values.subspan(first, end - first), scale, offset, [&](std::span<const float> average, std::size_t nAverages, std::size_t lastIndex) {
+                    if (nSpectra >= spectrumOutputs[channelIdx].size()) {
+                        if (verbose_console) {
+                            std::println("dropping spectrum of channel {}: output buffer full", channel_ids.value[channelIdx]);
+                        }
+                        return;
+                    }
+                    fillSpectrumDataset(_spectrumPool[channelIdx], channelIdx, average, nAverages, _nSamplesPublished + first + lastIndex);
+                    std::swap(spectrumOutputs[channelIdx][nSpectra++], _spectrumPool[channelIdx]);
+                });
+                first = end;
+            };
+            if (!_spectrumTriggerFilter.empty()) {
+                for (const auto& [index, map] : tags) {
+                    if (index < nSamples && _spectrumTriggerFilter.matches(map)) {
+                        feed(index);
+                        spectrum.restart();
+                        _spectrumTrigger[channelIdx].emplace(0, map);
+                    }
+                }
+            }
+            feed(nSamples);
+            spectrumOutputs[channelIdx].publish(nSpectra);
+        }
+    }
+
+    void fillSpectrumDataset(gr::DataSet<float>& ds, std::size_t channelIdx, std::span<const float> average, std::size_t nAverages, std::size_t lastIndex) {
+        const std::string unit = std::string(getChannelSetting(std::span(signal_units.value), channelIdx, {}));
+        ds.timestamp           = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        ds.axis_names          = {"Frequency"};
+        ds.axis_units          = {"Hz"};
+        ds.extents             = {static_cast<int32_t>(average.size())};
+        ds.layout              = gr::LayoutRight{};
+        ds.signal_names        = {std::string(getChannelSetting(std::span(signal_names.value), channelIdx, {}))};
+        ds.signal_units        = {unit.empty() ? std::string{} : std::format("{}^2", unit)};
+        ds.signal_quantities   = {"power spectrum"};
+
+        const float binWidth = outputSampleRate() / static_cast<float>(_spectra[channelIdx].length());
+        ds.axis_values.resize(1);
+        ds.axis_values[0].resize(average.size());
+        for (std::size_t bin = 0UZ; bin < average.size(); ++bin) {
+            ds.axis_values[0][bin] = static_cast<float>(bin) * binWidth;
+        }
+        ds.signal_values.assign(average.begin(), average.end());
+        const auto [min, max] = std::ranges::minmax(average);
+        ds.signal_ranges      = {{min, max}};
+
+        ds.timing_events.resize(1);
+        ds.timing_events[0].clear();
+        if (auto& trigger = _spectrumTrigger[channelIdx]) { // only the first spectrum after the trigger is aligned to it
+            ds.timing_events[0].push_back(std::move(*trigger));
+            trigger.reset();
+        }
+        ds.meta_information.resize(1);
+        ds.meta_information[0] = gr::property_map{
+            {gr::tag::SAMPLE_RATE.shortKey(), outputSampleRate()},
+            {"spectrum_window", spectrum_window.value},
+            {"spectrum_length", static_cast<gr::Size_t>(_spectra[channelIdx].length())},
+            {"spectrum_averages", static_cast<gr::Size_t>(nAverages)},
+            {"spectrum_end_index", static_cast<std::uint64_t>(lastIndex + 1UZ)}, // absolute sample index after the last averaged sample
+        };
+    }
+
+    void configureSpectra() {
+        if constexpr (acquisitionMode == AcquisitionMode::Streaming) {
+            std::size_t length = spectrum_length;
+            if (length > 0UZ && !std::has_single_bit(length)) {
+                this->emitErrorMessage(std::format("{}::settingsChanged()", this->name), gr::Error(std::format("spectrum_length must be a power of two: {}", length)));
+                length = 0UZ;
+            }
+            auto window = kernel::SpectrumAccumulator::parseWindow(spectrum_window.value);
+            if (!window) {
+                this->emitErrorMessage(std::format("{}::settingsChanged()", this->name), gr::Error(std::format("Invalid spectrum window: {}", spectrum_window.value)));
+            }
+            const auto updateInterval = spectrum_update_rate > 0.f ? static_cast<std::size_t>(outputSampleRate() / spectrum_update_rate) : 0UZ;
+            for (auto& spectrum : _spectra) {
+                spectrum.configure(length, window.value_or(kernel::SpectrumAccumulator::Window::Hann), updateInterval);
+            }
+            for (auto& trigger : _spectrumTrigger) {
+                trigger.reset();
+            }
+        }
+    }
+
+    template<gr::OutputSpanLike TOutSpan, gr::OutputSpanLike TSnapshotSpan, gr::OutputSpanLike TSpectrumSpan>
     requires(acquisitionMode == AcquisitionMode::RapidBlock)
-    gr::work::Status processBulk(gr::InputSpanLike auto& timingInSpan, std::span<TOutSpan>& outputs, gr::OutputSpanLike auto& digitalOutSpan) {
+    gr::work::Status processBulk(gr::InputSpanLike auto& timingInSpan, std::span<TOutSpan>& outputs, gr::OutputSpanLike auto& digitalOutSpan, std::span<TSnapshotSpan>& snapshotOutputs, std::span<TSpectrumSpan>& spectrumOutputs) {
+        FAIR_TRACE_SPAN("Picoscope::processBulk", "picoscope");
+        const auto placement = placeAcquisitionThread(); // for the duration of this call
         using TSample  = typename T::value_type;
         auto armResult = processTagsTriggered(timingInSpan);
+        writeMetrics();
         if (!_isArmed) {
             if (armResult.arm) {
                 _picoscope->setPaused(false);
@@ -329,42 +1040,90 @@ public:
                 output.publish(0);
             }
             digitalOutSpan.publish(0);
+            for (auto& snapshotOutput : snapshotOutputs) {
+                snapshotOutput.publish(0);
+            }
+            for (auto& spectrumOutput : spectrumOutputs) {
+                spectrumOutput.publish(0);
+            }
             return gr::work::Status::OK; // nothing to do here as the triggering is currently disabled
         }
         if (armResult.disarm) {
             _picoscope->setPaused(true);
             _isArmed = false; // todo move inside disarm?
         }
-        std::size_t nCaptures  = 0;
-        const auto  pollResult = _picoscope->poll([&](const std::span<std::span<const std::int16_t>> data, const std::int16_t overflow) {
+        if (rapid_block_layout == RapidBlockLayout::Burst && std::ranges::any_of(outputs.first(std::min(channel_ids.value.size(), outputs.size())), [](const auto& output) { return output.size() == 0UZ; })) {
+            for (auto& output : outputs) { // the burst is swapped into the first free slot, leave the captures with the driver until the consumer caught up
+                output.publish(0);
+            }
+            digitalOutSpan.publish(0);
+            for (auto& snapshotOutput : snapshotOutputs) {
+                snapshotOutput.publish(0);
+            }
+            for (auto& spectrumOutput : spectrumOutputs) {
+                spectrumOutput.publish(0);
+            }
+            return gr::work::Status::INSUFFICIENT_OUTPUT_ITEMS;
+        }
+        std::size_t                           nCaptures  = 0;
+        const auto                            pollStart  = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point firstReady{}; // driver delivered the first capture
+        std::chrono::steady_clock::time_point handlerEnd{};
+        std::size_t                           nCapturedSamples = 0UZ; // per channel, all captures
+        const auto                            pollResult       = _picoscope->poll([&](const std::span<std::span<const std::int16_t>> data, const std::int16_t overflow) {
             const std::chrono::system_clock::time_point acquisitionTime = std::chrono::system_clock::now();
+            nCapturedSamples += data[0].size();
+            AcquisitionHealth::increment(_health->samplesAcquired, data[0].size());
+            if (overflow != 0) {
+                AcquisitionHealth::increment(_health->overflowEvents);
+            }
+            _analogTriggerEdges.clear();
+            _edgeDetector.reset(); // every capture starts with an unknown trigger state
+            const bool multiChannel = rapid_block_layout == RapidBlockLayout::MultiChannel;
+            const bool burst        = rapid_block_layout == RapidBlockLayout::Burst;
+            if (multiChannel && !channel_ids.value.empty()) {
+                outputs[0][nCaptures] = createMultiChannelDataset(data[0].size());
+            }
             for (std::size_t channelIdx = 0; channelIdx < channel_ids.value.size(); channelIdx++) {
-                const float voltageMultiplier  = getChannelSetting(std::span(channel_ranges.value), channelIdx, 5.0f) / static_cast<float>(_maxValue);
-                const auto  driverData         = data[channelIdx];
-                outputs[channelIdx][nCaptures] = createDataset(channelIdx, driverData.size());
-                const auto offset              = getChannelSetting(std::span(signal_offsets.value), channelIdx, 0.0f);
-                const auto scale               = getChannelSetting(std::span(signal_scales.value), channelIdx, 1.0f);
-                for (std::size_t j = 0; j < driverData.size(); ++j) {
-                    if constexpr (std::is_same_v<TSample, float>) {
-                        outputs[channelIdx][nCaptures].signal_values[j] = offset + scale * voltageMultiplier * static_cast<float>(driverData[j]);
-                    } else if constexpr (std::is_same_v<TSample, gr::UncertainValue<float>>) {
-                        outputs[channelIdx][nCaptures].signal_values[j] = gr::UncertainValue(offset + scale * voltageMultiplier * static_cast<float>(driverData[j]), TPSImpl::uncertainty());
-                    } else if constexpr (std::is_same_v<TSample, int16_t>) {
-                        outputs[channelIdx][nCaptures].signal_values[j] = driverData[j]; // std::ranges::copy(driverData, output.begin() + static_cast<std::ptrdiff_t>(channel.unpublished.size()));
-                    }
+                const auto driverData = data[channelIdx];
+                if (burst) {
+                    prepareBurstDataset(_burstPool[channelIdx], channelIdx, nCaptures, driverData.size());
+                } else if (!multiChannel) {
+                    outputs[channelIdx][nCaptures] = createDataset(channelIdx, driverData.size());
                 }
+                T&                dataset   = burst ? _burstPool[channelIdx] : (multiChannel ? outputs[0][nCaptures] : outputs[channelIdx][nCaptures]);
+                const std::size_t signalIdx = multiChannel ? channelIdx : 0UZ;
+                const std::size_t rowIdx    = burst ? nCaptures : signalIdx; // row of the 2-D signal_values: channel (multi-channel) or segment (burst)
+                auto&             stats     = _channelStatistics[channelIdx];
+                auto&             overRange = _overRange[channelIdx];
+                stats.reset();
+                if (!burst || nCaptures == 0UZ) { // burst: the intervals of all segments are collected in the single signal
+                    overRange.intervals.clear();
+                }
+                overRange.indexOffset = burst ? nCaptures * driverData.size() : 0UZ;
+                kernel::convertChannel(driverData, std::span(dataset.signal_values).subspan(rowIdx * driverData.size(), driverData.size()), conversionParameters(channelIdx), //
+                    _analogTriggerChannel == channelIdx ? &_edgeDetector : nullptr, 0UZ, _analogTriggerEdges, stats, &overRange);
+                overRange.close(driverData.size());
                 // add Tags
-                if (overflow | (1 << channelIdx)) {                                                  // picoscope overrange
-                    outputs[channelIdx][nCaptures].metaInformation(0UZ).insert({"Overrange", true}); // todo: use correct tag string
+                if ((overflow & _overflowMasks[channelIdx]) || !overRange.intervals.empty()) { // picoscope overrange
+                    dataset.metaInformation(signalIdx).insert({"Overrange", true});   // todo: use correct tag string
                 }
-                if constexpr (std::is_same_v<TSample, float> || std::is_same_v<TSample, std::int16_t>) {
-                    gr::dataset::updateMinMax(outputs[channelIdx][nCaptures]);
-                } else {
-                    // TODO: fix UncertainValue, it requires changes in GR4
+                if (!overRange.intervals.empty()) { // flattened [start, end) pairs, indices within the signal values
+                    std::vector<std::uint64_t> intervals;
+                    intervals.reserve(2UZ * overRange.intervals.size());
+                    for (const auto& [start, end] : overRange.intervals) {
+                        intervals.push_back(start);
+                        intervals.push_back(end);
+                    }
+                    dataset.metaInformation(signalIdx).erase("over_range_intervals");
+                    dataset.metaInformation(signalIdx).insert({"over_range_intervals", std::move(intervals)});
+                }
+                if (stats.count > 0UZ) {
+                    dataset.signal_ranges[rowIdx] = {toSample<TSample>(stats.min), toSample<TSample>(stats.max)};
                 }
             }
             if constexpr (TPSImpl::N_DIGITAL_CHANNELS > 0) {
-                digitalOutSpan[nCaptures] = createDatasetDigital(data.back().size());
+                prepareDatasetDigital(digitalOutSpan[nCaptures], data.back().size());
                 for (std::size_t j = 0; j < data.back().size(); ++j) {
                     if (digital_port_invert_output) {
                         digitalOutSpan[nCaptures].signal_values[j] = static_cast<std::uint16_t>(~data.back()[j]);
@@ -373,40 +1132,64 @@ public:
                     }
                 }
             }
-            tagMatcher.reset();                                      // reset the tag matcher because for triggered acquisition there is always a gap in the data
-            std::vector<std::size_t> triggerOffsets = {pre_samples}; // by default, only give the edge that has actually triggered this acquisition
+            const auto converted = std::chrono::steady_clock::now();
+            _latencies->record(LatencyStage::Conversion, _picoscope->driverReady, converted);
+            FAIR_TRACE_EVENT("conversion", "picoscope", _picoscope->driverReady, converted);
+            if (nCaptures == 0UZ) {
+                firstReady = _picoscope->driverReady;
+            }
+            tagMatcher.reset();                    // reset the tag matcher because for triggered acquisition there is always a gap in the data
+            _triggerEdges.assign(1UZ, pre_samples); // by default, only give the edge that has actually triggered this acquisition
             // if the trigger channel is also digitised, we can additionally add other edges within the acquisition window.
             if (detail::isDigitalTrigger(trigger_source)) {
                 if constexpr (TPSImpl::N_DIGITAL_CHANNELS > 0) {
                     if (const std::expected<uint, gr::Error> digitalPin = detail::parseDigitalTriggerSource(trigger_source); digitalPin) {
-                        triggerOffsets = findDigitalTriggers(digitalPin.value(), digitalOutSpan[nCaptures].signalValues(0UZ));
+                        _triggerEdges.clear();
+                        findDigitalTriggers(digitalPin.value(), digitalOutSpan[nCaptures].signalValues(0UZ), _triggerEdges);
                     } else {
                         throw Error(std::format("Invalid Digital Trigger Source: {}", trigger_source.value));
                     }
                 }
-            } else {
-                for (const auto& [i, channel] : std::views::zip(std::views::iota(0U), channel_ids.value)) {
-                    if (channel == std::string_view{trigger_source}) {
-                        triggerOffsets = findAnalogTriggers(static_cast<std::size_t>(i), outputs[static_cast<std::size_t>(i)][nCaptures].signalValues(0UZ));
+            } else if (_analogTriggerChannel) {
+                _triggerEdges.assign(_analogTriggerEdges.begin(), _analogTriggerEdges.end()); // detected during conversion
+            }
+            _replayedTags.clear();
+            collectReplayedTags(nCaptures, 0UZ, 1UZ, data[0].size(), 0UZ); // one poll per call, the captures arrive in the order of their memory segments
+            eraseReplayedEdges(0UZ);
+            tagMatcher.match(_currentTimingTags, _triggerEdges, pre_samples + post_samples, acquisitionTime.time_since_epoch() - std::chrono::nanoseconds(static_cast<long>(1e9f * static_cast<float>(pre_samples + post_samples) / sample_rate)), _matchedTags);
+            mergeReplayedTags(_matchedTags.tags, data[0].size());
+            const timingmatcher::MatcherResult& triggerTags = _matchedTags;
+            _latencies->record(LatencyStage::Match, converted, std::chrono::steady_clock::now());
+            _health->addMatcherResult(triggerTags);
+            std::swap(_currentTimingTags, _nextTimingTags); // keeps the capacity of both
+            _nextTimingTags.clear();
+            if (_picoscope->isRecording()) { // the wrapper has recorded the capture before calling this handler
+                const std::size_t captureStart = _picoscope->recordedSamples() - data[0].size();
+                for (const auto& [index, map] : triggerTags.tags) {
+                    if (static_cast<std::ptrdiff_t>(index) >= 0) {
+                        recordTimingReference(captureStart + index, map);
                     }
                 }
             }
-            auto triggerTags   = tagMatcher.match(_currentTimingTags, triggerOffsets, pre_samples + post_samples, acquisitionTime.time_since_epoch() - std::chrono::nanoseconds(static_cast<long>(1e9f * static_cast<float>(pre_samples + post_samples) / sample_rate)));
-            _currentTimingTags = std::move(_nextTimingTags);
-            _nextTimingTags.clear();
             if (!triggerTags.tags.empty()) {
                 for (std::size_t channelIdx = 0; channelIdx < channel_ids.value.size(); ++channelIdx) {
-                    auto& output = outputs[channelIdx][nCaptures];
+                    if (!hasTimingTags(channelIdx) || (multiChannel && channelIdx > 0UZ)) { // the multi-channel DataSet has one timing event list shared by all channels
+                        continue;
+                    }
+                    auto&             output   = burst ? _burstPool[channelIdx] : outputs[channelIdx][nCaptures];
+                    const std::size_t eventIdx = burst ? nCaptures : 0UZ; // burst: one timing event list per segment
                     for (auto& [index, map] : triggerTags.tags) {
                         if (static_cast<std::ptrdiff_t>(index) >= 0u) {
-                            output.timing_events[0].push_back({static_cast<std::ptrdiff_t>(index), map});
+                            output.timing_events[eventIdx].push_back({static_cast<std::ptrdiff_t>(index), map});
                         }
                     }
                 }
                 if constexpr (TPSImpl::N_DIGITAL_CHANNELS > 0) {
-                    for (auto& [index, map] : triggerTags.tags) {
-                        if (static_cast<std::ptrdiff_t>(index) >= 0u) {
-                            digitalOutSpan[nCaptures].timing_events[0].push_back({static_cast<std::ptrdiff_t>(index), map});
+                    if (hasTimingTagsDigital()) {
+                        for (auto& [index, map] : triggerTags.tags) {
+                            if (static_cast<std::ptrdiff_t>(index) >= 0u) {
+                                digitalOutSpan[nCaptures].timing_events[0].push_back({static_cast<std::ptrdiff_t>(index), map});
+                            }
                         }
                     }
                 }
@@ -417,8 +1200,10 @@ public:
                     }
                 }
             }
+            handlerEnd = std::chrono::steady_clock::now();
             nCaptures++;
         });
+        const auto pollReturned = std::chrono::steady_clock::now();
         if (!pollResult) {
             if (verbose_console) {
                 std::println("Error polling: {}@{}L{}", pollResult.error().getDescription(), pollResult.error().location.file_name(), pollResult.error().location.line());
@@ -432,14 +1217,46 @@ public:
                 output.publish(0);
             }
             digitalOutSpan.publish(0);
+            for (auto& snapshotOutput : snapshotOutputs) {
+                snapshotOutput.publish(0);
+            }
+            for (auto& spectrumOutput : spectrumOutputs) {
+                spectrumOutput.publish(0);
+            }
             return gr::work::Status::INSUFFICIENT_INPUT_ITEMS;
         }
 
         // publish
-        for (std::size_t i = 0; i < outputs.size(); i++) {
-            outputs[i].publish(nCaptures);
+        if (rapid_block_layout == RapidBlockLayout::Burst) {
+            for (std::size_t i = 0; i < outputs.size(); i++) {
+                if (i < channel_ids.value.size()) {
+                    finishBurstDataset(_burstPool[i], nCaptures);
+                    std::swap(outputs[i][0], _burstPool[i]); // recycle the storage of the old buffer slot for the next burst
+                    if (reserveBurstDataset(i)) {
+                        AcquisitionHealth::increment(_health->burstAllocations);
+                    }
+                }
+                outputs[i].publish(1UZ);
+            }
+        } else {
+            for (std::size_t i = 0; i < outputs.size(); i++) {
+                outputs[i].publish(rapid_block_layout == RapidBlockLayout::MultiChannel && i > 0UZ ? 0UZ : nCaptures);
+            }
         }
         digitalOutSpan.publish(nCaptures);
+        for (auto& snapshotOutput : snapshotOutputs) {
+            snapshotOutput.publish(0);
+        }
+        for (auto& spectrumOutput : spectrumOutputs) {
+            spectrumOutput.publish(0);
+        }
+        AcquisitionHealth::increment(_health->samplesPublished, nCapturedSamples);
+        const auto published = std::chrono::steady_clock::now();
+        _latencies->record(LatencyStage::Driver, pollStart, firstReady);
+        _latencies->record(LatencyStage::Poll, handlerEnd, pollReturned);
+        _latencies->record(LatencyStage::Publish, pollReturned, published);
+        _latencies->record(LatencyStage::Total, firstReady, published);
+        FAIR_TRACE_EVENT("publish", "picoscope", pollReturned, published);
 
         if (trigger_once) {
             _picoscope->stopAcquisition();
@@ -448,6 +1265,18 @@ public:
         return gr::work::Status::OK;
     }
 
+    // matched timing tags are identical for all channels, `timing_tag_ports` allows to publish them only once instead of copying them to every port
+    [[nodiscard]] bool hasTimingTags(std::size_t channelIdx) const {
+        switch (timing_tag_ports.value) {
+        case TimingTagPorts::All: return true;
+        case TimingTagPorts::Digital: return TPSImpl::N_DIGITAL_CHANNELS == 0 && channelIdx == 0UZ;
+        case TimingTagPorts::First: return channelIdx == 0UZ;
+        }
+        return true;
+    }
+
+    [[nodiscard]] bool hasTimingTagsDigital() const { return timing_tag_ports == TimingTagPorts::All || (timing_tag_ports == TimingTagPorts::Digital && TPSImpl::N_DIGITAL_CHANNELS > 0); }
+
     auto processTagsTriggered(gr::InputSpanLike auto& tagData) {
         struct tagProcessResult {
             bool arm    = false;
@@ -455,14 +1284,13 @@ public:
         } result;
         bool armed = _isArmed;
         for (const auto& [i, tag_map] : tagData.tags()) {
-            if (!trigger_arm.value.empty() || !trigger_disarm.value.empty()) {
-                auto tagMapOwned = tag_map.get().owned();
-                if (detail::tagContainsTrigger(tagMapOwned, _armTriggerNameAndCtx)) {
+            if (!_armTriggerFilter.empty() || !_disarmTriggerFilter.empty()) {
+                if (_armTriggerFilter.matches(tag_map.get())) {
                     result.arm = true;
                     armed      = true;
                     _nextTimingTags.clear();
                 }
-                if (detail::tagContainsTrigger(tagMapOwned, _disarmTriggerNameAndCtx)) {
+                if (_disarmTriggerFilter.matches(tag_map.get())) {
                     result.disarm = true;
                     armed         = false;
                 }
@@ -488,10 +1316,80 @@ public:
         }
     }
 
+    // Streaming mode applies the analog offset, RapidBlock mode the signal offset, the range defaults to the ±5 V used for the trigger threshold
+    [[nodiscard]] kernel::ConversionParameters conversionParameters(std::size_t channelIdx) const {
+        const float voltageMultiplier = getChannelSetting(std::span(channel_ranges.value), channelIdx, kDefaultChannelRange) / static_cast<float>(_maxValue);
+        const float offset            = acquisitionMode == AcquisitionMode::Streaming ? getChannelSetting(std::span(channel_analog_offsets.value), channelIdx, 0.0f) : getChannelSetting(std::span(signal_offsets.value), channelIdx, 0.0f);
+        const auto* calibration       = channelIdx < _calibrations.size() && !_calibrations[channelIdx].empty() ? &_calibrations[channelIdx] : nullptr;
+        return {.scale = getChannelSetting(std::span(signal_scales.value), channelIdx, 1.0f) * voltageMultiplier, .offset = offset, .uncertainty = TPSImpl::uncertainty(), .maxValue = _maxValue, .calibration = calibration};
+    }
+
+    // exact serial number entries require `serial_number` to be set, otherwise only the `*` entries of the calibration table apply
+    void updateCalibrations() {
+        for (std::size_t channelIdx = 0UZ; channelIdx < _calibrations.size(); ++channelIdx) {
+            const CalibrationTable::Entry* entry = nullptr;
+            if (channelIdx < channel_ids.value.size()) {
+                entry = _calibrationTable.find(serial_number.value, channel_ids.value[channelIdx], getChannelSetting(std::span(channel_ranges.value), channelIdx, kDefaultChannelRange));
+            }
+            const auto offset         = conversionParameters(channelIdx).offset;
+            _calibrations[channelIdx] = kernel::Calibration::create(entry ? std::span<const float>(entry->coefficients) : std::span<const float>{}, getChannelSetting(std::span(channel_ranges.value), channelIdx, kDefaultChannelRange), //
+                getChannelSetting(std::span(signal_scales.value), channelIdx, 1.0f), offset, _maxValue);
+        }
+    }
+
+    [[nodiscard]] float outputSampleRate() const noexcept {
+        if constexpr (acquisitionMode == AcquisitionMode::Streaming) {
+            return sample_rate / static_cast<float>(std::max(decimation.value, gr::Size_t{1}));
+        } else {
+            return sample_rate;
+        }
+    }
+
+    // the linear conversion is folded into the FIR taps, raw and calibrated outputs filter the ADC counts and convert afterwards
+    void configureDecimators() {
+        const std::size_t factor = acquisitionMode == AcquisitionMode::Streaming ? static_cast<std::size_t>(decimation.value) : 1UZ;
+        for (std::size_t channelIdx = 0UZ; channelIdx < _decimators.size(); ++channelIdx) {
+            const auto params   = conversionParameters(channelIdx);
+            const bool filtered = std::is_same_v<T, std::int16_t> || params.calibration != nullptr;
+            _decimators[channelIdx].configure(factor, decimation_taps.value, filtered ? 1.f : params.scale, filtered ? 0.f : params.offset);
+        }
+    }
+
+    // decimating counterpart of kernel::convertChannel(), edges and over-range intervals are reported in the decimated time base
+    template<typename TOut>
+    void convertDecimated(std::size_t channelIdx, std::span<const std::int16_t> raw, std::span<TOut> out) {
+        auto&             decimator = _decimators[channelIdx];
+        const std::size_t nOutput   = decimator.outputCount(raw.size());
+        _decimatedOverRange.resize(nOutput);
+        const auto* calibration = _calibrations[channelIdx].empty() ? nullptr : &_calibrations[channelIdx];
+        if constexpr (std::is_same_v<TOut, float>) {
+            if (calibration == nullptr) {
+                decimator.process(raw, out, _decimatedOverRange, _maxValue);
+            }
+        }
+        if (!std::is_same_v<TOut, float> || calibration != nullptr) {
+            _decimatedTile.resize(nOutput);
+            decimator.process(raw, _decimatedTile, _decimatedOverRange, _maxValue);
+            for (std::size_t i = 0UZ; i < nOutput; ++i) {
+                if constexpr (std::is_same_v<TOut, std::int16_t>) {
+                    out[i] = static_cast<std::int16_t>(std::clamp(std::round(_decimatedTile[i]), -32768.f, 32767.f));
+                } else {
+                    out[i] = toSample<TOut>(calibration != nullptr ? calibration->evaluate(_decimatedTile[i]) : _decimatedTile[i]);
+                }
+            }
+        }
+        const std::span<const TOut> values = out.first(nOutput);
+        _channelStatistics[channelIdx].accumulate(values);
+        _channelStatistics[channelIdx].overRange += _overRange[channelIdx].process(_decimatedOverRange, _maxValue, unpublishedSamples);
+        if (_analogTriggerChannel == channelIdx) {
+            _edgeDetector.process(values, unpublishedSamples, _analogTriggerEdges);
+        }
+    }
+
     [[nodiscard]] gr::property_map channelToTagMap(std::size_t channelIdx, float sampleRate) {
-        const float offset = getChannelSetting(std::span(signal_offsets.value), channelIdx, 0.0f);
-        const float range  = getChannelSetting(std::span(channel_ranges.value), channelIdx, 0.0f);
-        return {
+        const float      offset = getChannelSetting(std::span(signal_offsets.value), channelIdx, 0.0f);
+        const float      range  = getChannelSetting(std::span(channel_ranges.value), channelIdx, kDefaultChannelRange);
+        gr::property_map map{
             {gr::tag::SIGNAL_NAME.shortKey(), getChannelSetting(std::span(signal_names.value), channelIdx, {})},
             {gr::tag::SAMPLE_RATE.shortKey(), sampleRate},
             {gr::tag::SIGNAL_QUANTITY.shortKey(), getChannelSetting(std::span(signal_quantities.value), channelIdx, {})},
@@ -499,6 +1397,38 @@ public:
             {gr::tag::SIGNAL_MIN.shortKey(), offset - range},
             {gr::tag::SIGNAL_MAX.shortKey(), offset + range},
         };
+        if constexpr (std::is_same_v<typename TSnapshotOutput::value_type, std::int16_t>) { // raw ADC counts: publish the exact conversion, applied downstream by e.g. RawScale
+            map.emplace("channel_range", range);
+            map.emplace("channel_analog_offset", getChannelSetting(std::span(channel_analog_offsets.value), channelIdx, 0.0f));
+            map.emplace("signal_scale", getChannelSetting(std::span(signal_scales.value), channelIdx, 1.0f));
+            map.emplace("signal_offset", offset);
+            conversionParameters(channelIdx).addTo(map);
+        }
+        if (channelIdx < _calibrations.size() && !_calibrations[channelIdx].empty()) { // applied for floating point outputs, to be applied downstream for int16
+            map.emplace("calibration_method", _calibrations[channelIdx].method());
+            map.emplace("calibration_coefficients", _calibrations[channelIdx].coefficients);
+        }
+        return map;
+    }
+
+    template<typename TSample>
+    [[nodiscard]] static constexpr TSample toSample(float value) {
+        if constexpr (std::is_same_v<TSample, gr::UncertainValue<float>>) {
+            return gr::UncertainValue(value, TPSImpl::uncertainty());
+        } else {
+            return static_cast<TSample>(value);
+        }
+    }
+
+    void configureEdgeDetector() {
+        _analogTriggerChannel.reset();
+        if (detail::isAnalogTrigger(trigger_source)) {
+            if (const auto it = std::ranges::find(channel_ids.value, trigger_source.value); it != channel_ids.value.end()) {
+                _analogTriggerChannel = static_cast<std::size_t>(std::distance(channel_ids.value.begin(), it));
+            }
+        }
+        _edgeDetector = {.threshold = trigger_threshold.value, .band = _analogTriggerChannel ? getChannelSetting(std::span(channel_ranges.value), *_analogTriggerChannel, kDefaultChannelRange) / 100.f : 0.f, .direction = trigger_direction.value};
+        _analogTriggerEdges.clear();
     }
 
     template<typename P>
@@ -513,8 +1443,17 @@ public:
     }
 
     void settingsChanged(const gr::property_map& oldSettings, const gr::property_map& newSettings) {
-        tagMatcher.sampleRate = sample_rate;
+        tagMatcher.sampleRate = outputSampleRate(); // the matcher works on the (decimated) output samples
         tagMatcher.timeout    = std::chrono::nanoseconds(matcher_timeout);
+        configureEdgeDetector();
+        if (newSettings.contains("cpu_affinity") || newSettings.contains("rt_priority")) {
+            _threadPlacementResolved = false; // resolved by the next processBulk
+        }
+        if (newSettings.contains("low_latency")) { // speculative samples are only tracked in low_latency mode
+            tagMatcher.reset();
+            _speculativeSamples = 0UZ;
+            _speculativeEdges.clear();
+        }
 
         const auto getOldSettingsSerialNumber = [&]() -> std::optional<std::string> {
             if (!oldSettings.contains("serial_number")) {
@@ -530,14 +1469,16 @@ public:
 
         if (!_picoscope || serial_number != getOldSettingsSerialNumber()) {
             _picoscope.emplace(serial_number, verbose_console);
+            _picoscope->health = _health.get();
         }
+        _picoscope->data.setOptions(driverBufferOptions());
         std::set<std::size_t> configuredSuccessfully{};
         for (const auto& [i, channelName] : std::views::zip(std::views::iota(0UZ), _picoscope->getChannelIds())) {
             ChannelConfig channelConfig = _picoscope->getChannelConfig(i);
             if (auto j = findChannelSettingIndex(channelName)) {
                 configuredSuccessfully.insert(*j);
                 channelConfig.enable   = true;
-                channelConfig.range    = toAnalogChannelRange(getChannelSetting(std::span(channel_ranges.value), *j, 5.0f)).value_or(AnalogChannelRange::ps5V);
+                channelConfig.range    = toAnalogChannelRange(getChannelSetting(std::span(channel_ranges.value), *j, kDefaultChannelRange)).value_or(AnalogChannelRange::ps5V);
                 channelConfig.offset   = getChannelSetting(std::span(channel_analog_offsets.value), *j, 0.0f);
                 channelConfig.coupling = detail::convertToEnum<Coupling>(getChannelSetting(std::span(channel_couplings.value), *j, std::string{"DC"}));
             } else {
@@ -551,15 +1492,53 @@ public:
             }
         }
 
+        if (newSettings.contains("calibration_file")) {
+            _calibrationTable = {};
+            if (!calibration_file.value.empty()) {
+                if (auto table = CalibrationTable::load(calibration_file.value)) {
+                    _calibrationTable = std::move(*table);
+                } else {
+                    this->emitErrorMessage(std::format("{}::settingsChanged()", this->name), table.error());
+                }
+            }
+        }
+        if (std::ranges::any_of(std::array{"calibration_file", "serial_number", "channel_ids", "channel_ranges", "channel_analog_offsets", "signal_scales", "signal_offsets"}, [&](const char* key) { return newSettings.contains(key); })) {
+            updateCalibrations();
+        }
+        if (std::ranges::any_of(std::array{"decimation", "decimation_taps", "calibration_file", "serial_number", "channel_ids", "channel_ranges", "channel_analog_offsets", "signal_scales", "signal_offsets"}, [&](const char* key) { return newSettings.contains(key); })) {
+            configureDecimators(); // the conversion is part of the filter taps
+        }
+
         if (newSettings.contains("trigger_arm") || newSettings.contains("trigger_disarm")) {
-            _armTriggerNameAndCtx    = detail::createTriggerNameAndCtx(trigger_arm);
-            _disarmTriggerNameAndCtx = detail::createTriggerNameAndCtx(trigger_disarm);
+            _armTriggerFilter    = TriggerFilter::compile(trigger_arm.value);
+            _disarmTriggerFilter = TriggerFilter::compile(trigger_disarm.value);
 
             if (!trigger_arm.value.empty() && !trigger_disarm.value.empty() && trigger_arm == trigger_disarm) {
                 this->emitErrorMessage(std::format("{}::settingsChanged()", this->name), gr::Error("Ill-formed settings: `trigger_arm` == `trigger_disarm`"));
             }
         }
 
+        if (newSettings.contains("trigger_filter")) {
+            _triggerFilter = TriggerFilter::compile(trigger_filter.value);
+        }
+        if (newSettings.contains("spectrum_trigger")) {
+            _spectrumTriggerFilter = TriggerFilter::compile(spectrum_trigger.value);
+        }
+        if (std::ranges::any_of(std::array{"spectrum_length", "spectrum_update_rate", "spectrum_window", "sample_rate", "decimation"}, [&](const char* key) { return newSettings.contains(key); })) {
+            configureSpectra();
+        }
+        if constexpr (acquisitionMode == AcquisitionMode::Streaming) {
+            if (std::ranges::any_of(std::array{"trigger_filter", "pre_samples", "post_samples", "history_depth", "sample_rate", "decimation"}, [&](const char* key) { return newSettings.contains(key); })) {
+                resetSnapshotHistory();
+            }
+        } else if (rapid_block_layout == RapidBlockLayout::Burst) { // preallocate the burst DataSets for the configured acquisition size
+            for (std::size_t channelIdx = 0; channelIdx < channel_ids.value.size() && channelIdx < _burstPool.size(); ++channelIdx) {
+                _burstSignalInfo[channelIdx] = channelToTagMap(channelIdx, outputSampleRate());
+                std::ignore                  = reserveBurstDataset(channelIdx);
+                prepareBurstDataset(_burstPool[channelIdx], channelIdx, 0UZ, pre_samples + post_samples);
+            }
+        }
+
         if (newSettings.contains("trigger_source")) {
             if (detail::isDigitalTrigger(trigger_source)) {
                 if (const auto parseRes = detail::parseDigitalTriggerSource(trigger_source); parseRes.has_value()) {
@@ -597,6 +1576,16 @@ public:
         }
     }
 
+    // the driver reports the over-range of channel A in bit 0, channel B in bit 1, ..., independent of which channels are enabled
+    void configureOverflowMasks() {
+        _overflowMasks.fill(0);
+        for (const auto& [channelIdx, channelId] : std::views::zip(std::views::iota(0UZ), channel_ids.value)) {
+            if (const auto channel = toChannel(channelId); channel && channelIdx < _overflowMasks.size()) {
+                _overflowMasks[channelIdx] = static_cast<std::int16_t>(1 << std::to_underlying(*channel));
+            }
+        }
+    }
+
     void start() {
         if (acquisitionMode == AcquisitionMode::Streaming) { // Warn users if they set up streaming acquisition with small buffer sizes
             // since there is no internal buffering, if the picoscope driver provides bigger chunks than the output buffers, it will have to drop samples.
@@ -611,18 +1600,49 @@ public:
         }
         initialize();
         tagMatcher.reset();
+        configureEdgeDetector();
+        _digitalTriggerEdges.clear();
+        _digitalTriggerLevel.reset();
+        _replayedTags.clear();
+        for (auto& overRange : _overRange) {
+            overRange.reset();
+        }
+        configureOverflowMasks();
+        configureDecimators();
+        configureSpectra();
+        if constexpr (acquisitionMode == AcquisitionMode::Streaming) {
+            resetSnapshotHistory(); // port buffer sizes are only known here
+        }
+        _rawAnchors.clear();
+        _rawAnchors.reserve(64UZ); // one per driver chunk since the last publish
+        _latencies->reset();
+        if (!record_path.value.empty()) {
+            if (auto result = _picoscope->startRecording(record_path.value, sample_rate, digital_port_enable || detail::isDigitalTrigger(trigger_source)); !result) {
+                this->emitErrorMessage(std::format("{}::start()", this->name), gr::Error(std::format("Cannot record to {}: {}", record_path.value, result.error().getDescription())));
+            }
+        }
         _picoscope->poll();
     }
 
+    // keeps the wrapper, i.e. the open unit and the driver buffer, for the next start(); it is only replaced if the serial number changes, the buffer is
+    // re-allocated if it has to grow or the driver buffer options change
     void stop() {
+        writeMetrics(true);
+        if (!_picoscope) {
+            return;
+        }
         _picoscope->stopAcquisition();
-        _picoscope = std::nullopt;
+        _picoscope->stopRecording(); // start() re-opens the archive if `record_path` is still set
     }
 
+    [[nodiscard]] DriverBufferOptions driverBufferOptions() const { return {.pages = driver_buffer_pages, .lock = driver_buffer_lock, .prefault = driver_buffer_prefault}; }
+
     void initialize() {
         if (!_picoscope) {
             _picoscope.emplace(serial_number, verbose_console);
+            _picoscope->health = _health.get();
         }
+        _picoscope->data.setOptions(driverBufferOptions());
         if constexpr (acquisitionMode == AcquisitionMode::Streaming) {
             _picoscope->startStreamingAcquisition(sample_rate, digital_port_enable || detail::isDigitalTrigger(trigger_source));
         } else {
@@ -642,11 +1662,10 @@ public:
         }
     }
 
-    constexpr T createDataset(const std::size_t channelIdx, std::size_t nSamples)
-    requires(acquisitionMode == AcquisitionMode::RapidBlock)
-    {
-        using TSample = typename T::value_type;
-        T ds{};
+    template<gr::DataSetLike TDataSet = T>
+    constexpr TDataSet createDataset(const std::size_t channelIdx, std::size_t nSamples) {
+        using TSample = typename TDataSet::value_type;
+        TDataSet ds{};
         ds.timestamp = 0;
 
         ds.axis_names = std::vector<std::string>{std::string(getChannelSetting(std::span(signal_names.value), channelIdx, {}))};
@@ -667,12 +1686,16 @@ public:
         // generate time axis
         int         i            = 0;
         const auto  pre          = static_cast<int>(pre_samples);
-        const float samplePeriod = 1.0f / sample_rate;
+        const float samplePeriod = 1.0f / outputSampleRate();
         std::ranges::generate(ds.axis_values[0], [&i, pre, samplePeriod]() {
             if constexpr (std::is_same_v<TSample, float> || std::is_same_v<TSample, gr::UncertainValue<float>>) {
                 float t = static_cast<float>(i - pre) * samplePeriod;
                 ++i;
                 return TSample{t};
+            } else if constexpr (HalfPrecision<TSample>) {
+                float t = static_cast<float>(i - pre) * samplePeriod;
+                ++i;
+                return static_cast<TSample>(t);
             } else if constexpr (std::is_same_v<TSample, std::int16_t>) {
                 return static_cast<std::int16_t>(i++ - pre);
                 // return (i - pre) * static_cast<std::int16_t>(samplePeriod * 1e9); // alternatively give nanoseconds instead of index
@@ -682,10 +1705,80 @@ public:
         });
 
         ds.meta_information.resize(1);
-        ds.meta_information[0] = channelToTagMap(channelIdx, sample_rate);
+        ds.meta_information[0] = channelToTagMap(channelIdx, outputSampleRate());
         return ds;
     }
 
+    // all enabled channels in one DataSet, sharing the time axis and the timing events
+    T createMultiChannelDataset(std::size_t nSamples)
+    requires(acquisitionMode == AcquisitionMode::RapidBlock)
+    {
+        const std::size_t nChannels = channel_ids.value.size();
+        T                 ds        = createDataset(0UZ, nSamples);
+        ds.extents                  = {static_cast<int32_t>(nChannels), static_cast<int32_t>(nSamples)};
+        ds.signal_names.resize(nChannels);
+        ds.signal_units.resize(nChannels);
+        ds.signal_quantities.resize(nChannels);
+        ds.meta_information.resize(nChannels);
+        for (std::size_t channelIdx = 1UZ; channelIdx < nChannels; ++channelIdx) {
+            ds.signal_names[channelIdx]      = getChannelSetting(std::span(signal_names.value), channelIdx, {});
+            ds.signal_units[channelIdx]      = getChannelSetting(std::span(signal_units.value), channelIdx, {});
+            ds.signal_quantities[channelIdx] = getChannelSetting(std::span(signal_quantities.value), channelIdx, {});
+            ds.meta_information[channelIdx]  = channelToTagMap(channelIdx, outputSampleRate());
+        }
+        ds.signal_values.resize(nChannels * nSamples);
+        ds.signal_ranges.resize(nChannels);
+        return ds;
+    }
+
+    // (re-)initialises a recycled burst DataSet for a new acquisition (captureIdx == 0) and makes sure that the segment captureIdx fits
+    void prepareBurstDataset(T& ds, std::size_t channelIdx, std::size_t captureIdx, std::size_t nSamples)
+    requires(acquisitionMode == AcquisitionMode::RapidBlock)
+    {
+        if (captureIdx == 0UZ) {
+            if (ds.axis_values.empty() || ds.axis_values[0].size() != nSamples || ds.signal_names.empty() || ds.signal_names[0] != getChannelSetting(std::span(signal_names.value), channelIdx, {})) {
+                auto values      = std::move(ds.signal_values); // keep the (large) sample storage, only the header is re-created
+                ds               = createDataset(channelIdx, nSamples);
+                ds.signal_values = std::move(values);
+            }
+            if (ds.meta_information[0] != _burstSignalInfo[channelIdx]) { // only differs after settings changes or over-range annotations
+                ds.meta_information[0] = _burstSignalInfo[channelIdx];
+            }
+            for (auto& events : ds.timing_events) {
+                events.clear();
+            }
+        }
+        const std::size_t nSegments = std::max<std::size_t>(n_captures, captureIdx + 1UZ);
+        ds.extents                  = {static_cast<int32_t>(nSegments), static_cast<int32_t>(nSamples)};
+        ds.signal_values.resize(nSegments * nSamples);
+        ds.signal_ranges.resize(nSegments);
+        ds.timing_events.resize(nSegments);
+    }
+
+    // makes sure the pooled burst DataSet can take a complete acquisition without re-allocating while converting, returns whether it had to allocate
+    [[nodiscard]] bool reserveBurstDataset(std::size_t channelIdx)
+    requires(acquisitionMode == AcquisitionMode::RapidBlock)
+    {
+        auto&             values  = _burstPool[channelIdx].signal_values;
+        const std::size_t nValues = static_cast<std::size_t>(n_captures) * (pre_samples + post_samples);
+        if (values.capacity() >= nValues) {
+            return false;
+        }
+        values.reserve(nValues);
+        return true;
+    }
+
+    static void finishBurstDataset(T& ds, std::size_t nCaptures) {
+        if (ds.extents.size() != 2UZ) {
+            return;
+        }
+        const auto nSamples = static_cast<std::size_t>(ds.extents[1]);
+        ds.extents[0]       = static_cast<int32_t>(nCaptures);
+        ds.signal_values.resize(nCaptures * nSamples);
+        ds.signal_ranges.resize(nCaptures);
+        ds.timing_events.resize(nCaptures);
+    }
+
     constexpr TDigitalOutput createDatasetDigital(std::size_t nSamples)
     requires(TPSImpl::N_DIGITAL_CHANNELS > 0 && acquisitionMode == AcquisitionMode::RapidBlock)
     {
@@ -704,62 +1797,51 @@ public:
         return ds;
     }
 
-    template<typename TSample>
-    std::vector<std::size_t> findAnalogTriggers(const std::size_t triggerIdx, std::span<TSample> samples) {
-        using enum TriggerDirection;
-        if (samples.empty()) {
-            return {};
+    // re-uses the DataSet of a recycled output slot if it has the layout of a digital capture of nSamples, otherwise creates a new one
+    void prepareDatasetDigital(TDigitalOutput& ds, std::size_t nSamples)
+    requires(TPSImpl::N_DIGITAL_CHANNELS > 0 && acquisitionMode == AcquisitionMode::RapidBlock)
+    {
+        if (ds.extents.size() != 1UZ || static_cast<std::size_t>(ds.extents[0]) != nSamples || ds.signal_values.size() != nSamples || ds.signal_ranges.size() != 1UZ || ds.timing_events.size() != 1UZ || ds.signal_names.size() != 1UZ) {
+            ds = createDatasetDigital(nSamples);
+            return;
         }
+        ds.signal_ranges[0] = {};
+        ds.timing_events[0].clear();
+    }
 
-        std::vector<std::size_t> triggerOffsets; // relative offset of detected triggers
-        const float              band = channel_ranges[triggerIdx] / 100.f;
-
-        const auto toFloat = [](TSample raw) {
-            if constexpr (std::is_same_v<TSample, float>) {
-                return raw;
-            } else if constexpr (std::is_same_v<TSample, int16_t>) {
-                return static_cast<float>(raw);
-            } else if constexpr (std::is_same_v<TSample, gr::UncertainValue<float>>) {
-                return raw.value;
-            } else {
-                static_assert(gr::meta::always_false<TSample>, "This type is not supported.");
-            }
-        };
-
-        bool triggerState = toFloat(samples[0]) >= trigger_threshold;
-        if (trigger_direction == Rising || trigger_direction == High) {
-            for (std::size_t i = 0; i < samples.size(); i++) {
-                if (const float value = toFloat(samples[i]); !triggerState && (value >= trigger_threshold)) {
-                    triggerState = true;
-                    triggerOffsets.push_back(i);
-                } else if (triggerState && (value <= trigger_threshold - band)) {
-                    triggerState = false;
-                }
-            }
-        } else if (trigger_direction == Falling || trigger_direction == Low) {
-            for (std::size_t i = 0; i < samples.size(); i++) {
-                if (const float value = toFloat(samples[i]); triggerState && (value <= trigger_threshold)) {
-                    triggerState = false;
-                    triggerOffsets.push_back(i);
-                } else if (!triggerState && (value >= trigger_threshold + band)) {
-                    triggerState = true;
+    // appends the edges of the digital trigger line to `triggerOffsets`, which keeps its capacity across calls
+    /**
+     * Streaming mode with decimation: detects the edges of the trigger bit on the raw digital words, so pulses shorter than the decimation factor are not
+     * missed, and assigns each edge to the decimated sample whose window contains it. `firstOutput` is the raw index of the first output sample of the
+     * chunk (the window of output i ends at raw index `firstOutput + i * decimation`), `outputOffset` the index of that sample in the output span.
+     */
+    void findDecimatedDigitalTriggers(const uint digitalChannelNumber, std::span<const std::int16_t> raw, std::size_t firstOutput, std::size_t decimation, std::size_t outputOffset)
+    requires(TPSImpl::N_DIGITAL_CHANNELS > 0)
+    {
+        using enum TriggerDirection;
+        const auto mask   = static_cast<std::uint16_t>(1U << digitalChannelNumber);
+        const bool rising = trigger_direction == Rising || trigger_direction == High;
+        for (std::size_t i = 0; i < raw.size(); ++i) {
+            const bool level = (static_cast<std::uint16_t>(raw[i]) & mask) != 0;
+            if (_digitalTriggerLevel.has_value() && *_digitalTriggerLevel != level && level == rising) {
+                const std::size_t edge = outputOffset + (i <= firstOutput ? 0UZ : (i - firstOutput + decimation - 1UZ) / decimation);
+                if (_digitalTriggerEdges.empty() || _digitalTriggerEdges.back() != edge) { // at most one edge per decimated sample
+                    _digitalTriggerEdges.push_back(edge);
                 }
             }
+            _digitalTriggerLevel = level;
         }
-        return triggerOffsets;
     }
 
-    std::vector<std::size_t> findDigitalTriggers(const uint digitalChannelNumber, std::span<std::uint16_t> samples)
+    void findDigitalTriggers(const uint digitalChannelNumber, std::span<std::uint16_t> samples, std::vector<std::size_t>& triggerOffsets)
     requires(TPSImpl::N_DIGITAL_CHANNELS > 0)
     {
         using enum TriggerDirection;
         if (samples.empty()) {
-            return {};
+            return;
         }
         const auto mask = static_cast<uint16_t>(1U << digitalChannelNumber);
 
-        std::vector<std::size_t> triggerOffsets;
-
         bool triggerState = (samples[0] & mask) > 0;
         if (trigger_direction == Rising || trigger_direction == High) {
             for (std::size_t i = 0; i < samples.size(); i++) {
@@ -780,7 +1862,6 @@ public:
                 }
             }
         }
-        return triggerOffsets;
     }
 };
 
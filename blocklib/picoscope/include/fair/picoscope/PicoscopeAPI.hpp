@@ -1,8 +1,11 @@
 #ifndef GR_DIGITIZERS_PICOSCOPEAPI_HPP
 #define GR_DIGITIZERS_PICOSCOPEAPI_HPP
 
+#include <functional>
+#include <memory>
 #include <source_location>
 #include <thread>
+#include <type_traits>
 #include <utility>
 
 #ifdef __GNUC__
@@ -21,7 +24,12 @@
 #include "fair/picoscope/StatusMessages.hpp"
 
 #include <PicoConnectProbes.h>
+#include <fair/picoscope/AcquisitionHealth.hpp>
+#include <fair/picoscope/DriverBuffer.hpp>
+#include <fair/picoscope/IntervalTimingMatcher.hpp>
+#include <fair/picoscope/RawRecorder.hpp>
 #include <fair/picoscope/TimingMatcher.hpp>
+#include <fair/trace/Trace.hpp>
 
 namespace fair::picoscope {
 
@@ -38,6 +46,18 @@ struct Error {
 
 enum class AcquisitionMode { Streaming, RapidBlock };
 
+enum class RapidBlockLayout {
+    PerChannel,  // one DataSet per channel and capture on the respective analog output
+    MultiChannel, // one DataSet per capture containing all enabled channels (extents = {nChannels, nSamples}) on the first analog output
+    Burst         // one DataSet per channel containing all captures of an acquisition (extents = {nCaptures, nSamples}), recycled, i.e. allocation-free in steady state
+};
+
+enum class TimingTagPorts {
+    All,     // every analog output and digitalOut
+    Digital, // digitalOut only, for models without digital inputs the first analog output
+    First    // first analog output only
+};
+
 enum class AnalogChannelRange { ps10mV, ps20mV, ps50mV, ps100mV, ps200mV, ps500mV, ps1V, ps2V, ps5V, ps10V, ps20V, ps50V, ps100V, ps200V, ps500V };
 constexpr std::array<std::pair<float, AnalogChannelRange>, magic_enum::enum_count<AnalogChannelRange>()> analogChannelRanges{{
     {000.01f, AnalogChannelRange::ps10mV},
@@ -197,13 +217,41 @@ struct TriggerConfig {
     bool operator==(const TriggerConfig& other) const = default;
 };
 
+/**
+ * Non-owning reference to a callable, like C++26 std::function_ref: binding and calling it never allocates, the callable has to outlive the call, e.g. a
+ * lambda passed directly to PicoscopeWrapper::poll(). Default constructed it is empty and converts to false.
+ */
+template<typename TSignature>
+class FunctionRef;
+
+template<typename R, typename... Args>
+class FunctionRef<R(Args...)> {
+    void* _callable = nullptr;
+    R (*_invoke)(void*, Args...) = nullptr;
+
+public:
+    constexpr FunctionRef() noexcept = default;
+
+    template<typename F>
+    requires(!std::is_same_v<std::remove_cvref_t<F>, FunctionRef> && std::is_invocable_r_v<R, F&, Args...>)
+    FunctionRef(F&& callable) noexcept // NOLINT(google-explicit-constructor): binds like a function parameter of callable type
+        : _callable(const_cast<void*>(static_cast<const void*>(std::addressof(callable)))), _invoke([](void* ptr, Args... args) -> R { return std::invoke(*static_cast<std::remove_reference_t<F>*>(ptr), std::forward<Args>(args)...); }) {}
+
+    [[nodiscard]] explicit operator bool() const noexcept { return _invoke != nullptr; }
+
+    R operator()(Args... args) const { return _invoke(_callable, std::forward<Args>(args)...); }
+};
+
+// called with the driver data of every chunk (Streaming) or capture (RapidBlock): one span per enabled channel (+ the digital port) and the over-range flags
+using DataHandler = FunctionRef<void(std::span<std::span<const std::int16_t>>, std::int16_t)>;
+
 /**
  * A simple C++ wrapper that abstracts away the picoscope-specific API and provides a simple C++ native API to be used in gnuradio4 blocks.
  * Also includes proper error handling and retry machinery to recover from temporary failures and prevent blocking calls.
  */
 template<PicoscopeImplementationLike TPSImpl>
 class PicoscopeWrapper {
-    using HandlerT = std::optional<std::function<void(std::span<std::span<const std::int16_t>>, std::int16_t)>>;
+    using HandlerT = DataHandler;
     struct OpeningContext {
         PicoscopeWrapper& scope;
         std::int16_t      status   = 0;
@@ -274,7 +322,13 @@ class PicoscopeWrapper {
         StreamingAcquisitionContext(StreamingAcquisitionContext&)            = delete;
         StreamingAcquisitionContext& operator=(StreamingAcquisitionContext&) = delete;
 
-        std::expected<void, Error> poll(const HandlerT& dataHandler) {
+        // per channel: the driver buffer segment, i.e. the largest chunk a streaming callback delivers
+        [[nodiscard]] std::size_t maxChunkSamples() const noexcept {
+            constexpr std::size_t kBaseBuf = 16384;
+            return std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(static_cast<double>(freq) / 1e6))) * kBaseBuf;
+        }
+
+        std::expected<void, Error> poll(HandlerT dataHandler) {
             if (scope.restartAcquisition) {
                 if (auto res = restart(); !res.has_value()) {
                     return res;
@@ -288,10 +342,12 @@ class PicoscopeWrapper {
             }
             struct Ctx {
                 StreamingAcquisitionContext& ctx;
-                const HandlerT&              handler;
+                HandlerT                     handler;
             } valueContext{*this, dataHandler};
             auto streamingReadyCallback = static_cast<typename TPSImpl::StreamingReadyType>([](int16_t /*handle*/, typename TPSImpl::NSamplesType noOfSamples, uint32_t startIndex, int16_t overflow, uint32_t /*triggerAt*/, int16_t /*triggered*/, int16_t /*autoStop*/, void* vobj) {
+                FAIR_TRACE_SPAN("streaming callback", "picoscope");
                 auto                                           dataContext = static_cast<Ctx*>(vobj);
+                dataContext->ctx.scope.driverReady                         = std::chrono::steady_clock::now();
                 constexpr std::size_t                          channels    = TPSImpl::N_ANALOG_CHANNELS + (TPSImpl::N_DIGITAL_CHANNELS > 0UZ ? 1UZ : 0UZ);
                 std::array<std::span<const int16_t>, channels> acquisitionData;
                 auto                                           activeChannels        = static_cast<std::size_t>(std::ranges::count_if(dataContext->ctx.scope.channel_config, [](const auto& ch) { return ch.second.enable; }));
@@ -305,8 +361,7 @@ class PicoscopeWrapper {
                     if (dataContext->ctx.enableDigital) {
                         const auto lowerBits  = dataBuffer.subspan(activeChannels * segmentSize + startIndex, static_cast<std::size_t>(noOfSamples));
                         const auto higherBits = dataBuffer.subspan((activeChannels + 1) * segmentSize + startIndex, static_cast<std::size_t>(noOfSamples));
-                        dataContext->ctx.dataDigital.clear();
-                        dataContext->ctx.dataDigital.resize(static_cast<std::size_t>(noOfSamples));
+                        dataContext->ctx.dataDigital.resize(static_cast<std::size_t>(noOfSamples)); // within the capacity reserved in start()
                         for (std::size_t i = 0; i < dataContext->ctx.dataDigital.size(); i++) {
                             dataContext->ctx.dataDigital[i] = static_cast<int16_t>((lowerBits[i] & 0xFF) | ((higherBits[i] << 8) & 0xFF00));
                         }
@@ -314,8 +369,11 @@ class PicoscopeWrapper {
                         ++activeChannels;
                     }
                 }
+                if (dataContext->ctx.scope.recorder.isOpen()) { // the raw driver data, before the handler converts it
+                    std::ignore = dataContext->ctx.scope.recorder.append(RawChunkKind::Streaming, std::span(acquisitionData).subspan(0, activeChannels), overflow);
+                }
                 if (dataContext->handler) {
-                    dataContext->handler.value()(std::span(acquisitionData).subspan(0, activeChannels), overflow);
+                    dataContext->handler(std::span(acquisitionData).subspan(0, activeChannels), overflow);
                 }
             });
             if (const PICO_STATUS res = scope.instance.getStreamingLatestValues(streamingReadyCallback, &valueContext); res != PICO_OK) {
@@ -344,9 +402,9 @@ class PicoscopeWrapper {
                 if (activeChannels == 0) { // early return if no channels are active
                     return std::unexpected{Error{"No channels configured"}};
                 }
-                const std::size_t kBaseBuf = 16384;
-                const std::size_t mult     = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(static_cast<double>(freq) / 1e6)));
-                scope.data.resize(activeChannels * mult * kBaseBuf);
+                if (scope.data.resize(activeChannels * maxChunkSamples())) {
+                    scope.reportDriverBuffer();
+                }
                 const std::size_t segmentSize = scope.data.size() / activeChannels;
                 std::size_t       j           = 0;
                 for (const auto& [output, chan] : std::views::zip(TPSImpl::outputs, scope.channel_config | std::views::values)) {
@@ -382,6 +440,7 @@ class PicoscopeWrapper {
                             }
                             j++;
                         }
+                        dataDigital.reserve(segmentSize); // the driver delivers at most one overview buffer per callback
                     } else {
                         std::vector<std::int16_t>{}.swap(dataDigital); // free the memory used to store the digital data
                     }
@@ -410,6 +469,7 @@ class PicoscopeWrapper {
         }
 
         std::expected<void, Error> restart() {
+            scope.countHealth(&AcquisitionHealth::restarts);
             if (const auto res = stop(); !res.has_value()) {
                 return res;
             }
@@ -444,13 +504,16 @@ class PicoscopeWrapper {
         std::int16_t              ready              = false;
         std::function<void()>     callback;
         std::vector<std::int16_t> dataDigital{};
+        std::vector<std::int16_t> overflows{}; // one over-range bit mask per capture, written by getValuesBulk
 
         explicit TriggeredAcquisitionContext(PicoscopeWrapper<TPSImpl>& _scope, const float _freq, const std::uint32_t _pre, const std::uint32_t _post, const std::uint32_t _n_captures, std::function<void()> _fn, const bool _enableDigital) : scope{_scope}, freq{_freq}, pre{_pre}, post{_post}, nCaptures{_n_captures}, enableDigital{_enableDigital}, callback{std::move(_fn)} {}
 
         TriggeredAcquisitionContext(TriggeredAcquisitionContext&)            = delete;
         TriggeredAcquisitionContext& operator=(TriggeredAcquisitionContext&) = delete;
 
-        std::expected<void, Error> poll(const HandlerT& dataHandler) {
+        [[nodiscard]] std::size_t maxChunkSamples() const noexcept { return std::size_t{pre} + post; } // per channel: one capture
+
+        std::expected<void, Error> poll(HandlerT dataHandler) {
             if (scope.restartAcquisition) {
                 std::ignore              = restart();
                 scope.restartAcquisition = false;
@@ -472,7 +535,7 @@ class PicoscopeWrapper {
             }
             if (ready || !scope.running) { // acquisition has terminated naturally or was requested to be ended
                 std::uint32_t noOfSamples = pre + post;
-                std::int16_t  overflow    = 0;
+                std::ranges::fill(overflows, std::int16_t{0});
                 if (!scope.running) { // was requested to be closed -> abort running acquisition
                     if (scope.verbose) {
                         std::println("stopping active acquisition");
@@ -495,28 +558,32 @@ class PicoscopeWrapper {
                         return {};
                     }
                 }
-                if (const PICO_STATUS res = scope.instance.getValuesBulk(&noOfSamples, 0U, nCapturesCompleted - 1, 1U, TPSImpl::ratioNone, &overflow); res != PICO_OK) {
+                const auto bulkStart = std::chrono::steady_clock::now();
+                if (const PICO_STATUS res = scope.instance.getValuesBulk(&noOfSamples, 0U, nCapturesCompleted - 1, 1U, TPSImpl::ratioNone, overflows.data()); res != PICO_OK) {
                     if (scope.verbose) {
                         std::println("Error: nCapturesCompleted: {}, nCapturesProcessed: {}, noOfSamples: {}, Error: {}: {}", nCapturesCompleted, nCapturesProcessed, noOfSamples, detail::statusToString(res), detail::statusToStringVerbose(res));
                     }
                     return std::unexpected(Error(res));
                 };
+                FAIR_TRACE_EVENT("getValuesBulk", "picoscope", bulkStart, std::chrono::steady_clock::now());
                 constexpr std::size_t                          channels = TPSImpl::N_ANALOG_CHANNELS + (TPSImpl::N_DIGITAL_CHANNELS > 0UZ ? 1UZ : 0UZ);
                 std::array<std::span<const int16_t>, channels> acquisitionData;
+                const std::size_t                              segmentSize = std::size_t{pre + post} * nCaptures; // per channel, see start()
                 for (std::size_t i = 0UZ; i < nCapturesCompleted; i++) {
-                    std::size_t j = 0;
+                    scope.driverReady         = std::chrono::steady_clock::now();
+                    const std::size_t capture = i * (pre + post); // offset of the memory segment within the channel's buffer
+                    std::size_t       j       = 0;
                     for (auto& chan : scope.channel_config | std::views::values) {
                         if (chan.enable) {
-                            acquisitionData[j] = std::span(scope.data).subspan(i * noOfSamples + j * (pre + post), pre + post);
+                            acquisitionData[j] = std::span(scope.data).subspan(j * segmentSize + capture, pre + post);
                             ++j;
                         }
                     }
                     if constexpr (TPSImpl::N_DIGITAL_CHANNELS > 0) {
                         if (enableDigital) {
-                            const auto lowerBits  = std::span{scope.data}.subspan(j * (pre + post), noOfSamples);
-                            const auto higherBits = std::span{scope.data}.subspan((j + 1) * (pre + post), noOfSamples);
-                            dataDigital.clear();
-                            dataDigital.resize(noOfSamples);
+                            const auto lowerBits  = std::span{scope.data}.subspan(j * segmentSize + capture, noOfSamples);
+                            const auto higherBits = std::span{scope.data}.subspan((j + 1) * segmentSize + capture, noOfSamples);
+                            dataDigital.resize(noOfSamples); // within the capacity reserved in start()
                             for (std::size_t k = 0; k < dataDigital.size(); k++) {
                                 dataDigital[k] = static_cast<int16_t>((lowerBits[k] & 0xFF) | ((higherBits[k] << 8) & 0xFF00));
                             }
@@ -524,8 +591,11 @@ class PicoscopeWrapper {
                             ++j;
                         }
                     }
+                    if (scope.recorder.isOpen()) {
+                        std::ignore = scope.recorder.append(RawChunkKind::Capture, std::span(acquisitionData).subspan(0, j), overflows[i]);
+                    }
                     if (dataHandler) {
-                        dataHandler.value()(std::span(acquisitionData).subspan(0, j), overflow);
+                        dataHandler(std::span(acquisitionData).subspan(0, j), overflows[i]);
                     }
                 }
                 started            = false; // getValuesBulk automatically stops any acquisition that would still be in progress
@@ -568,13 +638,16 @@ class PicoscopeWrapper {
                     if (const auto status = scope.instance.setNoOfCaptures(nCaptures); status != PICO_OK) {
                         return std::unexpected(Error(status));
                     }
+                    overflows.assign(nCaptures, std::int16_t{0});
                     // initialise data buffers to copy to
                     const std::size_t subsegmentSize = pre + post;
                     if (subsegmentSize > static_cast<std::size_t>(maxSamples)) {
                         return std::unexpected{Error{std::format("configured acquisition size(pre+post={}) does not fit into the available memory ({}) for {} captures", subsegmentSize, maxSamples, nCaptures)}};
                     }
                     const std::size_t segmentSize = subsegmentSize * nCaptures;
-                    scope.data.resize(segmentSize * activeChannels);
+                    if (scope.data.resize(segmentSize * activeChannels)) {
+                        scope.reportDriverBuffer();
+                    }
                     std::size_t j = 0;
                     for (const auto& [i, chan] : std::views::zip(std::views::iota(0UZ), scope.channel_config | std::views::values)) {
                         if (chan.enable) {
@@ -605,12 +678,15 @@ class PicoscopeWrapper {
                         }
                         if (enableDigital) {
                             for (std::size_t i = 0; i < 2; i++) {
-                                auto bufferStart = scope.data.data() + j * segmentSize;
-                                if (const PICO_STATUS res = scope.instance.setDataBuffer(static_cast<typename TPSImpl::ChannelType>(TPSImpl::DIGI_PORT_0 + i), bufferStart, static_cast<int32_t>(segmentSize), TPSImpl::ratioNone); res != PICO_OK) {
-                                    return std::unexpected(Error(res));
+                                for (std::uint32_t segment = 0; segment < nCaptures; segment++) {
+                                    auto bufferStart = scope.data.data() + j * segmentSize + segment * subsegmentSize;
+                                    if (const PICO_STATUS res = scope.instance.setDataBuffer(static_cast<typename TPSImpl::ChannelType>(TPSImpl::DIGI_PORT_0 + i), bufferStart, static_cast<int32_t>(subsegmentSize), segment, TPSImpl::ratioNone); res != PICO_OK) {
+                                        return std::unexpected(Error(res));
+                                    }
                                 }
                                 j++;
                             }
+                            dataDigital.reserve(subsegmentSize);
                         } else {
                             std::vector<std::int16_t>{}.swap(dataDigital); // free the memory used to store the digital data
                         }
@@ -647,6 +723,7 @@ class PicoscopeWrapper {
         }
 
         std::expected<void, Error> restart() {
+            scope.countHealth(&AcquisitionHealth::restarts);
             if (const auto res = stop(); !res.has_value()) {
                 return res;
             }
@@ -667,13 +744,13 @@ class PicoscopeWrapper {
     };
 
     using ContextVariant = std::variant<std::monostate, StreamingAcquisitionContext, TriggeredAcquisitionContext>;
-    std::string          serial;
-    bool                 verbose = false;
-    OpeningContext       openingContext{};
-    ContextVariant       activeContext{std::monostate{}};
-    TPSImpl              instance; // mainly stores the handle
-    std::vector<int16_t> data;     // data buffer used by the picoscope to store acquisition data
-    AcquisitionMode      acquisitionMode = AcquisitionMode::Streaming;
+    std::string           serial;
+    bool                  verbose = false;
+    OpeningContext        openingContext{};
+    ContextVariant        activeContext{std::monostate{}};
+    TPSImpl               instance; // mainly stores the handle
+    DriverBuffer<int16_t> data;     // data buffer used by the picoscope to store acquisition data, kept across restarts unless it has to grow
+    AcquisitionMode       acquisitionMode = AcquisitionMode::Streaming;
 
     using ChannelConfigType = std::array<std::pair<bool, ChannelConfig>, TPSImpl::N_ANALOG_CHANNELS>;
     ChannelConfigType channel_config{};
@@ -686,10 +763,13 @@ class PicoscopeWrapper {
     std::size_t                           errorCount  = 0;                              // store the performed retries in case of function failures
     std::chrono::steady_clock::time_point lastTry;                                      // saves the timestamp of the last failed attempt.
     std::optional<Error>                  lastError{};                                  // stores the last error when talking to the driver
+    std::chrono::steady_clock::time_point driverReady;                                  // when the driver delivered the last chunk or capture, before recording and conversion
 
     std::int16_t maxValue = std::numeric_limits<std::int16_t>::max();
 
-    DeviceInformation info;
+    DeviceInformation  info;
+    RawRecorder        recorder;         // records every driver chunk while open, see startRecording()
+    AcquisitionHealth* health = nullptr; // optional, owned by the block so the counters survive re-opening the driver
 
     std::expected<void, Error> setChannel(const std::size_t id, ChannelConfig config) {
         if (!openingContext.ready() || std::holds_alternative<std::monostate>(activeContext)) {
@@ -809,9 +889,33 @@ public:
 
     void stopAcquisition() { activeContext.template emplace<std::monostate>(); }
 
+    void reportDriverBuffer() const {
+        const DriverBufferPlacement& placement = data.placement();
+        if (!placement.degraded.empty()) {
+            std::println("PicoscopeAPI - Warning! Driver buffer options could not be applied: {}", placement.degraded);
+        }
+        if (verbose) {
+            std::println("driver buffer: {} MiB, pages: {}, locked: {}, prefaulted: {}", placement.bytes >> 20UZ, magic_enum::enum_name(placement.pages), placement.locked, placement.prefaulted);
+        }
+    }
+
+    void countHealth(AcquisitionHealth::Counter AcquisitionHealth::*counter) noexcept {
+        if (health) {
+            AcquisitionHealth::increment(health->*counter);
+        }
+    }
+
+    void resetErrorCount() noexcept {
+        if (errorCount > 0UZ) {
+            countHealth(&AcquisitionHealth::errorCountResets);
+        }
+        errorCount = 0;
+    }
+
     std::expected<void, Error> handleError(const Error& error) {
         lastError = error;
         ++errorCount;
+        countHealth(&AcquisitionHealth::retries);
         lastTry = std::chrono::steady_clock::now();
         if (verbose) {
             std::println("error occurred({}): {}:{}", errorCount, lastError->getError(), lastError->getDescription());
@@ -819,7 +923,9 @@ public:
         return {}; // only report errors after the retries have been used up.
     }
 
-    std::expected<void, Error> poll(const HandlerT& fn = std::nullopt) {
+    // the steady-state poll does not allocate: `fn` is only referenced, the driver and scratch buffers are sized in start()
+    std::expected<void, Error> poll(HandlerT fn = {}) {
+        FAIR_TRACE_SPAN("PicoscopeWrapper::poll", "picoscope");
         if (errorCount > maxErrors) {
             return std::unexpected(lastError.value_or(Error("unknown error")));
         }
@@ -829,7 +935,7 @@ public:
         if (auto result = openingContext.poll(); !result.has_value()) {
             return handleError(result.error()); // error checking opening progress
         } else if (!*result) {
-            errorCount = 0;
+            resetErrorCount();
             return {}; // scope has not yet finished opening
         }
         std::size_t i = 0UZ;
@@ -860,7 +966,7 @@ public:
             }
         }
         if (!openingContext.ready()) {
-            errorCount = 0;
+            resetErrorCount();
             return {}; // acquisition not yet started
         }
         if (std::holds_alternative<StreamingAcquisitionContext>(activeContext)) {
@@ -868,7 +974,7 @@ public:
             if (!result.has_value()) {
                 return handleError(result.error());
             }
-            errorCount = 0;
+            resetErrorCount();
             return result;
         }
         if (std::holds_alternative<TriggeredAcquisitionContext>(activeContext)) {
@@ -876,10 +982,10 @@ public:
             if (!result.has_value()) {
                 return handleError(result.error());
             }
-            errorCount = 0;
+            resetErrorCount();
             return result;
         }
-        errorCount = 0;
+        resetErrorCount();
         return {};
     }
 
@@ -887,6 +993,50 @@ public:
 
     [[nodiscard]] const std::optional<Error>& getLastError() const { return lastError; };
 
+    /**
+     * Records the int16 data of every driver chunk (Streaming) or capture (RapidBlock) of the enabled channels and the digital port to `path`, until
+     * stopRecording() or the destruction of the wrapper. See RawRecorder for the archive format.
+     */
+    std::expected<void, Error> startRecording(const std::filesystem::path& path, float sampleRate, bool enableDigital) {
+        RawArchiveInfo archiveInfo{.serial = info.serial.empty() ? serial : info.serial, .sampleRate = sampleRate, .maxValue = maxValue, .digital = TPSImpl::N_DIGITAL_CHANNELS > 0UZ && enableDigital};
+        archiveInfo.maxChunkSamples = std::visit(
+            []<typename TContext>(const TContext& context) -> std::size_t {
+                if constexpr (std::is_same_v<TContext, std::monostate>) {
+                    return 0UZ;
+                } else {
+                    return context.maxChunkSamples();
+                }
+            },
+            activeContext);
+        for (const auto& [output, chan] : std::views::zip(TPSImpl::outputs, channel_config | std::views::values)) {
+            if (chan.enable) { // the driver buffers are in the order of the device's channels
+                archiveInfo.channels.append(toChannelString(output.first));
+            }
+        }
+        if (auto result = recorder.open(path, archiveInfo); !result) {
+            return std::unexpected(Error(result.error()));
+        }
+        return {};
+    }
+
+    void stopRecording() { recorder.close(); }
+
+    [[nodiscard]] bool isRecording() const { return recorder.isOpen(); }
+
+    [[nodiscard]] std::uint64_t recordedSamples() const { return recorder.sampleIndex(); } // archive index of the next chunk
+
+    void recordTimingReference(const RawIndexEntry& entry) { std::ignore = recorder.addTimingReference(entry); }
+
+    // replayed archives (PicoscopeReplay): the timing tags recorded with the Streaming chunk (segment 0) or the capture in `segment` passed to the data
+    // handler, sample indices relative to its first sample. Empty for the other drivers
+    [[nodiscard]] std::span<const RawIndexEntry> replayedTimingReferences(std::size_t segment) const {
+        if constexpr (requires { instance.timingReferences(segment); }) {
+            return instance.timingReferences(segment);
+        } else {
+            return {};
+        }
+    }
+
     bool ready() { return openingContext.ready(); }
 
     std::vector<ChannelName> getChannelIds() {
@@ -928,7 +1078,7 @@ public:
 class PicoscopeDynamicWrapperBase {
 public:
     virtual ~PicoscopeDynamicWrapperBase()                                                                                                                                                                 = default;
-    virtual std::expected<void, Error>                poll(std::optional<std::function<void(std::span<std::span<const std::int16_t>>, int16_t)>> fn)                                                       = 0;
+    virtual std::expected<void, Error>                poll(DataHandler fn)                                                                                                                                 = 0;
     virtual std::vector<ChannelName>                  getChannelIds()                                                                                                                                      = 0;
     [[nodiscard]] virtual const ChannelConfig&        getChannelConfig(std::size_t) const                                                                                                                  = 0;
     virtual void                                      configureChannel(std::size_t, ChannelConfig)                                                                                                         = 0;
@@ -947,7 +1097,7 @@ public:
     PicoscopeWrapper<TPSImplementation> instance;
     explicit PicoscopeDynamicWrapper(std::string_view _serial, bool verbose) : instance{_serial, verbose} {};
     ~PicoscopeDynamicWrapper() override = default;
-    std::expected<void, Error>                poll(std::optional<std::function<void(std::span<std::span<const std::int16_t>>, int16_t)>> fn) override { return instance.poll(fn); }
+    std::expected<void, Error>                poll(DataHandler fn) override { return instance.poll(fn); }
     std::vector<ChannelName>                  getChannelIds() override { return instance.getChannelIds(); };
     [[nodiscard]] const ChannelConfig&        getChannelConfig(std::size_t id) const override { return instance.getChannelConfig(id); };
     void                                      configureChannel(std::size_t id, ChannelConfig config) override { return instance.configureChannel(id, config); };
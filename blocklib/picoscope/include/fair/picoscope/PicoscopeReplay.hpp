@@ -0,0 +1,375 @@
+#ifndef FAIR_PICOSCOPE_PICOSCOPEREPLAY_HPP
+#define FAIR_PICOSCOPE_PICOSCOPEREPLAY_HPP
+
+#include <fair/picoscope/PicoscopeAPI.hpp>
+#include <fair/picoscope/RawRecorder.hpp>
+#include <fair/picoscope/SimulatedDriver.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fair::picoscope {
+
+/**
+ * Replay parameters, registered per archive path via PicoscopeReplay::setReplay().
+ */
+struct ReplayConfig {
+    double speed = 1.0;   // 1: original pacing, N: N times faster, 0: as fast as the block polls
+    bool   loop  = false; // restart at the first chunk after the last one, otherwise the replay stops delivering data
+};
+
+/**
+ * Replays RawRecorder archives through the driver calls used by PicoscopeWrapper, in place of the vendor SDK: Streaming chunks are delivered via the
+ * `getStreamingLatestValues` callback, Capture chunks fill the memory segments of RapidBlock acquisitions. The int16 samples reach the block exactly as
+ * they were recorded, so a production acquisition (including its chunking and overflow flags) can be reproduced without hardware.
+ *
+ * The archives are selected by the serial number passed to openUnit(): either one archive or a directory, of which all `*.raw` files are replayed in
+ * the order of their names. Chunks are paced by their recorded acquisition time (or the nominal sample rate for archives without one), divided by
+ * `ReplayConfig::speed`.
+ *
+ * The timing tags matched during the recording are read from the archive index (`<archive>.idx`, see RawRecorder). timingReferences() returns those
+ * of the data just delivered, which the block publishes at their recorded samples instead of matching timing tags from its `timingIn` port again.
+ *
+ * The recorded channels are mapped to the device channels by name, enabled channels not present in the archive get zeros. The unit status, channel and
+ * buffer registration are shared with PicoscopeSimulated via SimulatedDriver.
+ */
+struct PicoscopeReplay : SimulatedDriver<PicoscopeReplay, 8UZ, 16UZ> {
+    friend SimulatedDriver;
+
+    static constexpr std::string_view kVariant = "REPLAY";
+
+    struct ChunkRef {
+        std::size_t  archive = 0UZ;
+        std::size_t  chunk   = 0UZ;
+        std::int64_t time    = 0; // [ns] since the first chunk of its kind, the position of the chunk on the replay time line
+    };
+
+    // replay cursor of one chunk kind
+    struct Cursor {
+        std::size_t                           chunk  = 0UZ; // position in the chunk list
+        std::size_t                           offset = 0UZ; // Streaming: samples of the current chunk already delivered
+        std::int64_t                          base   = 0;   // [ns] replay time of the first chunk in the current loop
+        std::chrono::steady_clock::time_point start{};
+    };
+
+    ReplayConfig                            _config{};
+    std::vector<RawArchiveView>             _archives{};
+    std::vector<std::vector<RawIndexEntry>> _indices{};   // per archive, ordered by sample index
+    std::vector<std::vector<RawIndexEntry>> _delivered{}; // per memory segment (Streaming: 0), the index entries of the data delivered last
+    std::vector<ChunkRef>                   _streamingChunks{};
+    std::vector<ChunkRef>                   _captureChunks{};
+    Cursor                                  _stream{};  // Streaming
+    RawChunk                                _current{}; // the chunk returned by dueChunk()
+    Cursor                                  _capture{}; // RapidBlock
+
+    static std::mutex& registryMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::map<std::string, ReplayConfig, std::less<>>& registry() {
+        static std::map<std::string, ReplayConfig, std::less<>> replays;
+        return replays;
+    }
+
+    // registers (or replaces) the replay parameters of the archive or directory `path`, applies to units opened afterwards
+    static void setReplay(const std::string& path, ReplayConfig config) {
+        std::scoped_lock lock(registryMutex());
+        registry().insert_or_assign(path, config);
+    }
+
+    static void clearReplays() {
+        std::scoped_lock lock(registryMutex());
+        registry().clear();
+    }
+
+    [[nodiscard]] static ReplayConfig replay(std::string_view path) {
+        std::scoped_lock lock(registryMutex());
+        const auto       it = registry().find(path);
+        return it != registry().end() ? it->second : ReplayConfig{};
+    }
+
+    [[nodiscard]] static std::vector<std::filesystem::path> archiveFiles(const std::filesystem::path& path) {
+        std::error_code ec;
+        if (!std::filesystem::is_directory(path, ec)) {
+            return std::filesystem::is_regular_file(path, ec) ? std::vector<std::filesystem::path>{path} : std::vector<std::filesystem::path>{};
+        }
+        std::vector<std::filesystem::path> files;
+        for (const auto& entry : std::filesystem::directory_iterator(path, ec)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".raw") {
+                files.push_back(entry.path());
+            }
+        }
+        std::ranges::sort(files);
+        return files;
+    }
+
+    PICO_STATUS openUnit(const std::string& serial_number) {
+        _archives.clear();
+        _indices.clear();
+        for (const auto& file : archiveFiles(serial_number)) {
+            auto view = RawArchiveView::open(file);
+            if (!view) {
+                return PICO_NOT_FOUND;
+            }
+            _archives.push_back(std::move(*view));
+            auto& index = _indices.emplace_back();
+            if (const auto indexFile = RawRecorder::indexPath(file); std::filesystem::exists(indexFile)) {
+                auto entries = loadRawIndex(indexFile);
+                if (!entries) {
+                    return PICO_NOT_FOUND;
+                }
+                index = std::move(*entries);
+                std::ranges::stable_sort(index, {}, &RawIndexEntry::sampleIndex); // late tags are recorded after the tags that follow them
+            }
+        }
+        if (_archives.empty()) {
+            return PICO_NOT_FOUND;
+        }
+        _serial = serial_number;
+        _config = replay(serial_number);
+        indexChunks();
+        _handle = 1;
+        return PICO_OK;
+    }
+
+    PICO_STATUS maximumValue(int16_t* value) const {
+        *value = _archives.empty() || _archives.front().header().maxValue == 0 ? std::numeric_limits<std::int16_t>::max() : _archives.front().header().maxValue;
+        return PICO_OK;
+    }
+
+    PICO_STATUS runStreaming(uint32_t* sampleInterval, TimeUnitsType /*timeUnits*/, uint32_t /*maxPreTriggerSamples*/, uint32_t /*maxPostTriggerSamples*/, int16_t /*autoStop*/, uint32_t /*downSampleRatio*/, RatioModeType /*downSampleRatioMode*/, uint32_t overviewBufferSize) {
+        if (!isOpened()) {
+            return PICO_INVALID_HANDLE;
+        }
+        if (*sampleInterval == 0U || overviewBufferSize == 0U) {
+            return PICO_INVALID_PARAMETER;
+        }
+        _bufferSize = overviewBufferSize;
+        _writeIndex = 0UZ;
+        _stream     = Cursor{.start = std::chrono::steady_clock::now()};
+        _streaming  = true;
+        return PICO_OK;
+    }
+
+    // delivers (the rest of) the next due chunk, split at the end of the driver buffer like the driver does
+    PICO_STATUS getStreamingLatestValues(StreamingReadyType ready, void* param) {
+        if (!_streaming) {
+            return PICO_INVALID_HANDLE;
+        }
+        const RawChunk* chunk = dueChunk(_streamingChunks, _stream, true);
+        if (chunk == nullptr) {
+            return PICO_OK;
+        }
+        const RawArchiveHeader& archive  = _archives[_streamingChunks[_stream.chunk].archive].header();
+        const std::size_t       n        = std::min<std::size_t>(chunk->header.nSamples - _stream.offset, _bufferSize - _writeIndex);
+        const int16_t           overflow = _stream.offset == 0UZ ? chunk->header.overflow : int16_t{0}; // reported with the first part of a split chunk
+        copyChunk(archive, *chunk, _stream.offset, n, [this](std::size_t idx) { return _channels[idx].buffer.size() >= _writeIndex ? _channels[idx].buffer.subspan(_writeIndex) : std::span<std::int16_t>{}; });
+        collectTimingReferences(0UZ, _streamingChunks[_stream.chunk].archive, chunk->header.sampleIndex + _stream.offset, n);
+        const auto startIndex = static_cast<uint32_t>(_writeIndex);
+        _writeIndex           = (_writeIndex + n) % _bufferSize;
+        _stream.offset += n;
+        if (_stream.offset >= chunk->header.nSamples) {
+            _stream.offset = 0UZ;
+            ++_stream.chunk;
+        }
+        if (n > 0UZ) {
+            ready(_handle, static_cast<NSamplesType>(n), startIndex, overflow, 0U, 0, 0, param);
+        }
+        return PICO_OK;
+    }
+
+    PICO_STATUS runBlock(int32_t noOfPreTriggerSamples, int32_t noOfPostTriggerSamples, uint32_t /*timebase*/, int32_t* timeIndisposed, uint32_t /*segmentIndex*/, BlockReadyType ready, void* param) {
+        if (!isOpened()) {
+            return PICO_INVALID_HANDLE;
+        }
+        _pre           = static_cast<uint32_t>(std::max(noOfPreTriggerSamples, 0));
+        _post          = static_cast<uint32_t>(std::max(noOfPostTriggerSamples, 0));
+        _blockReady    = ready;
+        _blockParam    = param;
+        _blockRunning  = true;
+        _blockNotified = false;
+        // every block is paced from its first capture: the time between blocks (processing, re-arming) is not part of the recording
+        _capture.start = std::chrono::steady_clock::now();
+        _capture.base  = _capture.chunk < _captureChunks.size() ? _captureChunks[_capture.chunk].time : 0;
+        *timeIndisposed = 0;
+        return PICO_OK;
+    }
+
+    PICO_STATUS getValuesBulk(uint32_t* noOfSamples, uint32_t fromSegmentIndex, uint32_t toSegmentIndex, uint32_t /*downSampleRatio*/, RatioModeType /*downSampleRatioMode*/, int16_t* overflow) {
+        if (toSegmentIndex < fromSegmentIndex || toSegmentIndex >= _nSegments) {
+            return PICO_SEGMENT_OUT_OF_RANGE;
+        }
+        const std::size_t nSamples = std::min<std::size_t>(*noOfSamples, _pre + _post);
+        for (uint32_t segment = fromSegmentIndex; segment <= toSegmentIndex; ++segment) {
+            const RawChunk* chunk = dueChunk(_captureChunks, _capture, false); // completion was already paced by isReady()
+            if (chunk == nullptr) {
+                return PICO_NO_SAMPLES_AVAILABLE;
+            }
+            const std::size_t n = std::min<std::size_t>(nSamples, chunk->header.nSamples);
+            copyChunk(_archives[_captureChunks[_capture.chunk].archive].header(), *chunk, 0UZ, n, [&](std::size_t idx) -> std::span<std::int16_t> {
+                const auto& state = _channels[idx];
+                return segment < state.segments.size() && state.segments[segment] != nullptr ? std::span(state.segments[segment], state.segmentLength) : std::span<std::int16_t>{};
+            });
+            overflow[segment - fromSegmentIndex] = chunk->header.overflow; // one over-range word per segment
+            collectTimingReferences(segment, _captureChunks[_capture.chunk].archive, chunk->header.sampleIndex, n);
+            ++_capture.chunk;
+        }
+        *noOfSamples  = static_cast<uint32_t>(nSamples);
+        _blockRunning = false;
+        return PICO_OK;
+    }
+
+    // the recorded timing tags of the data delivered last to the Streaming callback (segment 0) or of the memory segment, indices relative to its first sample
+    [[nodiscard]] std::span<const RawIndexEntry> timingReferences(std::size_t segment) const noexcept { return segment < _delivered.size() ? std::span<const RawIndexEntry>(_delivered[segment]) : std::span<const RawIndexEntry>{}; }
+
+    // true once all chunks of the current mode were delivered (never while looping)
+    [[nodiscard]] bool finished() const noexcept { return !_config.loop && (_streaming ? _stream.chunk >= _streamingChunks.size() : _capture.chunk >= _captureChunks.size()); }
+
+    [[nodiscard]] std::string unitSerial() const { return _archives.empty() ? _serial : std::string(_archives.front().header().serial.data(), ::strnlen(_archives.front().header().serial.data(), 24UZ)); }
+
+    void onClose() noexcept {
+        _archives.clear();
+        _indices.clear();
+        _delivered.clear();
+    }
+
+private:
+    [[nodiscard]] std::size_t maxMemorySamples() const noexcept { return std::numeric_limits<std::int32_t>::max(); } // the archive is the memory
+
+    // builds the replay time line of both chunk kinds from the recorded acquisition times (or the nominal sample rate for archives without them),
+    // every archive starts right after the end of the previous one
+    void indexChunks() {
+        _streamingChunks.clear();
+        _captureChunks.clear();
+        std::array<std::int64_t, 2> end{0, 0}; // [ns] replay time after the last chunk of the kind
+        for (std::size_t archiveIdx = 0UZ; archiveIdx < _archives.size(); ++archiveIdx) {
+            const RawArchiveView&                      archive    = _archives[archiveIdx];
+            const double                               sampleRate = archive.header().sampleRate > 0.f ? static_cast<double>(archive.header().sampleRate) : 1.0;
+            const std::array<std::int64_t, 2>          start      = end;
+            std::array<std::optional<std::int64_t>, 2> firstTime{};
+            for (std::size_t chunkIdx = 0UZ; chunkIdx < archive.size(); ++chunkIdx) {
+                const RawChunkHeader header = archive.chunk(chunkIdx).header;
+                const auto           kind   = static_cast<std::size_t>(header.kind == RawChunkKind::Capture);
+                std::int64_t         time   = start[kind];
+                if (header.acquisitionTime != 0) {
+                    time += header.acquisitionTime - firstTime[kind].value_or(header.acquisitionTime);
+                    firstTime[kind] = firstTime[kind].value_or(header.acquisitionTime);
+                } else {
+                    time += static_cast<std::int64_t>(1e9 * static_cast<double>(header.sampleIndex) / sampleRate);
+                }
+                (kind == 0UZ ? _streamingChunks : _captureChunks).push_back({.archive = archiveIdx, .chunk = chunkIdx, .time = time});
+                end[kind] = std::max(end[kind], time + static_cast<std::int64_t>(1e9 * static_cast<double>(header.nSamples) / sampleRate));
+            }
+        }
+    }
+
+    // the chunk at the cursor if it is due on the replay time line, restarts at the first chunk when looping
+    [[nodiscard]] const RawChunk* dueChunk(const std::vector<ChunkRef>& chunks, Cursor& cursor, bool paced) {
+        if (cursor.chunk >= chunks.size()) {
+            if (!_config.loop || chunks.empty()) {
+                return nullptr;
+            }
+            cursor.chunk  = 0UZ;
+            cursor.offset = 0UZ;
+            cursor.base   = 0;
+            cursor.start  = std::chrono::steady_clock::now();
+        }
+        const ChunkRef& ref = chunks[cursor.chunk];
+        if (paced && _config.speed > 0.0 && cursor.offset == 0UZ) {
+            const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - cursor.start).count() * _config.speed;
+            if (static_cast<double>(ref.time - cursor.base) > elapsed) {
+                return nullptr;
+            }
+        }
+        _current = _archives[ref.archive].chunk(ref.chunk);
+        return &_current;
+    }
+
+    [[nodiscard]] uint32_t completedCaptures() const {
+        if (!_blockRunning) {
+            return 0U;
+        }
+        const double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - _capture.start).count() * _config.speed;
+        uint32_t     n       = 0U;
+        for (std::size_t i = 0UZ; n < _nCaptures; ++i, ++n) {
+            const std::size_t chunkIdx = _capture.chunk + i;
+            if (chunkIdx >= _captureChunks.size() && !(_config.loop && !_captureChunks.empty())) {
+                break;
+            }
+            const ChunkRef& ref = _captureChunks[chunkIdx % _captureChunks.size()];
+            if (_config.speed > 0.0 && chunkIdx < _captureChunks.size() && static_cast<double>(ref.time - _capture.base) > elapsed) {
+                break;
+            }
+        }
+        return n;
+    }
+
+    void collectTimingReferences(std::size_t segment, std::size_t archive, std::uint64_t sampleIndex, std::size_t n) {
+        if (_delivered.size() <= segment) {
+            _delivered.resize(segment + 1UZ);
+        }
+        auto& delivered = _delivered[segment];
+        delivered.clear();
+        const auto& index = _indices[archive];
+        for (auto it = std::ranges::lower_bound(index, sampleIndex, {}, &RawIndexEntry::sampleIndex); it != index.end() && it->sampleIndex < sampleIndex + n; ++it) {
+            delivered.push_back(*it);
+            delivered.back().sampleIndex -= sampleIndex;
+        }
+    }
+
+    // copies samples [offset, offset + n) of the recorded channels to the device channel buffers returned by `target(idx)`, zeros for the enabled
+    // channels that were not recorded; the recorded digital port is split into the lower (port 0) and higher (port 1) 8 lines
+    template<typename TTarget>
+    void copyChunk(const RawArchiveHeader& header, const RawChunk& chunk, std::size_t offset, std::size_t n, TTarget&& target) const {
+        std::array<std::optional<std::size_t>, N_ANALOG_CHANNELS> recorded{};
+        for (std::size_t i = 0UZ; i < std::min<std::size_t>(header.nChannels, header.channels.size()); ++i) {
+            if (const auto idx = static_cast<std::size_t>(header.channels[i] - 'A'); header.channels[i] >= 'A' && idx < N_ANALOG_CHANNELS) {
+                recorded[idx] = i;
+            }
+        }
+        for (std::size_t idx = 0UZ; idx < N_ANALOG_CHANNELS; ++idx) {
+            const std::span<std::int16_t> out = target(idx);
+            if (!_channels[idx].enabled || out.size() < n) {
+                continue;
+            }
+            if (recorded[idx] && *recorded[idx] < chunk.header.nChannels) {
+                std::ranges::copy(chunk.channel(*recorded[idx]).subspan(offset, n), out.begin());
+            } else {
+                std::ranges::fill(out.first(n), std::int16_t{0});
+            }
+        }
+        if (!_digitalEnabled) {
+            return;
+        }
+        const bool                          hasDigital = header.digital != 0U && chunk.header.nChannels > header.nChannels;
+        const std::span<const std::int16_t> digital    = hasDigital ? chunk.channel(chunk.header.nChannels - 1UZ).subspan(offset, n) : std::span<const std::int16_t>{};
+        for (std::size_t port = 0UZ; port < 2UZ; ++port) {
+            const std::span<std::int16_t> out = target(N_ANALOG_CHANNELS + port);
+            if (out.size() < n) {
+                continue;
+            }
+            for (std::size_t i = 0UZ; i < n; ++i) {
+                out[i] = hasDigital ? static_cast<std::int16_t>((digital[i] >> (8 * port)) & 0xFF) : std::int16_t{0};
+            }
+        }
+    }
+};
+
+static_assert(PicoscopeImplementationLike<PicoscopeReplay>);
+
+} // namespace fair::picoscope
+
+#endif // FAIR_PICOSCOPE_PICOSCOPEREPLAY_HPP
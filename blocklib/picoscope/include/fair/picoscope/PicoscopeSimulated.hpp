@@ -0,0 +1,412 @@
+#ifndef FAIR_PICOSCOPE_PICOSCOPESIMULATED_HPP
+#define FAIR_PICOSCOPE_PICOSCOPESIMULATED_HPP
+
+#include <fair/picoscope/PicoscopeAPI.hpp>
+#include <fair/picoscope/SimulatedDriver.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <numbers>
+#include <random>
+#include <ranges>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace fair::picoscope {
+
+/**
+ * Configuration of a simulated unit, registered per serial number via PicoscopeSimulated::setSimulation().
+ */
+struct SimulatedSignal {
+    enum class Shape { Dc, Sine, Square, Pulse };
+
+    Shape shape     = Shape::Sine;
+    float amplitude = 1.f;    // [V]
+    float frequency = 1000.f; // [Hz]
+    float phase     = 0.f;    // [rad] at sample 0 (Streaming) or at the trigger (RapidBlock)
+    float offset    = 0.f;    // [V]
+    float duty      = 0.5f;   // Square and Pulse: high fraction of the period, Pulse is 0 while low
+    float noise     = 0.f;    // [V rms], approximately Gaussian
+};
+
+struct SimulatedDigitalLine {
+    float frequency = 0.f; // [Hz], 0: constant low
+    float duty      = 0.1f;
+    float delay     = 0.f; // [s] of the rising edge after sample 0 (Streaming) or the trigger (RapidBlock)
+};
+
+struct SimulatedFaults {
+    double      overflowProbability = 0.0;                                     // per streaming callback: over-range flag on a random enabled channel, its samples are clipped
+    double      dropProbability     = 0.0;                                     // per streaming callback: `dropSamples` samples are lost before the chunk, the signal jumps
+    std::size_t dropSamples         = 1000UZ;
+    std::size_t overflowSegment     = std::numeric_limits<std::size_t>::max(); // RapidBlock: the capture in this memory segment is clipped on all enabled channels
+    double      errorProbability    = 0.0;                                     // per streaming poll or RapidBlock readout: the driver call fails with `errorStatus`
+    PICO_STATUS errorStatus         = PICO_DRIVER_FUNCTION;
+    std::size_t failAfterPolls      = 0UZ;                                     // > 0: every streaming poll after this many polls fails with PICO_NOT_RESPONDING (unit lost)
+    std::size_t openFailures        = 0UZ;                                     // number of failed open attempts before the unit can be opened
+};
+
+struct SimulationConfig {
+    std::array<SimulatedSignal, 8UZ>       channels{};
+    std::array<SimulatedDigitalLine, 16UZ> digital{};
+    SimulatedFaults                        faults{};
+    bool                                   realtime         = true;                                    // false: every streaming poll delivers a full buffer (throughput benchmarks)
+    std::size_t                            chunkSamples     = 0UZ;                                     // Streaming: fixed transfer size, polls wait for a complete chunk, 0: everything due
+    float                                  triggerFrequency = 10.f;                                    // RapidBlock: captures per second in real time mode
+    std::size_t                            memorySamples    = 1UZ << 26UZ;                             // RapidBlock: sample memory per channel, split among the segments
+    std::int16_t                           maxValue         = std::numeric_limits<std::int16_t>::max(); // ADC counts at the range limits
+    std::uint32_t                          seed             = 42U;
+};
+
+/**
+ * Driver side observations of a simulated unit, e.g. for benchmarks. Shared by all units opened with the same serial number, updated while running.
+ */
+struct SimulationStatistics {
+    std::atomic<std::size_t>    droppedSamples{0UZ}; // Streaming: samples lost because the driver buffer was not polled in time, or injected drops
+    std::atomic<std::int64_t>   streamStart{0};      // [ns] steady clock at the last runStreaming(), sample n is available at streamStart + (n + 1) / fs
+    std::atomic<std::int64_t>   blockReady{0};       // [ns] steady clock when the captures of the last RapidBlock acquisition were complete
+    std::atomic<std::size_t>    unitsOpened{0UZ};    // successful openUnit() calls
+    std::atomic<std::uintptr_t> streamingBuffer{0};  // address of the last Streaming buffer registered with setDataBuffer()
+};
+
+namespace detail {
+inline std::mutex& simulationRegistryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+inline std::map<std::string, SimulationConfig, std::less<>>& simulationRegistry() {
+    static std::map<std::string, SimulationConfig, std::less<>> simulations;
+    return simulations;
+}
+
+inline std::map<std::string, SimulationStatistics, std::less<>>& simulationStatistics() {
+    static std::map<std::string, SimulationStatistics, std::less<>> statistics; // never erased, references stay valid
+    return statistics;
+}
+} // namespace detail
+
+/**
+ * Software simulation of a PicoScope with `nAnalogChannels` channels and `nDigitalChannels` digital lines (0 or 16), implementing the driver calls used by PicoscopeWrapper in place of the vendor
+ * SDK. Streaming mode delivers the generated signals via the `getStreamingLatestValues` callback at the configured sample rate (real time paced, or as
+ * fast as possible with `realtime == false`), RapidBlock mode fills the memory segments registered with `setDataBuffer` in `getValuesBulk`.
+ * Signals are digitised to the configured channel range and analog offset, clipped samples set the overflow flags.
+ *
+ * Units are selected by serial number: `openUnit("SIM1")` uses the configuration registered with `setSimulation("SIM1", ...)`, an unknown or empty
+ * serial number gets the default configuration (1 kHz, 1 V sine on all channels). The registry is shared by all channel layouts, which stand in for
+ * the different hardware series. The channel, buffer and capture bookkeeping shared with PicoscopeReplay lives in SimulatedDriver.
+ */
+template<std::size_t nAnalogChannels = 4UZ, std::size_t nDigitalChannels = 16UZ>
+struct BasicPicoscopeSimulated : SimulatedDriver<BasicPicoscopeSimulated<nAnalogChannels, nDigitalChannels>, nAnalogChannels, nDigitalChannels> {
+    using Base = SimulatedDriver<BasicPicoscopeSimulated, nAnalogChannels, nDigitalChannels>;
+    friend Base;
+    using typename Base::BlockReadyType;
+    using typename Base::ChannelState;
+    using typename Base::NSamplesType;
+    using typename Base::RatioModeType;
+    using typename Base::StreamingReadyType;
+    using typename Base::TimeUnitsType;
+    using Base::N_ANALOG_CHANNELS;
+    using Base::_blockNotified, Base::_blockParam, Base::_blockReady, Base::_blockRunning, Base::_bufferSize, Base::_channels, Base::_digitalEnabled, Base::_handle, Base::_nCaptures, Base::_nSegments, Base::_post, Base::_pre, Base::_serial, Base::_streaming, Base::_writeIndex;
+    using Base::isOpened;
+
+    static constexpr std::string_view kVariant = "SIMULATED";
+
+    SimulationConfig      _config{};
+    SimulationStatistics* _statistics = nullptr;
+    std::mt19937          _random{};
+
+    // Streaming
+    double                                _sampleRate  = 0.0;
+    std::size_t                           _sampleIndex = 0UZ; // absolute index of the next generated sample
+    std::size_t                           _polls       = 0UZ;
+    std::chrono::steady_clock::time_point _streamStart{};
+
+    // RapidBlock
+    std::chrono::steady_clock::time_point _blockStart{};
+
+    static std::mutex& registryMutex() { return detail::simulationRegistryMutex(); }
+
+    static std::map<std::string, SimulationConfig, std::less<>>& registry() { return detail::simulationRegistry(); }
+
+    // registers (or replaces) the simulated unit with the given serial number, applies to units opened afterwards
+    static void setSimulation(const std::string& serial, SimulationConfig config) {
+        std::scoped_lock lock(registryMutex());
+        registry().insert_or_assign(serial, std::move(config));
+    }
+
+    static void clearSimulations() {
+        std::scoped_lock lock(registryMutex());
+        registry().clear();
+    }
+
+    [[nodiscard]] static SimulationConfig simulation(std::string_view serial) {
+        std::scoped_lock lock(registryMutex());
+        const auto       it = registry().find(serial);
+        return it != registry().end() ? it->second : SimulationConfig{};
+    }
+
+    [[nodiscard]] static SimulationStatistics& statistics(std::string_view serial) {
+        std::scoped_lock lock(registryMutex());
+        return detail::simulationStatistics().try_emplace(std::string(serial)).first->second;
+    }
+
+    PICO_STATUS openUnit(const std::string& serial_number) {
+        _serial     = serial_number.empty() ? std::string("SIM") : serial_number;
+        _config     = simulation(_serial);
+        _statistics = &statistics(_serial);
+        _random.seed(_config.seed);
+        if (_config.faults.openFailures > 0UZ) {
+            --_config.faults.openFailures;
+            std::scoped_lock lock(registryMutex()); // failed attempts are remembered across reopening
+            if (auto it = registry().find(_serial); it != registry().end()) {
+                it->second.faults.openFailures = _config.faults.openFailures;
+            }
+            return PICO_NOT_FOUND;
+        }
+        _handle = 1;
+        _statistics->unitsOpened.fetch_add(1UZ, std::memory_order_relaxed);
+        return PICO_OK;
+    }
+
+    PICO_STATUS maximumValue(int16_t* value) const {
+        *value = _config.maxValue;
+        return PICO_OK;
+    }
+
+    PICO_STATUS runStreaming(uint32_t* sampleInterval, TimeUnitsType timeUnits, uint32_t /*maxPreTriggerSamples*/, uint32_t /*maxPostTriggerSamples*/, int16_t /*autoStop*/, uint32_t /*downSampleRatio*/, RatioModeType /*downSampleRatioMode*/, uint32_t overviewBufferSize) {
+        if (!isOpened()) {
+            return PICO_INVALID_HANDLE;
+        }
+        if (*sampleInterval == 0U) {
+            return PICO_INVALID_PARAMETER;
+        }
+        _sampleRate  = detail::convertTimeIntervalToSampleRate(TimeInterval{timeUnits, *sampleInterval});
+        _bufferSize  = overviewBufferSize;
+        _writeIndex  = 0UZ;
+        _sampleIndex = 0UZ;
+        _polls       = 0UZ;
+        _streamStart = std::chrono::steady_clock::now();
+        _streaming   = true;
+        _statistics->streamStart.store(std::chrono::duration_cast<std::chrono::nanoseconds>(_streamStart.time_since_epoch()).count(), std::memory_order_relaxed);
+        return PICO_OK;
+    }
+
+    PICO_STATUS getStreamingLatestValues(StreamingReadyType ready, void* param) {
+        if (!_streaming) {
+            return PICO_INVALID_HANDLE;
+        }
+        const SimulatedFaults& faults = _config.faults;
+        if (faults.failAfterPolls > 0UZ && _polls >= faults.failAfterPolls) {
+            return PICO_NOT_RESPONDING;
+        }
+        ++_polls;
+        if (faults.errorProbability > 0.0 && std::bernoulli_distribution(faults.errorProbability)(_random)) {
+            return faults.errorStatus;
+        }
+
+        std::size_t due = _bufferSize;
+        if (_config.realtime) {
+            const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - _streamStart).count();
+            const auto   target  = static_cast<std::size_t>(elapsed * _sampleRate);
+            due                  = target > _sampleIndex ? target - _sampleIndex : 0UZ;
+            if (due > _bufferSize) { // not polled fast enough: the driver's buffer overflowed and the oldest samples are lost
+                _sampleIndex += due - _bufferSize;
+                _statistics->droppedSamples.fetch_add(due - _bufferSize, std::memory_order_relaxed);
+                due = _bufferSize;
+            }
+        }
+        if (_config.chunkSamples > 0UZ) {
+            if (due < _config.chunkSamples) {
+                return PICO_OK;
+            }
+            due = _config.chunkSamples;
+        }
+        if (faults.dropProbability > 0.0 && std::bernoulli_distribution(faults.dropProbability)(_random)) {
+            _sampleIndex += faults.dropSamples;
+            _statistics->droppedSamples.fetch_add(faults.dropSamples, std::memory_order_relaxed);
+        }
+        const std::size_t n = std::min(due, _bufferSize - _writeIndex); // the driver delivers contiguous chunks, wrapping around at the buffer end
+        if (n == 0UZ) {
+            return PICO_OK;
+        }
+
+        int16_t overflow = 0;
+        for (std::size_t channelIdx = 0UZ; channelIdx < N_ANALOG_CHANNELS; ++channelIdx) {
+            auto& state = _channels[channelIdx];
+            if (state.enabled && state.buffer.size() >= _writeIndex + n) {
+                overflow |= static_cast<int16_t>(generateAnalog(channelIdx, static_cast<double>(_sampleIndex), state.buffer.subspan(_writeIndex, n)) ? (1 << channelIdx) : 0);
+            }
+        }
+        if (faults.overflowProbability > 0.0 && std::bernoulli_distribution(faults.overflowProbability)(_random)) {
+            const auto channelIdx = std::uniform_int_distribution<std::size_t>(0UZ, N_ANALOG_CHANNELS - 1UZ)(_random);
+            if (auto& state = _channels[channelIdx]; state.enabled && state.buffer.size() >= _writeIndex + n) {
+                auto samples = state.buffer.subspan(_writeIndex, n);
+                std::ranges::fill(samples.first(std::min<std::size_t>(n, 16UZ)), _config.maxValue);
+                overflow |= static_cast<int16_t>(1 << channelIdx);
+            }
+        }
+        if (_digitalEnabled) {
+            generateDigital(static_cast<double>(_sampleIndex), _writeIndex, n, [this](std::size_t port) -> std::span<std::int16_t> { return _channels[N_ANALOG_CHANNELS + port].buffer; });
+        }
+        const auto startIndex = static_cast<uint32_t>(_writeIndex);
+        _writeIndex           = (_writeIndex + n) % _bufferSize;
+        _sampleIndex += n;
+        ready(_handle, static_cast<NSamplesType>(n), startIndex, overflow, 0U, 0, 0, param);
+        return PICO_OK;
+    }
+
+    PICO_STATUS runBlock(int32_t noOfPreTriggerSamples, int32_t noOfPostTriggerSamples, uint32_t timebase, int32_t* timeIndisposed, uint32_t /*segmentIndex*/, BlockReadyType ready, void* param) {
+        if (!isOpened()) {
+            return PICO_INVALID_HANDLE;
+        }
+        _sampleRate     = 80'000'000.0 / static_cast<double>(timebase + 1U);
+        _pre            = static_cast<uint32_t>(std::max(noOfPreTriggerSamples, 0));
+        _post           = static_cast<uint32_t>(std::max(noOfPostTriggerSamples, 0));
+        _blockReady     = ready;
+        _blockParam     = param;
+        _blockStart     = std::chrono::steady_clock::now();
+        _blockRunning   = true;
+        _blockNotified  = false;
+        *timeIndisposed = static_cast<int32_t>(1000.0 * static_cast<double>(_nCaptures) / static_cast<double>(_config.triggerFrequency > 0.f ? _config.triggerFrequency : 1.f));
+        return PICO_OK;
+    }
+
+    PICO_STATUS getValuesBulk(uint32_t* noOfSamples, uint32_t fromSegmentIndex, uint32_t toSegmentIndex, uint32_t /*downSampleRatio*/, RatioModeType /*downSampleRatioMode*/, int16_t* overflow) {
+        if (toSegmentIndex < fromSegmentIndex || toSegmentIndex >= _nSegments) {
+            return PICO_SEGMENT_OUT_OF_RANGE;
+        }
+        if (_config.faults.errorProbability > 0.0 && std::bernoulli_distribution(_config.faults.errorProbability)(_random)) {
+            return _config.faults.errorStatus;
+        }
+        const std::size_t nSamples = std::min<std::size_t>(*noOfSamples, _pre + _post);
+        for (uint32_t segment = fromSegmentIndex; segment <= toSegmentIndex; ++segment) {
+            const double firstSample     = -static_cast<double>(_pre); // relative to the trigger of this capture
+            auto&        segmentOverflow = overflow[segment - fromSegmentIndex]; // one over-range word per segment
+            segmentOverflow              = 0;
+            for (std::size_t channelIdx = 0UZ; channelIdx < N_ANALOG_CHANNELS; ++channelIdx) {
+                auto& state = _channels[channelIdx];
+                if (state.enabled && segment < state.segments.size() && state.segments[segment] != nullptr) {
+                    const auto samples = std::span(state.segments[segment], std::min(nSamples, state.segmentLength));
+                    bool       clipped = generateAnalog(channelIdx, firstSample, samples);
+                    if (segment == _config.faults.overflowSegment) {
+                        std::ranges::fill(samples.first(std::min<std::size_t>(samples.size(), 16UZ)), _config.maxValue);
+                        clipped = true;
+                    }
+                    segmentOverflow |= static_cast<int16_t>(clipped ? (1 << channelIdx) : 0);
+                }
+            }
+            if (_digitalEnabled) {
+                generateDigital(firstSample, 0UZ, nSamples, [&](std::size_t port) -> std::span<std::int16_t> {
+                    const auto& state = _channels[N_ANALOG_CHANNELS + port];
+                    return segment < state.segments.size() && state.segments[segment] != nullptr ? std::span(state.segments[segment], state.segmentLength) : std::span<std::int16_t>{};
+                });
+            }
+        }
+        *noOfSamples  = static_cast<uint32_t>(nSamples);
+        _blockRunning = false;
+        return PICO_OK;
+    }
+
+    void onStreamingBuffer(int16_t* buffer) noexcept { _statistics->streamingBuffer.store(reinterpret_cast<std::uintptr_t>(buffer), std::memory_order_relaxed); }
+
+    void onBlockReady() noexcept { _statistics->blockReady.store(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(), std::memory_order_relaxed); }
+
+private:
+    [[nodiscard]] std::size_t maxMemorySamples() const noexcept { return _config.memorySamples; }
+
+    [[nodiscard]] uint32_t completedCaptures() const {
+        if (!_blockRunning) {
+            return 0U;
+        }
+        if (!_config.realtime || _config.triggerFrequency <= 0.f) {
+            return _nCaptures;
+        }
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - _blockStart).count();
+        return static_cast<uint32_t>(std::min<double>(std::floor(elapsed * static_cast<double>(_config.triggerFrequency)), _nCaptures));
+    }
+
+    [[nodiscard]] double sampleRate() const noexcept { return _sampleRate > 0.0 ? _sampleRate : 1.0; }
+
+    // digitises the signal of the channel for the samples [firstSample, firstSample + out.size()), returns true if any sample was clipped
+    bool generateAnalog(std::size_t channelIdx, double firstSample, std::span<std::int16_t> out) {
+        const SimulatedSignal& signal  = _config.channels[channelIdx];
+        const ChannelState&    state   = _channels[channelIdx];
+        const float            gain    = static_cast<float>(_config.maxValue) / state.range;
+        const float            limit   = static_cast<float>(_config.maxValue);
+        const double           step    = static_cast<double>(signal.frequency) / sampleRate(); // cycles per sample
+        double                 cycle   = firstSample * step + static_cast<double>(signal.phase) / (2.0 * std::numbers::pi);
+        cycle                          = cycle - std::floor(cycle);
+        std::normal_distribution<float> noise(0.f, signal.noise);
+        // sine via a rotating phasor, re-seeded exactly at the start of every chunk
+        const double angle = 2.0 * std::numbers::pi * step;
+        const float  cosStep = static_cast<float>(std::cos(angle));
+        const float  sinStep = static_cast<float>(std::sin(angle));
+        float        re      = static_cast<float>(std::cos(2.0 * std::numbers::pi * cycle));
+        float        im      = static_cast<float>(std::sin(2.0 * std::numbers::pi * cycle));
+        bool         clipped = false;
+        for (auto& sample : out) {
+            float value = signal.offset - state.offset; // the input window is centred at the analog offset
+            switch (signal.shape) {
+            case SimulatedSignal::Shape::Dc: value += signal.amplitude; break;
+            case SimulatedSignal::Shape::Sine: value += signal.amplitude * im; break;
+            case SimulatedSignal::Shape::Square: value += cycle < static_cast<double>(signal.duty) ? signal.amplitude : -signal.amplitude; break;
+            case SimulatedSignal::Shape::Pulse: value += cycle < static_cast<double>(signal.duty) ? signal.amplitude : 0.f; break;
+            }
+            if (signal.noise > 0.f) {
+                value += noise(_random);
+            }
+            const float counts = std::round(value * gain);
+            clipped |= counts >= limit || counts <= -limit;
+            sample = static_cast<std::int16_t>(std::clamp(counts, -limit, limit));
+
+            const float nextRe = re * cosStep - im * sinStep;
+            im                 = re * sinStep + im * cosStep;
+            re                 = nextRe;
+            cycle += step;
+            cycle -= cycle >= 1.0 ? 1.0 : 0.0;
+        }
+        return clipped;
+    }
+
+    // digital port p carries lines 8p..8p+7 in its lower 8 bits, like the driver
+    template<typename TPortBuffer>
+    void generateDigital(double firstSample, std::size_t offset, std::size_t n, TPortBuffer&& portBuffer) const {
+        for (std::size_t port = 0UZ; port < 2UZ; ++port) {
+            const std::span<std::int16_t> buffer = portBuffer(port);
+            if (buffer.size() < offset + n) {
+                continue;
+            }
+            for (std::size_t i = 0UZ; i < n; ++i) {
+                const double t    = (firstSample + static_cast<double>(i)) / sampleRate();
+                int16_t      bits = 0;
+                for (std::size_t bit = 0UZ; bit < 8UZ; ++bit) {
+                    const SimulatedDigitalLine& line = _config.digital[8UZ * port + bit];
+                    if (line.frequency <= 0.f) {
+                        continue;
+                    }
+                    const double cycle = (t - static_cast<double>(line.delay)) * static_cast<double>(line.frequency);
+                    bits |= static_cast<int16_t>((cycle - std::floor(cycle) < static_cast<double>(line.duty) ? 1 : 0) << bit);
+                }
+                buffer[offset + i] = bits;
+            }
+        }
+    }
+};
+
+using PicoscopeSimulated = BasicPicoscopeSimulated<>; // 3000a/5000a layout: 4 analog channels, 16 digital lines
+
+static_assert(PicoscopeImplementationLike<PicoscopeSimulated>);
+static_assert(PicoscopeImplementationLike<BasicPicoscopeSimulated<8UZ, 0UZ>>);
+
+} // namespace fair::picoscope
+
+#endif // FAIR_PICOSCOPE_PICOSCOPESIMULATED_HPP
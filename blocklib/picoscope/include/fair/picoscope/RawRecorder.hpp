@@ -0,0 +1,563 @@
+#ifndef FAIR_PICOSCOPE_RAWRECORDER_HPP
+#define FAIR_PICOSCOPE_RAWRECORDER_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace fair::picoscope {
+
+/**
+ * Raw acquisition archive written by RawRecorder: the int16 driver chunks exactly as delivered by the driver, for offline debugging.
+ *
+ *  archive: | RawArchiveHeader | RawChunkHeader | samples channel 0 | ... | samples digital | RawChunkHeader | ... | 0-padding | RawChunkHeader ...
+ *  index:   | RawIndexHeader | RawIndexEntry | RawIndexEntry | ...
+ *
+ * Records are 8 byte aligned and never cross a multiple of `windowSize`, the rest of a window is zero-padded (a chunk magic of 0 means: continue at the
+ * next window). Channels are stored one after the other, the digital port (if recorded) is the last channel with the 16 lines in one int16 sample.
+ * The index (`<archive>.idx`) holds the matched timing tags with their absolute sample indices in the archive, PicoscopeReplay publishes them again.
+ */
+struct RawArchiveHeader {
+    static constexpr std::array<char, 8> kMagic = {'P', 'S', 'R', 'A', 'W', '0', '0', '1'};
+
+    std::array<char, 8>  magic      = kMagic;
+    std::uint32_t        windowSize = 0U;
+    float                sampleRate = 0.f; // nominal driver sample rate
+    std::int16_t         maxValue   = 0;   // ADC counts at the range limits
+    std::uint16_t        nChannels  = 0U;  // recorded analog channels
+    std::uint16_t        digital    = 0U;  // 1: the digital port is recorded after the analog channels
+    std::uint16_t        reserved   = 0U;
+    std::array<char, 16> channels{};       // channel ids of the analog channels, e.g. "ABD"
+    std::array<char, 24> serial{};
+};
+static_assert(sizeof(RawArchiveHeader) == 64UZ);
+
+enum class RawChunkKind : std::uint16_t { Streaming, Capture };
+
+struct RawChunkHeader {
+    static constexpr std::uint32_t kMagic = 0x4b4e4843U; // "CHNK"
+
+    std::uint32_t magic           = kMagic;
+    RawChunkKind  kind            = RawChunkKind::Streaming;
+    std::int16_t  overflow        = 0;   // driver over-range mask, bit n: analog channel n
+    std::uint32_t nSamples        = 0U;  // per channel
+    std::uint32_t nChannels       = 0U;  // including the digital port
+    std::uint64_t sampleIndex     = 0UZ; // absolute index of the first sample since the recording was started
+    std::int64_t  acquisitionTime = 0;   // [ns] system clock when the chunk was received from the driver
+
+    [[nodiscard]] std::size_t recordSize() const noexcept { return (sizeof(RawChunkHeader) + std::size_t{nChannels} * nSamples * sizeof(std::int16_t) + 7UZ) & ~7UZ; }
+};
+static_assert(sizeof(RawChunkHeader) == 32UZ);
+
+struct RawIndexHeader {
+    static constexpr std::array<char, 8> kMagic = {'P', 'S', 'I', 'D', 'X', '0', '0', '2'};
+
+    std::array<char, 8> magic    = kMagic;
+    std::uint64_t       reserved = 0UZ;
+};
+
+struct RawIndexEntry {
+    std::uint64_t        time        = 0UZ; // [ns] TAI, `trigger_time` of the timing tag
+    std::uint64_t        sampleIndex = 0UZ; // absolute archive sample index the tag was matched to
+    float                offset      = 0.f; // `trigger_offset` of the matched tag, fraction of the sample
+    std::uint32_t        reserved    = 0U;
+    std::array<char, 40> name{};            // `trigger_name`, zero-padded, truncated if longer
+    std::array<char, 64> context{};         // `context`, zero-padded, truncated if longer
+
+    [[nodiscard]] std::string_view triggerName() const noexcept { return {name.data(), ::strnlen(name.data(), name.size())}; }
+    [[nodiscard]] std::string_view triggerContext() const noexcept { return {context.data(), ::strnlen(context.data(), context.size())}; }
+
+    void setText(std::string_view triggerName, std::string_view triggerContext) noexcept {
+        name.fill('\0');
+        context.fill('\0');
+        std::ranges::copy(triggerName.substr(0UZ, name.size()), name.begin());
+        std::ranges::copy(triggerContext.substr(0UZ, context.size()), context.begin());
+    }
+};
+static_assert(sizeof(RawIndexEntry) == 128UZ);
+
+namespace detail {
+
+/**
+ * Append-only file written through fixed size memory mapped windows. The writer only copies into mapped memory: the next window is mapped (and its
+ * disk space allocated) ahead of time by service() on a background thread, which also writes back and unmaps the filled windows. If the writer runs
+ * out of mapped space, reserve() fails instead of blocking.
+ */
+class MappedAppendFile {
+    static constexpr std::size_t kRetiredSlots = 8UZ;
+
+    int         _fd         = -1;
+    std::size_t _windowSize = 0UZ;
+
+    // writer
+    std::byte*  _window       = nullptr;
+    std::size_t _windowOffset = 0UZ; // file offset of _window
+    std::size_t _pos          = 0UZ; // write position within _window
+    std::size_t _retireSlot   = 0UZ;
+
+    // writer -> flusher hand over
+    std::atomic<std::byte*>                            _current{nullptr};
+    std::atomic<std::byte*>                            _next{nullptr};
+    std::array<std::atomic<std::byte*>, kRetiredSlots> _retired{};
+    std::atomic<std::size_t>                           _committed{0UZ}; // bytes in use
+    std::atomic<bool>                                  _failed{false};
+
+    // flusher
+    std::size_t _mappedEnd = 0UZ; // file offset after the last mapped window
+    std::size_t _flushSlot = 0UZ;
+
+public:
+    MappedAppendFile() = default;
+    MappedAppendFile(const MappedAppendFile&)            = delete;
+    MappedAppendFile& operator=(const MappedAppendFile&) = delete;
+    ~MappedAppendFile() { close(); }
+
+    [[nodiscard]] bool isOpen() const noexcept { return _fd >= 0; }
+    [[nodiscard]] bool failed() const noexcept { return _failed.load(std::memory_order_relaxed); }
+
+    // creates (truncates) the file and maps the first window, `header` is written at its start
+    std::expected<void, std::string> open(const std::filesystem::path& path, std::size_t windowSize, std::span<const std::byte> header) {
+        close();
+        _windowSize = roundToPages(windowSize);
+        _fd         = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (_fd < 0) {
+            return std::unexpected(std::format("Cannot open {}: {}", path.string(), std::strerror(errno)));
+        }
+        _failed.store(false, std::memory_order_relaxed);
+        _mappedEnd = 0UZ;
+        _flushSlot = _retireSlot = 0UZ;
+        if (!mapNext()) {
+            const int error = errno;
+            close();
+            return std::unexpected(std::format("Cannot map {}: {}", path.string(), std::strerror(error)));
+        }
+        _window       = _next.exchange(nullptr, std::memory_order_acquire);
+        _windowOffset = 0UZ;
+        _current.store(_window, std::memory_order_release);
+        std::ranges::copy(header, _window);
+        _pos = (header.size() + 7UZ) & ~7UZ;
+        _committed.store(_pos, std::memory_order_release);
+        return {};
+    }
+
+    // windows are mapped at multiples of the page size
+    [[nodiscard]] static std::size_t roundToPages(std::size_t size) noexcept {
+        const auto pageSize = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        return std::max((size + pageSize - 1UZ) / pageSize, 1UZ) * pageSize;
+    }
+
+    /**
+     * Writer: contiguous mapped memory for a record of `size` bytes (8 byte aligned), nullptr if the record does not fit in a window or the next window
+     * is not mapped yet. The record becomes part of the file with commit().
+     */
+    [[nodiscard]] std::byte* reserve(std::size_t size) noexcept {
+        if (_window == nullptr || size > _windowSize) {
+            return nullptr;
+        }
+        if (_pos + size > _windowSize) { // the remaining space stays zero-padded
+            std::byte* next = _next.load(std::memory_order_acquire);
+            if (next == nullptr || _retired[_retireSlot].load(std::memory_order_acquire) != nullptr) {
+                return nullptr; // the flusher is behind, drop the record instead of waiting
+            }
+            _next.store(nullptr, std::memory_order_relaxed);
+            _retired[_retireSlot].store(_window, std::memory_order_release);
+            _retireSlot = (_retireSlot + 1UZ) % kRetiredSlots;
+            _window     = next;
+            _windowOffset += _windowSize;
+            _pos = 0UZ;
+            _current.store(_window, std::memory_order_release);
+            _committed.store(_windowOffset, std::memory_order_release);
+        }
+        return _window + _pos;
+    }
+
+    void commit(std::size_t size) noexcept {
+        _pos += size;
+        _committed.store(_windowOffset + _pos, std::memory_order_release);
+    }
+
+    /**
+     * Flusher: unmaps the filled windows (the kernel writes them back asynchronously), maps the next window and schedules the write-back of the current
+     * one. Returns false after an I/O error, the writer then runs out of space and drops records.
+     */
+    bool service() noexcept {
+        if (!isOpen()) {
+            return false;
+        }
+        for (std::size_t i = 0UZ; i < kRetiredSlots; ++i, _flushSlot = (_flushSlot + 1UZ) % kRetiredSlots) {
+            std::byte* retired = _retired[_flushSlot].load(std::memory_order_acquire);
+            if (retired == nullptr) {
+                break;
+            }
+            ::msync(retired, _windowSize, MS_ASYNC);
+            ::munmap(retired, _windowSize);
+            _retired[_flushSlot].store(nullptr, std::memory_order_release);
+        }
+        if (_next.load(std::memory_order_acquire) == nullptr && !failed() && !mapNext()) {
+            _failed.store(true, std::memory_order_relaxed);
+        }
+        if (std::byte* current = _current.load(std::memory_order_acquire); current != nullptr) {
+            ::msync(current, _windowSize, MS_ASYNC);
+        }
+        return !failed();
+    }
+
+    // unmaps everything and truncates the file to the committed records, the writer and the flusher must have stopped
+    void close() noexcept {
+        if (!isOpen()) {
+            return;
+        }
+        for (auto& retired : _retired) {
+            if (std::byte* window = retired.exchange(nullptr); window != nullptr) {
+                ::munmap(window, _windowSize);
+            }
+        }
+        for (std::byte* window : {_window, _next.exchange(nullptr)}) {
+            if (window != nullptr) {
+                ::msync(window, _windowSize, MS_SYNC);
+                ::munmap(window, _windowSize);
+            }
+        }
+        _window = nullptr;
+        _current.store(nullptr);
+        std::ignore = ::ftruncate(_fd, static_cast<off_t>(_committed.load()));
+        ::close(_fd);
+        _fd = -1;
+        _committed.store(0UZ);
+    }
+
+private:
+    bool mapNext() noexcept {
+        if (::posix_fallocate(_fd, static_cast<off_t>(_mappedEnd), static_cast<off_t>(_windowSize)) != 0) { // no SIGBUS on a full disk later on
+            return false;
+        }
+        void* window = ::mmap(nullptr, _windowSize, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, static_cast<off_t>(_mappedEnd));
+        if (window == MAP_FAILED) {
+            return false;
+        }
+        _mappedEnd += _windowSize;
+        _next.store(static_cast<std::byte*>(window), std::memory_order_release);
+        return true;
+    }
+};
+
+} // namespace detail
+
+struct RawArchiveInfo {
+    std::string  serial{};
+    std::string  channels{}; // ids of the recorded analog channels, e.g. "ABD"
+    float        sampleRate      = 0.f;
+    std::int16_t maxValue        = 0;
+    bool         digital         = false;
+    std::size_t  maxChunkSamples = 0UZ; // per channel, the largest chunk the driver delivers; its record has to fit into a window, 0: not checked
+};
+
+/**
+ * Records the raw driver chunks to a memory mapped archive and the matched timing tags to its index, see RawArchiveHeader for the format.
+ *
+ * append() and addTimingReference() are called from the acquisition thread and only copy into mapped memory, file growth and write-back happen on the
+ * recorder's flusher thread. Chunks that do not fit into the mapped space (flusher too slow, disk full) are counted as dropped; sample indices keep
+ * counting, so the gap is visible in the archive.
+ */
+class RawRecorder {
+    detail::MappedAppendFile _archive;
+    detail::MappedAppendFile _index;
+    std::jthread             _flusher;
+    std::uint64_t            _nSamples  = 0UZ; // absolute index of the next chunk
+    std::uint16_t            _nChannels = 0U;  // per chunk, including the digital port
+    std::atomic<std::size_t> _droppedChunks{0UZ};
+    std::atomic<std::size_t> _recordedBytes{0UZ};
+
+public:
+    static constexpr std::size_t               kDefaultWindowSize = 64UZ << 20UZ;
+    static constexpr std::size_t               kIndexWindowSize   = 1UZ << 20UZ;
+    static constexpr std::chrono::milliseconds kFlushPeriod{2};
+
+    RawRecorder() = default;
+    RawRecorder(const RawRecorder&)            = delete;
+    RawRecorder& operator=(const RawRecorder&) = delete;
+    ~RawRecorder() { close(); }
+
+    [[nodiscard]] static std::filesystem::path indexPath(const std::filesystem::path& archive) { return std::filesystem::path(archive.string() + ".idx"); }
+
+    std::expected<void, std::string> open(const std::filesystem::path& path, const RawArchiveInfo& info, std::size_t windowSize = kDefaultWindowSize) {
+        close();
+        RawArchiveHeader header;
+        header.windowSize = static_cast<std::uint32_t>(detail::MappedAppendFile::roundToPages(windowSize));
+        header.sampleRate = info.sampleRate;
+        header.maxValue   = info.maxValue;
+        header.nChannels  = static_cast<std::uint16_t>(std::min(info.channels.size(), header.channels.size()));
+        header.digital    = info.digital ? 1U : 0U;
+        std::ranges::copy(std::string_view(info.channels).substr(0UZ, header.channels.size()), header.channels.begin());
+        std::ranges::copy(std::string_view(info.serial).substr(0UZ, header.serial.size()), header.serial.begin());
+        const RawChunkHeader largestChunk{.nSamples = static_cast<std::uint32_t>(info.maxChunkSamples), .nChannels = std::uint32_t{header.nChannels} + header.digital};
+        if (largestChunk.recordSize() > header.windowSize) { // reserve() could never place these records, every chunk would be dropped
+            return std::unexpected(std::format("{}: chunks of {} samples per channel ({} bytes) do not fit into archive windows of {} bytes", path.string(), info.maxChunkSamples, largestChunk.recordSize(), header.windowSize));
+        }
+        auto result = _archive.open(path, header.windowSize, std::as_bytes(std::span(&header, 1UZ)));
+        if (!result) {
+            return result;
+        }
+        constexpr RawIndexHeader indexHeader{};
+        if (result = _index.open(indexPath(path), kIndexWindowSize, std::as_bytes(std::span(&indexHeader, 1UZ))); !result) {
+            _archive.close();
+            return result;
+        }
+        _nSamples  = 0UZ;
+        _nChannels = static_cast<std::uint16_t>(header.nChannels + header.digital);
+        _droppedChunks.store(0UZ, std::memory_order_relaxed);
+        _recordedBytes.store(0UZ, std::memory_order_relaxed);
+        _flusher = std::jthread([this](std::stop_token stop) {
+            while (!stop.stop_requested()) {
+                _archive.service();
+                _index.service();
+                std::this_thread::sleep_for(kFlushPeriod);
+            }
+        });
+        return {};
+    }
+
+    [[nodiscard]] bool isOpen() const noexcept { return _archive.isOpen(); }
+
+    void close() {
+        if (_flusher.joinable()) {
+            _flusher.request_stop();
+            _flusher.join();
+        }
+        _archive.close();
+        _index.close();
+    }
+
+    /**
+     * Appends a driver chunk: the recorded analog channels followed by the digital port (if recorded), all of the same length. Returns false if the
+     * chunk was dropped.
+     */
+    bool append(RawChunkKind kind, std::span<const std::span<const std::int16_t>> channels, std::int16_t overflow, std::chrono::system_clock::time_point acquisitionTime = std::chrono::system_clock::now()) {
+        if (!isOpen() || channels.empty()) {
+            return false;
+        }
+        RawChunkHeader header;
+        header.kind            = kind;
+        header.overflow        = overflow;
+        header.nSamples        = static_cast<std::uint32_t>(channels[0].size());
+        header.nChannels       = static_cast<std::uint32_t>(std::min<std::size_t>(channels.size(), _nChannels));
+        header.sampleIndex     = _nSamples;
+        header.acquisitionTime = std::chrono::duration_cast<std::chrono::nanoseconds>(acquisitionTime.time_since_epoch()).count();
+        _nSamples += header.nSamples;
+
+        const std::size_t size   = header.recordSize();
+        std::byte*        record = _archive.reserve(size);
+        if (record == nullptr) {
+            _droppedChunks.fetch_add(1UZ, std::memory_order_relaxed);
+            return false;
+        }
+        std::memcpy(record, &header, sizeof(header));
+        auto* samples = reinterpret_cast<std::int16_t*>(record + sizeof(header));
+        for (std::size_t i = 0UZ; i < header.nChannels; ++i) {
+            const auto channel = channels[i].first(std::min<std::size_t>(channels[i].size(), header.nSamples));
+            std::ranges::copy(channel, samples + i * header.nSamples);
+        }
+        _archive.commit(size);
+        _recordedBytes.fetch_add(size, std::memory_order_relaxed);
+        return true;
+    }
+
+    // a matched timing tag at an absolute sample index of the archive
+    bool addTimingReference(const RawIndexEntry& entry) {
+        if (!isOpen()) {
+            return false;
+        }
+        std::byte* record = _index.reserve(sizeof(RawIndexEntry));
+        if (record == nullptr) {
+            return false;
+        }
+        std::memcpy(record, &entry, sizeof(entry));
+        _index.commit(sizeof(entry));
+        return true;
+    }
+
+    [[nodiscard]] std::uint64_t sampleIndex() const noexcept { return _nSamples; } // absolute index of the next chunk's first sample
+    [[nodiscard]] std::size_t   droppedChunks() const noexcept { return _droppedChunks.load(std::memory_order_relaxed); }
+    [[nodiscard]] std::size_t   recordedBytes() const noexcept { return _recordedBytes.load(std::memory_order_relaxed); }
+};
+
+struct RawChunk {
+    RawChunkHeader                header{};
+    std::span<const std::int16_t> samples{}; // header.nChannels * header.nSamples
+
+    [[nodiscard]] std::span<const std::int16_t> channel(std::size_t i) const { return samples.subspan(i * header.nSamples, header.nSamples); }
+};
+
+/**
+ * Zero-copy read access to a raw archive through a read-only memory mapping. The chunk spans stay valid as long as the view.
+ */
+class RawArchiveView {
+    const std::byte*         _data = nullptr;
+    std::size_t              _size = 0UZ;
+    RawArchiveHeader         _header{};
+    std::vector<std::size_t> _chunks{}; // offsets of the chunk headers
+
+public:
+    RawArchiveView() = default;
+    RawArchiveView(const RawArchiveView&)            = delete;
+    RawArchiveView& operator=(const RawArchiveView&) = delete;
+    RawArchiveView(RawArchiveView&& other) noexcept : _data(std::exchange(other._data, nullptr)), _size(std::exchange(other._size, 0UZ)), _header(other._header), _chunks(std::move(other._chunks)) {}
+    RawArchiveView& operator=(RawArchiveView&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            _data   = std::exchange(other._data, nullptr);
+            _size   = std::exchange(other._size, 0UZ);
+            _header = other._header;
+            _chunks = std::move(other._chunks);
+        }
+        return *this;
+    }
+    ~RawArchiveView() { unmap(); }
+
+    [[nodiscard]] static std::expected<RawArchiveView, std::string> open(const std::filesystem::path& path) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return std::unexpected(std::format("Cannot open {}: {}", path.string(), std::strerror(errno)));
+        }
+        RawArchiveView view;
+        view._size = static_cast<std::size_t>(::lseek(fd, 0, SEEK_END));
+        if (view._size < sizeof(RawArchiveHeader)) {
+            ::close(fd);
+            return std::unexpected(std::format("{}: not a raw archive", path.string()));
+        }
+        void* data = ::mmap(nullptr, view._size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // the mapping keeps the file open
+        if (data == MAP_FAILED) {
+            view._size = 0UZ;
+            return std::unexpected(std::format("Cannot map {}: {}", path.string(), std::strerror(errno)));
+        }
+        ::madvise(data, view._size, MADV_SEQUENTIAL);
+        view._data = static_cast<const std::byte*>(data);
+        std::memcpy(&view._header, view._data, sizeof(RawArchiveHeader));
+        if (view._header.magic != RawArchiveHeader::kMagic || view._header.windowSize == 0U) {
+            return std::unexpected(std::format("{}: not a raw archive", path.string()));
+        }
+        const std::size_t window = view._header.windowSize;
+        for (std::size_t pos = sizeof(RawArchiveHeader); pos + sizeof(RawChunkHeader) <= view._size;) {
+            RawChunkHeader chunk;
+            std::memcpy(&chunk, view._data + pos, sizeof(chunk));
+            if (chunk.magic == 0U) { // padding, continue at the next window
+                pos = (pos / window + 1UZ) * window;
+                continue;
+            }
+            if (chunk.magic != RawChunkHeader::kMagic || pos + chunk.recordSize() > view._size) {
+                return std::unexpected(std::format("{}: corrupt chunk at offset {}", path.string(), pos));
+            }
+            view._chunks.push_back(pos);
+            pos += chunk.recordSize();
+        }
+        return view;
+    }
+
+    [[nodiscard]] const RawArchiveHeader& header() const noexcept { return _header; }
+    [[nodiscard]] std::size_t             size() const noexcept { return _chunks.size(); }
+
+    [[nodiscard]] RawChunk chunk(std::size_t i) const {
+        RawChunk chunk;
+        std::memcpy(&chunk.header, _data + _chunks[i], sizeof(RawChunkHeader));
+        const auto* samples = reinterpret_cast<const std::int16_t*>(_data + _chunks[i] + sizeof(RawChunkHeader)); // 8 byte aligned within the mapping
+        chunk.samples       = std::span(samples, std::size_t{chunk.header.nChannels} * chunk.header.nSamples);
+        return chunk;
+    }
+
+private:
+    void unmap() noexcept {
+        if (_data != nullptr) {
+            ::munmap(const_cast<std::byte*>(_data), _size);
+            _data = nullptr;
+        }
+    }
+};
+
+[[nodiscard]] inline std::expected<std::vector<RawIndexEntry>, std::string> loadRawIndex(const std::filesystem::path& path) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) {
+        return std::unexpected(std::format("Cannot open {}", path.string()));
+    }
+    RawIndexHeader header;
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != RawIndexHeader::kMagic) {
+        return std::unexpected(std::format("{}: not a raw archive index", path.string()));
+    }
+    std::vector<RawIndexEntry> entries;
+    for (RawIndexEntry entry; stream.read(reinterpret_cast<char*>(&entry), sizeof(entry));) {
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+/**
+ * Offline access to a raw archive and its index, copies both files to memory. The chunk spans point into `data`: a copy would refer to the samples of
+ * the original, so the reader is move-only. Moving `data` keeps its heap storage, i.e. the spans stay valid in the moved-to reader.
+ */
+struct RawArchiveReader {
+    using Chunk = RawChunk;
+
+    RawArchiveHeader           header{};
+    std::vector<Chunk>         chunks{};
+    std::vector<RawIndexEntry> index{};
+    std::vector<std::int16_t>  data{};
+
+    RawArchiveReader()                                       = default;
+    RawArchiveReader(const RawArchiveReader&)                = delete;
+    RawArchiveReader& operator=(const RawArchiveReader&)     = delete;
+    RawArchiveReader(RawArchiveReader&&) noexcept            = default;
+    RawArchiveReader& operator=(RawArchiveReader&&) noexcept = default;
+    ~RawArchiveReader()                                      = default;
+
+    [[nodiscard]] static std::expected<RawArchiveReader, std::string> load(const std::filesystem::path& path) {
+        auto view = RawArchiveView::open(path);
+        if (!view) {
+            return std::unexpected(view.error());
+        }
+        RawArchiveReader reader;
+        reader.header        = view->header();
+        std::size_t nSamples = 0UZ;
+        for (std::size_t i = 0UZ; i < view->size(); ++i) {
+            nSamples += view->chunk(i).samples.size();
+        }
+        reader.data.resize(nSamples); // allocated before the spans into it are created
+        std::size_t offset = 0UZ;
+        for (std::size_t i = 0UZ; i < view->size(); ++i) {
+            const RawChunk chunk = view->chunk(i);
+            std::ranges::copy(chunk.samples, reader.data.begin() + static_cast<std::ptrdiff_t>(offset));
+            reader.chunks.push_back({chunk.header, std::span<const std::int16_t>(reader.data).subspan(offset, chunk.samples.size())});
+            offset += chunk.samples.size();
+        }
+        if (const auto indexFile = RawRecorder::indexPath(path); std::filesystem::exists(indexFile)) {
+            auto entries = loadRawIndex(indexFile);
+            if (!entries) {
+                return std::unexpected(entries.error());
+            }
+            reader.index = std::move(*entries);
+        }
+        return reader;
+    }
+};
+
+} // namespace fair::picoscope
+
+#endif // FAIR_PICOSCOPE_RAWRECORDER_HPP
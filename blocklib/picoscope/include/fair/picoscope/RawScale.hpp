@@ -0,0 +1,143 @@
+#ifndef FAIR_PICOSCOPE_RAWSCALE_HPP
+#define FAIR_PICOSCOPE_RAWSCALE_HPP
+
+#include <fair/picoscope/ConversionKernel.hpp>
+
+#include <gnuradio-4.0/Block.hpp>
+#include <gnuradio-4.0/BlockRegistry.hpp>
+#include <gnuradio-4.0/DataSet.hpp>
+#include <gnuradio-4.0/Tag.hpp>
+#include <gnuradio-4.0/meta/UncertainValue.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <type_traits>
+
+namespace fair::picoscope {
+
+/**
+ * Deferred scaling of raw `std::int16_t` Picoscope outputs to physical units.
+ *
+ * The Picoscope block publishes the exact affine conversion of the raw ADC counts in the signal info tag (stream) or the DataSet meta information, see
+ * kernel::ConversionParameters. Archiving sinks can keep the 2-byte samples and only the consumers that need physical units place this block in front.
+ * Non-linear calibrations (`calibration_coefficients`, see CalibrationTable) are applied as well.
+ * Until the first conversion tag is received `default_scale` and `default_offset` are applied. For DataSets the time axis is converted from sample
+ * indices to seconds if the meta information provides the sample rate.
+ */
+template<typename T>
+requires std::disjunction_v<std::is_same<T, float>, std::is_same<T, gr::UncertainValue<float>>, std::is_same<T, gr::DataSet<float>>, std::is_same<T, gr::DataSet<gr::UncertainValue<float>>>>
+struct RawScale : gr::Block<RawScale<T>> {
+    template<typename U, gr::meta::fixed_string description = "", typename... Arguments>
+    using A = gr::Annotated<U, description, Arguments...>;
+
+    using TValue = std::conditional_t<gr::DataSetLike<T>, typename T::value_type, T>;
+    using TInput = std::conditional_t<gr::DataSetLike<T>, gr::DataSet<std::int16_t>, std::int16_t>;
+
+    gr::PortIn<TInput> in;
+    gr::PortOut<T>     out;
+
+    A<float, "scale used until a conversion tag is received">  default_scale  = 1.f;
+    A<float, "offset used until a conversion tag is received"> default_offset = 0.f;
+
+    GR_MAKE_REFLECTABLE(RawScale, in, out, default_scale, default_offset);
+
+    std::optional<kernel::ConversionParameters> _tagParameters; // last conversion received from upstream, takes precedence over the defaults
+    kernel::Calibration                         _calibration;   // non-linear calibration received together with the conversion
+
+    [[nodiscard]] kernel::ConversionParameters parameters() const {
+        auto params        = _tagParameters.value_or(kernel::ConversionParameters{.scale = default_scale, .offset = default_offset});
+        params.calibration = _calibration.empty() ? nullptr : &_calibration;
+        return params;
+    }
+
+    template<typename TMap>
+    void updateParameters(const TMap& map, const kernel::ConversionParameters& params) {
+        _tagParameters = params;
+        _calibration   = {};
+
+        const auto* coefficients = map.template get_if<std::vector<float>>("calibration_coefficients");
+        const auto* range        = map.template get_if<float>("channel_range");
+        const auto* signalScale  = map.template get_if<float>("signal_scale");
+        if (coefficients != nullptr && range != nullptr && signalScale != nullptr) {
+            _calibration = kernel::Calibration::create(*coefficients, *range, *signalScale, params.offset, params.maxValue);
+        }
+    }
+
+    gr::work::Status processBulk(gr::InputSpanLike auto& inSpan, gr::OutputSpanLike auto& outSpan)
+    requires(!gr::DataSetLike<T>)
+    {
+        const std::size_t nSamples = std::min(inSpan.size(), outSpan.size());
+        std::size_t       first    = 0UZ;
+        for (const auto& [relIndex, tagMap] : inSpan.tags()) { // the conversion changes exactly at the sample carrying the tag
+            if (relIndex >= static_cast<std::ptrdiff_t>(nSamples)) {
+                break;
+            }
+            if (auto tagParameters = kernel::ConversionParameters::fromTagMap(tagMap.get())) {
+                const auto index = static_cast<std::size_t>(std::max<std::ptrdiff_t>(relIndex, 0));
+                kernel::convert(std::span<const std::int16_t>(inSpan).subspan(first, index - first), std::span(outSpan).subspan(first), parameters());
+                first = index;
+                updateParameters(tagMap.get(), *tagParameters);
+            }
+        }
+        kernel::convert(std::span<const std::int16_t>(inSpan).subspan(first, nSamples - first), std::span(outSpan).subspan(first), parameters());
+        std::ignore = inSpan.consume(nSamples);
+        outSpan.publish(nSamples);
+        return gr::work::Status::OK;
+    }
+
+    [[nodiscard]] T processOne(const TInput& raw)
+    requires gr::DataSetLike<T>
+    {
+        T ds{};
+        ds.timestamp         = raw.timestamp;
+        ds.extents           = raw.extents;
+        ds.layout            = raw.layout;
+        ds.axis_names        = raw.axis_names;
+        ds.axis_units        = raw.axis_units;
+        ds.signal_names      = raw.signal_names;
+        ds.signal_quantities = raw.signal_quantities;
+        ds.signal_units      = raw.signal_units;
+        ds.meta_information  = raw.meta_information;
+        ds.timing_events     = raw.timing_events;
+
+        // signal values: one block per signal (multi-channel layout) or a single signal with several segments (per-channel and burst layouts)
+        const std::size_t nSignals      = std::max<std::size_t>(1UZ, raw.meta_information.size());
+        const std::size_t signalSamples = raw.signal_values.size() / nSignals;
+        ds.signal_values.resize(raw.signal_values.size());
+        for (std::size_t signalIdx = 0UZ; signalIdx < nSignals; ++signalIdx) {
+            const auto params = signalIdx < raw.meta_information.size() ? kernel::ConversionParameters::fromTagMap(raw.meta_information[signalIdx]) : std::nullopt;
+            if (params) {
+                updateParameters(raw.meta_information[signalIdx], *params);
+            }
+            kernel::convert(std::span(raw.signal_values).subspan(signalIdx * signalSamples, signalSamples), std::span(ds.signal_values).subspan(signalIdx * signalSamples), parameters());
+        }
+
+        // ranges of the converted values, one per signal or segment
+        ds.signal_ranges.resize(raw.signal_ranges.size());
+        if (!ds.signal_ranges.empty()) {
+            const std::size_t rangeSamples = ds.signal_values.size() / ds.signal_ranges.size();
+            for (std::size_t rangeIdx = 0UZ; rangeIdx < ds.signal_ranges.size() && rangeSamples > 0UZ; ++rangeIdx) {
+                const auto [min, max]       = std::ranges::minmax(std::span(ds.signal_values).subspan(rangeIdx * rangeSamples, rangeSamples), {}, [](const TValue& value) { return kernel::toFloat(value); });
+                ds.signal_ranges[rangeIdx] = {min, max};
+            }
+        }
+
+        // sample index axis -> time axis
+        const float* sampleRate = raw.meta_information.empty() ? nullptr : raw.meta_information[0].template get_if<float>(gr::tag::SAMPLE_RATE.shortKey());
+        const float  period     = sampleRate != nullptr && *sampleRate > 0.f ? 1.f / *sampleRate : 1.f;
+        ds.axis_values.resize(raw.axis_values.size());
+        for (std::size_t axisIdx = 0UZ; axisIdx < raw.axis_values.size(); ++axisIdx) {
+            ds.axis_values[axisIdx].resize(raw.axis_values[axisIdx].size());
+            std::ranges::transform(raw.axis_values[axisIdx], ds.axis_values[axisIdx].begin(), [period](std::int16_t index) { return TValue{static_cast<float>(index) * period}; });
+        }
+        return ds;
+    }
+};
+
+} // namespace fair::picoscope
+
+inline auto registerRawScale = gr::registerBlock<fair::picoscope::RawScale, float, gr::UncertainValue<float>, gr::DataSet<float>, gr::DataSet<gr::UncertainValue<float>>>(gr::globalBlockRegistry());
+
+#endif // FAIR_PICOSCOPE_RAWSCALE_HPP
@@ -0,0 +1,96 @@
+#ifndef FAIR_PICOSCOPE_SAMPLEHISTORY_HPP
+#define FAIR_PICOSCOPE_SAMPLEHISTORY_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace fair::picoscope {
+
+/**
+ * Ring buffer of the most recent samples of a single channel, addressed by the absolute sample index of the stream.
+ * Used to cut pre-trigger windows out of the streaming data without having to keep a full rate copy downstream.
+ *
+ * index  0 ..... beginIndex() ............................ endIndex()
+ *        [evicted][<------------- capacity() ------------->)  push() appends at endIndex()
+ *
+ * Single writer, any number of lock-free readers (seqlock-style): the writer announces the index range it is about to overwrite before touching the
+ * samples and publishes the new end afterwards, readers copy optimistically and validate afterwards that none of the copied samples was overwritten
+ * in the meantime. reset() must not run concurrently with readers.
+ */
+template<typename T>
+requires std::is_trivially_copyable_v<T>
+struct SampleHistory {
+    std::vector<T>           _data{};
+    std::size_t              _start = 0UZ; // absolute index of the first sample after reset()
+    std::atomic<std::size_t> _end{0UZ};      // absolute index one past the newest published sample
+    std::atomic<std::size_t> _reserved{0UZ}; // end of the samples being written, samples before _reserved - capacity() may be overwritten
+
+    void reset(std::size_t capacity, std::size_t startIndex = 0UZ) {
+        _data.assign(capacity, T{});
+        _start = startIndex;
+        _end.store(startIndex, std::memory_order_release);
+        _reserved.store(startIndex, std::memory_order_release);
+    }
+
+    [[nodiscard]] std::size_t capacity() const noexcept { return _data.size(); }
+    [[nodiscard]] std::size_t beginIndex() const noexcept { return beginIndex(_end.load(std::memory_order_acquire)); }
+    [[nodiscard]] std::size_t endIndex() const noexcept { return _end.load(std::memory_order_acquire); }
+    [[nodiscard]] bool        contains(std::size_t first, std::size_t count) const noexcept {
+        const std::size_t end = endIndex();
+        return first >= beginIndex(end) && first + count <= end;
+    }
+
+    void push(std::span<const T> samples) {
+        const std::size_t end = _end.load(std::memory_order_relaxed); // single writer
+        if (_data.empty()) {
+            _reserved.store(end + samples.size(), std::memory_order_relaxed);
+            _end.store(end + samples.size(), std::memory_order_release);
+            return;
+        }
+        const std::size_t newEnd = end + samples.size();
+        if (samples.size() > _data.size()) { // only the newest samples fit
+            samples = samples.last(_data.size());
+        }
+        _reserved.store(newEnd, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release); // readers seeing any of the new samples also see the reservation
+        std::size_t pos = (newEnd - samples.size()) % _data.size();
+        for (std::size_t written = 0UZ; written < samples.size();) { // at most two contiguous copies
+            const std::size_t n = std::min(samples.size() - written, _data.size() - pos);
+            std::ranges::copy(samples.subspan(written, n), _data.begin() + static_cast<std::ptrdiff_t>(pos));
+            written += n;
+            pos = 0UZ;
+        }
+        _end.store(newEnd, std::memory_order_release);
+    }
+
+    // copies the samples [first, first + out.size()), returns false if the range is not (or no longer) contained in the history
+    [[nodiscard]] bool copy(std::size_t first, std::span<T> out) const {
+        if (!contains(first, out.size())) {
+            return false;
+        }
+        if (out.empty()) {
+            return true;
+        }
+        std::size_t pos = first % _data.size();
+        for (std::size_t read = 0UZ; read < out.size();) {
+            const std::size_t n = std::min(out.size() - read, _data.size() - pos);
+            std::ranges::copy(std::span(_data).subspan(pos, n), out.begin() + static_cast<std::ptrdiff_t>(read));
+            read += n;
+            pos = 0UZ;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const std::size_t reserved = _reserved.load(std::memory_order_relaxed);
+        return first + _data.size() >= reserved; // not overwritten by a concurrent push() while copying
+    }
+
+private:
+    [[nodiscard]] std::size_t beginIndex(std::size_t end) const noexcept { return std::max(_start, end - std::min(end, _data.size())); }
+};
+
+} // namespace fair::picoscope
+
+#endif // FAIR_PICOSCOPE_SAMPLEHISTORY_HPP
@@ -0,0 +1,305 @@
+#ifndef FAIR_PICOSCOPE_SIMULATEDDRIVER_HPP
+#define FAIR_PICOSCOPE_SIMULATEDDRIVER_HPP
+
+#include <fair/picoscope/PicoscopeAPI.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace fair::picoscope {
+
+/**
+ * Driver calls shared by the software stand-ins for the vendor SDK (PicoscopeSimulated, PicoscopeReplay): channel layout and driver types, unit status,
+ * channel and buffer registration and the RapidBlock segment bookkeeping. `TDerived` is the source of the samples and provides
+ *
+ *  - openUnit(), maximumValue(), runStreaming(), getStreamingLatestValues(), runBlock() and getValuesBulk(), using the state below,
+ *  - completedCaptures(): captures of the running RapidBlock acquisition which are available,
+ *  - maxMemorySamples(): sample memory per channel, split among the segments,
+ *  - kVariant: the PICO_VARIANT_INFO string,
+ *  - static registryMutex() and registry(): the units which can be opened, as listed by enumerateUnits(),
+ *
+ * and may shadow unitSerial() and the hooks onStreamingBuffer(), onBlockReady() and onClose().
+ */
+template<typename TDerived, std::size_t nAnalogChannels, std::size_t nDigitalChannels>
+struct SimulatedDriver {
+    static constexpr std::size_t N_DIGITAL_CHANNELS = nDigitalChannels;
+    static constexpr std::size_t N_ANALOG_CHANNELS  = nAnalogChannels;
+    static_assert(N_ANALOG_CHANNELS > 0UZ && N_ANALOG_CHANNELS <= 8UZ && (N_DIGITAL_CHANNELS == 0UZ || N_DIGITAL_CHANNELS == 16UZ));
+
+    enum Channel : std::int32_t { CHANNEL_A, CHANNEL_B, CHANNEL_C, CHANNEL_D, CHANNEL_E, CHANNEL_F, CHANNEL_G, CHANNEL_H, EXTERNAL, TRIGGER_AUX, DIGITAL_PORT0 = 0x80, DIGITAL_PORT1 };
+    enum CouplingMode : std::int32_t { AC, DC };
+    enum RatioMode : std::int32_t { RATIO_MODE_NONE };
+
+    static constexpr std::underlying_type_t<Channel> DIGI_PORT_0 = DIGITAL_PORT0;
+
+    using ChannelType            = Channel;
+    using CouplingType           = CouplingMode;
+    using RangeType              = AnalogChannelRange;
+    using ThresholdDirectionType = TriggerDirection;
+    using TimeUnitsType          = TimeUnits;
+    using RatioModeType          = RatioMode;
+    using NSamplesType           = int32_t;
+    using StreamingReadyType     = void (*)(int16_t handle, NSamplesType noOfSamples, uint32_t startIndex, int16_t overflow, uint32_t triggerAt, int16_t triggered, int16_t autoStop, void* parameter);
+    using BlockReadyType         = void (*)(int16_t handle, PICO_STATUS status, void* parameter);
+
+    static constexpr RatioModeType ratioNone{RATIO_MODE_NONE};
+
+    static constexpr std::array<std::pair<ChannelName, ChannelType>, N_ANALOG_CHANNELS + 2UZ> outputs = [] {
+        std::array<std::pair<ChannelName, ChannelType>, N_ANALOG_CHANNELS + 2UZ> result{};
+        for (std::size_t i = 0UZ; i < N_ANALOG_CHANNELS; ++i) {
+            result[i] = {static_cast<ChannelName>(i), static_cast<ChannelType>(i)};
+        }
+        result[N_ANALOG_CHANNELS]       = {ChannelName::EXTERNAL, EXTERNAL};
+        result[N_ANALOG_CHANNELS + 1UZ] = {ChannelName::AUX, TRIGGER_AUX};
+        return result;
+    }();
+
+    static constexpr std::array<std::pair<AnalogChannelRange, RangeType>, 12> ranges = {{
+        {AnalogChannelRange::ps10mV, AnalogChannelRange::ps10mV},
+        {AnalogChannelRange::ps20mV, AnalogChannelRange::ps20mV},
+        {AnalogChannelRange::ps50mV, AnalogChannelRange::ps50mV},
+        {AnalogChannelRange::ps100mV, AnalogChannelRange::ps100mV},
+        {AnalogChannelRange::ps200mV, AnalogChannelRange::ps200mV},
+        {AnalogChannelRange::ps500mV, AnalogChannelRange::ps500mV},
+        {AnalogChannelRange::ps1V, AnalogChannelRange::ps1V},
+        {AnalogChannelRange::ps2V, AnalogChannelRange::ps2V},
+        {AnalogChannelRange::ps5V, AnalogChannelRange::ps5V},
+        {AnalogChannelRange::ps10V, AnalogChannelRange::ps10V},
+        {AnalogChannelRange::ps20V, AnalogChannelRange::ps20V},
+        {AnalogChannelRange::ps50V, AnalogChannelRange::ps50V},
+    }};
+
+    struct ChannelState {
+        bool                       enabled  = false;
+        float                      range    = 5.f;
+        float                      offset   = 0.f;
+        std::span<std::int16_t>    buffer{};   // Streaming
+        std::vector<std::int16_t*> segments{}; // RapidBlock, one buffer per memory segment
+        std::size_t                segmentLength = 0UZ;
+    };
+
+    int16_t                                           _handle = 0;
+    std::string                                       _serial{};
+    std::array<ChannelState, N_ANALOG_CHANNELS + 2UZ> _channels{}; // analog channels followed by the two digital ports
+    bool                                              _digitalEnabled = false;
+
+    // Streaming
+    bool        _streaming  = false;
+    std::size_t _bufferSize = 0UZ;
+    std::size_t _writeIndex = 0UZ; // position in the streaming buffers
+
+    // RapidBlock
+    uint32_t       _nSegments     = 1U;
+    uint32_t       _nCaptures     = 1U;
+    uint32_t       _pre           = 0U;
+    uint32_t       _post          = 0U;
+    bool           _blockRunning  = false;
+    bool           _blockNotified = false;
+    BlockReadyType _blockReady    = nullptr;
+    void*          _blockParam    = nullptr;
+
+    static constexpr TimeUnitsType convertTimeUnits(TimeUnits tu) { return tu; }
+
+    [[nodiscard]] static constexpr std::expected<TimebaseResult, Error> convertSampleRateToTimebase(float desiredFreq) {
+        // same timebase scheme as the 4000a series: fS = 80 MHz / (n+1)
+        if (desiredFreq <= 0.f || desiredFreq >= 80'000'000.f) {
+            return TimebaseResult{0, 80'000'000.f};
+        }
+        const auto timebase = static_cast<uint32_t>((80'000'000.f / desiredFreq) - 1.f);
+        return TimebaseResult{timebase, 80'000'000.f / static_cast<float>(timebase + 1)};
+    }
+
+    static constexpr std::expected<CouplingType, Error> convertToCoupling(Coupling coupling) {
+        if (coupling == Coupling::AC) {
+            return AC;
+        } else if (coupling == Coupling::DC) {
+            return DC;
+        }
+        return std::unexpected(Error(std::format("Unsupported coupling mode: {}", static_cast<int>(coupling))));
+    }
+
+    static constexpr std::expected<ThresholdDirectionType, Error> convertToThresholdDirection(TriggerDirection direction) { return direction; }
+
+    static constexpr float uncertainty() { return 0.0000045f; }
+
+    static int maxChannel() { return static_cast<int>(N_ANALOG_CHANNELS); }
+
+    static PICO_STATUS enumerateUnits(int16_t* count, int8_t* serials, int16_t* serialsSize) {
+        std::string list;
+        {
+            std::scoped_lock lock(TDerived::registryMutex());
+            for (const auto& serial : TDerived::registry() | std::views::keys) {
+                list += list.empty() ? serial : "," + serial;
+            }
+            *count = static_cast<int16_t>(TDerived::registry().size());
+        }
+        if (serials != nullptr) {
+            const auto n = std::min(list.size(), static_cast<std::size_t>(std::max<int16_t>(*serialsSize, 0)));
+            std::ranges::copy(list | std::views::take(n), reinterpret_cast<char*>(serials));
+            *serialsSize = static_cast<int16_t>(n);
+        }
+        return PICO_OK;
+    }
+
+    PICO_STATUS openUnitAsync(std::int16_t* status, const std::string& serial_number) {
+        const PICO_STATUS result = self().openUnit(serial_number);
+        *status                  = result == PICO_OK ? 1 : 0;
+        return result;
+    }
+
+    PICO_STATUS openUnitProgress(std::int16_t* progressPercent, std::int16_t* complete) {
+        *progressPercent = isOpened() ? 100 : 0;
+        *complete        = isOpened() ? 1 : 0;
+        return isOpened() ? PICO_OK : PICO_NOT_FOUND;
+    }
+
+    [[nodiscard]] bool isOpened() const { return _handle > 0; }
+
+    [[nodiscard]] PICO_STATUS closeUnit() {
+        _handle    = 0;
+        _streaming = false;
+        self().onClose();
+        return PICO_OK;
+    }
+
+    [[nodiscard]] PICO_STATUS changePowerSource(PICO_STATUS /*powerState*/) const { return PICO_OK; }
+
+    PICO_STATUS getUnitInfo(int8_t* string, int16_t stringLength, int16_t* requiredSize, PICO_INFO info) const {
+        std::string value;
+        switch (info) {
+        case PICO_VARIANT_INFO: value = TDerived::kVariant; break;
+        case PICO_HARDWARE_VERSION: value = "1"; break;
+        case PICO_BATCH_AND_SERIAL: value = self().unitSerial(); break;
+        default: return PICO_INVALID_INFO;
+        }
+        *requiredSize = static_cast<int16_t>(value.size() + 1UZ); // including the terminating null character
+        if (stringLength < *requiredSize) {
+            return PICO_STRING_BUFFER_TO_SMALL;
+        }
+        std::ranges::copy(value, reinterpret_cast<char*>(string));
+        string[value.size()] = 0;
+        return PICO_OK;
+    }
+
+    PICO_STATUS memorySegments(uint32_t nSegments, int32_t* nMaxSamples) {
+        if (nSegments == 0U) {
+            return PICO_INVALID_PARAMETER;
+        }
+        _nSegments   = nSegments;
+        *nMaxSamples = static_cast<int32_t>(std::min<std::size_t>(self().maxMemorySamples() / nSegments, std::numeric_limits<int32_t>::max()));
+        return PICO_OK;
+    }
+
+    [[nodiscard]] PICO_STATUS setNoOfCaptures(uint32_t nCaptures) {
+        if (nCaptures == 0U || nCaptures > _nSegments) {
+            return PICO_SEGMENT_OUT_OF_RANGE;
+        }
+        _nCaptures = nCaptures;
+        return PICO_OK;
+    }
+
+    PICO_STATUS getNoOfCaptures(uint32_t* nCaptures) const {
+        *nCaptures = self().completedCaptures();
+        return PICO_OK;
+    }
+
+    PICO_STATUS getNoOfProcessedCaptures(uint32_t* nProcessedCaptures) const { return getNoOfCaptures(nProcessedCaptures); }
+
+    [[nodiscard]] PICO_STATUS setChannel(ChannelType channel, int16_t enabled, CouplingType /*type*/, RangeType range, float analogOffset) {
+        if (channel < CHANNEL_A || static_cast<std::size_t>(channel) >= N_ANALOG_CHANNELS) {
+            return channel == EXTERNAL || channel == TRIGGER_AUX ? PICO_OK : PICO_INVALID_CHANNEL;
+        }
+        auto& state   = _channels[static_cast<std::size_t>(channel)];
+        state.enabled = enabled != 0;
+        state.range   = toAnalogChannelRangeValue(range);
+        state.offset  = analogOffset;
+        return PICO_OK;
+    }
+
+    PICO_STATUS setDataBuffer(ChannelType channel, int16_t* buffer, int32_t bufferLth, RatioModeType /*mode*/) {
+        auto* state = channelState(channel);
+        if (state == nullptr) {
+            return PICO_INVALID_CHANNEL;
+        }
+        state->buffer = std::span(buffer, static_cast<std::size_t>(std::max(bufferLth, 0)));
+        self().onStreamingBuffer(buffer);
+        return PICO_OK;
+    }
+
+    PICO_STATUS setDataBuffer(ChannelType channel, int16_t* buffer, int32_t bufferLth, uint32_t segmentIndex, RatioModeType /*mode*/) {
+        auto* state = channelState(channel);
+        if (state == nullptr) {
+            return PICO_INVALID_CHANNEL;
+        }
+        if (segmentIndex >= _nSegments) {
+            return PICO_SEGMENT_OUT_OF_RANGE;
+        }
+        state->segments.resize(_nSegments, nullptr);
+        state->segments[segmentIndex] = buffer;
+        state->segmentLength          = static_cast<std::size_t>(std::max(bufferLth, 0));
+        return PICO_OK;
+    }
+
+    [[nodiscard]] PICO_STATUS setSimpleTrigger(int16_t /*enable*/, ChannelType /*source*/, int16_t /*threshold*/, ThresholdDirectionType /*direction*/, uint32_t /*delay*/, int16_t /*autoTriggerMs*/) const {
+        return PICO_OK; // the source places the trigger at the pre-trigger sample of every capture
+    }
+
+    [[nodiscard]] PICO_STATUS setDigitalPorts(int16_t enabled = 1, int16_t /*digitalPortThreshold*/ = 0) {
+        _digitalEnabled = enabled != 0;
+        return PICO_OK;
+    }
+
+    [[nodiscard]] PICO_STATUS setTriggerDigitalPort(uint pinNumber, TriggerDirection /*direction*/) const { return pinNumber < N_DIGITAL_CHANNELS ? PICO_OK : PICO_INVALID_DIGITAL_CHANNEL; }
+
+    // the driver calls the block ready callback from its own thread, the stand-ins call it from the first isReady() poll after the last capture
+    PICO_STATUS isReady(int16_t* ready) {
+        *ready = _blockRunning && self().completedCaptures() >= _nCaptures ? 1 : 0;
+        if (*ready && !_blockNotified) {
+            _blockNotified = true;
+            self().onBlockReady();
+            if (_blockReady != nullptr) {
+                _blockReady(_handle, PICO_OK, _blockParam);
+            }
+        }
+        return PICO_OK;
+    }
+
+    [[nodiscard]] PICO_STATUS driverStop() {
+        _streaming    = false;
+        _blockRunning = false;
+        return PICO_OK;
+    }
+
+    [[nodiscard]] std::string unitSerial() const { return _serial; }
+
+    void onStreamingBuffer(int16_t* /*buffer*/) noexcept {}
+    void onBlockReady() noexcept {}
+    void onClose() noexcept {}
+
+protected:
+    [[nodiscard]] ChannelState* channelState(ChannelType channel) {
+        if (channel >= CHANNEL_A && static_cast<std::size_t>(channel) < N_ANALOG_CHANNELS) {
+            return &_channels[static_cast<std::size_t>(channel)];
+        } else if (channel == DIGITAL_PORT0 || channel == DIGITAL_PORT1) {
+            return &_channels[N_ANALOG_CHANNELS + static_cast<std::size_t>(channel - DIGITAL_PORT0)];
+        }
+        return nullptr;
+    }
+
+private:
+    [[nodiscard]] TDerived&       self() noexcept { return static_cast<TDerived&>(*this); }
+    [[nodiscard]] const TDerived& self() const noexcept { return static_cast<const TDerived&>(*this); }
+};
+
+} // namespace fair::picoscope
+
+#endif // FAIR_PICOSCOPE_SIMULATEDDRIVER_HPP
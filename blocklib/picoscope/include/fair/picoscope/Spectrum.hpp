@@ -0,0 +1,205 @@
+#ifndef FAIR_PICOSCOPE_SPECTRUM_HPP
+#define FAIR_PICOSCOPE_SPECTRUM_HPP
+
+#include <fair/picoscope/ConversionKernel.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace fair::picoscope::kernel {
+
+/**
+ * Iterative radix-2 decimation-in-time FFT of a fixed power-of-two size. The bit reversal permutation and the twiddle factors are computed once per size
+ * and shared by all channels and blocks via get().
+ */
+struct FftPlan {
+    std::size_t                      size = 0UZ;
+    std::vector<std::uint32_t>       bitReversed{};
+    std::vector<std::complex<float>> twiddles{}; // exp(-2πik/size), k < size/2
+
+    explicit FftPlan(std::size_t size_) : size(size_), bitReversed(size_), twiddles(size_ / 2UZ) {
+        assert(std::has_single_bit(size));
+        const int bits = std::countr_zero(size);
+        for (std::size_t i = 0UZ; i < size; ++i) {
+            std::size_t reversed = 0UZ;
+            for (int bit = 0; bit < bits; ++bit) {
+                reversed |= ((i >> bit) & 1UZ) << (bits - 1 - bit);
+            }
+            bitReversed[i] = static_cast<std::uint32_t>(reversed);
+        }
+        for (std::size_t k = 0UZ; k < twiddles.size(); ++k) {
+            const double phase = -2.0 * std::numbers::pi * static_cast<double>(k) / static_cast<double>(size);
+            twiddles[k]        = {static_cast<float>(std::cos(phase)), static_cast<float>(std::sin(phase))};
+        }
+    }
+
+    // plan cache, plans are immutable and never evicted, the returned reference stays valid
+    [[nodiscard]] static const FftPlan& get(std::size_t size) {
+        static std::mutex                                       mutex;
+        static std::map<std::size_t, std::unique_ptr<FftPlan>> plans;
+        std::scoped_lock                                        lock(mutex);
+        auto&                                                   plan = plans[size];
+        if (!plan) {
+            plan = std::make_unique<FftPlan>(size);
+        }
+        return *plan;
+    }
+
+    // in-place forward transform, data.size() == size
+    void transform(std::span<std::complex<float>> data) const noexcept {
+        assert(data.size() == size);
+        for (std::size_t i = 0UZ; i < size; ++i) {
+            if (const std::size_t j = bitReversed[i]; i < j) {
+                std::swap(data[i], data[j]);
+            }
+        }
+        for (std::size_t half = 1UZ, stride = size / 2UZ; half < size; half *= 2UZ, stride /= 2UZ) {
+            for (std::size_t start = 0UZ; start < size; start += 2UZ * half) {
+                for (std::size_t k = 0UZ; k < half; ++k) {
+                    const std::complex<float> w = twiddles[k * stride];
+                    const std::complex<float> a = data[start + k];
+                    const std::complex<float> b = data[start + k + half];
+                    // explicit product, std::complex operator* checks for NaN/inf without -ffast-math
+                    const std::complex<float> v{b.real() * w.real() - b.imag() * w.imag(), b.real() * w.imag() + b.imag() * w.real()};
+                    data[start + k]        = a + v;
+                    data[start + k + half] = a - v;
+                }
+            }
+        }
+    }
+};
+
+/**
+ * Averaged one-sided power spectrum of a real signal: non-overlapping windowed segments of `length` samples are transformed and their power is summed
+ * until `updateInterval` samples have passed, then the average is handed to the callback. The power is normalised to the window, so that a sine of
+ * amplitude A shows a peak of A²/2 (the DC bin holds the squared mean). All buffers are allocated in configure().
+ */
+struct SpectrumAccumulator {
+    enum class Window { Rectangular, Hann, Hamming, Blackman };
+
+    const FftPlan*                   plan = nullptr;
+    std::vector<float>               window{};
+    float                            normalisation = 1.f; // one-sided power normalisation: 2 / (sum window)²
+    std::vector<float>               segment{};
+    std::size_t                      fill = 0UZ;
+    std::vector<std::complex<float>> work{};
+    std::vector<double>              power{}; // sum over the averaged segments, length/2 + 1 bins
+    std::vector<float>               average{};
+    std::size_t                      averages       = 0UZ;
+    std::size_t                      updateInterval = 0UZ; // samples between spectra
+    std::size_t                      sinceUpdate    = 0UZ;
+
+    [[nodiscard]] bool        enabled() const noexcept { return plan != nullptr; }
+    [[nodiscard]] std::size_t length() const noexcept { return plan ? plan->size : 0UZ; }
+    [[nodiscard]] std::size_t nBins() const noexcept { return plan ? plan->size / 2UZ + 1UZ : 0UZ; }
+
+    [[nodiscard]] static std::optional<Window> parseWindow(std::string_view name) noexcept {
+        using enum Window;
+        if (name == "rectangular") {
+            return Rectangular;
+        } else if (name == "hann") {
+            return Hann;
+        } else if (name == "hamming") {
+            return Hamming;
+        } else if (name == "blackman") {
+            return Blackman;
+        }
+        return std::nullopt;
+    }
+
+    // length == 0 disables the accumulator, otherwise it has to be a power of two
+    void configure(std::size_t length_, Window windowType, std::size_t updateInterval_) {
+        plan = length_ == 0UZ ? nullptr : &FftPlan::get(length_);
+        window.resize(length_);
+        const double n = static_cast<double>(length_);
+        for (std::size_t i = 0UZ; i < length_; ++i) {
+            const double phase = 2.0 * std::numbers::pi * static_cast<double>(i) / n; // periodic windows
+            switch (windowType) {
+            case Window::Rectangular: window[i] = 1.f; break;
+            case Window::Hann: window[i] = static_cast<float>(0.5 - 0.5 * std::cos(phase)); break;
+            case Window::Hamming: window[i] = static_cast<float>(0.54 - 0.46 * std::cos(phase)); break;
+            case Window::Blackman: window[i] = static_cast<float>(0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase)); break;
+            }
+        }
+        double windowSum = 0.0;
+        for (const float w : window) {
+            windowSum += static_cast<double>(w);
+        }
+        normalisation  = windowSum > 0.0 ? static_cast<float>(2.0 / (windowSum * windowSum)) : 1.f;
+        updateInterval = std::max(updateInterval_, 1UZ);
+        segment.resize(length_);
+        work.resize(length_);
+        power.resize(nBins());
+        average.resize(nBins());
+        restart();
+    }
+
+    // discards the partial segment and the averaged segments, e.g. to align the next spectrum to a trigger or after dropped samples
+    void restart() noexcept {
+        fill        = 0UZ;
+        averages    = 0UZ;
+        sinceUpdate = 0UZ;
+        std::ranges::fill(power, 0.0);
+    }
+
+    /**
+     * Adds values * scale + offset to the current segment. `onSpectrum(std::span<const float> average, std::size_t averages, std::size_t lastIndex)` is
+     * called for every completed spectrum, lastIndex is the index in `values` of the last sample contributing to it.
+     */
+    template<typename TIn, typename TCallback>
+    void push(std::span<const TIn> values, float scale, float offset, TCallback&& onSpectrum) {
+        if (!enabled()) {
+            return;
+        }
+        for (std::size_t i = 0UZ; i < values.size();) {
+            const std::size_t n = std::min(values.size() - i, segment.size() - fill);
+            for (std::size_t k = 0UZ; k < n; ++k) {
+                segment[fill + k] = toFloat(values[i + k]) * scale + offset;
+            }
+            fill += n;
+            sinceUpdate += n;
+            i += n;
+            if (fill < segment.size()) {
+                break;
+            }
+            accumulateSegment();
+            if (sinceUpdate >= updateInterval) {
+                const double factor = static_cast<double>(normalisation) / static_cast<double>(averages);
+                std::ranges::transform(power, average.begin(), [factor](double p) { return static_cast<float>(p * factor); });
+                average.front() *= 0.5f; // DC is not folded
+                average.back() *= 0.5f;  // neither is Nyquist
+                onSpectrum(std::span<const float>(average), averages, i - 1UZ);
+                restart();
+            }
+        }
+    }
+
+private:
+    void accumulateSegment() noexcept {
+        for (std::size_t k = 0UZ; k < segment.size(); ++k) {
+            work[k] = {segment[k] * window[k], 0.f};
+        }
+        plan->transform(work);
+        for (std::size_t k = 0UZ; k < power.size(); ++k) {
+            power[k] += static_cast<double>(std::norm(work[k]));
+        }
+        ++averages;
+        fill = 0UZ;
+    }
+};
+
+} // namespace fair::picoscope::kernel
+
+#endif // FAIR_PICOSCOPE_SPECTRUM_HPP
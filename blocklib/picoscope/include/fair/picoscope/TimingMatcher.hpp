@@ -3,14 +3,37 @@
 #include <gnuradio-4.0/Buffer.hpp>
 #include <gnuradio-4.0/Tag.hpp>
 
+#include <fair/trace/Trace.hpp>
+
+#include <array>
+#include <string_view>
+#include <utility>
+
 namespace fair::picoscope::timingmatcher {
 using namespace std::chrono_literals;
 
+// reasons for dropping a timing tag (or, for Unordered, also an UNKNOWN_EVENT) instead of publishing it
+enum class DropReason : std::size_t { InvalidTag, Outdated, Unordered, RealignFailed, BeforeChunk };
+inline constexpr std::array<std::string_view, 5UZ> kDropReasonNames{"invalid_tag", "outdated", "unordered", "realign_failed", "before_chunk"};
+
 struct MatcherResult {
-    std::size_t              processedTags    = 0;
-    std::size_t              processedSamples = 0;
-    std::vector<gr::Tag>     tags{};
-    std::vector<std::string> messages{}; // diagnostic or error messages
+    std::size_t                                      processedTags    = 0;
+    std::size_t                                      processedSamples = 0;
+    std::vector<gr::Tag>                             tags{};
+    std::vector<std::string>                         messages{};        // diagnostic or error messages
+    std::array<std::size_t, kDropReasonNames.size()> dropped{};         // dropped tags per DropReason
+    std::size_t                                      unknownEvents = 0; // UNKNOWN_EVENT tags created for trigger edges without timing tag
+
+    void drop(DropReason reason) noexcept { ++dropped[std::to_underlying(reason)]; }
+
+    void clear() noexcept { // keeps the capacity of the vectors
+        processedTags    = 0UZ;
+        processedSamples = 0UZ;
+        tags.clear();
+        messages.clear();
+        dropped       = {};
+        unknownEvents = 0UZ;
+    }
 };
 
 /**
@@ -116,7 +139,15 @@ struct TimingMatcher {
     }
 
     MatcherResult match(const std::span<const gr::property_map> tags, const std::span<const std::size_t>& triggerSampleIndices, const std::size_t nSamples, const std::chrono::nanoseconds localAcqTime) {
-        MatcherResult     result;
+        MatcherResult result;
+        match(tags, triggerSampleIndices, nSamples, localAcqTime, result);
+        return result;
+    }
+
+    // as above, but re-uses the vectors of `result` (e.g. a member of the caller), so chunks without tags do not allocate
+    void match(const std::span<const gr::property_map> tags, const std::span<const std::size_t>& triggerSampleIndices, const std::size_t nSamples, const std::chrono::nanoseconds localAcqTime, MatcherResult& result) {
+        FAIR_TRACE_SPAN("TimingMatcher::match", "matcher");
+        result.clear();
         std::size_t       triggerIndex    = 0;
         std::size_t       unmatchedEvents = 0; // number of events that have to be adjusted based on the next trigger that is found
         float             Ts              = 1e9f / sampleRate;
@@ -126,6 +157,7 @@ struct TimingMatcher {
         auto pushTagOrdered               = [&](gr::Tag&& tag, std::string_view source) {
             if (!result.tags.empty() && result.tags.back().index > tag.index) {
                 result.messages.emplace_back(std::format("Dropping unordered tag (source={}, newIndex={}, lastIndex={})", source, tag.index, result.tags.back().index));
+                result.drop(DropReason::Unordered);
                 return false;
             }
             result.tags.push_back(std::move(tag));
@@ -140,8 +172,9 @@ struct TimingMatcher {
                     if (!result.tags.empty() && result.tags.back().index > currentFlankIndex) {
                         // this should normally not happen, but there are some cases where a hardware event is published based on realigning it instead of the hardware edge and so the hardware edge is not consumed
                         result.messages.emplace_back(std::format("Cannot publish UNKNOWN_EVENT at {}, there have already been tags published before at {}", currentFlankIndex, result.tags.back().index));
-                    } else {
-                        pushTagOrdered(createUnknownEventTag(currentFlankIndex, currentFlankTime), "unknown-event/no-tags-left");
+                        result.drop(DropReason::Unordered);
+                    } else if (pushTagOrdered(createUnknownEventTag(currentFlankIndex, currentFlankTime), "unknown-event/no-tags-left")) {
+                        result.unknownEvents++;
                     }
                     triggerIndex++;
                     continue;
@@ -153,6 +186,7 @@ struct TimingMatcher {
             const gr::property_map& currentTag = tags[tagIndex];
             if (!checkValidTimingTag(currentTag)) {
                 result.messages.emplace_back(std::format("Invalid timing tag at index {}: {}", tagIndex, currentTag));
+                result.drop(DropReason::InvalidTag);
                 result.processedTags++;
                 continue;
             }
@@ -160,6 +194,7 @@ struct TimingMatcher {
             if (!metaMap) {
                 result.processedTags++;
                 result.messages.emplace_back(std::format("Invalid type for TRIGGER_META_INFO value, expected property map, at index {}: {}", tagIndex, currentTag));
+                result.drop(DropReason::InvalidTag);
                 continue;
             }
             auto* maybeTagLocalTime  = metaMap->get_if<unsigned long>("LOCAL-TIME");
@@ -168,6 +203,7 @@ struct TimingMatcher {
             if (!maybeTagLocalTime || !maybeTriggerTime || !maybeTriggerOffset) {
                 result.processedTags++;
                 result.messages.emplace_back(std::format("Invalid type for LOCAL-TIME/TRIGGER_TIME/TRIGGER_OFFSET, expected {}, at index {}: {}", gr::meta::type_name<unsigned long>(), tagIndex, currentTag));
+                result.drop(DropReason::InvalidTag);
                 continue;
             }
             const auto currentTagLocalTime = std::chrono::nanoseconds(*maybeTagLocalTime);
@@ -185,6 +221,7 @@ struct TimingMatcher {
                             pushTagOrdered(std::move(*realignedTag), "realign/no-trigger-left");
                         } else {
                             result.messages.emplace_back(std::format("Failed to realign tag relative to last matched trigger: {}", currentTag));
+                            result.drop(DropReason::RealignFailed);
                         }
                         result.processedTags++;
                     } else { // there is no previous tag, look at the next tag, but look at this one again before publishing the next sample
@@ -202,12 +239,14 @@ struct TimingMatcher {
             if ((currentTagLocalTime + timeout) < localAcqTime) { // outdated tag -> drop // evt0 in diagram
                 result.processedTags++;
                 result.messages.emplace_back(std::format("dropping outdated tag1: {}", currentTag));
+                result.drop(DropReason::Outdated);
                 continue;
             }
 
             const auto maybeHWTrigger = metaMap->get_if<bool>("HW-TRIGGER");
             assert(maybeHWTrigger && "HW-TRIGGER should be bool");
             if (!maybeHWTrigger) {
+                result.drop(DropReason::InvalidTag);
                 result.processedTags++;
                 continue;
             }
@@ -222,6 +261,7 @@ struct TimingMatcher {
                         pushTagOrdered(std::move(*realignedTag), "realign/no-hw-or-flank-too-far");
                     } else {
                         result.messages.emplace_back(std::format("Failed to realign tag relative to last matched trigger: {}", currentTag));
+                        result.drop(DropReason::RealignFailed);
                     }
                     result.processedTags++;
                 } else { // there is currently no previous matched tag, keep tags to attach after the next trigger was detected // evtA in diagram
@@ -231,7 +271,9 @@ struct TimingMatcher {
             }
 
             if ((currentFlankTime + timeout) < currentTagLocalTime) { // hw edge without corresponding event
-                pushTagOrdered(createUnknownEventTag(currentFlankIndex, currentFlankTime), "unknown-event/no-matching-tag");
+                if (pushTagOrdered(createUnknownEventTag(currentFlankIndex, currentFlankTime), "unknown-event/no-matching-tag")) {
+                    result.unknownEvents++;
+                }
                 result.processedSamples = std::max(result.processedSamples, currentFlankIndex);
                 triggerIndex++; // skip outdated timing message(s)
                 continue;
@@ -252,6 +294,7 @@ struct TimingMatcher {
                     pushTagOrdered(std::move(*realignedTag), "realign/unmatched-events");
                 } else {
                     result.messages.emplace_back(std::format("Failed to realign tag relative to last matched trigger: {}", currentTag));
+                    result.drop(DropReason::RealignFailed);
                 }
                 unmatchedEvents--;
                 result.processedTags++;
@@ -271,12 +314,14 @@ struct TimingMatcher {
             if (!metaMap) {
                 result.processedTags++;
                 result.messages.emplace_back(std::format("Invalid type for trigger tag, expected property map"));
+                result.drop(DropReason::InvalidTag);
                 continue;
             }
             auto* maybeLocalTimeValue = metaMap->get_if<unsigned long>("LOCAL-TIME");
             if (!maybeLocalTimeValue) {
                 result.processedTags++;
                 result.messages.emplace_back(std::format("Invalid type for local time, expected unsigned long"));
+                result.drop(DropReason::InvalidTag);
                 continue;
             }
             const auto unconsumedTagLocalTime = std::chrono::nanoseconds(*maybeLocalTimeValue);
@@ -284,13 +329,12 @@ struct TimingMatcher {
             if (unconsumedTagLocalTime < lastSampleTime - 2 * timeout) { // needs twice the timeout, since it is already contained once in the unpublished samples
                 result.processedTags++;
                 result.messages.emplace_back(std::format("dropping outdated(lastSampletTime={}, timeout={}) tag3: {}", lastSampleTime, timeout, unconsumedTag));
+                result.drop(DropReason::Outdated);
             } else {
                 break;
             }
             unmatchedEvents--;
         }
-
-        return result;
     }
 
     void reset() { _lastMatchedTag = std::nullopt; }
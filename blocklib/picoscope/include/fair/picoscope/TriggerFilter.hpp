@@ -0,0 +1,144 @@
+#ifndef FAIR_PICOSCOPE_TRIGGERFILTER_HPP
+#define FAIR_PICOSCOPE_TRIGGERFILTER_HPP
+
+#include <gnuradio-4.0/Tag.hpp>
+
+#include <algorithm>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace fair::picoscope {
+
+/**
+ * Trigger expression compiled once at settings time and matched against the (borrowed) timing tag maps without copying them.
+ *
+ * Syntax: comma separated list of `<trigger_name>[/<ctx>]` expressions, both parts may contain the wildcards `*` (any sequence) and `?` (any character):
+ *  - `CMD_BP_START`                      matches the trigger name with any or no context
+ *  - `CMD_BP_START/FAIR.SELECTOR.C=1`    trigger name and context have to match, the tag has to provide a context
+ *  - `CMD_BP_START/`                     trigger name has to match and the context has to be empty
+ *  - `CMD_BP_START, CMD_SEQ_*/FAIR.SELECTOR.C=?` any of the listed expressions
+ *
+ * Expressions without wildcards in the trigger name are stored in a hash map, so the common case costs a single hash probe per tag.
+ */
+struct TriggerFilter {
+    struct Context {
+        std::optional<std::string> pattern{}; // nullopt: any or no context
+        bool                       wildcard = false;
+    };
+
+    struct NamePattern {
+        std::string pattern;
+        Context     context;
+    };
+
+    struct StringHash {
+        using is_transparent = void;
+        [[nodiscard]] std::size_t operator()(std::string_view str) const noexcept { return std::hash<std::string_view>{}(str); }
+    };
+
+    std::unordered_map<std::string, std::vector<Context>, StringHash, std::equal_to<>> _exactNames{};
+    std::vector<NamePattern>                                                          _namePatterns{}; // trigger names containing wildcards
+
+    [[nodiscard]] static bool hasWildcard(std::string_view str) noexcept { return str.find_first_of("*?") != std::string_view::npos; }
+
+    [[nodiscard]] static bool wildcardMatch(std::string_view pattern, std::string_view str) noexcept {
+        std::size_t p         = 0UZ;
+        std::size_t s         = 0UZ;
+        std::size_t starPos   = std::string_view::npos; // position of the last `*` in the pattern
+        std::size_t starMatch = 0UZ;                    // position in str matched by the last `*`
+        while (s < str.size()) {
+            if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == str[s])) {
+                ++p;
+                ++s;
+            } else if (p < pattern.size() && pattern[p] == '*') {
+                starPos   = p++;
+                starMatch = s;
+            } else if (starPos != std::string_view::npos) { // backtrack: let the last `*` consume one more character
+                p = starPos + 1UZ;
+                s = ++starMatch;
+            } else {
+                return false;
+            }
+        }
+        while (p < pattern.size() && pattern[p] == '*') {
+            ++p;
+        }
+        return p == pattern.size();
+    }
+
+    [[nodiscard]] static TriggerFilter compile(std::string_view expressions) {
+        constexpr auto trim = [](std::string_view str) {
+            const auto first = str.find_first_not_of(" \t");
+            return first == std::string_view::npos ? std::string_view{} : str.substr(first, str.find_last_not_of(" \t") - first + 1UZ);
+        };
+        TriggerFilter filter;
+        for (const auto part : std::views::split(expressions, ',')) {
+            const std::string_view expression = trim(std::string_view(part.begin(), part.end()));
+            if (expression.empty()) {
+                continue;
+            }
+            const std::size_t      slash = expression.find('/');
+            const std::string_view name  = expression.substr(0UZ, slash);
+            Context                context;
+            if (slash != std::string_view::npos) {
+                context.pattern  = std::string(expression.substr(slash + 1UZ));
+                context.wildcard = hasWildcard(*context.pattern);
+            }
+            if (hasWildcard(name)) {
+                filter._namePatterns.push_back({std::string(name), std::move(context)});
+            } else if (!name.empty()) {
+                filter._exactNames[std::string(name)].push_back(std::move(context));
+            }
+        }
+        return filter;
+    }
+
+    [[nodiscard]] bool empty() const noexcept { return _exactNames.empty() && _namePatterns.empty(); }
+
+    [[nodiscard]] static bool matchesContext(const Context& context, std::optional<std::string_view> ctx) noexcept {
+        if (!context.pattern) {
+            return true;
+        }
+        if (!ctx) {
+            return false;
+        }
+        return context.wildcard ? wildcardMatch(*context.pattern, *ctx) : *context.pattern == *ctx;
+    }
+
+    [[nodiscard]] bool matches(std::string_view triggerName, std::optional<std::string_view> ctx) const noexcept {
+        if (triggerName.empty()) {
+            return false;
+        }
+        if (const auto it = _exactNames.find(triggerName); it != _exactNames.end()) {
+            if (std::ranges::any_of(it->second, [&](const Context& context) { return matchesContext(context, ctx); })) {
+                return true;
+            }
+        }
+        return std::ranges::any_of(_namePatterns, [&](const NamePattern& namePattern) { return matchesContext(namePattern.context, ctx) && wildcardMatch(namePattern.pattern, triggerName); });
+    }
+
+    template<typename TMap>
+    [[nodiscard]] bool matches(const TMap& map) const {
+        if (empty()) {
+            return false;
+        }
+        const auto triggerNameValue = map.find_value(gr::tag::TRIGGER_NAME.shortKey());
+        if (!triggerNameValue || !triggerNameValue->is_string()) {
+            return false;
+        }
+        const auto                      contextValue = map.find_value(gr::tag::CONTEXT.shortKey()); // keeps the value alive while comparing
+        std::optional<std::string_view> ctx;
+        if (contextValue && contextValue->is_string()) {
+            ctx = contextValue->value_or(std::string_view{});
+        }
+        return matches(triggerNameValue->value_or(std::string_view{}), ctx);
+    }
+};
+
+} // namespace fair::picoscope
+
+#endif // FAIR_PICOSCOPE_TRIGGERFILTER_HPP
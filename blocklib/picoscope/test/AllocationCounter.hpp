@@ -0,0 +1,45 @@
+#ifndef FAIR_PICOSCOPE_TEST_ALLOCATIONCOUNTER_HPP
+#define FAIR_PICOSCOPE_TEST_ALLOCATIONCOUNTER_HPP
+
+// Replaces the global allocation functions with counting ones. Include in exactly one translation unit of a test executable.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace fair::picoscope::test {
+inline std::atomic<std::size_t> gAllocationCount{0UZ};
+
+[[nodiscard]] inline std::size_t allocationCount() noexcept { return gAllocationCount.load(std::memory_order_relaxed); }
+} // namespace fair::picoscope::test
+
+void* operator new(std::size_t size) {
+    fair::picoscope::test::gAllocationCount.fetch_add(1UZ, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0UZ ? 1UZ : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    fair::picoscope::test::gAllocationCount.fetch_add(1UZ, std::memory_order_relaxed);
+    const auto align = static_cast<std::size_t>(alignment);
+    if (void* ptr = std::aligned_alloc(align, (size + align - 1UZ) / align * align)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return ::operator new(size); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return ::operator new(size, alignment); }
+void  operator delete(void* ptr) noexcept { std::free(ptr); }
+void  operator delete[](void* ptr) noexcept { std::free(ptr); }
+void  operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void  operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+void  operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void  operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void  operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+void  operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+#endif // FAIR_PICOSCOPE_TEST_ALLOCATIONCOUNTER_HPP
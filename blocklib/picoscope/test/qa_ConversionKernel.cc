@@ -0,0 +1,199 @@
+#include <boost/ut.hpp>
+
+#include <fair/picoscope/Calibration.hpp>
+#include <fair/picoscope/ConversionKernel.hpp>
+#include <fair/picoscope/DecimatingFir.hpp>
+#include <fair/picoscope/SampleHistory.hpp>
+#include <fair/picoscope/Spectrum.hpp>
+#include <fair/picoscope/TriggerFilter.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <numbers>
+#include <numeric>
+#include <ranges>
+#include <vector>
+
+/**
+ * Hardware independent tests of the acquisition kernels (conversion, calibration, over-range, decimation, spectra, sample history, trigger filters), run by ctest.
+ */
+namespace fair::picoscope::test {
+
+const boost::ut::suite<"ConversionKernel"> ConversionKernelTests = [] {
+    using namespace boost::ut;
+    using namespace gr;
+    using namespace fair::picoscope;
+
+    "fused conversion, edges and statistics"_test = [] {
+        std::vector<std::int16_t> raw(4000UZ);
+        for (std::size_t i = 0UZ; i < raw.size(); ++i) {
+            raw[i] = (i / 1012UZ) % 2UZ == 1UZ ? std::int16_t{200} : std::int16_t{0}; // rising edges at 1012 and 3036, not aligned to the tiles
+        }
+        kernel::EdgeDetector      edgeDetector{.threshold = 100.f, .band = 10.f, .direction = TriggerDirection::Rising};
+        kernel::ChannelStatistics stats;
+        std::vector<std::size_t>  edges;
+        std::vector<float>        out(raw.size());
+        const std::size_t         firstChunk = 1012UZ; // the first edge is the first sample of the second chunk
+        kernel::convertChannel(std::span<const std::int16_t>(raw).first(firstChunk), std::span(out).first(firstChunk), {}, &edgeDetector, 0UZ, edges, stats);
+        kernel::convertChannel(std::span<const std::int16_t>(raw).subspan(firstChunk), std::span(out).subspan(firstChunk), {}, &edgeDetector, firstChunk, edges, stats);
+
+        expect(edges == std::vector<std::size_t>{1012UZ, 3036UZ});
+        expect(std::ranges::equal(raw, out, [](std::int16_t r, float v) { return static_cast<float>(r) == v; }));
+        expect(eq(stats.count, raw.size()));
+        expect(eq(stats.min, 0.f) && eq(stats.max, 200.f));
+        expect(approx(stats.mean(), 200.0 * (1012.0 + 964.0) / 4000.0, 1e-9));
+        expect(eq(stats.overRange, 0UZ));
+    };
+
+    "TriggerFilter"_test = [] {
+        using namespace std::chrono_literals;
+        using namespace gr::tag;
+
+        const auto testCase = [](bool expectedResult, const std::string& triggerNameAndCtx, const std::string& tagTriggerName, const std::string& tagCtx, bool includeCtx) { //
+            const auto tag = Tag(0, includeCtx ? property_map{{TRIGGER_NAME.shortKey(), tagTriggerName}, {CONTEXT.shortKey(), tagCtx}}                                       //
+                                               : property_map{{TRIGGER_NAME.shortKey(), tagTriggerName}});
+            const bool res = TriggerFilter::compile(triggerNameAndCtx).matches(tag.map);
+            expect(eq(expectedResult, res)) << std::format("triggerNameAndCtx:{}, tag.map:{}", triggerNameAndCtx, tag.map);
+        };
+
+        // both trigger_name and ctx are set
+        testCase(true, "trigger1/ctx1", "trigger1", "ctx1", true);
+        testCase(false, "trigger1/ctx1", "trigger2", "ctx1", true); // incorrect trigger_name
+        testCase(false, "trigger1/ctx1", "trigger1", "ctx2", true); // incorrect ctx
+        testCase(false, "trigger1/ctx1", "trigger1", "", true);     // empty ctx
+        testCase(false, "trigger1/ctx1", "trigger1", "", false);    // no ctx key in tag.map
+
+        // both trigger_name and empty ctx are set
+        testCase(true, "trigger1/", "trigger1", "", true);
+        testCase(false, "trigger1/", "trigger2", "", true);     // incorrect trigger_name
+        testCase(false, "trigger1/", "trigger1", "ctx2", true); // incorrect ctx
+        testCase(false, "trigger1/", "trigger1", "", false);    // no ctx key in tag.map
+
+        // only trigger_name is set
+        testCase(false, "trigger1", "trigger2", "ctx1", true); // incorrect trigger_name
+        testCase(true, "trigger1", "trigger1", "ctx2", true);  // incorrect ctx
+        testCase(true, "trigger1", "trigger1", "", true);      // empty ctx
+        testCase(true, "trigger1", "trigger1", "", false);     // no ctx key in tag.map
+
+        // lists and wildcards
+        testCase(true, "trigger2, trigger1/ctx1", "trigger1", "ctx1", true);
+        testCase(false, "trigger2, trigger1/ctx1", "trigger1", "ctx2", true); // incorrect ctx
+        testCase(true, "trig*", "trigger1", "", false);
+        testCase(true, "trigger?/ctx*", "trigger1", "ctx12", true);
+        testCase(false, "trigger?/ctx*", "trigger12", "ctx1", true); // `?` matches exactly one character
+        testCase(false, "trigger?/ctx*", "trigger1", "", false);     // no ctx key in tag.map
+        testCase(false, "", "trigger1", "", false);                  // empty filter never matches
+    };
+
+    "calibration"_test = [] {
+        const auto table = CalibrationTable::parse(R"(
+            # serial  channel range  c0     c1    c2
+            JO123/45  A       5      0.01   1.02  -0.003
+            *         A       5      0      1
+            *         B       0.5    0.001  0.99 # comment
+        )");
+        expect(table.has_value()) << fatal;
+        expect(eq(table->find("JO123/45", "A", 5.f)->coefficients.size(), 3UZ));
+        expect(eq(table->find("other", "A", 5.f)->coefficients.size(), 2UZ)); // wildcard serial
+        expect(table->find("JO123/45", "B", 5.f) == nullptr);                  // no entry for the range
+        expect(!CalibrationTable::parse("JO123/45 A 5 x").has_value());
+
+        // fused polynomial: value = signal_offset + signal_scale * P(range * raw / maxValue)
+        constexpr std::int16_t          maxValue = 32512;
+        const std::vector<std::int16_t> raw{-32512, -1000, 0, 12345, 32512};
+        for (const std::size_t degree : {2UZ, kernel::Calibration::kMaxHornerDegree + 2UZ}) { // Horner and LUT
+            std::vector<float> coefficients{0.01f, 1.02f, -0.003f};
+            coefficients.resize(degree + 1UZ, 1e-7f);
+            const auto         calibration = kernel::Calibration::create(coefficients, 5.f, 2.f, 0.5f, maxValue);
+            std::vector<float> out(raw.size());
+            expect(eq(calibration.usesLut(), degree > kernel::Calibration::kMaxHornerDegree));
+            kernel::convert(std::span(raw), std::span(out), kernel::ConversionParameters{.maxValue = maxValue, .calibration = &calibration});
+            for (std::size_t i = 0UZ; i < raw.size(); ++i) {
+                const double v        = 5.0 * raw[i] / maxValue;
+                double       expected = 0.0;
+                for (const float c : coefficients | std::views::reverse) {
+                    expected = expected * v + static_cast<double>(c);
+                }
+                expect(approx(out[i], static_cast<float>(0.5 + 2.0 * expected), 1e-4f)) << std::format("degree {}, raw {}", degree, raw[i]);
+            }
+        }
+    };
+
+    "over-range intervals"_test = [] {
+        kernel::OverRangeDetector overRange{.indexOffset = 100UZ};
+        kernel::ChannelStatistics stats;
+        std::vector<std::size_t>  edges;
+        const std::vector<std::int16_t> chunk1{0, 32767, 32767, 5, -32767, -32767};
+        const std::vector<std::int16_t> chunk2{-32767, 1, 32767};
+        std::vector<float>              out(chunk1.size());
+        kernel::convertChannel(std::span(chunk1), std::span(out), {}, nullptr, 0UZ, edges, stats, &overRange);
+        kernel::convertChannel(std::span(chunk2), std::span(out), {}, nullptr, chunk1.size(), edges, stats, &overRange); // interval continues across chunks
+        overRange.close(chunk1.size() + chunk2.size());
+        expect(eq(stats.overRange, 6UZ));
+        expect(eq(overRange.totalIntervals, 3UZ));
+        expect(eq(overRange.intervals.size(), 3UZ) >> fatal);
+        expect(eq(overRange.intervals[0].start, 101UZ) && eq(overRange.intervals[0].end, 103UZ));
+        expect(eq(overRange.intervals[1].start, 104UZ) && eq(overRange.intervals[1].end, 107UZ));
+        expect(eq(overRange.intervals[2].start, 108UZ) && eq(overRange.intervals[2].end, 109UZ));
+    };
+
+    "decimating FIR"_test = [] {
+        kernel::DecimatingFir fir;
+        fir.configure(4UZ, {}, 0.5f, 1.f); // designed low-pass, unity DC gain
+        expect(approx(std::accumulate(fir.taps.begin(), fir.taps.end(), 0.f), 1.f, 1e-5f));
+        const std::vector<std::int16_t> raw(1000UZ, std::int16_t{100});
+        std::vector<float>              out(raw.size());
+        std::vector<std::int16_t>       overRange(raw.size());
+        std::size_t                     nOutput = 0UZ;
+        for (std::size_t chunk : {7UZ, 250UZ, 743UZ}) { // chunks not aligned to the decimation factor
+            nOutput += fir.process(std::span(raw).first(chunk), std::span(out).subspan(nOutput), std::span(overRange).subspan(nOutput));
+        }
+        expect(eq(nOutput, 250UZ));
+        expect(eq(fir.pending, 0UZ));
+        expect(approx(out[nOutput - 1UZ], 51.f, 1e-3f)); // settled: 0.5 * 100 + 1
+        expect(std::ranges::all_of(std::span(overRange).first(nOutput), [](std::int16_t flag) { return flag == 0; }));
+    };
+
+    "spectrum"_test = [] {
+        kernel::SpectrumAccumulator spectrum;
+        spectrum.configure(256UZ, kernel::SpectrumAccumulator::Window::Hann, 1000UZ);
+        expect(&kernel::FftPlan::get(256UZ) == spectrum.plan); // plans are cached
+        std::vector<float> signal(4096UZ);
+        for (std::size_t i = 0UZ; i < signal.size(); ++i) {
+            signal[i] = 1.5f + 2.f * static_cast<float>(std::sin(2.0 * std::numbers::pi * 32.0 * static_cast<double>(i) / 256.0)); // bin 32
+        }
+        std::size_t nSpectra = 0UZ;
+        spectrum.push(std::span<const float>(signal), 1.f, 0.f, [&](std::span<const float> average, std::size_t nAverages, std::size_t lastIndex) {
+            ++nSpectra;
+            expect(eq(average.size(), 129UZ));
+            expect(eq(nAverages, 4UZ)); // first complete segment after 1000 samples
+            expect(eq(lastIndex, nSpectra * 1024UZ - 1UZ));
+            expect(approx(average[0], 2.25f, 1e-3f)); // mean²
+            expect(approx(average[32], 2.f, 1e-3f));  // A²/2
+            expect(lt(average[64], 1e-6f));
+        });
+        expect(eq(nSpectra, 4UZ));
+    };
+
+    "sample history"_test = [] {
+        SampleHistory<float> history;
+        history.reset(100UZ, 10UZ);
+        std::vector<float> chunk(70UZ);
+        std::iota(chunk.begin(), chunk.end(), 10.f); // value == absolute index
+        history.push(chunk);
+        std::iota(chunk.begin(), chunk.end(), 80.f);
+        history.push(chunk);
+        expect(eq(history.beginIndex(), 50UZ));
+        expect(eq(history.endIndex(), 150UZ));
+        std::vector<float> window(20UZ);
+        expect(history.copy(90UZ, window)); // wraps around the end of the ring
+        expect(eq(window.front(), 90.f) && eq(window.back(), 109.f));
+        expect(!history.copy(40UZ, window)); // evicted
+        expect(!history.copy(140UZ, window)); // not yet acquired
+    };
+};
+
+} // namespace fair::picoscope::test
+
+int main() { /* tests are statically executed */ }
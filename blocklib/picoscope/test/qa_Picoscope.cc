@@ -273,6 +273,11 @@ void testStreamingBasics(float sampleRate = 83000.f, bool testDigitalOutput = fa
         expect(eq(tag.map.template value_or<std::string>(tag::SIGNAL_UNIT.shortKey(), std::string{}), "Test unit"s));
         expect(eq(tag.map.template value_or<float>(tag::SIGNAL_MIN.shortKey(), INFINITY), -5.f));
         expect(eq(tag.map.template value_or<float>(tag::SIGNAL_MAX.shortKey(), INFINITY), 5.f));
+        if constexpr (std::is_same_v<T, std::int16_t>) { // raw samples carry the conversion to physical units
+            const auto params = kernel::ConversionParameters::fromTagMap(tag.map);
+            expect(params.has_value());
+            expect(approx(params.value_or(kernel::ConversionParameters{}).scale, 5.f / static_cast<float>(std::numeric_limits<std::int16_t>::max()), 1e-9f));
+        }
     }
 
     // Digital output testing relies on the actual test setup.
@@ -310,6 +315,10 @@ const boost::ut::suite PicoscopeTests = [] {
         testStreamingBasics<int16_t, PicoscopeT>();
         testStreamingBasics<float, PicoscopeT>();
         testStreamingBasics<gr::UncertainValue<float>, PicoscopeT>();
+#ifdef FAIR_PICOSCOPE_HALF_PRECISION
+        testStreamingBasics<std::float16_t, PicoscopeT>();
+        testStreamingBasics<std::bfloat16_t, PicoscopeT>();
+#endif
     } | picoscopeTypes{};
 
     "rapid block basics"_test = []<PicoscopeImplementationLike PicoscopeT> {
@@ -483,38 +492,6 @@ const boost::ut::suite PicoscopeTests = [] {
         }
     } | picoscopeTypes{};
 
-    "tagContainsTrigger"_test = [] {
-        std::println("tagContainsTrigger");
-        using namespace std::chrono_literals;
-        using namespace gr::tag;
-
-        const auto testCase = [](bool expectedResult, const std::string& triggerNameAndCtx, const std::string& tagTriggerName, const std::string& tagCtx, bool includeCtx) { //
-            const auto tag = Tag(0, includeCtx ? property_map{{TRIGGER_NAME.shortKey(), tagTriggerName}, {CONTEXT.shortKey(), tagCtx}}                                       //
-                                               : property_map{{TRIGGER_NAME.shortKey(), tagTriggerName}});
-            const bool res = detail::tagContainsTrigger(tag.map, detail::createTriggerNameAndCtx(triggerNameAndCtx));
-            expect(eq(expectedResult, res)) << std::format("triggerNameAndCtx:{}, tag.map:{}", triggerNameAndCtx, tag.map);
-        };
-
-        // both trigger_name and ctx are set
-        testCase(true, "trigger1/ctx1", "trigger1", "ctx1", true);
-        testCase(false, "trigger1/ctx1", "trigger2", "ctx1", true); // incorrect trigger_name
-        testCase(false, "trigger1/ctx1", "trigger1", "ctx2", true); // incorrect ctx
-        testCase(false, "trigger1/ctx1", "trigger1", "", true);     // empty ctx
-        testCase(false, "trigger1/ctx1", "trigger1", "", false);    // no ctx key in tag.map
-
-        // both trigger_name and empty ctx are set
-        testCase(true, "trigger1/", "trigger1", "", true);
-        testCase(false, "trigger1/", "trigger2", "", true);     // incorrect trigger_name
-        testCase(false, "trigger1/", "trigger1", "ctx2", true); // incorrect ctx
-        testCase(false, "trigger1/", "trigger1", "", false);    // no ctx key in tag.map
-
-        // only trigger_name is set
-        testCase(false, "trigger1", "trigger2", "ctx1", true); // incorrect trigger_name
-        testCase(true, "trigger1", "trigger1", "ctx2", true);  // incorrect ctx
-        testCase(true, "trigger1", "trigger1", "", true);      // empty ctx
-        testCase(true, "trigger1", "trigger1", "", false);     // no ctx key in tag.map
-    };
-
     "rapid block arm/disarm trigger"_test = []<PicoscopeImplementationLike PicoscopeT> {
         if (!promptForTestCase(std::format("rapid block arm/disarm trigger: {}", gr::meta::type_name<PicoscopeT>()))) {
             return;
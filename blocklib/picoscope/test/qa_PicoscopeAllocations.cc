@@ -0,0 +1,236 @@
+#include "AllocationCounter.hpp"
+
+#include <boost/ut.hpp>
+
+#include <gnuradio-4.0/Scheduler.hpp>
+
+#include <fair/picoscope/Picoscope.hpp>
+#include <fair/picoscope/PicoscopeAPI.hpp>
+#include <fair/picoscope/PicoscopeSimulated.hpp>
+
+using namespace std::string_literals;
+
+/**
+ * Regression test for the allocation-free acquisition path: once the wrapper has opened the (simulated) unit and sized its buffers, polling and the
+ * data handler calls must not touch the heap in Streaming and RapidBlock mode, including the digital port conversion. Restarts reuse the driver buffer.
+ *
+ * The end-to-end tests run the Picoscope block in a scheduled graph (tag matching, conversion, publishing, burst recycling) and count the allocations of
+ * all threads in steady state. Out of scope, as they allocate per event by design: the payload of timing tags (the tag maps copied to the outputs and
+ * DataSet timing events, UNKNOWN_EVENT tags and matcher messages), late tag messages, and the PerChannel and MultiChannel RapidBlock layouts, which
+ * publish a new DataSet per capture. The graphs therefore have no timing input, and the captures are shorter than `matcher_timeout`.
+ */
+namespace fair::picoscope::test {
+
+constexpr std::size_t kWarmUpPolls   = 20UZ;
+constexpr std::size_t kMeasuredPolls = 200UZ;
+
+struct PollResult {
+    std::size_t updates     = 0UZ; // handler calls within the measured polls
+    std::size_t allocations = 0UZ; // within the measured polls
+};
+
+PollResult pollSteadyState(PicoscopeWrapper<PicoscopeSimulated>& picoscope, std::size_t expectedChannels) {
+    using namespace boost::ut;
+    while (!picoscope.ready()) {
+        std::ignore = picoscope.poll();
+    }
+    std::size_t updates    = 0UZ;
+    std::size_t badUpdates = 0UZ;
+    const auto  handler    = [&](std::span<std::span<const std::int16_t>> data, std::int16_t /*overflow*/) {
+        ++updates;
+        badUpdates += data.size() != expectedChannels || data[0].empty() ? 1UZ : 0UZ; // no expect() in the measured window, it may allocate
+    };
+    for (std::size_t i = 0UZ; i < kWarmUpPolls; ++i) { // configures the channels and sizes the driver and scratch buffers
+        expect(picoscope.poll(handler).has_value());
+    }
+    updates = 0UZ;
+
+    const std::size_t allocationsStart = allocationCount();
+    for (std::size_t i = 0UZ; i < kMeasuredPolls; ++i) {
+        std::ignore = picoscope.poll(handler);
+    }
+    const PollResult result{.updates = updates, .allocations = allocationCount() - allocationsStart};
+    expect(eq(badUpdates, 0UZ));
+    expect(!picoscope.getLastError().has_value());
+    return result;
+}
+
+// consumes without copying or logging the items, so the sinks do not allocate themselves
+template<typename T>
+struct CountingSink : gr::Block<CountingSink<T>> {
+    gr::PortIn<T> in;
+
+    GR_MAKE_REFLECTABLE(CountingSink, in);
+
+    std::size_t _nItems = 0UZ;
+
+    gr::work::Status processBulk(gr::InputSpanLike auto& inSpan) {
+        _nItems += inSpan.size();
+        std::ignore = inSpan.consume(inSpan.size());
+        return gr::work::Status::OK;
+    }
+};
+
+template<typename TPicoscope>
+[[nodiscard]] std::uint64_t healthCounter(TPicoscope& ps, const std::string& key) {
+    const std::optional<gr::Message> reply = ps.propertyCallbackHealth(TPicoscope::kHealthProperty, gr::Message{});
+    if (!reply.has_value() || !reply->data.has_value()) {
+        return 0UZ;
+    }
+    const auto value = reply->data->template get_if<std::uint64_t>(key);
+    return value ? *value : 0UZ;
+}
+
+struct SteadyState {
+    std::size_t   allocations      = 0UZ; // all threads, within the measurement window
+    std::uint64_t publishedBefore  = 0UZ; // samples per channel published during the warm-up
+    std::uint64_t published        = 0UZ; // samples per channel published within the measurement window
+    std::uint64_t burstAllocations = 0UZ; // within the measurement window
+};
+
+// runs the graph until the buffers and pools are sized, then counts the allocations while the acquisition continues; the health is read outside of the window
+template<typename TPicoscope>
+SteadyState runSteadyState(gr::Graph&& flowGraph, TPicoscope& ps, std::chrono::milliseconds warmUp, std::chrono::milliseconds window) {
+    using namespace boost::ut;
+    gr::scheduler::Simple sched{};
+    std::ignore = sched.exchange(std::move(flowGraph));
+    expect(sched.changeStateTo(gr::lifecycle::State::INITIALISED).has_value());
+    expect(sched.changeStateTo(gr::lifecycle::State::RUNNING).has_value());
+    std::this_thread::sleep_for(warmUp);
+
+    SteadyState       result{.publishedBefore = healthCounter(ps, "samples_published"), .burstAllocations = healthCounter(ps, "burst_allocations")};
+    const std::size_t allocationsStart = allocationCount();
+    std::this_thread::sleep_for(window);
+    result.allocations      = allocationCount() - allocationsStart;
+    result.published        = healthCounter(ps, "samples_published") - result.publishedBefore;
+    result.burstAllocations = healthCounter(ps, "burst_allocations") - result.burstAllocations;
+
+    expect(sched.changeStateTo(gr::lifecycle::State::REQUESTED_STOP).has_value());
+    return result;
+}
+
+const boost::ut::suite<"PicoscopeAllocations"> allocationTests = [] {
+    using namespace boost::ut;
+
+    PicoscopeSimulated::setSimulation("ALLOC", SimulationConfig{.realtime = false}); // every poll delivers data
+
+    "streaming poll is allocation free"_test = [] {
+        PicoscopeWrapper<PicoscopeSimulated> picoscope{"ALLOC", false};
+        picoscope.configureChannel(0UZ, ChannelConfig{true, AnalogChannelRange::ps5V, 0.0f, Coupling::DC});
+        picoscope.configureChannel(1UZ, ChannelConfig{true, AnalogChannelRange::ps5V, 0.0f, Coupling::DC});
+        picoscope.startStreamingAcquisition(1e6f, true);
+        const auto result = pollSteadyState(picoscope, 3UZ); // two channels + digital port
+        expect(eq(result.updates, kMeasuredPolls));
+        expect(eq(result.allocations, 0UZ));
+    };
+
+    "RapidBlock poll is allocation free"_test = [] {
+        PicoscopeWrapper<PicoscopeSimulated> picoscope{"ALLOC", false};
+        picoscope.configureChannel(0UZ, ChannelConfig{true, AnalogChannelRange::ps5V, 0.0f, Coupling::DC});
+        picoscope.configureChannel(1UZ, ChannelConfig{true, AnalogChannelRange::ps5V, 0.0f, Coupling::DC});
+        picoscope.configureTrigger(TriggerConfig{.source = ChannelName::A, .direction = TriggerDirection::Rising, .threshold = 0, .delay = 0, .auto_trigger_ms = 1});
+        picoscope.startTriggeredAcquisition(1e6f, 500UZ, 1500UZ, 4UZ, [] {}, true);
+        const auto result = pollSteadyState(picoscope, 3UZ);
+        expect(gt(result.updates, 0UZ));
+        expect(eq(result.allocations, 0UZ));
+    };
+
+    "driver buffer is kept across restarts"_test = [] {
+        PicoscopeWrapper<PicoscopeSimulated> picoscope{"ALLOC", false};
+        picoscope.data.setOptions({.pages = DriverBufferPages::Explicit, .lock = true, .prefault = true}); // degrades without reserved pages or privileges
+        picoscope.configureChannel(0UZ, ChannelConfig{true, AnalogChannelRange::ps5V, 0.0f, Coupling::DC});
+        picoscope.startStreamingAcquisition(1e6f, false);
+        std::ignore               = pollSteadyState(picoscope, 1UZ);
+        const std::int16_t* first = picoscope.data.data();
+        expect(picoscope.data.placement().prefaulted);
+        expect(eq(reinterpret_cast<std::uintptr_t>(first) % DriverBuffer<std::int16_t>::kHugePageSize, 0UZ));
+
+        picoscope.configureChannel(0UZ, ChannelConfig{true, AnalogChannelRange::ps2V, 0.0f, Coupling::DC}); // restarts the acquisition
+        std::ignore = pollSteadyState(picoscope, 1UZ);
+        expect(eq(picoscope.data.data(), first));
+
+        picoscope.configureChannel(1UZ, ChannelConfig{true, AnalogChannelRange::ps5V, 0.0f, Coupling::DC}); // twice the memory
+        std::ignore = pollSteadyState(picoscope, 2UZ);
+        expect(ge(picoscope.data.placement().bytes, picoscope.data.size() * sizeof(std::int16_t)));
+    };
+
+    "streaming block is allocation free in steady state"_test = [] {
+        using namespace std::chrono_literals;
+        PicoscopeSimulated::setSimulation("ALLOC-STREAMING", SimulationConfig{});
+
+        gr::Graph flowGraph;
+        auto&     ps = flowGraph.emplaceBlock<Picoscope<float, PicoscopeSimulated>>({
+            {"serial_number", "ALLOC-STREAMING"s},
+            {"sample_rate", 1'000'000.f},
+            {"auto_arm", true},
+            {"channel_ids", std::vector<std::string>{"A", "B"}},
+            {"channel_ranges", std::vector<float>{2.f, 5.f}},
+            {"channel_couplings", std::vector<std::string>{"DC", "DC"}},
+        });
+        constexpr std::size_t kBufferSize = 65536UZ;
+        auto&                 sinkA       = flowGraph.emplaceBlock<CountingSink<float>>();
+        auto&                 sinkB       = flowGraph.emplaceBlock<CountingSink<float>>();
+        auto&                 sinkC       = flowGraph.emplaceBlock<CountingSink<float>>();
+        auto&                 sinkD       = flowGraph.emplaceBlock<CountingSink<float>>();
+        auto&                 sinkDigital = flowGraph.emplaceBlock<CountingSink<std::uint16_t>>();
+        expect(flowGraph.connect<"out#0", "in">(ps, sinkA, gr::EdgeParameters{.minBufferSize = kBufferSize}).has_value());
+        expect(flowGraph.connect<"out#1", "in">(ps, sinkB, gr::EdgeParameters{.minBufferSize = kBufferSize}).has_value());
+        expect(flowGraph.connect<"out#2", "in">(ps, sinkC, gr::EdgeParameters{.minBufferSize = kBufferSize}).has_value());
+        expect(flowGraph.connect<"out#3", "in">(ps, sinkD, gr::EdgeParameters{.minBufferSize = kBufferSize}).has_value());
+        expect(flowGraph.connect<"digitalOut", "in">(ps, sinkDigital, gr::EdgeParameters{.minBufferSize = kBufferSize}).has_value());
+
+        const SteadyState result = runSteadyState(std::move(flowGraph), ps, 300ms, 500ms);
+        std::println("streaming: {} samples published within the window, {} allocations", result.published, result.allocations);
+        expect(gt(result.publishedBefore, 0UZ));
+        expect(gt(result.published, 0UZ));
+        expect(eq(result.allocations, 0UZ));
+    };
+
+    "rapid block burst is allocation free in steady state"_test = [] {
+        using namespace std::chrono_literals;
+        constexpr gr::Size_t nCaptures = 4;
+        constexpr gr::Size_t nSamples  = 1000; // shorter than the default matcher_timeout, i.e. the trigger edges produce no UNKNOWN_EVENT tags
+
+        SimulationConfig config;
+        config.triggerFrequency = 1000.f;
+        PicoscopeSimulated::setSimulation("ALLOC-BURST", config);
+
+        gr::Graph flowGraph;
+        auto&     ps = flowGraph.emplaceBlock<Picoscope<gr::DataSet<float>, PicoscopeSimulated>>({
+            {"serial_number", "ALLOC-BURST"s},
+            {"sample_rate", 1'000'000.f},
+            {"pre_samples", gr::Size_t{100}},
+            {"post_samples", nSamples - 100},
+            {"n_captures", nCaptures},
+            {"rapid_block_layout", "Burst"s},
+            {"auto_arm", true},
+            {"channel_ids", std::vector<std::string>{"A", "B"}},
+            {"channel_ranges", std::vector<float>{2.f, 5.f}},
+            {"trigger_threshold", 0.0f},
+            {"channel_couplings", std::vector<std::string>{"DC", "DC"}},
+        });
+        constexpr std::size_t kBufferSize = 4UZ; // small rings, so the warm-up passes all slots and the recycled storage is used
+        auto&                 sinkA       = flowGraph.emplaceBlock<CountingSink<gr::DataSet<float>>>();
+        auto&                 sinkB       = flowGraph.emplaceBlock<CountingSink<gr::DataSet<float>>>();
+        auto&                 sinkC       = flowGraph.emplaceBlock<CountingSink<gr::DataSet<float>>>();
+        auto&                 sinkD       = flowGraph.emplaceBlock<CountingSink<gr::DataSet<float>>>();
+        auto&                 sinkDigital = flowGraph.emplaceBlock<CountingSink<gr::DataSet<std::uint16_t>>>();
+        expect(flowGraph.connect<"out#0", "in">(ps, sinkA, gr::EdgeParameters{.minBufferSize = kBufferSize}).has_value());
+        expect(flowGraph.connect<"out#1", "in">(ps, sinkB, gr::EdgeParameters{.minBufferSize = kBufferSize}).has_value());
+        expect(flowGraph.connect<"out#2", "in">(ps, sinkC, gr::EdgeParameters{.minBufferSize = kBufferSize}).has_value());
+        expect(flowGraph.connect<"out#3", "in">(ps, sinkD, gr::EdgeParameters{.minBufferSize = kBufferSize}).has_value());
+        expect(flowGraph.connect<"digitalOut", "in">(ps, sinkDigital, gr::EdgeParameters{.minBufferSize = kBufferSize}).has_value());
+
+        const SteadyState result   = runSteadyState(std::move(flowGraph), ps, 500ms, 500ms);
+        const std::size_t ringSize = std::max(ps.out[0].bufferSize(), ps.digitalOut.bufferSize() / nCaptures);
+        std::println("rapid block burst: {} bursts published within the window, ring of {} slots, {} allocations", result.published / (nCaptures * nSamples), ringSize, result.allocations);
+        expect(gt(result.publishedBefore / (nCaptures * nSamples), ringSize)) << "the warm-up has to pass every ring slot once";
+        expect(gt(result.published, 0UZ));
+        expect(eq(result.burstAllocations, 0UZ));
+        expect(eq(result.allocations, 0UZ));
+    };
+};
+
+} // namespace fair::picoscope::test
+
+int main() { /* tests are statically executed */ }
@@ -0,0 +1,388 @@
+#include "AllocationCounter.hpp"
+
+#include <boost/ut.hpp>
+
+#include <gnuradio-4.0/Block.hpp>
+#include <gnuradio-4.0/Graph.hpp>
+#include <gnuradio-4.0/Scheduler.hpp>
+
+#include <fair/picoscope/LatencyHistogram.hpp>
+#include <fair/picoscope/Picoscope.hpp>
+#include <fair/picoscope/PicoscopeSimulated.hpp>
+
+#include <bit>
+#include <charconv>
+#include <ctime>
+#include <format>
+#include <fstream>
+#include <map>
+#include <print>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Sustained throughput benchmark of the Picoscope block against simulated units with the channel layouts of the supported hardware series, no
+ * device needed. Runs a matrix of model, output type, sample rate (paced in real time, or unpaced: every poll delivers a full driver buffer) and
+ * RapidBlock `n_captures`, and reports per case as JSON:
+ *  - sustained samples/s (per channel) and process CPU time per sample
+ *  - samples dropped by the block (full output buffers) and by the driver (not polled in time)
+ *  - heap allocations in the measurement window
+ *  - p50/p99/p999 latency from the samples being available in the driver to their arrival at the first sink (paced cases only)
+ * The CPU time includes the signal generation of the simulated driver, compare the numbers against a baseline of the same tool rather than hardware.
+ *
+ * usage: qa_PicoscopeBenchmark [--duration <s>] [--filter <substring>] [--json <file>|-] [--baseline <file>] [--tolerance <f>] [--latency-tolerance <f>]
+ *
+ * With `--baseline` (a previous JSON report) the exit code is non-zero if a case regressed beyond the relative tolerances: throughput, CPU time,
+ * allocation rate and drop fraction by `--tolerance` (default 0.2), the p99 latency by `--latency-tolerance` (default 1.0).
+ */
+
+// Workaround for compile-time bottleneck in vir-simd, see qa_Picoscope.cc
+namespace vir::detail {
+template<>
+constexpr size_t struct_size<gr::DataSet<gr::UncertainValue<float>>, 0, sizeof(gr::DataSet<gr::UncertainValue<float>>) * CHAR_BIT, 8>() {
+    return 0UZ;
+}
+} // namespace vir::detail
+
+namespace fair::picoscope::test {
+
+// stand-ins with the channel layouts of the hardware series
+using Simulated3000a = BasicPicoscopeSimulated<4UZ, 16UZ>;
+using Simulated4000a = BasicPicoscopeSimulated<8UZ, 0UZ>;
+using Simulated5000a = BasicPicoscopeSimulated<4UZ, 16UZ>;
+using Simulated6000  = BasicPicoscopeSimulated<4UZ, 0UZ>;
+
+template<typename T>
+struct BenchmarkSink : gr::Block<BenchmarkSink<T>> {
+    gr::PortIn<T> in;
+
+    GR_MAKE_REFLECTABLE(BenchmarkSink, in);
+
+    std::size_t           _nReceived  = 0UZ;     // samples (Streaming) or DataSets (RapidBlock), read concurrently via std::atomic_ref
+    std::size_t           _nDropped   = 0UZ;     // sum of the `droppedSamples` tags, read concurrently via std::atomic_ref
+    LatencyHistogram*     _latency    = nullptr; // only set for the sink measuring the latency
+    SimulationStatistics* _statistics = nullptr;
+    double                _sampleRate = 0.0;
+
+    [[nodiscard]] std::size_t received() { return std::atomic_ref(_nReceived).load(std::memory_order_relaxed); }
+    [[nodiscard]] std::size_t dropped() { return std::atomic_ref(_nDropped).load(std::memory_order_relaxed); }
+
+    gr::work::Status processBulk(gr::InputSpanLike auto& inSpan) {
+        const auto now = std::chrono::steady_clock::now().time_since_epoch();
+        for (const auto& [relIndex, tagMap] : inSpan.tags()) {
+            if (const auto* dropped = tagMap.get().template get_if<std::size_t>("droppedSamples")) {
+                std::atomic_ref(_nDropped).store(_nDropped + *dropped, std::memory_order_relaxed);
+            }
+        }
+        const std::size_t n        = inSpan.size();
+        const std::size_t received = _nReceived;
+        if (_latency != nullptr && n > 0UZ) {
+            if constexpr (gr::DataSetLike<T>) { // the captures were complete when the driver reported the block as ready
+                const std::chrono::nanoseconds ready{_statistics->blockReady.load(std::memory_order_relaxed)};
+                for (std::size_t i = 0UZ; i < n; ++i) {
+                    _latency->record(now - ready);
+                }
+            } else { // the last received sample was generated at streamStart + (index + 1) / fs
+                const std::size_t              index = received + n - 1UZ + _nDropped + _statistics->droppedSamples.load(std::memory_order_relaxed);
+                const std::chrono::nanoseconds available{_statistics->streamStart.load(std::memory_order_relaxed) + static_cast<std::int64_t>(1e9 * static_cast<double>(index + 1UZ) / _sampleRate)};
+                _latency->record(now - available);
+            }
+        }
+        std::atomic_ref(_nReceived).store(received + n, std::memory_order_relaxed);
+        std::ignore = inSpan.consume(n);
+        return gr::work::Status::OK;
+    }
+};
+
+struct BenchmarkCase {
+    std::string name;
+    std::string model;
+    std::string type;
+    std::string mode;
+    float       sampleRate = 1'000'000.f;
+    bool        paced      = true;
+    gr::Size_t  nCaptures  = 0; // RapidBlock only
+};
+
+struct BenchmarkResult {
+    BenchmarkCase benchmark;
+    double        samplesPerSecond     = 0.0;
+    double        cpuNsPerSample       = 0.0;
+    std::size_t   droppedSamples       = 0UZ;
+    std::size_t   driverDroppedSamples = 0UZ;
+    double        dropFraction         = 0.0;
+    std::size_t   allocations          = 0UZ;
+    double        allocationsPerSecond = 0.0;
+    std::uint64_t latencyP50           = 0UZ; // [ns]
+    std::uint64_t latencyP99           = 0UZ; // [ns]
+    std::uint64_t latencyP999          = 0UZ; // [ns]
+};
+
+struct Options {
+    double                     duration         = 1.0; // [s] measurement window per case, after a warm-up of 20%
+    std::string                filter;
+    std::string                jsonPath = "-";
+    std::optional<std::string> baselinePath;
+    double                     tolerance        = 0.2;
+    double                     latencyTolerance = 1.0;
+};
+
+constexpr gr::Size_t kPreSamples  = 1000;
+constexpr gr::Size_t kPostSamples = 9000;
+
+[[nodiscard]] inline std::int64_t processCpuTimeNs() {
+    timespec ts{};
+    ::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return static_cast<std::int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+template<typename TPSImpl, typename T>
+BenchmarkResult runCase(const BenchmarkCase& benchmark, const Options& options) {
+    using namespace boost::ut;
+    using namespace gr;
+    using TDigital = std::conditional_t<DataSetLike<T>, DataSet<std::uint16_t>, std::uint16_t>;
+
+    const std::string serial = "BENCH-" + benchmark.name;
+    SimulationConfig  config;
+    config.realtime         = benchmark.paced;
+    config.triggerFrequency = 1000.f; // RapidBlock: one capture per ms
+    TPSImpl::setSimulation(serial, config);
+    SimulationStatistics& statistics = TPSImpl::statistics(serial);
+    statistics.droppedSamples.store(0UZ);
+
+    std::vector<std::string> channelIds;
+    for (std::size_t i = 0UZ; i < TPSImpl::N_ANALOG_CHANNELS; ++i) {
+        channelIds.emplace_back(toChannelString(static_cast<ChannelName>(i)));
+    }
+    property_map settings = {
+        {"serial_number", serial},
+        {"sample_rate", benchmark.sampleRate},
+        {"auto_arm", true},
+        {"channel_ids", channelIds},
+        {"channel_ranges", std::vector<float>(channelIds.size(), 5.f)},
+        {"channel_couplings", std::vector<std::string>(channelIds.size(), "DC")},
+        {"digital_port_enable", TPSImpl::N_DIGITAL_CHANNELS > 0UZ},
+    };
+    if constexpr (DataSetLike<T>) {
+        settings.insert_or_assign("pre_samples", kPreSamples);
+        settings.insert_or_assign("post_samples", kPostSamples);
+        settings.insert_or_assign("n_captures", benchmark.nCaptures);
+        settings.insert_or_assign("trigger_once", false);
+    }
+
+    Graph             flowGraph;
+    auto&             ps = flowGraph.emplaceBlock<Picoscope<T, TPSImpl>>(settings);
+    const std::size_t minBufferSize = DataSetLike<T> ? 64UZ : std::bit_ceil(static_cast<std::size_t>(benchmark.sampleRate / 50.f)); // 20 ms
+    const EdgeParameters edge{.minBufferSize = std::max(minBufferSize, 65536UZ)};
+
+    std::array<BenchmarkSink<T>*, TPSImpl::N_ANALOG_CHANNELS> sinks{};
+    for (auto& sink : sinks) {
+        sink = &flowGraph.emplaceBlock<BenchmarkSink<T>>(property_map{});
+    }
+    expect(flowGraph.connect<"out#0", "in">(ps, *sinks[0], edge).has_value());
+    expect(flowGraph.connect<"out#1", "in">(ps, *sinks[1], edge).has_value());
+    expect(flowGraph.connect<"out#2", "in">(ps, *sinks[2], edge).has_value());
+    expect(flowGraph.connect<"out#3", "in">(ps, *sinks[3], edge).has_value());
+    if constexpr (TPSImpl::N_ANALOG_CHANNELS > 4UZ) {
+        expect(flowGraph.connect<"out#4", "in">(ps, *sinks[4], edge).has_value());
+        expect(flowGraph.connect<"out#5", "in">(ps, *sinks[5], edge).has_value());
+        expect(flowGraph.connect<"out#6", "in">(ps, *sinks[6], edge).has_value());
+        expect(flowGraph.connect<"out#7", "in">(ps, *sinks[7], edge).has_value());
+    }
+    auto& sinkDigital = flowGraph.emplaceBlock<BenchmarkSink<TDigital>>(property_map{});
+    expect(flowGraph.connect<"digitalOut", "in">(ps, sinkDigital, edge).has_value());
+
+    LatencyHistogram latency;
+    sinks[0]->_statistics = &statistics;
+    sinks[0]->_sampleRate = static_cast<double>(benchmark.sampleRate);
+    sinks[0]->_latency    = benchmark.paced ? &latency : nullptr;
+
+    scheduler::Simple<scheduler::ExecutionPolicy::multiThreaded> sched{};
+    std::ignore = sched.exchange(std::move(flowGraph));
+    expect(sched.changeStateTo(lifecycle::State::INITIALISED).has_value());
+    expect(sched.changeStateTo(lifecycle::State::RUNNING).has_value());
+    std::this_thread::sleep_for(std::chrono::duration<double>(0.2 * options.duration)); // warm-up: settings, arming, buffer first touch
+
+    latency.reset();
+    const std::size_t receivedStart      = sinks[0]->received();
+    const std::size_t droppedStart       = sinks[0]->dropped();
+    const std::size_t driverDroppedStart = statistics.droppedSamples.load();
+    const std::size_t allocationsStart   = allocationCount();
+    const std::int64_t cpuStart          = processCpuTimeNs();
+    const auto         start             = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.duration));
+    const double       elapsed       = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const std::int64_t cpu           = processCpuTimeNs() - cpuStart;
+    const std::size_t  allocations   = allocationCount() - allocationsStart;
+    const std::size_t  dropped       = sinks[0]->dropped() - droppedStart;
+    const std::size_t  driverDropped = statistics.droppedSamples.load() - driverDroppedStart;
+    const std::size_t  received      = sinks[0]->received() - receivedStart;
+    expect(sched.changeStateTo(lifecycle::State::REQUESTED_STOP).has_value());
+
+    const std::size_t nSamples = DataSetLike<T> ? received * static_cast<std::size_t>(kPreSamples + kPostSamples) : received;
+    BenchmarkResult   result{.benchmark = benchmark};
+    result.samplesPerSecond     = static_cast<double>(nSamples) / elapsed;
+    result.cpuNsPerSample       = nSamples > 0UZ ? static_cast<double>(cpu) / static_cast<double>(nSamples) : 0.0;
+    result.droppedSamples       = dropped;
+    result.driverDroppedSamples = driverDropped;
+    result.dropFraction         = static_cast<double>(dropped + driverDropped) / std::max(1.0, static_cast<double>(nSamples + dropped + driverDropped));
+    result.allocations          = allocations;
+    result.allocationsPerSecond = static_cast<double>(allocations) / elapsed;
+    result.latencyP50           = latency.percentile(0.5);
+    result.latencyP99           = latency.percentile(0.99);
+    result.latencyP999          = latency.percentile(0.999);
+    return result;
+}
+
+std::string toJson(const std::vector<BenchmarkResult>& results) {
+    std::string json = "{\n  \"benchmarks\": [\n";
+    for (const auto& [i, r] : std::views::enumerate(results)) {
+        const auto& b = r.benchmark;
+        json += std::format("    {{\"name\": \"{}\", \"model\": \"{}\", \"type\": \"{}\", \"mode\": \"{}\", \"sample_rate\": {}, \"paced\": {}, \"n_captures\": {}, "
+                            "\"samples_per_second\": {:.1f}, \"cpu_ns_per_sample\": {:.4f}, \"dropped_samples\": {}, \"driver_dropped_samples\": {}, \"drop_fraction\": {:.6f}, "
+                            "\"allocations\": {}, \"allocations_per_second\": {:.1f}, \"latency_p50_ns\": {}, \"latency_p99_ns\": {}, \"latency_p999_ns\": {}}}{}\n",
+            b.name, b.model, b.type, b.mode, b.sampleRate, b.paced, b.nCaptures, r.samplesPerSecond, r.cpuNsPerSample, r.droppedSamples, r.driverDroppedSamples, r.dropFraction, //
+            r.allocations, r.allocationsPerSecond, r.latencyP50, r.latencyP99, r.latencyP999, i + 1 < static_cast<std::ptrdiff_t>(results.size()) ? "," : "");
+    }
+    json += "  ]\n}\n";
+    return json;
+}
+
+// reads the numeric fields of the flat per-case objects of a previous report, keyed by case name
+std::map<std::string, std::map<std::string, double>> loadBaseline(const std::string& path) {
+    std::ifstream stream(path);
+    if (!stream) {
+        throw std::runtime_error(std::format("cannot open baseline {}", path));
+    }
+    std::stringstream buffer;
+    buffer << stream.rdbuf();
+    const std::string                                     text = buffer.str();
+    std::map<std::string, std::map<std::string, double>> baseline;
+    const std::regex                                      object(R"(\{[^{}]*\})");
+    const std::regex                                      field(R"re("(\w+)"\s*:\s*("([^"]*)"|[-+0-9.eE]+))re");
+    for (auto it = std::sregex_iterator(text.begin(), text.end(), object); it != std::sregex_iterator(); ++it) {
+        const std::string                 entry = it->str();
+        std::string                       name;
+        std::map<std::string, double>     values;
+        for (auto f = std::sregex_iterator(entry.begin(), entry.end(), field); f != std::sregex_iterator(); ++f) {
+            if ((*f)[1] == "name") {
+                name = (*f)[3];
+            } else if ((*f)[3].length() == 0 && (*f)[2].str().front() != '"') {
+                values[(*f)[1]] = std::stod((*f)[2]);
+            }
+        }
+        if (!name.empty()) {
+            baseline.insert_or_assign(name, std::move(values));
+        }
+    }
+    return baseline;
+}
+
+// prints and counts the regressions against the baseline, cases missing in the baseline are skipped
+std::size_t compareToBaseline(const std::vector<BenchmarkResult>& results, const std::map<std::string, std::map<std::string, double>>& baseline, const Options& options) {
+    std::size_t regressions = 0UZ;
+    auto        check       = [&](const std::string& name, std::string_view metric, double value, double reference, double limit, bool higherIsBetter) {
+        if (higherIsBetter ? value < limit : value > limit) {
+            std::println(stderr, "REGRESSION {}: {} = {:.4g}, baseline {:.4g}, limit {:.4g}", name, metric, value, reference, limit);
+            ++regressions;
+        }
+    };
+    for (const auto& r : results) {
+        const auto it = baseline.find(r.benchmark.name);
+        if (it == baseline.end()) {
+            std::println("{}: not in baseline", r.benchmark.name);
+            continue;
+        }
+        const auto value = [&](const char* key) { return it->second.contains(key) ? it->second.at(key) : 0.0; };
+        const auto& name  = r.benchmark.name;
+        check(name, "samples_per_second", r.samplesPerSecond, value("samples_per_second"), value("samples_per_second") * (1.0 - options.tolerance), true);
+        check(name, "cpu_ns_per_sample", r.cpuNsPerSample, value("cpu_ns_per_sample"), value("cpu_ns_per_sample") * (1.0 + options.tolerance), false);
+        check(name, "allocations_per_second", r.allocationsPerSecond, value("allocations_per_second"), value("allocations_per_second") * (1.0 + options.tolerance) + 1.0, false);
+        check(name, "drop_fraction", r.dropFraction, value("drop_fraction"), value("drop_fraction") * (1.0 + options.tolerance) + 1e-4, false);
+        if (r.benchmark.paced) {
+            check(name, "latency_p99_ns", static_cast<double>(r.latencyP99), value("latency_p99_ns"), value("latency_p99_ns") * (1.0 + options.latencyTolerance), false);
+        }
+    }
+    return regressions;
+}
+
+std::optional<Options> parseOptions(std::span<char*> args) {
+    Options options;
+    for (std::size_t i = 1UZ; i < args.size(); ++i) {
+        const std::string_view arg = args[i];
+        if (i + 1UZ >= args.size()) {
+            std::println(stderr, "missing value for {}", arg);
+            return std::nullopt;
+        }
+        const std::string_view value = args[++i];
+        if (arg == "--duration") {
+            options.duration = std::stod(std::string(value));
+        } else if (arg == "--filter") {
+            options.filter = value;
+        } else if (arg == "--json") {
+            options.jsonPath = value;
+        } else if (arg == "--baseline") {
+            options.baselinePath = std::string(value);
+        } else if (arg == "--tolerance") {
+            options.tolerance = std::stod(std::string(value));
+        } else if (arg == "--latency-tolerance") {
+            options.latencyTolerance = std::stod(std::string(value));
+        } else {
+            std::println(stderr, "unknown option {}", arg);
+            return std::nullopt;
+        }
+    }
+    return options;
+}
+
+} // namespace fair::picoscope::test
+
+int main(int argc, char* argv[]) {
+    using namespace fair::picoscope;
+    using namespace fair::picoscope::test;
+
+    const auto options = parseOptions(std::span(argv, static_cast<std::size_t>(argc)));
+    if (!options) {
+        std::println(stderr, "usage: {} [--duration <s>] [--filter <substring>] [--json <file>|-] [--baseline <file>] [--tolerance <f>] [--latency-tolerance <f>]", argv[0]);
+        return 2;
+    }
+
+    std::vector<BenchmarkResult> results;
+    auto run = [&]<typename TPSImpl, typename T>(BenchmarkCase benchmark) {
+        if (!benchmark.name.contains(options->filter)) {
+            return;
+        }
+        const auto& r = results.emplace_back(runCase<TPSImpl, T>(benchmark, *options));
+        std::println("{:<45} {:>12.0f} S/s {:>8.2f} ns/S  dropped {:>8} (driver {:>8})  allocs {:>8.1f}/s  latency p50/p99/p999 {:.3f}/{:.3f}/{:.3f} ms", r.benchmark.name, r.samplesPerSecond, r.cpuNsPerSample, //
+            r.droppedSamples, r.driverDroppedSamples, r.allocationsPerSecond, 1e-6 * static_cast<double>(r.latencyP50), 1e-6 * static_cast<double>(r.latencyP99), 1e-6 * static_cast<double>(r.latencyP999));
+    };
+    auto runModel = [&]<typename TPSImpl>(std::string_view model) {
+        for (const auto& [rate, rateName, paced] : std::array{std::tuple{1'000'000.f, "1MSps", true}, std::tuple{10'000'000.f, "10MSps", true}, std::tuple{10'000'000.f, "unpaced", false}}) {
+            const auto streaming = [&](std::string_view type) { return BenchmarkCase{.name = std::format("streaming/{}/{}/{}", model, type, rateName), .model = std::string(model), .type = std::string(type), .mode = "streaming", .sampleRate = rate, .paced = paced}; };
+            run.template operator()<TPSImpl, float>(streaming("float"));
+            run.template operator()<TPSImpl, std::int16_t>(streaming("int16"));
+        }
+        for (const gr::Size_t nCaptures : {gr::Size_t{1}, gr::Size_t{16}}) {
+            run.template operator()<TPSImpl, gr::DataSet<float>>({.name = std::format("rapidblock/{}/DataSet<float>/{}captures", model, nCaptures), .model = std::string(model), .type = "DataSet<float>", .mode = "rapidblock", .sampleRate = 10'000'000.f, .paced = true, .nCaptures = nCaptures});
+        }
+    };
+    runModel.template operator()<Simulated3000a>("3000a");
+    runModel.template operator()<Simulated4000a>("4000a");
+    runModel.template operator()<Simulated5000a>("5000a");
+    runModel.template operator()<Simulated6000>("6000");
+
+    const std::string json = toJson(results);
+    if (options->jsonPath == "-") {
+        std::print("{}", json);
+    } else {
+        std::ofstream(options->jsonPath) << json;
+    }
+    if (options->baselinePath) {
+        const std::size_t regressions = compareToBaseline(results, loadBaseline(*options->baselinePath), *options);
+        std::println("{} regression(s) against {}", regressions, *options->baselinePath);
+        return regressions == 0UZ ? 0 : 1;
+    }
+    return 0;
+}
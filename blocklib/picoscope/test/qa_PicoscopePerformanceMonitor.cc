@@ -46,11 +46,19 @@ int main(int argc, char* argv[]) {
     using namespace gr::testing;
     using namespace fair::picoscope;
 
-    int runTime = 60; // in seconds
+    int         runTime     = 60; // in seconds
+    std::string cpuAffinity = ""; // e.g. isolated cores `2-3`, the acquisition thread is pinned to these
+    int         rtPriority  = 0;  // SCHED_FIFO priority of the acquisition thread
 
     if (argc >= 2) {
         runTime = std::atoi(argv[1]);
     }
+    if (argc >= 3) {
+        cpuAffinity = argv[2];
+    }
+    if (argc >= 4) {
+        rtPriority = std::atoi(argv[3]);
+    }
 
     using SampleType = float;
 
@@ -77,6 +85,8 @@ int main(int argc, char* argv[]) {
         {"auto_arm", true}, //
         {"channel_ids", channelIds},
         {"channel_ranges", channelRanges},
+        {"cpu_affinity", cpuAffinity},
+        {"rt_priority", rtPriority},
     }});
 
     auto& perfMonitorA = graph.emplaceBlock<PerformanceMonitor<SampleType>>({{"name", "Perf A"}, {"evaluate_perf_rate", evaluatePerfRate}, {"publish_rate", publishRate}});
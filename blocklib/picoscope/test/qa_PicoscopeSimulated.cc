@@ -0,0 +1,1125 @@
+#include <boost/ut.hpp>
+
+#include <gnuradio-4.0/Scheduler.hpp>
+#include <gnuradio-4.0/testing/TagMonitors.hpp>
+
+#include <fair/picoscope/Picoscope.hpp>
+#include <fair/picoscope/PicoscopeReplay.hpp>
+#include <fair/picoscope/PicoscopeSimulated.hpp>
+
+using namespace std::string_literals;
+using namespace std::string_view_literals;
+
+// Workaround for compile-time bottleneck in vir-simd, see qa_Picoscope.cc
+namespace vir::detail {
+template<>
+constexpr size_t struct_size<gr::DataSet<gr::UncertainValue<float>>, 0, sizeof(gr::DataSet<gr::UncertainValue<float>>) * CHAR_BIT, 8>() {
+    return 0UZ;
+}
+} // namespace vir::detail
+
+namespace fair::picoscope::test {
+
+template<typename T>
+using BulkTagSink = gr::testing::TagSink<T, gr::testing::ProcessFunction::USE_PROCESS_BULK>;
+
+constexpr std::size_t minPicoBufferSize = 65536UZ;
+
+// keeps a copy of every received item and sleeps after each one, so the output buffer of the upstream block runs full
+template<typename T>
+struct SlowSink : gr::Block<SlowSink<T>> {
+    gr::PortIn<T> in;
+
+    GR_MAKE_REFLECTABLE(SlowSink, in);
+
+    std::vector<T>            _received{};
+    std::chrono::milliseconds _delay{10};
+
+    gr::work::Status processBulk(gr::InputSpanLike auto& inSpan) {
+        if (inSpan.size() == 0UZ) {
+            std::ignore = inSpan.consume(0UZ);
+            return gr::work::Status::INSUFFICIENT_INPUT_ITEMS;
+        }
+        _received.push_back(inSpan[0]);
+        std::ignore = inSpan.consume(1UZ);
+        std::this_thread::sleep_for(_delay);
+        return gr::work::Status::OK;
+    }
+};
+
+// timing events for the rising edges of a digital line of the simulated unit
+struct SimulatedTiming {
+    SimulatedDigitalLine      line{};                     // as configured in the SimulationConfig, frequency 0: no timing events
+    std::chrono::milliseconds tagDelay{0};                // the tag arrives this long after its edge was acquired
+    std::string               triggerName = "CMD_TIMING"s;
+};
+
+// publishes one timing tag per rising edge of `_timing.line` of the simulated unit `_serial` (Streaming), like the timing receiver with LOCAL-TIME and
+// TRIGGER_TIME set to the system time at which the edge was acquired, so the matcher assigns each tag to its edge
+struct SimulatedTimingSource : gr::Block<SimulatedTimingSource> {
+    gr::PortOut<std::uint8_t> out;
+
+    GR_MAKE_REFLECTABLE(SimulatedTimingSource, out);
+
+    std::string     _serial{};
+    SimulatedTiming _timing{};
+    std::int64_t    _streamStart = 0;   // of the acquisition the edges are counted for
+    std::size_t     _nEdges      = 0UZ; // published so far
+
+    gr::work::Status processBulk(gr::OutputSpanLike auto& outSpan) {
+        const std::int64_t streamStart = PicoscopeSimulated::statistics(_serial).streamStart.load();
+        if (streamStart != _streamStart) { // the acquisition was (re)started
+            _streamStart = streamStart;
+            _nEdges      = 0UZ;
+        }
+        const auto  steadyNow = std::chrono::steady_clock::now();
+        const auto  systemNow = std::chrono::system_clock::now();
+        std::size_t nTags     = 0UZ;
+        while (streamStart != 0 && _timing.line.frequency > 0.f && nTags < outSpan.size()) {
+            const std::chrono::duration<double>         edgeTime{static_cast<double>(_timing.line.delay) + static_cast<double>(_nEdges) / static_cast<double>(_timing.line.frequency)};
+            const std::chrono::steady_clock::time_point edge = std::chrono::steady_clock::time_point{std::chrono::nanoseconds(streamStart)} + std::chrono::duration_cast<std::chrono::nanoseconds>(edgeTime);
+            if (edge + _timing.tagDelay > steadyNow) {
+                break;
+            }
+            const auto localTime = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>((systemNow - (steadyNow - edge)).time_since_epoch()).count());
+            outSpan[nTags]       = 0U;
+            outSpan.publishTag(
+                gr::property_map{
+                    {gr::tag::TRIGGER_NAME.shortKey(), _timing.triggerName},
+                    {gr::tag::TRIGGER_TIME.shortKey(), localTime},
+                    {gr::tag::TRIGGER_OFFSET.shortKey(), 0.f},
+                    {gr::tag::TRIGGER_META_INFO.shortKey(), gr::property_map{{"LOCAL-TIME", localTime}, {"HW-TRIGGER", true}}},
+                },
+                nTags);
+            ++nTags;
+            ++_nEdges;
+        }
+        outSpan.publish(nTags);
+        if (nTags == 0UZ) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return gr::work::Status::OK;
+    }
+};
+
+// a property request sent to the running block `at` after the start of the acquisition
+struct StreamingRequest {
+    std::chrono::milliseconds at{0};
+    gr::message::Command      command = gr::message::Command::Get;
+    std::string               endpoint{};
+    gr::property_map          data{};
+};
+
+struct StreamingResult {
+    std::size_t                             nSamples        = 0UZ;
+    std::size_t                             nDigitalSamples = 0UZ;
+    std::size_t                             nTags           = 0UZ;
+    std::uint64_t                           unknownEvents   = 0U;  // Health: trigger edges published as UNKNOWN_EVENT
+    double                                  rate            = 0.0; // measured samples per second
+    std::vector<float>                      samples{};             // first channel, only if logged
+    std::vector<gr::Tag>                    tags{};                // published on the first channel
+    std::vector<gr::Tag>                    secondTags{};          // published on the second channel
+    std::vector<gr::Tag>                    digitalTags{};         // published on digitalOut
+    std::vector<gr::property_map>           lateTags{};            // "LateTimingTag" messages: `index` and `tag`
+    std::vector<gr::DataSet<float>>         snapshots{};           // first channel, float outputs only
+    std::vector<gr::DataSet<float>>         spectra{};             // first channel
+    std::vector<std::optional<gr::Message>> replies{};             // one per StreamingRequest, empty if the block did not reply
+};
+
+template<typename T, typename TPSImpl = PicoscopeSimulated>
+StreamingResult runStreaming(std::string serial, float sampleRate, std::chrono::milliseconds duration, bool logSamples, const gr::property_map& extraSettings = {}, const SimulatedTiming& timing = {}, std::span<const StreamingRequest> requests = {}) {
+    using namespace boost::ut;
+    using namespace gr;
+
+    Graph        flowGraph;
+    property_map settings = {
+        {"serial_number", serial},
+        {"sample_rate", sampleRate},
+        {"auto_arm", true},
+        {"channel_ids", std::vector<std::string>{"A", "B"}},
+        {"channel_ranges", std::vector<float>{2.f, 5.f}},
+        {"channel_couplings", std::vector<std::string>{"DC", "DC"}},
+    };
+    for (const auto& [key, value] : extraSettings) {
+        settings.insert_or_assign(key, value);
+    }
+    auto& ps = flowGraph.emplaceBlock<Picoscope<T, TPSImpl>>(settings);
+
+    auto& tagMonitor = flowGraph.emplaceBlock<testing::TagMonitor<T, testing::ProcessFunction::USE_PROCESS_BULK>>({{"log_samples", false}, {"log_tags", true}});
+    auto& sinkA      = flowGraph.emplaceBlock<BulkTagSink<T>>({{"log_samples", logSamples}, {"log_tags", false}});
+    auto& sinkB      = flowGraph.emplaceBlock<BulkTagSink<T>>({{"log_samples", false}, {"log_tags", true}});
+    auto& sinkC      = flowGraph.emplaceBlock<BulkTagSink<T>>({{"log_samples", false}, {"log_tags", false}});
+    auto& sinkD      = flowGraph.emplaceBlock<BulkTagSink<T>>({{"log_samples", false}, {"log_tags", false}});
+
+    expect(flowGraph.connect<"out#0", "in">(ps, tagMonitor, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+    expect(flowGraph.connect<"out", "in">(tagMonitor, sinkA, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+    expect(flowGraph.connect<"out#1", "in">(ps, sinkB, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+    expect(flowGraph.connect<"out#2", "in">(ps, sinkC, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+    expect(flowGraph.connect<"out#3", "in">(ps, sinkD, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+    if constexpr (TPSImpl::N_ANALOG_CHANNELS > 4UZ) {
+        auto& sinkE = flowGraph.emplaceBlock<BulkTagSink<T>>({{"log_samples", false}, {"log_tags", false}});
+        auto& sinkF = flowGraph.emplaceBlock<BulkTagSink<T>>({{"log_samples", false}, {"log_tags", false}});
+        auto& sinkG = flowGraph.emplaceBlock<BulkTagSink<T>>({{"log_samples", false}, {"log_tags", false}});
+        auto& sinkH = flowGraph.emplaceBlock<BulkTagSink<T>>({{"log_samples", false}, {"log_tags", false}});
+        expect(flowGraph.connect<"out#4", "in">(ps, sinkE, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+        expect(flowGraph.connect<"out#5", "in">(ps, sinkF, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+        expect(flowGraph.connect<"out#6", "in">(ps, sinkG, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+        expect(flowGraph.connect<"out#7", "in">(ps, sinkH, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+    }
+
+    auto& sinkDigital = flowGraph.emplaceBlock<BulkTagSink<uint16_t>>({{"log_samples", false}, {"log_tags", true}});
+    expect(flowGraph.connect<"digitalOut", "in">(ps, sinkDigital, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+    if (timing.line.frequency > 0.f) {
+        auto& timingSource   = flowGraph.emplaceBlock<SimulatedTimingSource>();
+        timingSource._serial = serial;
+        timingSource._timing = timing;
+        expect(flowGraph.connect<"out", "timingIn">(timingSource, ps).has_value());
+    }
+    auto& snapshotSink = flowGraph.emplaceBlock<BulkTagSink<DataSet<T>>>({{"log_samples", true}, {"log_tags", false}});
+    expect(flowGraph.connect<"snapshotOut#0", "in">(ps, snapshotSink).has_value());
+    auto& spectrumSink = flowGraph.emplaceBlock<BulkTagSink<DataSet<float>>>({{"log_samples", true}, {"log_tags", false}});
+    expect(flowGraph.connect<"spectrumOut#0", "in">(ps, spectrumSink).has_value());
+    MsgPortIn  fromPicoscope;
+    MsgPortOut toPicoscope;
+    expect(ps.msgOut.connect(fromPicoscope).has_value());
+    expect(toPicoscope.connect(ps.msgIn).has_value());
+
+    scheduler::Simple<scheduler::ExecutionPolicy::multiThreaded> sched{};
+    std::ignore = sched.exchange(std::move(flowGraph));
+    expect(sched.changeStateTo(lifecycle::State::INITIALISED).has_value());
+    expect(sched.changeStateTo(lifecycle::State::RUNNING).has_value());
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& [requestIdx, request] : std::views::zip(std::views::iota(0UZ), requests)) {
+        std::this_thread::sleep_until(start + request.at);
+        if (request.command == message::Command::Set) {
+            sendMessage<message::Command::Set>(toPicoscope, ps.unique_name, request.endpoint, request.data, std::to_string(requestIdx));
+        } else {
+            sendMessage<message::Command::Get>(toPicoscope, ps.unique_name, request.endpoint, request.data, std::to_string(requestIdx));
+        }
+    }
+    std::this_thread::sleep_until(start + duration);
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    expect(sched.changeStateTo(lifecycle::State::REQUESTED_STOP).has_value());
+
+    StreamingResult result{.nSamples = sinkA._nSamplesProduced, .nDigitalSamples = sinkDigital._nSamplesProduced, .nTags = tagMonitor._tags.size(), .rate = static_cast<double>(sinkA._nSamplesProduced) / elapsed, .tags = tagMonitor._tags};
+    if (const std::optional<Message> health = ps.propertyCallbackHealth(Picoscope<T, TPSImpl>::kHealthProperty, Message{}); health && health->data) {
+        if (const auto unknownEvents = health->data->get_if<std::uint64_t>("unknown_events")) {
+            result.unknownEvents = *unknownEvents;
+        }
+    }
+    auto&      messageReader = fromPicoscope.streamReader();
+    const auto messages      = messageReader.get<SpanReleasePolicy::ProcessAll>(messageReader.available());
+    result.replies.resize(requests.size());
+    for (const Message& message : messages) {
+        if (message.endpoint == "LateTimingTag" && message.data) {
+            result.lateTags.push_back(*message.data);
+        }
+        for (const auto& [requestIdx, request] : std::views::zip(std::views::iota(0UZ), requests)) {
+            if (message.endpoint == request.endpoint && message.clientRequestID == std::to_string(requestIdx)) {
+                result.replies[requestIdx] = message;
+            }
+        }
+    }
+    if constexpr (std::is_same_v<T, float>) {
+        result.snapshots = snapshotSink._samples;
+    }
+    result.spectra     = spectrumSink._samples;
+    result.secondTags  = sinkB._tags;
+    result.digitalTags = sinkDigital._tags;
+    if (logSamples) {
+        result.samples.reserve(sinkA._samples.size());
+        std::ranges::transform(sinkA._samples, std::back_inserter(result.samples), [](const T& value) { return static_cast<float>(value); });
+    }
+    std::println("{} - {}: {} samples, {} digital samples, {} tags, measured rate: {:.0f} S/s ({:.2f}% of {} S/s)", serial, gr::meta::type_name<T>(), result.nSamples, result.nDigitalSamples, result.nTags, result.rate, 100. * result.rate / static_cast<double>(sampleRate), sampleRate);
+    return result;
+}
+
+struct RapidBlockResult {
+    std::array<std::vector<gr::DataSet<float>>, 2UZ> outputs{}; // DataSets received on out#0 and out#1
+    std::optional<gr::Message>                       health{};  // Health property reply after the acquisition
+};
+
+// a single RapidBlock acquisition (`trigger_once`) of the simulated unit `serial`, 1 kS/s on channel A with 100 pre- and 900 post-trigger samples unless overridden
+RapidBlockResult runRapidBlock(std::string serial, const gr::property_map& extraSettings = {}) {
+    using namespace boost::ut;
+    using namespace gr;
+    using TPicoscope = Picoscope<DataSet<float>, PicoscopeSimulated>;
+
+    Graph        flowGraph;
+    property_map settings = {
+        {"serial_number", serial},
+        {"sample_rate", 1'000'000.f},
+        {"pre_samples", gr::Size_t{100}},
+        {"post_samples", gr::Size_t{900}},
+        {"n_captures", gr::Size_t{1}},
+        {"auto_arm", true},
+        {"trigger_once", true},
+        {"channel_ids", std::vector<std::string>{"A"}},
+        {"channel_ranges", std::vector<float>{2.f}},
+        {"trigger_threshold", 0.0f},
+        {"channel_couplings", std::vector<std::string>{"DC"}},
+    };
+    for (const auto& [key, value] : extraSettings) {
+        settings.insert_or_assign(key, value);
+    }
+    auto& ps          = flowGraph.emplaceBlock<TPicoscope>(settings);
+    auto& sinkA       = flowGraph.emplaceBlock<BulkTagSink<DataSet<float>>>({{"log_samples", true}, {"log_tags", false}});
+    auto& sinkB       = flowGraph.emplaceBlock<BulkTagSink<DataSet<float>>>({{"log_samples", true}, {"log_tags", false}});
+    auto& sinkC       = flowGraph.emplaceBlock<BulkTagSink<DataSet<float>>>({{"log_samples", false}, {"log_tags", false}});
+    auto& sinkD       = flowGraph.emplaceBlock<BulkTagSink<DataSet<float>>>({{"log_samples", false}, {"log_tags", false}});
+    auto& sinkDigital = flowGraph.emplaceBlock<BulkTagSink<DataSet<uint16_t>>>({{"log_samples", false}, {"log_tags", false}});
+    expect(flowGraph.connect<"out#0", "in">(ps, sinkA).has_value());
+    expect(flowGraph.connect<"out#1", "in">(ps, sinkB).has_value());
+    expect(flowGraph.connect<"out#2", "in">(ps, sinkC).has_value());
+    expect(flowGraph.connect<"out#3", "in">(ps, sinkD).has_value());
+    expect(flowGraph.connect<"digitalOut", "in">(ps, sinkDigital).has_value());
+
+    scheduler::Simple sched{};
+    std::ignore = sched.exchange(std::move(flowGraph));
+    expect(sched.runAndWait().has_value());
+    return {.outputs = {sinkA._samples, sinkB._samples}, .health = ps.propertyCallbackHealth(TPicoscope::kHealthProperty, Message{})};
+}
+
+const boost::ut::suite PicoscopeSimulatedTests = [] {
+    using namespace boost::ut;
+    using namespace gr;
+    using namespace std::chrono_literals;
+
+    "simulated driver streaming"_test = [] {
+        SimulationConfig config;
+        config.channels[1].amplitude = 7.f; // exceeds the ±5 V range
+        config.digital[3].frequency  = 1000.f;
+        config.digital[3].duty       = 0.5f;
+        PicoscopeSimulated::setSimulation("SIM-DRIVER", config);
+
+        PicoscopeSimulated sim;
+        expect(eq(sim.openUnit("SIM-DRIVER"), PICO_OK));
+        std::array<std::vector<int16_t>, 4> buffers;
+        for (auto& buffer : buffers) {
+            buffer.resize(10000UZ);
+        }
+        expect(eq(sim.setChannel(PicoscopeSimulated::CHANNEL_A, 1, PicoscopeSimulated::DC, AnalogChannelRange::ps2V, 0.f), PICO_OK));
+        expect(eq(sim.setChannel(PicoscopeSimulated::CHANNEL_B, 1, PicoscopeSimulated::DC, AnalogChannelRange::ps5V, 0.f), PICO_OK));
+        expect(eq(sim.setDigitalPorts(), PICO_OK));
+        expect(eq(sim.setDataBuffer(PicoscopeSimulated::CHANNEL_A, buffers[0].data(), 10000, PicoscopeSimulated::ratioNone), PICO_OK));
+        expect(eq(sim.setDataBuffer(PicoscopeSimulated::CHANNEL_B, buffers[1].data(), 10000, PicoscopeSimulated::ratioNone), PICO_OK));
+        expect(eq(sim.setDataBuffer(PicoscopeSimulated::DIGITAL_PORT0, buffers[2].data(), 10000, PicoscopeSimulated::ratioNone), PICO_OK));
+        expect(eq(sim.setDataBuffer(PicoscopeSimulated::DIGITAL_PORT1, buffers[3].data(), 10000, PicoscopeSimulated::ratioNone), PICO_OK));
+
+        uint32_t interval = 10U; // 100 kS/s
+        expect(eq(sim.runStreaming(&interval, TimeUnits::us, 0U, 0U, 0, 1U, PicoscopeSimulated::ratioNone, 10000U), PICO_OK));
+        struct Received {
+            std::size_t nSamples = 0UZ;
+            int16_t     overflow = 0;
+        } received;
+        const auto callback = [](int16_t, PicoscopeSimulated::NSamplesType n, uint32_t, int16_t overflow, uint32_t, int16_t, int16_t, void* param) {
+            auto& r = *static_cast<Received*>(param);
+            r.nSamples += static_cast<std::size_t>(n);
+            r.overflow |= overflow;
+        };
+        const auto start = std::chrono::steady_clock::now();
+        while (std::chrono::steady_clock::now() - start < 200ms) {
+            std::this_thread::sleep_for(5ms);
+            expect(eq(sim.getStreamingLatestValues(callback, &received), PICO_OK));
+        }
+        expect(ge(received.nSamples, 15000UZ) && le(received.nSamples, 25000UZ)) << "real time paced";
+        expect(eq(received.overflow, int16_t{0b10})) << "only channel B is over-range";
+        expect(approx(static_cast<float>(std::ranges::max(buffers[0])) * 2.f / 32767.f, 1.f, 0.01f)) << "1 V sine";
+        const auto nHigh = std::ranges::count_if(buffers[2], [](int16_t bits) { return (bits & 0b1000) != 0; });
+        expect(approx(static_cast<double>(nHigh) / 10000., 0.5, 0.02)) << "digital line 3 toggles with 50% duty cycle";
+        expect(eq(sim.driverStop(), PICO_OK));
+        expect(eq(sim.closeUnit(), PICO_OK));
+    };
+
+    "streaming"_test = []<typename T> {
+        constexpr float       sampleRate    = 100'000.f;
+        SimulationStatistics& statistics    = PicoscopeSimulated::statistics("SIM-STREAMING");
+        const std::size_t     droppedBefore = statistics.droppedSamples.load();
+        const auto            result        = runStreaming<T>("SIM-STREAMING", sampleRate, 2s, std::is_same_v<T, float>);
+
+        // bounds from the simulated clock instead of the wall-clock rate, which depends on how long the test thread sleeps
+        const std::chrono::steady_clock::time_point streamStart{std::chrono::nanoseconds(statistics.streamStart.load())};
+        const double                                generated = std::chrono::duration<double>(std::chrono::steady_clock::now() - streamStart).count() * static_cast<double>(sampleRate);
+        const auto                                  delivered = static_cast<double>(result.nSamples + statistics.droppedSamples.load() - droppedBefore);
+        expect(le(delivered, generated)) << "no samples ahead of the simulated clock";
+        expect(ge(delivered, 0.5 * generated)) << "sanity bound: the block keeps up with the simulated clock";
+        expect(le(result.nSamples, result.nDigitalSamples));
+        expect(ge(result.nTags, 1UZ));
+        if constexpr (std::is_same_v<T, float>) {
+            expect(approx(std::ranges::max(result.samples), 1.f, 0.01f)) << "1 V sine on channel A";
+            expect(approx(std::ranges::min(result.samples), -1.f, 0.01f));
+        }
+    } | std::tuple<float, int16_t>{};
+
+    "streaming throughput"_test = [] {
+        SimulationConfig config;
+        config.realtime = false; // every poll delivers a full driver buffer, measures the block and not the acquisition
+        PicoscopeSimulated::setSimulation("SIM-THROUGHPUT", config);
+        const auto result = runStreaming<float>("SIM-THROUGHPUT", 10'000'000.f, 2s, false);
+        expect(gt(result.nSamples, 0UZ));
+        std::println("streaming throughput: {:.1f} MS/s per channel", result.rate * 1e-6);
+    };
+
+    "restart keeps the unit and the driver buffer"_test = [] {
+        SimulationStatistics& statistics = PicoscopeSimulated::statistics("SIM-RESTART");
+
+        Graph flowGraph;
+        auto& ps = flowGraph.emplaceBlock<Picoscope<float, PicoscopeSimulated>>({
+            {"serial_number", "SIM-RESTART"s},
+            {"sample_rate", 100'000.f},
+            {"auto_arm", true},
+            {"channel_ids", std::vector<std::string>{"A"}},
+            {"channel_ranges", std::vector<float>{2.f}},
+            {"channel_couplings", std::vector<std::string>{"DC"}},
+        });
+        auto& sinkA       = flowGraph.emplaceBlock<BulkTagSink<float>>({{"log_samples", false}, {"log_tags", false}});
+        auto& sinkB       = flowGraph.emplaceBlock<BulkTagSink<float>>({{"log_samples", false}, {"log_tags", false}});
+        auto& sinkC       = flowGraph.emplaceBlock<BulkTagSink<float>>({{"log_samples", false}, {"log_tags", false}});
+        auto& sinkD       = flowGraph.emplaceBlock<BulkTagSink<float>>({{"log_samples", false}, {"log_tags", false}});
+        auto& sinkDigital = flowGraph.emplaceBlock<BulkTagSink<uint16_t>>({{"log_samples", false}, {"log_tags", false}});
+        expect(flowGraph.connect<"out#0", "in">(ps, sinkA, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+        expect(flowGraph.connect<"out#1", "in">(ps, sinkB, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+        expect(flowGraph.connect<"out#2", "in">(ps, sinkC, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+        expect(flowGraph.connect<"out#3", "in">(ps, sinkD, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+        expect(flowGraph.connect<"digitalOut", "in">(ps, sinkDigital, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+
+        scheduler::Simple<scheduler::ExecutionPolicy::multiThreaded> sched{};
+        std::ignore          = sched.exchange(std::move(flowGraph));
+        const auto runAndStop = [&sched] {
+            expect(sched.changeStateTo(lifecycle::State::RUNNING).has_value());
+            std::this_thread::sleep_for(200ms);
+            expect(sched.changeStateTo(lifecycle::State::REQUESTED_STOP).has_value());
+            for (std::size_t i = 0UZ; i < 1000UZ && sched.state() != lifecycle::State::STOPPED; ++i) {
+                std::this_thread::sleep_for(1ms);
+            }
+            expect(sched.state() == lifecycle::State::STOPPED) << fatal;
+        };
+        expect(sched.changeStateTo(lifecycle::State::INITIALISED).has_value());
+        runAndStop();
+        const std::size_t    firstRun     = sinkA._nSamplesProduced;
+        const std::uintptr_t driverBuffer = statistics.streamingBuffer.load();
+        expect(gt(firstRun, 0UZ));
+        expect(neq(driverBuffer, std::uintptr_t{0}));
+
+        expect(sched.changeStateTo(lifecycle::State::INITIALISED).has_value());
+        runAndStop();
+        expect(gt(sinkA._nSamplesProduced, firstRun)) << "the acquisition restarts";
+        expect(eq(statistics.unitsOpened.load(), 1UZ)) << "the unit stays open while stopped";
+        expect(eq(statistics.streamingBuffer.load(), driverBuffer)) << "the driver buffer is re-registered, not re-allocated";
+    };
+
+    "streaming decimation with odd chunks"_test = [] { // chunks are no multiple of the decimation factor, the remainder carries over to the next chunk
+        constexpr float       sampleRate  = 500'000.f;
+        constexpr std::size_t kDecimation = 4UZ;
+        SimulationConfig      config;
+        config.chunkSamples          = 1001UZ;
+        config.channels[0].frequency = 1234.f;
+        PicoscopeSimulated::setSimulation("SIM-DECIMATION", config);
+        const auto result = runStreaming<std::int16_t>("SIM-DECIMATION", sampleRate, 300ms, true, {{"decimation", static_cast<gr::Size_t>(kDecimation)}});
+        expect(eq(PicoscopeSimulated::statistics("SIM-DECIMATION").droppedSamples.load(), 0UZ) >> fatal) << "the raw stream has to be contiguous for the comparison";
+        expect(gt(result.nSamples, 0UZ) >> fatal);
+
+        // single-shot reference: the same signal acquired as one chunk and decimated in one go
+        config.realtime     = false;
+        config.chunkSamples = 0UZ;
+        PicoscopeSimulated::setSimulation("SIM-DECIMATION-REFERENCE", config);
+        const std::size_t         nRaw = result.nSamples * kDecimation;
+        std::vector<std::int16_t> raw(nRaw);
+        PicoscopeSimulated        sim;
+        expect(eq(sim.openUnit("SIM-DECIMATION-REFERENCE"), PICO_OK));
+        expect(eq(sim.setChannel(PicoscopeSimulated::CHANNEL_A, 1, PicoscopeSimulated::DC, AnalogChannelRange::ps2V, 0.f), PICO_OK));
+        expect(eq(sim.setDataBuffer(PicoscopeSimulated::CHANNEL_A, raw.data(), static_cast<int32_t>(nRaw), PicoscopeSimulated::ratioNone), PICO_OK));
+        uint32_t interval = 2U; // 500 kS/s
+        expect(eq(sim.runStreaming(&interval, TimeUnits::us, 0U, 0U, 0, 1U, PicoscopeSimulated::ratioNone, static_cast<uint32_t>(nRaw)), PICO_OK));
+        std::size_t received = 0UZ;
+        expect(eq(sim.getStreamingLatestValues([](int16_t, PicoscopeSimulated::NSamplesType n, uint32_t, int16_t, uint32_t, int16_t, int16_t, void* param) { *static_cast<std::size_t*>(param) = static_cast<std::size_t>(n); }, &received), PICO_OK));
+        expect(eq(received, nRaw) >> fatal);
+        expect(eq(sim.driverStop(), PICO_OK));
+        expect(eq(sim.closeUnit(), PICO_OK));
+
+        kernel::DecimatingFir fir;
+        fir.configure(kDecimation, {}, 1.f, 0.f);
+        std::vector<float> reference(fir.outputCount(nRaw));
+        std::ignore = fir.process(raw, reference);
+        std::size_t firstMismatch = 0UZ;
+        while (firstMismatch < result.nSamples && result.samples[firstMismatch] == std::clamp(std::round(reference[firstMismatch]), -32768.f, 32767.f)) {
+            ++firstMismatch;
+        }
+        expect(eq(firstMismatch, result.nSamples)) << "every output sample at the position of the single-shot decimation, i.e. no raw sample lost between the chunks";
+    };
+
+    "streaming decimation with a digital trigger"_test = [] { // trigger pulses shorter than the decimation factor
+        constexpr float  sampleRate = 100'000.f;
+        SimulationConfig config;
+        config.digital[3].frequency = 100.f;
+        config.digital[3].duty      = 0.0015f;   // a single raw sample is high
+        config.digital[3].delay     = 0.000035f; // at raw sample 4 + k * 1000, never at the raw sample coinciding with a decimated one
+        PicoscopeSimulated::setSimulation("SIM-DECIMATION-DIGITAL", config);
+        const auto result  = runStreaming<float>("SIM-DECIMATION-DIGITAL", sampleRate, 1s, false, {{"decimation", gr::Size_t{10}}, {"trigger_source", "DI3"s}, {"matcher_timeout", gr::Size_t{1'000'000}}});
+        const auto nPulses = static_cast<double>(result.nSamples) * 10. / static_cast<double>(sampleRate) * 100.;
+        expect(gt(nPulses, 10.) >> fatal);
+        expect(ge(static_cast<double>(result.unknownEvents), 0.8 * nPulses)) << "every pulse is found at the raw rate, matched to no timing tag";
+        expect(le(static_cast<double>(result.unknownEvents), nPulses + 1.));
+    };
+
+    "streaming snapshots around matched timing tags"_test = [] {
+        constexpr gr::Size_t preSamples  = 100;
+        constexpr gr::Size_t postSamples = 200;
+        SimulationConfig     config;
+        config.channels[0].shape     = SimulatedSignal::Shape::Square;
+        config.channels[0].frequency = 10.f;
+        config.channels[0].phase     = -2.f * std::numbers::pi_v<float> * 0.05055f; // rising edges at sample 506 + k * 10000
+        PicoscopeSimulated::setSimulation("SIM-SNAPSHOTS", config);
+        const SimulatedTiming timing{.line = {.frequency = 10.f, .delay = 0.005055f}, .tagDelay = 5ms};
+        const property_map    settings{{"trigger_source", "A"s}, {"trigger_threshold", 0.f}, {"matcher_timeout", gr::Size_t{100'000'000}}, {"pre_samples", preSamples}, {"post_samples", postSamples}, {"trigger_filter", "CMD_TIMING"s}};
+        const auto            result = runStreaming<float>("SIM-SNAPSHOTS", 100'000.f, 1s, false, settings, timing);
+
+        expect(ge(result.snapshots.size(), 5UZ) >> fatal) << "one snapshot per matched timing tag";
+        for (const auto& snapshot : result.snapshots) {
+            expect(eq(snapshot.signal_values.size(), static_cast<std::size_t>(preSamples + postSamples)) >> fatal);
+            expect(approx(snapshot.signal_values[preSamples - 1UZ], -1.f, 0.01f)) << "pre-trigger samples before the edge";
+            expect(approx(snapshot.signal_values[preSamples], 1.f, 0.01f)) << "the trigger sample is the first one after the edge";
+            expect(approx(snapshot.signal_values.back(), 1.f, 0.01f));
+            expect(eq(snapshot.timing_events.size(), 1UZ) >> fatal);
+            expect(eq(snapshot.timing_events[0].size(), 1UZ) >> fatal);
+            expect(eq(snapshot.timing_events[0][0].first, static_cast<std::ptrdiff_t>(preSamples)));
+            expect(snapshot.timing_events[0][0].second.get_if<std::string>(gr::tag::TRIGGER_NAME.shortKey()) != nullptr && *snapshot.timing_events[0][0].second.get_if<std::string>(gr::tag::TRIGGER_NAME.shortKey()) == "CMD_TIMING");
+        }
+
+        property_map otherFilter = settings;
+        otherFilter.insert_or_assign("trigger_filter", "CMD_OTHER"s);
+        const auto filtered = runStreaming<float>("SIM-SNAPSHOTS", 100'000.f, 500ms, false, otherFilter, timing);
+        expect(ge(std::ranges::count_if(filtered.tags, [](const gr::Tag& tag) { return tag.map.contains(gr::tag::TRIGGER_TIME.shortKey()); }), 2)) << "the timing tags are matched";
+        expect(filtered.snapshots.empty()) << "no snapshot for tags not passing trigger_filter";
+    };
+
+    "streaming spectra"_test = [] {
+        constexpr std::size_t nBins = 513UZ; // spectrum_length / 2 + 1
+        SimulationConfig      config;
+        config.channels[0].frequency = 3125.f;    // bin 32 of 1024 at 100 kS/s, bin 64 at 50 kS/s and bin 16 at 200 kS/s
+        config.digital[3].frequency  = 2.f;
+        config.digital[3].delay      = 0.050555f; // rising edges at sample 5056 + k * 50000
+        PicoscopeSimulated::setSimulation("SIM-SPECTRUM", config);
+        const auto peakBin = [](const DataSet<float>& spectrum) { return static_cast<std::size_t>(std::distance(spectrum.signal_values.begin(), std::ranges::max_element(spectrum.signal_values))); };
+        const auto meta    = [](const DataSet<float>& spectrum, std::string_view key) -> std::optional<double> {
+            if (spectrum.meta_information.empty()) {
+                return std::nullopt;
+            }
+            const auto& info = spectrum.meta_information[0];
+            if (const auto* value = info.get_if<float>(key)) {
+                return static_cast<double>(*value);
+            } else if (const auto* size = info.get_if<gr::Size_t>(key)) {
+                return static_cast<double>(*size);
+            } else if (const auto* index = info.get_if<std::uint64_t>(key)) {
+                return static_cast<double>(*index);
+            }
+            return std::nullopt;
+        };
+
+        // averages of 10 segments (10 Hz, rounded up to whole segments), restarted at every CMD_TIMING tag
+        const SimulatedTiming timing{.line = config.digital[3], .tagDelay = 5ms};
+        const property_map    settings{{"spectrum_length", gr::Size_t{1024}}, {"spectrum_update_rate", 10.f}, {"spectrum_trigger", "CMD_TIMING"s}, {"trigger_source", "DI3"s}, {"matcher_timeout", gr::Size_t{100'000'000}}};
+        const auto            result = runStreaming<float>("SIM-SPECTRUM", 100'000.f, 1500ms, false, settings, timing);
+        expect(ge(result.spectra.size(), 8UZ) >> fatal) << "four spectra per trigger period";
+        std::size_t nAligned = 0UZ;
+        for (const auto& spectrum : result.spectra) {
+            expect(eq(spectrum.signal_values.size(), nBins) >> fatal);
+            expect(eq(peakBin(spectrum), 32UZ));
+            expect(approx(spectrum.axis_values[0][32], 3125.f, 0.01f));
+            expect(approx(spectrum.signal_values[32], 0.5f, 0.01f)) << "A²/2 of the 1 V sine";
+            expect(eq(meta(spectrum, "spectrum_averages").value_or(0.), 10.));
+            const auto end = static_cast<std::size_t>(meta(spectrum, "spectrum_end_index").value_or(0.));
+            expect(ge(end, 5056UZ + 10240UZ) >> fatal) << "no complete spectrum before the first trigger";
+            const std::size_t sinceTrigger = (end - 5056UZ) % 50000UZ;
+            expect(eq(sinceTrigger % 10240UZ, 0UZ) && ge(sinceTrigger, 10240UZ) && le(sinceTrigger, 40960UZ)) << "the average restarts at each trigger, end index" << end;
+            const bool aligned = !spectrum.timing_events.empty() && !spectrum.timing_events[0].empty();
+            expect(eq(aligned, sinceTrigger == 10240UZ)) << "only the first spectrum after a trigger carries it";
+            if (aligned) {
+                ++nAligned;
+                expect(eq(spectrum.timing_events[0][0].first, std::ptrdiff_t{0}));
+                expect(spectrum.timing_events[0][0].second.get_if<std::string>(gr::tag::TRIGGER_NAME.shortKey()) != nullptr && *spectrum.timing_events[0][0].second.get_if<std::string>(gr::tag::TRIGGER_NAME.shortKey()) == "CMD_TIMING");
+            }
+        }
+        expect(ge(nAligned, 2UZ));
+
+        // changing the decimation while running re-configures the update interval and the frequency axis
+        const std::array<StreamingRequest, 1UZ> requests{StreamingRequest{.at = 600ms, .command = message::Command::Set, .endpoint = std::string(gr::block::property::kSetting), .data = {{"decimation", gr::Size_t{2}}}}};
+        const auto decimated = runStreaming<float>("SIM-SPECTRUM", 100'000.f, 1200ms, false, {{"spectrum_length", gr::Size_t{1024}}, {"spectrum_update_rate", 10.f}}, {}, requests);
+        expect(ge(decimated.spectra.size(), 4UZ) >> fatal);
+        const auto& before = decimated.spectra.front();
+        const auto& after  = decimated.spectra.back();
+        expect(eq(meta(before, gr::tag::SAMPLE_RATE.shortKey()).value_or(0.), 100'000.));
+        expect(eq(meta(before, "spectrum_averages").value_or(0.), 10.));
+        expect(eq(peakBin(before), 32UZ));
+        expect(eq(meta(after, gr::tag::SAMPLE_RATE.shortKey()).value_or(0.), 50'000.)) << "decimation applied while running";
+        expect(eq(meta(after, "spectrum_averages").value_or(0.), 5.)) << "update interval in decimated samples";
+        expect(eq(after.signal_values.size(), nBins) >> fatal);
+        expect(eq(peakBin(after), 64UZ));
+        expect(approx(after.axis_values[0][64], 3125.f, 0.01f));
+
+        const auto faster = runStreaming<float>("SIM-SPECTRUM", 200'000.f, 500ms, false, {{"spectrum_length", gr::Size_t{1024}}, {"spectrum_update_rate", 10.f}});
+        expect(ge(faster.spectra.size(), 2UZ) >> fatal);
+        for (const auto& spectrum : faster.spectra) {
+            expect(eq(meta(spectrum, "spectrum_averages").value_or(0.), 20.)) << "update interval follows sample_rate";
+            expect(eq(peakBin(spectrum), 16UZ));
+            expect(approx(spectrum.axis_values[0][16], 3125.f, 0.01f));
+        }
+    };
+
+    "streaming sample history requests"_test = [] {
+        const auto get    = [](std::chrono::milliseconds at, property_map request) { return StreamingRequest{.at = at, .command = message::Command::Get, .endpoint = std::string(Picoscope<float, PicoscopeSimulated>::kHistoryProperty), .data = std::move(request)}; };
+        const auto values = [](const Message& reply, const std::string& channel) -> std::vector<float> {
+            const auto* channels = reply.data->get_if<property_map>("values");
+            const auto* samples  = channels != nullptr ? channels->get_if<std::vector<float>>(channel) : nullptr;
+            return samples != nullptr ? *samples : std::vector<float>{};
+        };
+        const auto failed = [](const std::optional<Message>& reply, std::string_view reason) { return reply.has_value() && !reply->data.has_value() && reply->data.error().message.contains(reason); };
+
+        PicoscopeSimulated::setSimulation("SIM-HISTORY", SimulationConfig{});
+        const std::array requests{
+            get(300ms, {{"index", std::uint64_t{10000}}, {"pre", 0.001f}, {"post", 0.002f}}),
+            get(300ms, {{"index", std::uint64_t{10000}}, {"pre", 0.001f}, {"channels", std::vector<std::string>{"B"}}}),
+            get(300ms, {{"index", std::uint64_t{10000}}, {"channels", std::vector<std::string>{"C"}}}),
+            get(300ms, {{"index", std::uint64_t{10000}}, {"pre", 5.f}, {"post", 5.f}}),
+            get(300ms, {{"index", std::uint64_t{100'000'000}}, {"post", 0.001f}}),
+            get(300ms, {{"time", std::uint64_t{1}}}),
+            get(300ms, {{"pre", 0.001f}}),
+            get(2400ms, {{"index", std::uint64_t{10000}}, {"post", 0.001f}}),
+        };
+        const auto result = runStreaming<float>("SIM-HISTORY", 100'000.f, 2500ms, false, {{"history_depth", 0.1f}}, {}, requests);
+
+        expect(result.replies[0].has_value() && result.replies[0]->data.has_value()) << fatal;
+        const Message& window = *result.replies[0];
+        expect(eq(window.data->value_or<std::uint64_t>("index", 0U), std::uint64_t{9900}));
+        expect(eq(window.data->value_or<std::uint64_t>("reference_index", 0U), std::uint64_t{10000}));
+        expect(eq(window.data->value_or<float>(gr::tag::SAMPLE_RATE.shortKey(), 0.f), 100'000.f));
+        const auto windowA = values(window, "A");
+        expect(eq(windowA.size(), 300UZ) >> fatal);
+        for (std::size_t i = 0UZ; i < windowA.size(); ++i) { // 1 kHz sine with phase 0 at sample 0, index 9900 is a full period
+            expect(approx(windowA[i], std::sin(2.f * std::numbers::pi_v<float> * static_cast<float>(i) / 100.f), 0.01f)) << "sample" << i;
+        }
+        expect(eq(values(window, "B").size(), 300UZ)) << "all channels by default";
+
+        expect(result.replies[1].has_value() && result.replies[1]->data.has_value()) << fatal;
+        expect(eq(values(*result.replies[1], "B").size(), 100UZ));
+        expect(values(*result.replies[1], "A").empty()) << "only the requested channels";
+
+        expect(failed(result.replies[2], "unknown channel"));
+        expect(failed(result.replies[3], "exceeds the history capacity"));
+        expect(failed(result.replies[4], "are not in the history")) << "not acquired yet";
+        expect(failed(result.replies[5], "no timing reference")) << "no timing tags to extrapolate the time from";
+        expect(failed(result.replies[6], "is required"));
+        expect(failed(result.replies[7], "are not in the history")) << "overwritten by newer samples";
+
+        // the history is kept in the decimated time base
+        SimulationConfig config;
+        config.channels[0].frequency = 10.f;
+        PicoscopeSimulated::setSimulation("SIM-HISTORY-DECIMATED", config);
+        const std::array decimatedRequests{get(500ms, {{"index", std::uint64_t{2000}}, {"pre", 0.01f}, {"post", 0.01f}})};
+        const auto       decimated = runStreaming<float>("SIM-HISTORY-DECIMATED", 100'000.f, 700ms, false, {{"history_depth", 1.f}, {"decimation", gr::Size_t{10}}}, {}, decimatedRequests);
+        expect(decimated.replies[0].has_value() && decimated.replies[0]->data.has_value()) << fatal;
+        const Message& decimatedWindow = *decimated.replies[0];
+        expect(eq(decimatedWindow.data->value_or<std::uint64_t>("index", 0U), std::uint64_t{1900})) << "pre in decimated samples";
+        expect(eq(decimatedWindow.data->value_or<float>(gr::tag::SAMPLE_RATE.shortKey(), 0.f), 10'000.f));
+        const auto decimatedA = values(decimatedWindow, "A");
+        expect(eq(decimatedA.size(), 200UZ) >> fatal);
+        for (std::size_t i = 0UZ; i < decimatedA.size(); i += 10UZ) { // 10 Hz sine, the low-pass delays it by a few samples
+            expect(approx(decimatedA[i], std::sin(2.f * std::numbers::pi_v<float> * 10.f * static_cast<float>(1900UZ + i) / 10'000.f), 0.1f)) << "sample" << i;
+        }
+    };
+
+    "streaming latency histograms"_test = [] {
+        using TPicoscope       = Picoscope<float, PicoscopeSimulated>;
+        const auto request     = [](std::chrono::milliseconds at, message::Command command, property_map data = {}) { return StreamingRequest{.at = at, .command = command, .endpoint = std::string(TPicoscope::kLatencyProperty), .data = std::move(data)}; };
+        const auto stage       = [](const Message& reply, std::string_view name) {
+            const auto* histogram = reply.data->get_if<property_map>(name);
+            return histogram != nullptr ? *histogram : property_map{};
+        };
+        const auto buckets     = [](const property_map& histogram, std::string_view key) {
+            const auto* values = histogram.get_if<std::vector<std::uint64_t>>(key);
+            return values != nullptr ? *values : std::vector<std::uint64_t>{};
+        };
+        const auto bucketCount = [&buckets](const property_map& histogram) {
+            const auto counts = buckets(histogram, "bucket_counts");
+            return std::accumulate(counts.begin(), counts.end(), std::uint64_t{0});
+        };
+
+        PicoscopeSimulated::setSimulation("SIM-LATENCY", SimulationConfig{});
+        const std::array requests{
+            request(400ms, message::Command::Get),
+            request(500ms, message::Command::Set, {{"reset", true}}),
+            request(500ms, message::Command::Set, {{"reset", false}}),
+            request(900ms, message::Command::Get),
+        };
+        const auto result = runStreaming<float>("SIM-LATENCY", 100'000.f, 1s, false, {}, {}, requests);
+
+        expect(result.replies[0].has_value() && result.replies[0]->data.has_value()) << fatal;
+        for (const std::string_view name : AcquisitionLatencies::kStageNames) {
+            const property_map histogram = stage(*result.replies[0], name);
+            const auto         count     = histogram.value_or<std::uint64_t>("count", 0U);
+            const auto         values    = buckets(histogram, "bucket_values");
+            const auto         maximum   = histogram.value_or<std::uint64_t>("max", 0U);
+            expect(gt(count, std::uint64_t{0})) << "stage" << name << "fills while acquiring";
+            expect(eq(bucketCount(histogram), count)) << "stage" << name << "buckets hold all recorded durations";
+            expect(eq(values.size(), buckets(histogram, "bucket_counts").size()) >> fatal);
+            expect(!values.empty() && std::ranges::is_sorted(values)) << fatal;
+            expect(le(values.back(), maximum)) << "stage" << name << "lower bound of the largest bucket";
+            expect(le(histogram.value_or<std::uint64_t>("p50", 0U), histogram.value_or<std::uint64_t>("p99", 0U)) && le(histogram.value_or<std::uint64_t>("p99", 0U), histogram.value_or<std::uint64_t>("p999", 0U)) && le(histogram.value_or<std::uint64_t>("p999", 0U), maximum)) << "stage" << name;
+        }
+
+        expect(result.replies[1].has_value() && result.replies[1]->data.has_value()) << fatal;
+        for (const std::string_view name : AcquisitionLatencies::kStageNames) { // the reply to the reset reflects the new, empty window
+            const property_map histogram = stage(*result.replies[1], name);
+            expect(eq(histogram.value_or<std::uint64_t>("count", 1U), std::uint64_t{0})) << "stage" << name;
+            expect(eq(bucketCount(histogram), std::uint64_t{0})) << "stage" << name;
+            expect(eq(histogram.value_or<std::uint64_t>("max", 1U), std::uint64_t{0})) << "stage" << name;
+        }
+        expect(result.replies[2].has_value() && !result.replies[2]->data.has_value()) << "read-only apart from the reset";
+
+        expect(result.replies[3].has_value() && result.replies[3]->data.has_value()) << fatal;
+        const property_map total = stage(*result.replies[3], "total");
+        expect(gt(total.value_or<std::uint64_t>("count", 0U), std::uint64_t{0})) << "refills after the reset";
+        expect(eq(bucketCount(total), total.value_or<std::uint64_t>("count", 0U)));
+    };
+
+    "timing tags only on the first port"_test = [] {
+        const auto isTimingTag = [](const gr::Tag& tag) { return tag.map.contains(gr::tag::TRIGGER_TIME.shortKey()); };
+        SimulationConfig config;
+        config.digital[3].frequency = 10.f;
+        config.digital[3].delay     = 0.005055f;
+        PicoscopeSimulated::setSimulation("SIM-TAG-PORTS", config);
+        const SimulatedTiming timing{.line = config.digital[3], .tagDelay = 5ms};
+        const property_map    settings{{"trigger_source", "DI3"s}, {"matcher_timeout", gr::Size_t{100'000'000}}, {"timing_tag_ports", "First"s}};
+
+        const auto first = runStreaming<float>("SIM-TAG-PORTS", 100'000.f, 1s, false, settings, timing);
+        expect(ge(std::ranges::count_if(first.tags, isTimingTag), 5)) << "matched timing tags on the first port";
+        expect(std::ranges::none_of(first.secondTags, isTimingTag)) << "none on the second channel";
+        expect(std::ranges::none_of(first.digitalTags, isTimingTag)) << "none on the digital port";
+        expect(std::ranges::any_of(first.secondTags, [](const gr::Tag& tag) { return tag.map.contains(gr::tag::SIGNAL_NAME.shortKey()); })) << "the signal info is still published on every port";
+
+        property_map allPorts = settings;
+        allPorts.insert_or_assign("timing_tag_ports", "All"s);
+        const auto all = runStreaming<float>("SIM-TAG-PORTS", 100'000.f, 1s, false, allPorts, timing);
+        expect(ge(std::ranges::count_if(all.tags, isTimingTag), 5));
+        expect(eq(std::ranges::count_if(all.secondTags, isTimingTag), std::ranges::count_if(all.tags, isTimingTag))) << "the same tags on every channel";
+
+        // RapidBlock: the timing events of the captures
+        SimulationConfig blockConfig;
+        blockConfig.triggerFrequency = 100.f;
+        PicoscopeSimulated::setSimulation("SIM-TAG-PORTS-BLOCK", blockConfig);
+        const auto captures = runRapidBlock("SIM-TAG-PORTS-BLOCK", {
+                                                                      {"n_captures", gr::Size_t{2}},
+                                                                      {"channel_ids", std::vector<std::string>{"A", "B"}},
+                                                                      {"channel_ranges", std::vector<float>{2.f, 5.f}},
+                                                                      {"channel_couplings", std::vector<std::string>{"DC", "DC"}},
+                                                                      {"matcher_timeout", gr::Size_t{1000}}, // UNKNOWN_EVENT at every trigger
+                                                                      {"timing_tag_ports", "First"s},
+                                                                  });
+        expect(eq(captures.outputs[0].size(), 2UZ) >> fatal);
+        expect(eq(captures.outputs[1].size(), 2UZ) >> fatal);
+        for (const auto& [dsA, dsB] : std::views::zip(captures.outputs[0], captures.outputs[1])) {
+            expect(!dsA.timing_events.empty()) << fatal;
+            expect(eq(dsA.timing_events[0].size(), 1UZ)) << "timing event of the capture on the first port";
+            expect(std::ranges::all_of(dsB.timing_events, [](const auto& events) { return events.empty(); })) << "none on the second port";
+        }
+    };
+
+    "streaming low latency with late timing tags"_test = [] { // the timing tags arrive after the samples of their edge were published
+        SimulationConfig config;
+        config.digital[3].frequency = 10.f;
+        config.digital[3].delay     = 0.005055f; // rising edges at sample 506 + k * 10000
+        PicoscopeSimulated::setSimulation("SIM-LATE-TAGS", config);
+        const SimulatedTiming timing{.line = config.digital[3], .tagDelay = 50ms};
+        const auto            path     = std::filesystem::temp_directory_path() / "qa_PicoscopeLateTags.raw";
+        const property_map    settings = {{"low_latency", true}, {"trigger_source", "DI3"s}, {"matcher_timeout", gr::Size_t{200'000'000}}, {"record_path", path.string()}};
+        const auto            result   = runStreaming<float>("SIM-LATE-TAGS", 100'000.f, 2s, false, settings, timing);
+
+        expect(ge(result.lateTags.size(), 10UZ) >> fatal) << "every timing tag arrives after its edge was published";
+        for (const property_map& lateTag : result.lateTags) {
+            const auto index = lateTag.get_if<gr::Size_t>("index");
+            const auto tag   = lateTag.get_if<property_map>("tag");
+            expect(index != nullptr && tag != nullptr) << fatal;
+            expect(eq(*index % 10000U, 506U)) << "absolute index of the trigger edge";
+            expect(tag->get_if<std::string>(gr::tag::TRIGGER_NAME.shortKey()) != nullptr && *tag->get_if<std::string>(gr::tag::TRIGGER_NAME.shortKey()) == "CMD_TIMING");
+            expect(tag->get_if<float>(gr::tag::TRIGGER_OFFSET.shortKey()) != nullptr && *tag->get_if<float>(gr::tag::TRIGGER_OFFSET.shortKey()) < 1.f) << "offset within the trigger sample";
+        }
+        expect(std::ranges::none_of(result.tags, [](const gr::Tag& tag) { return tag.map.contains(gr::tag::TRIGGER_TIME.shortKey()); })) << "late tags are not published on the stream";
+
+        const auto index = loadRawIndex(RawRecorder::indexPath(path));
+        expect(index.has_value()) << fatal;
+        expect(ge(index->size(), result.lateTags.size())) << "late tags are recorded";
+        for (const RawIndexEntry& entry : *index) {
+            expect(eq(entry.sampleIndex % 10000UZ, 506UZ)) << "at the archive sample of their edge";
+        }
+        std::filesystem::remove(path);
+        std::filesystem::remove(RawRecorder::indexPath(path));
+
+        // late_tag_horizon below the tag delay: the matcher gives up on the published samples before the tags arrive
+        const auto beyondHorizon = runStreaming<float>("SIM-LATE-TAGS", 100'000.f, 1s, false, {{"low_latency", true}, {"late_tag_horizon", gr::Size_t{1000}}, {"trigger_source", "DI3"s}, {"matcher_timeout", gr::Size_t{200'000'000}}}, timing);
+        expect(gt(beyondHorizon.nSamples, 0UZ));
+        expect(beyondHorizon.lateTags.empty()) << "no late tags beyond the horizon";
+    };
+
+    "streaming with injected faults"_test = [] {
+        SimulationConfig config;
+        config.faults.dropProbability     = 0.05;
+        config.faults.overflowProbability = 0.05;
+        config.faults.errorProbability    = 0.01;
+        PicoscopeSimulated::setSimulation("SIM-FAULTS", config);
+        const auto result = runStreaming<float>("SIM-FAULTS", 100'000.f, 1s, false);
+        expect(gt(result.nSamples, 0UZ)) << "acquisition continues after dropped samples and failed polls";
+    };
+
+    "streaming health and metrics"_test = [] { // a slow consumer forces dropped samples, the simulated driver over-ranges and fails some polls
+        using TPicoscope = Picoscope<float, PicoscopeSimulated>;
+        SimulationConfig config;
+        config.faults.overflowProbability = 0.2;
+        config.faults.errorProbability    = 0.02;
+        PicoscopeSimulated::setSimulation("SIM-HEALTH", config);
+        const auto metricsPath = std::filesystem::temp_directory_path() / "qa_PicoscopeHealth.prom";
+        std::filesystem::remove(metricsPath);
+
+        Graph flowGraph;
+        auto& ps = flowGraph.emplaceBlock<TPicoscope>({
+            {"serial_number", "SIM-HEALTH"s},
+            {"sample_rate", 100'000.f},
+            {"auto_arm", true},
+            {"channel_ids", std::vector<std::string>{"A"}},
+            {"channel_ranges", std::vector<float>{2.f}},
+            {"channel_couplings", std::vector<std::string>{"DC"}},
+            {"metrics_path", metricsPath.string()},
+            {"metrics_interval", 0.1f},
+        });
+        auto& sinkA       = flowGraph.emplaceBlock<SlowSink<float>>();
+        auto& sinkB       = flowGraph.emplaceBlock<BulkTagSink<float>>({{"log_samples", false}, {"log_tags", false}});
+        auto& sinkC       = flowGraph.emplaceBlock<BulkTagSink<float>>({{"log_samples", false}, {"log_tags", false}});
+        auto& sinkD       = flowGraph.emplaceBlock<BulkTagSink<float>>({{"log_samples", false}, {"log_tags", false}});
+        auto& sinkDigital = flowGraph.emplaceBlock<BulkTagSink<uint16_t>>({{"log_samples", false}, {"log_tags", false}});
+        expect(flowGraph.connect<"out#0", "in">(ps, sinkA, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value()); // full after less than a second
+        expect(flowGraph.connect<"out#1", "in">(ps, sinkB, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+        expect(flowGraph.connect<"out#2", "in">(ps, sinkC, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+        expect(flowGraph.connect<"out#3", "in">(ps, sinkD, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+        expect(flowGraph.connect<"digitalOut", "in">(ps, sinkDigital, gr::EdgeParameters{.minBufferSize = minPicoBufferSize}).has_value());
+
+        scheduler::Simple<scheduler::ExecutionPolicy::multiThreaded> sched{};
+        std::ignore = sched.exchange(std::move(flowGraph));
+        expect(sched.changeStateTo(lifecycle::State::INITIALISED).has_value());
+        expect(sched.changeStateTo(lifecycle::State::RUNNING).has_value());
+        std::this_thread::sleep_for(2s);
+        expect(sched.changeStateTo(lifecycle::State::REQUESTED_STOP).has_value());
+
+        const std::optional<Message> reply = ps.propertyCallbackHealth(TPicoscope::kHealthProperty, Message{});
+        expect(reply.has_value() && reply->data.has_value()) << fatal;
+        const property_map& health  = *reply->data;
+        const auto          counter = [&health](std::string_view name) { return health.value_or<std::uint64_t>(name, 0U); };
+        expect(gt(counter("samples_dropped"), std::uint64_t{0})) << "the slow consumer's buffer runs full";
+        expect(le(counter("samples_published") + counter("samples_dropped"), counter("samples_acquired")));
+        expect(gt(counter("overflow_events"), std::uint64_t{0}));
+        expect(gt(counter("retries"), std::uint64_t{0})) << "failed polls are retried";
+        expect(gt(counter("error_count_resets"), std::uint64_t{0}) && le(counter("error_count_resets"), counter("retries"))) << "the acquisition recovers";
+        expect(health.contains("matcher_drops"));
+        expect(gt(health.value_or<double>("buffer_fill", 0.0), 0.9)) << "fill of the fullest output buffer";
+        const auto* placement = health.get_if<property_map>("thread_placement");
+        expect(placement != nullptr && placement->contains("degraded"));
+        Message setRequest;
+        setRequest.cmd = message::Command::Set;
+        expect(!ps.propertyCallbackHealth(TPicoscope::kHealthProperty, setRequest).value().data.has_value()) << "read-only";
+
+        // the Prometheus snapshot written at stop() holds the same counters
+        std::ifstream     file(metricsPath);
+        const std::string metrics{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+        expect(!metrics.empty()) << fatal;
+        const std::string labels = std::format("{{block=\"{}\",serial=\"SIM-HEALTH\"}}", ps.name.value);
+        for (const auto& [name, help, member] : AcquisitionHealth::kCounters) {
+            expect(metrics.contains(std::format("# HELP picoscope_{}_total {}\n", name, help))) << name;
+            expect(metrics.contains(std::format("# TYPE picoscope_{}_total counter\n", name))) << name;
+            expect(metrics.contains(std::format("picoscope_{}_total{} {}\n", name, labels, counter(name)))) << name;
+        }
+        for (const std::string_view reason : timingmatcher::kDropReasonNames) {
+            expect(metrics.contains(std::format("picoscope_matcher_dropped_tags_total{{block=\"{}\",serial=\"SIM-HEALTH\",reason=\"{}\"}} ", ps.name.value, reason))) << reason;
+        }
+        expect(metrics.contains("# TYPE picoscope_buffer_fill gauge\n"));
+        expect(metrics.contains(std::format("picoscope_buffer_fill{} ", labels)));
+        expect(!std::filesystem::exists(std::filesystem::path(metricsPath) += ".tmp")) << "written atomically";
+        std::filesystem::remove(metricsPath);
+    };
+
+    "raw recording"_test = [] {
+        const auto path   = std::filesystem::temp_directory_path() / "qa_PicoscopeSimulated.raw";
+        const auto result = runStreaming<float>("SIM-RECORDING", 100'000.f, 1s, false, {{"record_path", path.string()}});
+
+        auto archive = RawArchiveReader::load(path);
+        expect(archive.has_value()) << [&] { return archive.error(); };
+        if (archive) {
+            expect(eq(std::string_view(archive->header.channels.data()), "AB"sv));
+            expect(eq(archive->header.nChannels, std::uint16_t{2}));
+            expect(eq(archive->header.digital, std::uint16_t{0}));
+            expect(!archive->chunks.empty());
+            std::uint64_t nextIndex = 0UZ;
+            for (const auto& chunk : archive->chunks) {
+                expect(eq(chunk.header.sampleIndex, nextIndex)) << "no chunk dropped";
+                expect(eq(chunk.header.nChannels, 2U));
+                nextIndex += chunk.header.nSamples;
+            }
+            expect(ge(nextIndex, result.nSamples)) << "every sample the block received is in the archive";
+            if (!archive->chunks.empty()) {
+                const auto& first = archive->chunks.front();
+                expect(approx(static_cast<float>(std::ranges::max(first.channel(0))) * 2.f / 32767.f, 1.f, 0.01f)) << "raw counts of the 1 V sine on channel A";
+            }
+        }
+        static_assert(!std::is_copy_constructible_v<RawArchiveReader> && std::is_nothrow_move_constructible_v<RawArchiveReader>, "the chunk spans point into the reader's own data");
+        if (archive) {
+            const std::int16_t*    samples = archive->data.data();
+            const RawArchiveReader moved   = std::move(*archive);
+            expect(!moved.chunks.empty() && moved.chunks.front().samples.data() == samples && moved.data.data() == samples) << "spans stay valid after a move";
+        }
+        std::filesystem::remove(path);
+        std::filesystem::remove(RawRecorder::indexPath(path));
+    };
+
+    "raw recording rejects chunks larger than an archive window"_test = [] {
+        const auto  path = std::filesystem::temp_directory_path() / "qa_PicoscopeSimulatedWindow.raw";
+        RawRecorder recorder;
+        const auto  rejected = recorder.open(path, {.channels = "AB", .digital = true, .maxChunkSamples = 1UZ << 20UZ}, 1UZ << 20UZ); // 3 channels of 2 MB
+        expect(!rejected.has_value()) << "every chunk would be dropped";
+        expect(!recorder.isOpen());
+        expect(recorder.open(path, {.channels = "AB", .digital = true, .maxChunkSamples = 1UZ << 16UZ}, 1UZ << 20UZ).has_value());
+        recorder.close();
+        std::filesystem::remove(path);
+        std::filesystem::remove(RawRecorder::indexPath(path));
+    };
+
+    "raw replay"_test = [] {
+        const auto path     = std::filesystem::temp_directory_path() / "qa_PicoscopeReplay.raw";
+        const auto recorded = runStreaming<float>("SIM-REPLAY", 100'000.f, 1s, true, {{"record_path", path.string()}});
+
+        PicoscopeReplay::setReplay(path.string(), {.speed = 0.0}); // as fast as possible
+        const auto replayed = runStreaming<float, PicoscopeReplay>(path.string(), 100'000.f, 1s, true);
+        expect(ge(replayed.nSamples, recorded.nSamples)) << "the archive holds every sample the recording block received";
+        const std::size_t nCompare = std::min(recorded.samples.size(), replayed.samples.size());
+        expect(gt(nCompare, 0UZ));
+        expect(std::ranges::equal(std::span(recorded.samples).first(nCompare), std::span(replayed.samples).first(nCompare))) << "bit-exact replay";
+
+        std::filesystem::remove(path);
+        std::filesystem::remove(RawRecorder::indexPath(path));
+        PicoscopeReplay::clearReplays();
+    };
+
+    "raw replay of the recorded timing tags"_test = [] { // the archive index holds the matched tags, the replay publishes them at the same samples
+        SimulationConfig config;
+        config.digital[3].frequency = 20.f;
+        config.digital[3].delay     = 0.002035f; // rising edges at sample 204 + k * 5000
+        PicoscopeSimulated::setSimulation("SIM-REPLAY-TAGS", config);
+        const auto         path     = std::filesystem::temp_directory_path() / "qa_PicoscopeReplayTags.raw";
+        const property_map settings = {{"trigger_source", "DI3"s}, {"matcher_timeout", gr::Size_t{100'000'000}}};
+        property_map       recordSettings = settings;
+        recordSettings.insert_or_assign("record_path", path.string());
+        const auto recorded = runStreaming<float>("SIM-REPLAY-TAGS", 100'000.f, 1s, false, recordSettings, {.line = config.digital[3], .tagDelay = 5ms});
+
+        PicoscopeReplay::setReplay(path.string(), {.speed = 0.0});
+        const auto replayed = runStreaming<float, PicoscopeReplay>(path.string(), 100'000.f, 1s, false, settings); // no timing tags on timingIn
+
+        const auto timingTags = [](const StreamingResult& result) {
+            std::vector<std::tuple<std::size_t, std::uint64_t, std::string, float>> tags;
+            for (const auto& [index, map] : result.tags) {
+                if (const auto* time = map.get_if<std::uint64_t>(gr::tag::TRIGGER_TIME.shortKey())) {
+                    const auto* name   = map.get_if<std::string>(gr::tag::TRIGGER_NAME.shortKey());
+                    const auto* offset = map.get_if<float>(gr::tag::TRIGGER_OFFSET.shortKey());
+                    tags.emplace_back(index, *time, name != nullptr ? *name : std::string{}, offset != nullptr ? *offset : -1.f);
+                }
+            }
+            return tags;
+        };
+        const auto original = timingTags(recorded);
+        const auto replay   = timingTags(replayed);
+        expect(ge(original.size(), 10UZ) >> fatal) << "the timing tags are matched to the edges during the recording";
+        expect(le(replay.size(), original.size())) << "the replayed tags are the recorded ones";
+        expect(ge(replay.size() + 2UZ, original.size())) << "the replay holds back the last matcher_timeout of the archive, like the recording did";
+        expect(std::ranges::equal(std::span(replay).first(std::min(replay.size(), original.size())), std::span(original).first(std::min(replay.size(), original.size())))) << "same sample, trigger time, name and offset";
+        for (const auto& [index, time, name, offset] : replay) {
+            expect(eq(index % 5000UZ, 204UZ)) << "on the recorded trigger edge";
+        }
+        expect(le(replayed.unknownEvents, recorded.unknownEvents + 1U)) << "the edges of replayed tags are not reported as UNKNOWN_EVENT";
+
+        std::filesystem::remove(path);
+        std::filesystem::remove(RawRecorder::indexPath(path));
+        PicoscopeReplay::clearReplays();
+    };
+
+    "rapid block"_test = [] {
+        constexpr gr::Size_t preSamples  = 100;
+        constexpr gr::Size_t postSamples = 900;
+        constexpr gr::Size_t nCaptures   = 3;
+
+        SimulationConfig config;
+        config.triggerFrequency = 100.f;
+        PicoscopeSimulated::setSimulation("SIM-BLOCK", config);
+
+        Graph flowGraph;
+        auto& ps = flowGraph.emplaceBlock<Picoscope<DataSet<float>, PicoscopeSimulated>>({
+            {"serial_number", "SIM-BLOCK"s},
+            {"sample_rate", 1'000'000.f},
+            {"pre_samples", preSamples},
+            {"post_samples", postSamples},
+            {"n_captures", nCaptures},
+            {"auto_arm", true},
+            {"trigger_once", true},
+            {"channel_ids", std::vector<std::string>{"A"}},
+            {"channel_ranges", std::vector<float>{2.f}},
+            {"trigger_threshold", 0.0f},
+            {"channel_couplings", std::vector<std::string>{"DC"}},
+        });
+        auto& sinkA       = flowGraph.emplaceBlock<BulkTagSink<DataSet<float>>>({{"log_samples", true}, {"log_tags", false}});
+        auto& sinkB       = flowGraph.emplaceBlock<BulkTagSink<DataSet<float>>>({{"log_samples", false}, {"log_tags", false}});
+        auto& sinkC       = flowGraph.emplaceBlock<BulkTagSink<DataSet<float>>>({{"log_samples", false}, {"log_tags", false}});
+        auto& sinkD       = flowGraph.emplaceBlock<BulkTagSink<DataSet<float>>>({{"log_samples", false}, {"log_tags", false}});
+        auto& sinkDigital = flowGraph.emplaceBlock<BulkTagSink<DataSet<uint16_t>>>({{"log_samples", false}, {"log_tags", false}});
+        expect(flowGraph.connect<"out#0", "in">(ps, sinkA).has_value());
+        expect(flowGraph.connect<"out#1", "in">(ps, sinkB).has_value());
+        expect(flowGraph.connect<"out#2", "in">(ps, sinkC).has_value());
+        expect(flowGraph.connect<"out#3", "in">(ps, sinkD).has_value());
+        expect(flowGraph.connect<"digitalOut", "in">(ps, sinkDigital).has_value());
+
+        scheduler::Simple sched{};
+        std::ignore = sched.exchange(std::move(flowGraph));
+        expect(sched.runAndWait().has_value());
+
+        expect(eq(sinkA._samples.size(), static_cast<std::size_t>(nCaptures)));
+        for (const auto& ds : sinkA._samples) {
+            expect(eq(ds.signal_values.size(), static_cast<std::size_t>(preSamples + postSamples)));
+            if (ds.signal_values.size() == preSamples + postSamples) {
+                // 1 kHz sine with phase 0 at the trigger: 0 V at the trigger, 1 V a quarter period (250 samples) later
+                expect(approx(ds.signal_values[preSamples], 0.f, 0.01f));
+                expect(approx(ds.signal_values[preSamples + 250UZ], 1.f, 0.01f));
+            }
+        }
+    };
+
+    "rapid block over-range of a single capture"_test = [] { // the driver reports one over-range word per capture
+        constexpr gr::Size_t nCaptures = 4;
+
+        SimulationConfig config;
+        config.triggerFrequency       = 100.f;
+        config.faults.overflowSegment = 2UZ;
+        PicoscopeSimulated::setSimulation("SIM-BLOCK-OVERFLOW", config);
+        const auto result = runRapidBlock("SIM-BLOCK-OVERFLOW", {{"n_captures", nCaptures}, {"channel_ids", std::vector<std::string>{"B"}}}); // over-range bit 1
+
+        const auto& captures = result.outputs[0];
+        expect(eq(captures.size(), static_cast<std::size_t>(nCaptures)) >> fatal);
+        for (std::size_t capture = 0UZ; capture < captures.size(); ++capture) {
+            const auto& meta = captures[capture].meta_information;
+            expect(eq(!meta.empty() && meta[0].contains("Overrange"), capture == 2UZ)) << "capture" << capture;
+            expect(eq(!meta.empty() && meta[0].contains("over_range_intervals"), capture == 2UZ)) << "capture" << capture;
+        }
+        expect(result.health.has_value() && result.health->data.has_value()) << fatal;
+        const auto overflowEvents = result.health->data->get_if<std::uint64_t>("overflow_events");
+        expect(overflowEvents != nullptr) << fatal;
+        expect(eq(*overflowEvents, std::uint64_t{1})) << "one over-range word per capture instead of one for all";
+    };
+
+    "rapid block multi-channel layout"_test = [] { // one DataSet per capture holding both channels
+        constexpr gr::Size_t  preSamples  = 100;
+        constexpr gr::Size_t  postSamples = 900;
+        constexpr gr::Size_t  nCaptures   = 3;
+        constexpr std::size_t nSamples    = preSamples + postSamples;
+
+        SimulationConfig config;
+        config.triggerFrequency      = 100.f;
+        config.channels[1].shape     = SimulatedSignal::Shape::Dc;
+        config.channels[1].amplitude = 2.5f;
+        PicoscopeSimulated::setSimulation("SIM-BLOCK-MULTI", config);
+        const auto result = runRapidBlock("SIM-BLOCK-MULTI", {
+                                                                 {"n_captures", nCaptures},
+                                                                 {"rapid_block_layout", "MultiChannel"s},
+                                                                 {"channel_ids", std::vector<std::string>{"A", "B"}},
+                                                                 {"signal_names", std::vector<std::string>{"sine", "dc"}},
+                                                                 {"channel_ranges", std::vector<float>{2.f, 5.f}},
+                                                                 {"channel_couplings", std::vector<std::string>{"DC", "DC"}},
+                                                                 {"matcher_timeout", gr::Size_t{1000}}, // every capture gets an UNKNOWN_EVENT at its trigger
+                                                             });
+
+        expect(eq(result.outputs[0].size(), static_cast<std::size_t>(nCaptures)) >> fatal) << "one DataSet per capture on the first output";
+        expect(result.outputs[1].empty()) << "nothing on the other outputs";
+        for (const auto& ds : result.outputs[0]) {
+            expect((ds.extents == std::vector<std::int32_t>{2, static_cast<std::int32_t>(nSamples)}) >> fatal);
+            expect(eq(ds.signal_values.size(), 2UZ * nSamples) >> fatal);
+            expect((ds.signal_names == std::vector<std::string>{"sine", "dc"})) << "signals in the order of channel_ids";
+            const auto sine = std::span(ds.signal_values).first(nSamples);
+            const auto dc   = std::span(ds.signal_values).subspan(nSamples, nSamples);
+            expect(approx(sine[preSamples], 0.f, 0.01f));
+            expect(approx(sine[preSamples + 250UZ], 1.f, 0.01f));
+            expect(std::ranges::all_of(dc, [](float value) { return std::abs(value - 2.5f) < 0.01f; })) << "the second row is channel B of the same capture";
+            expect(eq(ds.timing_events.size(), 1UZ) >> fatal) << "one timing event list shared by the channels";
+            expect(eq(ds.timing_events[0].size(), 1UZ) >> fatal) << "only the tag of this capture";
+            expect(eq(ds.timing_events[0][0].first, static_cast<std::ptrdiff_t>(preSamples)));
+        }
+    };
+
+    "rapid block burst with a slow consumer"_test = [] { // the burst pool recycles the output slots, which must stay intact while the ring is full
+        constexpr gr::Size_t  preSamples  = 100;
+        constexpr gr::Size_t  postSamples = 900;
+        constexpr gr::Size_t  nCaptures   = 4;
+        constexpr std::size_t nSamples    = preSamples + postSamples;
+
+        SimulationConfig config;
+        config.triggerFrequency = 1000.f;
+        PicoscopeSimulated::setSimulation("SIM-BURST-SLOW", config);
+
+        Graph flowGraph;
+        auto& ps = flowGraph.emplaceBlock<Picoscope<DataSet<float>, PicoscopeSimulated>>({
+            {"serial_number", "SIM-BURST-SLOW"s},
+            {"sample_rate", 1'000'000.f},
+            {"pre_samples", preSamples},
+            {"post_samples", postSamples},
+            {"n_captures", nCaptures},
+            {"rapid_block_layout", "Burst"s},
+            {"auto_arm", true},
+            {"channel_ids", std::vector<std::string>{"A"}},
+            {"channel_ranges", std::vector<float>{2.f}},
+            {"trigger_threshold", 0.0f},
+            {"channel_couplings", std::vector<std::string>{"DC"}},
+        });
+        auto& sinkA       = flowGraph.emplaceBlock<SlowSink<DataSet<float>>>();
+        auto& sinkB       = flowGraph.emplaceBlock<BulkTagSink<DataSet<float>>>({{"log_samples", false}, {"log_tags", false}});
+        auto& sinkC       = flowGraph.emplaceBlock<BulkTagSink<DataSet<float>>>({{"log_samples", false}, {"log_tags", false}});
+        auto& sinkD       = flowGraph.emplaceBlock<BulkTagSink<DataSet<float>>>({{"log_samples", false}, {"log_tags", false}});
+        auto& sinkDigital = flowGraph.emplaceBlock<BulkTagSink<DataSet<uint16_t>>>({{"log_samples", false}, {"log_tags", false}});
+        expect(flowGraph.connect<"out#0", "in">(ps, sinkA, gr::EdgeParameters{.minBufferSize = 4UZ}).has_value()); // small ring, wraps within the test
+        expect(flowGraph.connect<"out#1", "in">(ps, sinkB).has_value());
+        expect(flowGraph.connect<"out#2", "in">(ps, sinkC).has_value());
+        expect(flowGraph.connect<"out#3", "in">(ps, sinkD).has_value());
+        expect(flowGraph.connect<"digitalOut", "in">(ps, sinkDigital).has_value());
+
+        scheduler::Simple<scheduler::ExecutionPolicy::multiThreaded> sched{};
+        std::ignore = sched.exchange(std::move(flowGraph));
+        expect(sched.changeStateTo(lifecycle::State::INITIALISED).has_value());
+        expect(sched.changeStateTo(lifecycle::State::RUNNING).has_value());
+        std::this_thread::sleep_for(500ms);
+        const std::size_t ringSize = ps.out[0].bufferSize();
+        expect(sched.changeStateTo(lifecycle::State::REQUESTED_STOP).has_value());
+
+        const std::optional<Message> reply = ps.propertyCallbackHealth(Picoscope<DataSet<float>, PicoscopeSimulated>::kHealthProperty, Message{});
+        expect(reply.has_value() && reply->data.has_value()) << fatal;
+        const auto allocations = reply->data->get_if<std::uint64_t>("burst_allocations");
+        const auto published   = reply->data->get_if<std::uint64_t>("samples_published");
+        expect(allocations && published) << fatal;
+        const std::size_t nBursts = *published / (nCaptures * nSamples);
+        std::println("slow consumer: {} bursts received, {} published, ring of {} slots, {} burst allocations", sinkA._received.size(), nBursts, ringSize, *allocations);
+
+        expect(gt(sinkA._received.size(), 5UZ));
+        expect(gt(nBursts, ringSize)) << "the ring has to wrap around to recycle the consumed bursts";
+        expect(le(*allocations, ringSize)) << "only slots which were never written allocate, recycled slots keep their storage";
+        for (const auto& ds : sinkA._received) { // a slot re-used before it was consumed would show the samples of a later burst or a partial one
+            expect((ds.extents == std::vector<std::int32_t>{static_cast<std::int32_t>(nCaptures), static_cast<std::int32_t>(nSamples)}) >> fatal);
+            expect(eq(ds.signal_values.size(), nCaptures * nSamples) >> fatal);
+            for (std::size_t segment = 0UZ; segment < nCaptures; ++segment) {
+                expect(approx(ds.signal_values[segment * nSamples + preSamples], 0.f, 0.01f));
+                expect(approx(ds.signal_values[segment * nSamples + preSamples + 250UZ], 1.f, 0.01f));
+            }
+        }
+    };
+};
+
+} // namespace fair::picoscope::test
+
+int main() { /* tests are statically executed */ }
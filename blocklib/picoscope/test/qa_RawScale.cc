@@ -0,0 +1,182 @@
+#include <boost/ut.hpp>
+
+#include <gnuradio-4.0/Scheduler.hpp>
+#include <gnuradio-4.0/testing/TagMonitors.hpp>
+
+#include <fair/picoscope/RawScale.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Tests of the RawScale block on hand-made raw streams and DataSets: default conversion, conversion and calibration tags, tag propagation and the DataSet
+ * layouts published by Picoscope<gr::DataSet<std::int16_t>>, run by ctest.
+ */
+namespace fair::picoscope::test {
+
+using namespace std::string_literals;
+
+template<typename T>
+using BulkTagSink = gr::testing::TagSink<T, gr::testing::ProcessFunction::USE_PROCESS_BULK>;
+
+// publishes `_values` in a single call, with `_tags` at their sample index, and is done afterwards
+template<typename T>
+struct RawSource : gr::Block<RawSource<T>> {
+    gr::PortOut<T> out;
+
+    GR_MAKE_REFLECTABLE(RawSource, out);
+
+    std::vector<T>       _values{};
+    std::vector<gr::Tag> _tags{};
+    bool                 _published = false;
+
+    gr::work::Status processBulk(gr::OutputSpanLike auto& outSpan) {
+        if (_published) {
+            outSpan.publish(0UZ);
+            return gr::work::Status::DONE;
+        }
+        if (outSpan.size() < _values.size()) {
+            outSpan.publish(0UZ);
+            return gr::work::Status::INSUFFICIENT_OUTPUT_ITEMS;
+        }
+        std::ranges::copy(_values, outSpan.begin());
+        for (const gr::Tag& tag : _tags) {
+            outSpan.publishTag(tag.map, tag.index);
+        }
+        outSpan.publish(_values.size());
+        _published = true;
+        return gr::work::Status::OK;
+    }
+};
+
+gr::property_map conversionTag(float scale, float offset, float uncertainty = 0.f) {
+    gr::property_map map{{"signal_name", "A"s}};
+    kernel::ConversionParameters{.scale = scale, .offset = offset, .uncertainty = uncertainty}.addTo(map);
+    return map;
+}
+
+// raw samples through RawScale<T>, returns the converted samples and the tags received downstream
+template<typename T>
+std::pair<std::vector<T>, std::vector<gr::Tag>> runStream(std::vector<std::int16_t> values, std::vector<gr::Tag> tags, const gr::property_map& settings = {}) {
+    using namespace boost::ut;
+    gr::Graph flowGraph;
+    auto&     source = flowGraph.emplaceBlock<RawSource<std::int16_t>>();
+    source._values   = std::move(values);
+    source._tags     = std::move(tags);
+    auto& scale      = flowGraph.emplaceBlock<RawScale<T>>(settings);
+    auto& sink       = flowGraph.emplaceBlock<BulkTagSink<T>>({{"log_samples", true}, {"log_tags", true}});
+    expect(flowGraph.connect<"out", "in">(source, scale).has_value());
+    expect(flowGraph.connect<"out", "in">(scale, sink).has_value());
+
+    gr::scheduler::Simple sched{};
+    std::ignore = sched.exchange(std::move(flowGraph));
+    expect(sched.runAndWait().has_value());
+    return {sink._samples, sink._tags};
+}
+
+const boost::ut::suite<"RawScale"> RawScaleTests = [] {
+    using namespace boost::ut;
+    using namespace gr;
+
+    "defaults until the first conversion tag"_test = [] {
+        std::vector<std::int16_t> raw(10UZ);
+        for (std::size_t i = 0UZ; i < raw.size(); ++i) {
+            raw[i] = static_cast<std::int16_t>(1000UZ * i);
+        }
+        const property_map info{{"signal_name", "A"s}}; // no conversion, keeps the defaults
+        const auto [values, tags] = runStream<float>(raw, {{0UZ, info}, {5UZ, conversionTag(0.001f, 0.5f)}}, {{"default_scale", 2e-4f}, {"default_offset", -1.f}});
+
+        expect(eq(values.size(), raw.size()) >> fatal);
+        for (std::size_t i = 0UZ; i < values.size(); ++i) {
+            const float expected = i < 5UZ ? -1.f + 2e-4f * static_cast<float>(raw[i]) : 0.5f + 0.001f * static_cast<float>(raw[i]);
+            expect(approx(values[i], expected, 1e-5f)) << "sample" << i << "changes the conversion exactly at the tag";
+        }
+        expect(eq(tags.size(), 2UZ) >> fatal) << "tags are forwarded";
+        expect(eq(tags[0].index, 0UZ));
+        expect(tags[0].map == info);
+        expect(eq(tags[1].index, 5UZ));
+        expect(tags[1].map == conversionTag(0.001f, 0.5f)) << "including the conversion, for further raw consumers";
+    };
+
+    "conversion tags replace each other"_test = [] {
+        const std::vector<std::int16_t> raw(6UZ, std::int16_t{100});
+        const auto [values, tags] = runStream<UncertainValue<float>>(raw, {{0UZ, conversionTag(0.01f, 0.f, 0.1f)}, {3UZ, conversionTag(0.02f, 1.f, 0.2f)}});
+
+        expect(eq(values.size(), raw.size()) >> fatal);
+        for (std::size_t i = 0UZ; i < values.size(); ++i) {
+            expect(approx(values[i].value, i < 3UZ ? 1.f : 3.f, 1e-5f)) << "sample" << i;
+            expect(approx(values[i].uncertainty, i < 3UZ ? 0.1f : 0.2f, 1e-6f)) << "adc_uncertainty of sample" << i;
+        }
+        expect(eq(tags.size(), 2UZ));
+    };
+
+    "calibration from the conversion tag"_test = [] {
+        property_map info = conversionTag(2.f / 32767.f, 0.f);
+        info.emplace("channel_range", 2.f);
+        info.emplace("signal_scale", 1.f);
+        info.emplace("calibration_coefficients", std::vector<float>{0.1f, 1.f, 0.5f}); // v_cal = 0.1 + v + 0.5 v²
+        const std::vector<std::int16_t> raw{-16384, 0, 16384, 32767};
+        const auto [values, tags] = runStream<float>(raw, {{0UZ, info}});
+
+        expect(eq(values.size(), raw.size()) >> fatal);
+        for (std::size_t i = 0UZ; i < values.size(); ++i) {
+            const float v = 2.f * static_cast<float>(raw[i]) / 32767.f;
+            expect(approx(values[i], 0.1f + v + 0.5f * v * v, 1e-4f)) << "sample" << i;
+        }
+    };
+
+    "multi-channel DataSet"_test = [] {
+        DataSet<std::int16_t> raw;
+        raw.timestamp     = 42;
+        raw.extents       = {2, 4};
+        raw.axis_names    = {"Time"};
+        raw.axis_units    = {"s"};
+        raw.axis_values   = {{0, 1, 2, 3}};
+        raw.signal_names  = {"A", "B"};
+        raw.signal_units  = {"V", "A"};
+        raw.signal_values = {0, 100, 200, 300, -100, 0, 100, 200};
+        raw.signal_ranges = {{0, 300}, {-100, 200}};
+        raw.meta_information.resize(2UZ);
+        kernel::ConversionParameters{.scale = 0.01f, .offset = 0.f}.addTo(raw.meta_information[0]);
+        kernel::ConversionParameters{.scale = 0.1f, .offset = 1.f}.addTo(raw.meta_information[1]);
+        raw.meta_information[0].emplace(std::string(tag::SAMPLE_RATE.shortKey()), 1000.f);
+        raw.timing_events = {{{1, property_map{{std::string(tag::TRIGGER_NAME.shortKey()), "CMD_TIMING"s}}}}};
+
+        Graph flowGraph;
+        auto& source   = flowGraph.emplaceBlock<RawSource<DataSet<std::int16_t>>>();
+        source._values = {raw};
+        auto& scale    = flowGraph.emplaceBlock<RawScale<DataSet<float>>>();
+        auto& sink     = flowGraph.emplaceBlock<BulkTagSink<DataSet<float>>>({{"log_samples", true}, {"log_tags", false}});
+        expect(flowGraph.connect<"out", "in">(source, scale).has_value());
+        expect(flowGraph.connect<"out", "in">(scale, sink).has_value());
+        scheduler::Simple sched{};
+        std::ignore = sched.exchange(std::move(flowGraph));
+        expect(sched.runAndWait().has_value());
+
+        expect(eq(sink._samples.size(), 1UZ) >> fatal);
+        const DataSet<float>& ds = sink._samples[0];
+        expect(eq(ds.timestamp, raw.timestamp));
+        expect(ds.extents == raw.extents);
+        expect(ds.signal_names == raw.signal_names);
+        expect(ds.signal_units == raw.signal_units);
+        expect(ds.meta_information == raw.meta_information);
+        expect(ds.timing_events == raw.timing_events) << "timing events are forwarded with the DataSet";
+        const std::vector<float> expected{0.f, 1.f, 2.f, 3.f, -9.f, 1.f, 11.f, 21.f}; // each signal with its own conversion
+        expect(eq(ds.signal_values.size(), expected.size()) >> fatal);
+        for (std::size_t i = 0UZ; i < expected.size(); ++i) {
+            expect(approx(ds.signal_values[i], expected[i], 1e-5f)) << "value" << i;
+        }
+        expect(eq(ds.signal_ranges.size(), 2UZ) >> fatal);
+        expect(approx(ds.signal_ranges[0].min, 0.f, 1e-5f) && approx(ds.signal_ranges[0].max, 3.f, 1e-5f));
+        expect(approx(ds.signal_ranges[1].min, -9.f, 1e-5f) && approx(ds.signal_ranges[1].max, 21.f, 1e-5f));
+        expect(eq(ds.axis_values.size(), 1UZ) >> fatal);
+        expect(eq(ds.axis_values[0].size(), 4UZ) >> fatal);
+        expect(approx(ds.axis_values[0][3], 3e-3f, 1e-7f)) << "sample indices to seconds";
+    };
+};
+
+} // namespace fair::picoscope::test
+
+int main() { /* tests are statically executed */ }
@@ -1,6 +1,10 @@
 #include <boost/ut.hpp>
+#include <fair/picoscope/IntervalTimingMatcher.hpp>
 #include <fair/picoscope/TimingMatcher.hpp>
+#include <algorithm>
+#include <array>
 #include <format>
+#include <ranges>
 
 using namespace std::string_literals;
 using namespace std::chrono_literals;
@@ -171,6 +175,7 @@ const boost::ut::suite<"TimingMatchers"> TimingMatcherTests = [] {
             {1'200, generateTimingTag("EVT_CMD3", acqTimestamp + 1'200'000, 0.0f, true)},
         };
         expectRangesEquals(expected, result.tags);
+        expect(eq(3UZ, result.unknownEvents));
     };
 
     "overlappingEvents"_test = [&] {
@@ -577,6 +582,7 @@ const boost::ut::suite<"TimingMatchers"> TimingMatcherTests = [] {
         expect(eq(40UZ, result.tags[1].index));
         expect(eq(50UZ, result.tags[2].index));
         expect(std::ranges::any_of(result.messages, [](const auto& m) { return m.contains("Dropping unordered tag"); }));
+        expect(gt(result.dropped[std::to_underlying(timingmatcher::DropReason::Unordered)], 0UZ));
     };
 
     "unorderedIndices2"_test = [&] {
@@ -603,6 +609,204 @@ const boost::ut::suite<"TimingMatchers"> TimingMatcherTests = [] {
         expect(eq(70UZ, result.tags[2].index));
         expect(eq(110UZ, result.tags[3].index));
         expect(std::ranges::any_of(result.messages, [](const auto& m) { return m.contains("Dropping unordered tag"); }));
+        expect(gt(result.dropped[std::to_underlying(timingmatcher::DropReason::Unordered)], 0UZ));
+    };
+};
+
+const boost::ut::suite<"IntervalTimingMatcher"> IntervalTimingMatcherTests = [] {
+    using namespace boost::ut;
+    using namespace gr;
+    using namespace fair::picoscope;
+    using fair::picoscope::timingmatcher::IntervalTimingMatcher;
+    using fair::picoscope::timingmatcher::TimingMatcher;
+
+    auto generateTimingTag = [](std::string&& event, std::uint64_t time, float offset, bool hwTrigger = true, std::optional<std::uint64_t> localTime = std::nullopt) {
+        return gr::property_map{
+            {gr::tag::TRIGGER_NAME.shortKey(), std::move(event)},
+            {gr::tag::TRIGGER_TIME.shortKey(), time},
+            {gr::tag::TRIGGER_OFFSET.shortKey(), offset},
+            {gr::tag::TRIGGER_META_INFO.shortKey(), gr::property_map{{"LOCAL-TIME", localTime.value_or(time)}, {"HW-TRIGGER", hwTrigger}}},
+        };
+    };
+
+    auto expectRangesEquals = [](const auto& r1, const auto& r2, std::source_location location = std::source_location::current()) { expect(std::ranges::equal(r1, r2), location) << [&r1, &r2]() { return std::format("exp: {}\n got: {}", gr::join(r1), gr::join(r2)); }; };
+
+    // feeds the matcher chunk by chunk like Picoscope::processBulk: unprocessed tags and samples are presented again with the next chunk, tags become
+    // available with the chunk given in `tagArrivals`, returns the published tags with absolute sample indices and the number of processed samples
+    auto matchInChunks = [](std::span<const std::size_t> chunkSizes, std::span<const std::pair<std::size_t, gr::property_map>> tagArrivals, std::span<const std::size_t> edges, std::uint64_t acqTimestamp) {
+        IntervalTimingMatcher         matcher{.timeout = 10us, .sampleRate = 1e6f};
+        std::vector<gr::property_map> pendingTags;
+        std::vector<std::size_t>      chunkEdges;
+        std::vector<gr::Tag>          published;
+        std::size_t                   consumed  = 0UZ;
+        std::size_t                   available = 0UZ;
+        for (std::size_t chunk = 0UZ; chunk < chunkSizes.size(); ++chunk) {
+            available += chunkSizes[chunk];
+            for (const auto& [arrival, tag] : tagArrivals) {
+                if (arrival == chunk) {
+                    pendingTags.push_back(tag);
+                }
+            }
+            chunkEdges.clear();
+            for (const std::size_t edge : edges) {
+                if (edge >= consumed && edge < available) {
+                    chunkEdges.push_back(edge - consumed);
+                }
+            }
+            auto result = matcher.match(pendingTags, chunkEdges, available - consumed, std::chrono::nanoseconds(acqTimestamp + consumed * 1'000UZ));
+            for (gr::Tag& tag : result.tags) {
+                published.emplace_back(tag.index + consumed, std::move(tag.map));
+            }
+            pendingTags.erase(pendingTags.begin(), pendingTags.begin() + static_cast<std::ptrdiff_t>(result.processedTags));
+            consumed += result.processedSamples;
+        }
+        return std::pair{published, consumed};
+    };
+
+    "simpleMatching"_test = [&] {
+        unsigned long                 acqTimestamp = 123456789;
+        std::vector<gr::property_map> tags{
+            generateTimingTag("EVT_CMD1"s, acqTimestamp + 100'000, 0.0f, true),
+            generateTimingTag("EVT_CMD2"s, acqTimestamp + 150'000, 0.0f, true),
+            generateTimingTag("EVT_CMD3"s, acqTimestamp + 200'000, 0.0f, true),
+        };
+        std::vector<std::size_t> triggerSampleIndices{100, 150, 200};
+
+        IntervalTimingMatcher matcher{.timeout = 10us, .sampleRate = 1e6f};
+        auto                  result = matcher.match(tags, triggerSampleIndices, 250UZ, std::chrono::nanoseconds(acqTimestamp));
+
+        expect(eq(triggerSampleIndices.size(), result.processedTags));
+        expect(eq(240UZ, result.processedSamples));
+        expectRangesEquals(
+            std::vector<gr::Tag>{
+                {100, generateTimingTag("EVT_CMD1"s, acqTimestamp + 100'000, 0.0f, true)},
+                {150, generateTimingTag("EVT_CMD2"s, acqTimestamp + 150'000, 0.0f, true)},
+                {200, generateTimingTag("EVT_CMD3"s, acqTimestamp + 200'000, 0.0f, true)},
+            },
+            result.tags);
+    };
+
+    "denseSpuriousPulse"_test = [&] { // spurious pulse shortly before a real one: the greedy matcher takes the first edge in the window, the interval matcher the closest one
+        unsigned long                 acqTimestamp = 123456789;
+        std::vector<gr::property_map> tags{
+            generateTimingTag("EVT_CMD1"s, acqTimestamp + 100'000, 0.0f, true),
+            generateTimingTag("EVT_CMD2"s, acqTimestamp + 150'000, 0.0f, true),
+            generateTimingTag("EVT_CMD3"s, acqTimestamp + 200'000, 0.0f, true),
+        };
+        std::vector<std::size_t> triggerSampleIndices{100, 148, 150, 200};
+
+        IntervalTimingMatcher matcher{.timeout = 10us, .sampleRate = 1e6f};
+        auto                  result = matcher.match(tags, triggerSampleIndices, 250UZ, std::chrono::nanoseconds(acqTimestamp));
+
+        expect(eq(tags.size(), result.processedTags));
+        expect(eq(240UZ, result.processedSamples));
+        expectRangesEquals(
+            std::vector<gr::Tag>{
+                {100, generateTimingTag("EVT_CMD1"s, acqTimestamp + 100'000, 0.0f, true)},
+                TimingMatcher::createUnknownEventTag(148, std::chrono::nanoseconds(acqTimestamp + 148'000)),
+                {150, generateTimingTag("EVT_CMD2"s, acqTimestamp + 150'000, 0.0f, true)},
+                {200, generateTimingTag("EVT_CMD3"s, acqTimestamp + 200'000, 0.0f, true)},
+            },
+            result.tags);
+    };
+
+    "overlappingHwPulses"_test = [&] { // two hw events on top of each other only produce a single edge, the second tag is realigned to the first
+        unsigned long                 acqTimestamp = 123456789;
+        std::vector<gr::property_map> tags{
+            generateTimingTag("EVT_CMD1"s, acqTimestamp + 100'000, 0.0f, true),
+            generateTimingTag("EVT_CMD2"s, acqTimestamp + 102'000, 0.0f, true),
+        };
+        std::vector<std::size_t> triggerSampleIndices{100};
+
+        IntervalTimingMatcher matcher{.timeout = 10us, .sampleRate = 1e6f};
+        auto                  result = matcher.match(tags, triggerSampleIndices, 250UZ, std::chrono::nanoseconds(acqTimestamp));
+
+        expect(eq(tags.size(), result.processedTags));
+        expect(eq(240UZ, result.processedSamples));
+        expectRangesEquals(
+            std::vector<gr::Tag>{
+                {100, generateTimingTag("EVT_CMD1"s, acqTimestamp + 100'000, 0.0f, true)},
+                {102, generateTimingTag("EVT_CMD2"s, acqTimestamp + 102'000, 0.0f, true)},
+            },
+            result.tags);
+    };
+
+    "pendingHwTag"_test = [&] { // a hw tag at the end of the chunk must not be resolved before its edge had the chance to arrive
+        unsigned long                 acqTimestamp = 123456789;
+        std::vector<gr::property_map> tags{
+            generateTimingTag("EVT_CMD1"s, acqTimestamp + 100'000, 0.0f, true),
+            generateTimingTag("EVT_CMD2"s, acqTimestamp + 245'000, 0.0f, true),
+        };
+        std::vector<std::size_t> triggerSampleIndices{100};
+
+        IntervalTimingMatcher matcher{.timeout = 10us, .sampleRate = 1e6f};
+        auto                  result = matcher.match(tags, triggerSampleIndices, 250UZ, std::chrono::nanoseconds(acqTimestamp));
+
+        expect(eq(1UZ, result.processedTags));
+        expect(eq(235UZ, result.processedSamples));
+        expectRangesEquals(std::vector<gr::Tag>{{100, generateTimingTag("EVT_CMD1"s, acqTimestamp + 100'000, 0.0f, true)}}, result.tags);
+    };
+
+    "chunkedMatching"_test = [&] { // tags and edges spread over several chunks give the same result as matching all samples at once
+        unsigned long                                               acqTimestamp = 123456789;
+        const std::vector<std::size_t>                              chunkSizes{97, 131, 64, 200, 158};
+        const std::vector<std::pair<std::size_t, gr::property_map>> tagArrivals{
+            {1, generateTimingTag("EVT_CMD1"s, acqTimestamp + 100'000, 0.0f, true)},
+            {1, generateTimingTag("EVT_CMD2"s, acqTimestamp + 150'000, 0.0f, true)},
+            {1, generateTimingTag("EVT_CMD3"s, acqTimestamp + 200'000, 0.0f, true)},
+            {1, generateTimingTag("EVT_CMD4"s, acqTimestamp + 203'000, 0.0f, true)},
+            {2, generateTimingTag("EVT_CMD5"s, acqTimestamp + 300'000, 0.0f, true)}, // arrives before the chunk containing its edge
+            {3, generateTimingTag("EVT_CMD6"s, acqTimestamp + 301'000, 0.0f, true)}, // overlapping pulse without edge
+            {4, generateTimingTag("EVT_CMD7"s, acqTimestamp + 485'000, 0.0f, true)}, // arrives after the chunk containing its edge
+        };
+        const std::vector<std::size_t> edges{100, 148, 150, 200, 203, 300, 485, 520};
+
+        const auto [chunked, consumed] = matchInChunks(chunkSizes, tagArrivals, edges, acqTimestamp);
+
+        const auto            tags      = tagArrivals | std::views::values | std::ranges::to<std::vector>();
+        IntervalTimingMatcher singleShot{.timeout = 10us, .sampleRate = 1e6f};
+        const auto            reference = singleShot.match(tags, edges, std::ranges::fold_left(chunkSizes, 0UZ, std::plus{}), std::chrono::nanoseconds(acqTimestamp));
+
+        expect(eq(tags.size(), reference.processedTags));
+        expect(eq(reference.processedSamples, consumed));
+        expect(eq(9UZ, chunked.size()));
+        expectRangesEquals(reference.tags, chunked);
+        expect(eq(485UZ, chunked[7].index));
+        expect(eq(520UZ, chunked[8].index));
+    };
+
+    "chunkedDenseMatching"_test = [&] { // periodic events with spurious edges, tags arriving once the timeout after their edge was acquired, possibly with the next chunk
+        unsigned long                                         acqTimestamp = 123456789;
+        constexpr std::array                                  kChunkCycle{97UZ, 131UZ, 64UZ, 200UZ, 158UZ};
+        std::vector<std::size_t>                              chunkSizes;
+        std::vector<std::size_t>                              chunkEnds;
+        std::vector<std::size_t>                              edges;
+        std::vector<std::pair<std::size_t, gr::property_map>> tagArrivals;
+        for (std::size_t total = 0UZ; total < 4'700UZ; total += chunkSizes.back()) {
+            chunkSizes.push_back(kChunkCycle[chunkSizes.size() % kChunkCycle.size()]);
+            chunkEnds.push_back(total + chunkSizes.back());
+        }
+        for (std::size_t event = 0UZ; event < 200UZ; ++event) {
+            const std::size_t index = 50UZ + 23UZ * event;
+            if (event % 7UZ == 0UZ) {
+                edges.push_back(index - 2UZ); // spurious pulse shortly before the real one
+            }
+            edges.push_back(index);
+            const std::size_t arrival = static_cast<std::size_t>(std::ranges::upper_bound(chunkEnds, index + 10UZ) - chunkEnds.begin());
+            tagArrivals.emplace_back(arrival, generateTimingTag(std::format("EVT_{}", event), acqTimestamp + index * 1'000UZ, 0.0f, true));
+        }
+
+        const auto [chunked, consumed] = matchInChunks(chunkSizes, tagArrivals, edges, acqTimestamp);
+
+        const auto            tags      = tagArrivals | std::views::values | std::ranges::to<std::vector>();
+        IntervalTimingMatcher singleShot{.timeout = 10us, .sampleRate = 1e6f};
+        const auto            reference = singleShot.match(tags, edges, chunkEnds.back(), std::chrono::nanoseconds(acqTimestamp));
+
+        expect(eq(tags.size(), reference.processedTags));
+        expect(eq(29UZ, reference.unknownEvents));
+        expect(eq(reference.processedSamples, consumed));
+        expect(eq(edges.size(), chunked.size()));
+        expectRangesEquals(reference.tags, chunked);
     };
 };
 } // namespace fair::picoscope::test
@@ -0,0 +1,229 @@
+#ifndef FAIR_THREAD_THREADPLACEMENT_HPP
+#define FAIR_THREAD_THREADPLACEMENT_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <expected>
+#include <format>
+#include <optional>
+#include <print>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+#include <pthread.h>
+#include <sched.h>
+
+/**
+ * CPU affinity and real-time priority of the threads servicing the hardware (Picoscope acquisition, TimingSource poller, CMW poller), so they can be
+ * moved to isolated cores (`isolcpus=`, cpusets) away from noisy neighbours. Everything is best-effort: CPUs outside the allowed set of the process are
+ * dropped and SCHED_FIFO without CAP_SYS_NICE or a sufficient RLIMIT_RTPRIO is skipped, EffectivePlacement tells what the thread actually got:
+ *
+ *   const fair::thread::ThreadPlacement requested{.cpuAffinity = "2,4-6", .rtPriority = 80};
+ *   const auto                          effective = fair::thread::applyToCurrentThread(requested);
+ *   fair::thread::report("TimingSource", "poller", requested, effective, verbose);
+ */
+namespace fair::thread {
+
+inline constexpr std::size_t kMaxCpus = CPU_SETSIZE; // cpu_set_t capacity
+
+struct ThreadPlacement {
+    std::string cpuAffinity{};  // CPU list as for `taskset -c`, e.g. "2,4-6", empty: unchanged
+    int         rtPriority = 0; // SCHED_FIFO priority (1..99), 0: scheduling policy unchanged
+
+    [[nodiscard]] bool empty() const noexcept { return cpuAffinity.empty() && rtPriority <= 0; }
+
+    bool operator==(const ThreadPlacement&) const = default;
+};
+
+// what the thread runs with after applying a ThreadPlacement, may be less than requested
+struct EffectivePlacement {
+    std::string cpus{};   // CPU list the thread may run on
+    std::string policy{}; // SCHED_OTHER, SCHED_FIFO, ...
+    int         priority = 0;
+    std::string degraded{}; // why (parts of) the requested placement were not applied, empty if all were
+
+    [[nodiscard]] std::string toString() const { return std::format("cpus {}, {} priority {}", cpus, policy, priority); }
+};
+
+[[nodiscard]] inline std::expected<cpu_set_t, std::string> parseCpuList(std::string_view list) {
+    const auto parseCpu = [](std::string_view text) -> std::optional<std::size_t> {
+        std::size_t cpu      = 0UZ;
+        const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), cpu);
+        if (ec != std::errc{} || ptr != text.data() + text.size() || cpu >= kMaxCpus) {
+            return std::nullopt;
+        }
+        return cpu;
+    };
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (const auto token : std::views::split(list, ',')) {
+        std::string_view entry(token.begin(), token.end());
+        entry.remove_prefix(std::min(entry.find_first_not_of(' '), entry.size()));
+        entry.remove_suffix(entry.size() - std::min(entry.find_last_not_of(' ') + 1UZ, entry.size()));
+        const std::size_t                dash  = entry.find('-');
+        const std::optional<std::size_t> first = parseCpu(entry.substr(0UZ, dash));
+        const std::optional<std::size_t> last  = dash == std::string_view::npos ? first : parseCpu(entry.substr(dash + 1UZ));
+        if (!first || !last || *last < *first) {
+            return std::unexpected(std::format("invalid entry '{}', expected `<cpu>` or `<first>-<last>` with CPUs below {}", entry, kMaxCpus));
+        }
+        for (std::size_t cpu = *first; cpu <= *last; ++cpu) {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+    return cpus;
+}
+
+[[nodiscard]] inline std::string formatCpuList(const cpu_set_t& cpus) {
+    std::string list;
+    for (std::size_t cpu = 0UZ; cpu < kMaxCpus; ++cpu) {
+        if (!CPU_ISSET(cpu, &cpus)) {
+            continue;
+        }
+        std::size_t last = cpu;
+        while (last + 1UZ < kMaxCpus && CPU_ISSET(last + 1UZ, &cpus)) {
+            ++last;
+        }
+        list += std::format("{}{}", list.empty() ? "" : ",", last == cpu ? std::format("{}", cpu) : std::format("{}-{}", cpu, last));
+        cpu = last;
+    }
+    return list;
+}
+
+[[nodiscard]] inline std::string policyName(int policy) {
+    switch (policy) {
+    case SCHED_OTHER: return "SCHED_OTHER";
+    case SCHED_FIFO: return "SCHED_FIFO";
+    case SCHED_RR: return "SCHED_RR";
+    case SCHED_BATCH: return "SCHED_BATCH";
+    case SCHED_IDLE: return "SCHED_IDLE";
+    default: return std::format("policy {}", policy);
+    }
+}
+
+[[nodiscard]] inline EffectivePlacement currentPlacement() {
+    EffectivePlacement placement;
+    if (cpu_set_t cpus; ::pthread_getaffinity_np(::pthread_self(), sizeof(cpus), &cpus) == 0) {
+        placement.cpus = formatCpuList(cpus);
+    }
+    int         policy = SCHED_OTHER;
+    sched_param param{};
+    if (::pthread_getschedparam(::pthread_self(), &policy, &param) == 0) {
+        placement.policy   = policyName(policy);
+        placement.priority = param.sched_priority;
+    }
+    return placement;
+}
+
+/**
+ * Applies `requested` to the calling thread as far as permitted. The placement stays with the thread, for pool threads which are returned afterwards
+ * use ScopedThreadPlacement.
+ */
+[[nodiscard]] inline EffectivePlacement applyToCurrentThread(const ThreadPlacement& requested) {
+    std::string degraded;
+    const auto  addReason = [&degraded](std::string_view reason) { degraded += std::format("{}{}", degraded.empty() ? "" : "; ", reason); };
+    if (!requested.cpuAffinity.empty()) {
+        if (const auto cpus = parseCpuList(requested.cpuAffinity); !cpus) {
+            addReason(std::format("invalid cpu_affinity '{}': {}", requested.cpuAffinity, cpus.error()));
+        } else if (const int result = ::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set_t), &*cpus); result != 0) {
+            addReason(std::format("cannot set the CPU affinity to {}: {}", requested.cpuAffinity, std::strerror(result)));
+        } else if (cpu_set_t applied; ::pthread_getaffinity_np(::pthread_self(), sizeof(applied), &applied) == 0 && !CPU_EQUAL(&applied, &*cpus)) { // the kernel restricts the mask to the cpuset
+            cpu_set_t missing;
+            CPU_XOR(&missing, &applied, &*cpus);
+            addReason(std::format("CPUs {} are not permitted", formatCpuList(missing)));
+        }
+    }
+    if (requested.rtPriority > 0) {
+        const sched_param param{.sched_priority = std::clamp(requested.rtPriority, ::sched_get_priority_min(SCHED_FIFO), ::sched_get_priority_max(SCHED_FIFO))};
+        if (const int result = ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &param); result != 0) {
+            addReason(std::format("cannot set SCHED_FIFO priority {} (needs CAP_SYS_NICE or RLIMIT_RTPRIO): {}", param.sched_priority, std::strerror(result)));
+        }
+    }
+    EffectivePlacement placement = currentPlacement();
+    placement.degraded           = std::move(degraded);
+    return placement;
+}
+
+// a ThreadPlacement parsed once, to be applied repeatedly without parsing or allocating, see ScopedThreadPlacement(const ResolvedPlacement&)
+struct ResolvedPlacement {
+    std::optional<cpu_set_t> cpus{};       // empty: affinity unchanged, also if the CPU list is invalid (applyToCurrentThread reports why)
+    int                      priority = 0; // SCHED_FIFO priority, clamped to the valid range, 0: scheduling policy unchanged
+
+    [[nodiscard]] bool empty() const noexcept { return !cpus && priority <= 0; }
+};
+
+[[nodiscard]] inline ResolvedPlacement resolve(const ThreadPlacement& requested) {
+    ResolvedPlacement resolved;
+    if (!requested.cpuAffinity.empty()) {
+        if (auto cpus = parseCpuList(requested.cpuAffinity); cpus) {
+            resolved.cpus = *cpus;
+        }
+    }
+    if (requested.rtPriority > 0) {
+        resolved.priority = std::clamp(requested.rtPriority, ::sched_get_priority_min(SCHED_FIFO), ::sched_get_priority_max(SCHED_FIFO));
+    }
+    return resolved;
+}
+
+// prints a warning if `requested` could not be fully applied and the effective placement if one was requested or `verbose`
+inline void report(std::string_view owner, std::string_view threadName, const ThreadPlacement& requested, const EffectivePlacement& effective, bool verbose) {
+    if (!effective.degraded.empty()) {
+        std::println("{} - Warning! {} thread runs best-effort: {}", owner, threadName, effective.degraded);
+    }
+    if (verbose || !requested.empty()) {
+        std::println("{}: {} thread placement: {}", owner, threadName, effective.toString());
+    }
+}
+
+/**
+ * Applies a ThreadPlacement to the calling thread for the lifetime of the object and restores the previous affinity and scheduling policy afterwards,
+ * e.g. for long running tasks on shared thread pools. Constructed from a ResolvedPlacement it neither parses nor allocates and skips reading back the
+ * effective placement, for work items which are placed on every call: a get and a set per attribute plus the restore (~2 µs for the affinity
+ * on a virtual machine), and a migration if the worker was running on a CPU outside the set.
+ */
+class ScopedThreadPlacement {
+    cpu_set_t          _previousCpus;
+    int                _previousPolicy = SCHED_OTHER;
+    sched_param        _previousParam{};
+    bool               _restoreCpus       = false;
+    bool               _restoreScheduling = false;
+    EffectivePlacement _effective;
+
+public:
+    explicit ScopedThreadPlacement(const ThreadPlacement& requested) {
+        _restoreCpus       = !requested.cpuAffinity.empty() && ::pthread_getaffinity_np(::pthread_self(), sizeof(_previousCpus), &_previousCpus) == 0;
+        _restoreScheduling = requested.rtPriority > 0 && ::pthread_getschedparam(::pthread_self(), &_previousPolicy, &_previousParam) == 0;
+        _effective         = applyToCurrentThread(requested);
+    }
+    explicit ScopedThreadPlacement(const ResolvedPlacement& placement) noexcept {
+        if (placement.cpus) {
+            _restoreCpus = ::pthread_getaffinity_np(::pthread_self(), sizeof(_previousCpus), &_previousCpus) == 0 && ::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set_t), &*placement.cpus) == 0;
+        }
+        if (placement.priority > 0) {
+            const sched_param param{.sched_priority = placement.priority};
+            _restoreScheduling = ::pthread_getschedparam(::pthread_self(), &_previousPolicy, &_previousParam) == 0 && ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &param) == 0;
+        }
+    }
+    ScopedThreadPlacement(ScopedThreadPlacement&& other) noexcept : _previousCpus(other._previousCpus), _previousPolicy(other._previousPolicy), _previousParam(other._previousParam), _restoreCpus(std::exchange(other._restoreCpus, false)), _restoreScheduling(std::exchange(other._restoreScheduling, false)), _effective(std::move(other._effective)) {}
+    ScopedThreadPlacement(const ScopedThreadPlacement&)            = delete;
+    ScopedThreadPlacement& operator=(const ScopedThreadPlacement&) = delete;
+    ScopedThreadPlacement& operator=(ScopedThreadPlacement&&)      = delete;
+
+    ~ScopedThreadPlacement() {
+        if (_restoreCpus) {
+            std::ignore = ::pthread_setaffinity_np(::pthread_self(), sizeof(_previousCpus), &_previousCpus);
+        }
+        if (_restoreScheduling) {
+            std::ignore = ::pthread_setschedparam(::pthread_self(), _previousPolicy, &_previousParam);
+        }
+    }
+
+    [[nodiscard]] const EffectivePlacement& effective() const noexcept { return _effective; }
+};
+
+} // namespace fair::thread
+
+#endif // FAIR_THREAD_THREADPLACEMENT_HPP
@@ -0,0 +1,78 @@
+#include <boost/ut.hpp>
+
+#include <fair/thread/ThreadPlacement.hpp>
+
+#include <thread>
+
+namespace fair::thread::test {
+
+const boost::ut::suite<"ThreadPlacement"> ThreadPlacementTests = [] {
+    using namespace boost::ut;
+
+    "cpu lists are parsed and formatted"_test = [] {
+        const auto cpus = parseCpuList("2, 4-6,9");
+        expect(cpus.has_value()) << fatal;
+        expect(eq(CPU_COUNT(&*cpus), 5));
+        expect(eq(formatCpuList(*cpus), std::string("2,4-6,9")));
+        expect(!parseCpuList("3-1").has_value());
+        expect(!parseCpuList("a").has_value());
+        expect(!parseCpuList("1,,2").has_value());
+        expect(!parseCpuList(std::format("{}", kMaxCpus)).has_value());
+    };
+
+    "affinity is applied and restored"_test = [] {
+        std::jthread worker([] {
+            const EffectivePlacement initial = currentPlacement();
+            const auto               allowed = parseCpuList(initial.cpus);
+            expect(allowed.has_value()) << fatal;
+            std::size_t firstCpu = 0UZ;
+            while (!CPU_ISSET(firstCpu, &*allowed)) {
+                ++firstCpu;
+            }
+            {
+                const ScopedThreadPlacement placement({.cpuAffinity = std::format("{}", firstCpu)});
+                expect(eq(placement.effective().cpus, std::format("{}", firstCpu)));
+                expect(placement.effective().degraded.empty());
+            }
+            expect(eq(currentPlacement().cpus, initial.cpus));
+        });
+    };
+
+    "resolved placements are applied per scope and restored after a move"_test = [] {
+        std::jthread worker([] {
+            const EffectivePlacement initial = currentPlacement();
+            const auto               allowed = parseCpuList(initial.cpus);
+            expect(allowed.has_value()) << fatal;
+            std::size_t firstCpu = 0UZ;
+            while (!CPU_ISSET(firstCpu, &*allowed)) {
+                ++firstCpu;
+            }
+            const ResolvedPlacement resolved = resolve({.cpuAffinity = std::format("{}", firstCpu)});
+            expect(resolved.cpus.has_value() && !resolve({.cpuAffinity = "x"}).cpus.has_value());
+            expect(resolve({}).empty());
+            const auto placeOnce = [&resolved] { return ScopedThreadPlacement(resolved); }; // e.g. for the duration of a processBulk call
+            {
+                ScopedThreadPlacement       placement = placeOnce();
+                const ScopedThreadPlacement moved(std::move(placement));
+                expect(eq(currentPlacement().cpus, std::format("{}", firstCpu)));
+            }
+            expect(eq(currentPlacement().cpus, initial.cpus)) << "restored once, by the moved-to object";
+        });
+    };
+
+    "requests which are not permitted degrade with a reason"_test = [] {
+        std::jthread worker([] {
+            const EffectivePlacement initial = currentPlacement();
+            const EffectivePlacement invalid = applyToCurrentThread({.cpuAffinity = "x"});
+            expect(!invalid.degraded.empty());
+            expect(eq(invalid.cpus, initial.cpus));
+
+            const EffectivePlacement realtime = applyToCurrentThread({.rtPriority = 10}); // applied only with CAP_SYS_NICE or RLIMIT_RTPRIO
+            expect(realtime.policy == "SCHED_FIFO" ? realtime.degraded.empty() && realtime.priority == 10 : !realtime.degraded.empty());
+        });
+    };
+};
+
+} // namespace fair::thread::test
+
+int main() { /* tests are statically executed */ }
@@ -16,6 +16,9 @@
 
 #include "gnuradio-4.0/TriggerMatcher.hpp"
 
+#include <fair/thread/ThreadPlacement.hpp>
+#include <fair/trace/Trace.hpp>
+
 #include "event_definitions.hpp"
 #include "timing.hpp"
 
@@ -72,10 +75,13 @@ tags: [
     A<float, "avg. sample rate", Doc<"Controls the sample rate at which to publish the digital output state. A value of 0.0f means samples are published only when there's an event.">, Visible>                                sample_rate     = 1000.f;
     A<std::string, "timing device name", Doc<"Specifies the timing device to use. In case it is left empty, the first timing device that is found is used.">>                                                                   timing_device   = "";
     A<std::uint64_t, "max delay", Doc<"Maximum delay for messages from the timing hardware. Only used for sample_rate != 0.0f">, Unit<"ns">>                                                                                    max_delay       = 10'000'000; // 10 ms // todo: uint64t ns
+    A<std::string, "poller CPU affinity", Doc<"CPU list the poller thread is pinned to, e.g. `2,4-6`, empty: not pinned. Best-effort, CPUs outside the allowed set of the process are dropped.">>                               cpu_affinity    = "";
+    A<int, "poller real-time priority", Doc<"SCHED_FIFO priority (1..99) of the poller thread, 0: default scheduling. Needs CAP_SYS_NICE or RLIMIT_RTPRIO, otherwise best-effort with a warning.">>                             rt_priority     = 0;
+    A<std::string, "poller thread pool", Doc<"Name of the gr::thread_pool::Manager pool running the poller, e.g. a dedicated pool on isolated cores. Falls back to the default IO pool.">>                                      thread_pool     = std::string(gr::thread_pool::kDefaultIoPoolId);
     A<bool, "verbose console", Doc<"For debugging">>                                                                                                                                                                            verbose_console = false;
     // TODO: enable/disable publishing on input port changes -> For now everything is published, add in follow-up PR
 
-    GR_MAKE_REFLECTABLE(TimingSource, out, /*ctxInfo,*/ event_actions, io_events, sample_rate, timing_device, max_delay, verbose_console);
+    GR_MAKE_REFLECTABLE(TimingSource, out, /*ctxInfo,*/ event_actions, io_events, sample_rate, timing_device, max_delay, cpu_affinity, rt_priority, thread_pool, verbose_console);
 
     using ConditionsType = std::map<std::string, std::map<std::string, std::variant<std::shared_ptr<saftlib::OutputCondition_Proxy>, std::shared_ptr<saftlib::SoftwareCondition_Proxy>>>>;
     Timing _timing;
@@ -108,10 +114,15 @@ tags: [
         _startTime = TimePoint(std::chrono::nanoseconds(_timing.currentTimeTAI()));
 
         _pollerRunning.store(true, std::memory_order_release);
-        gr::thread_pool::Manager::defaultIoPool()->execute([this]() {
+        pollerPool()->execute([this, placement = fair::thread::ThreadPlacement{.cpuAffinity = cpu_affinity, .rtPriority = rt_priority}]() {
+            FAIR_TRACE_THREAD_NAME("TimingSource poller");
+            const fair::thread::ScopedThreadPlacement pinned(placement); // the pool thread gets its previous placement back when the poller stops
+            fair::thread::report(this->name.value, "poller", placement, pinned.effective(), verbose_console);
             while (!_pollerStop.load(std::memory_order_acquire)) {
                 // >0 if a signal was received, 0 if timeout was hit, < 0 in case of failure
-                const int waitResult = _timing.saftSigGroup.wait_for_signal(static_cast<int>(max_delay >> 22ul));
+                [[maybe_unused]] const auto waitStart  = std::chrono::steady_clock::now();
+                const int                   waitResult = _timing.saftSigGroup.wait_for_signal(static_cast<int>(max_delay >> 22ul));
+                FAIR_TRACE_EVENT("wait_for_signal", "timing", waitStart, std::chrono::steady_clock::now());
                 if (_pollerStop.load(std::memory_order_acquire)) {
                     break;
                 }
@@ -124,6 +135,21 @@ tags: [
         });
     }
 
+    // the pool named by `thread_pool`, or the default IO pool if there is none
+    [[nodiscard]] auto pollerPool() const {
+        using gr::thread_pool::Manager;
+        if (thread_pool.value != gr::thread_pool::kDefaultIoPoolId) {
+            try {
+                if (auto pool = Manager::instance().get(thread_pool.value); pool) {
+                    return pool;
+                }
+            } catch (const std::exception&) { // unknown pool
+            }
+            std::println("TimingSource - Warning! thread pool '{}' not found, the poller runs on the default IO pool", thread_pool.value);
+        }
+        return Manager::defaultIoPool();
+    }
+
     void stop() {
         if (verbose_console) {
             std::println("stop {}", this->name);
@@ -468,6 +494,7 @@ tags: [
     }
 
     [[nodiscard]] gr::work::Status processBulk(OutputSpanLike auto& outSpan) {
+        FAIR_TRACE_SPAN("TimingSource::processBulk", "timing");
         const auto timingEvents = _event_reader.get<SpanReleasePolicy::ProcessAll>();
         // publish to output port and message port
         std::size_t  toPublish   = 0;
@@ -0,0 +1,224 @@
+#ifndef FAIR_TRACE_TRACE_HPP
+#define FAIR_TRACE_TRACE_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+/**
+ * Timeline of the acquisition hot path in the Chrome trace-event format, to be opened in https://ui.perfetto.dev or chrome://tracing. Compiled out
+ * unless GR_DIGITIZERS_ENABLE_TRACING is defined to 1 (CMake option ENABLE_TRACING), the macros then expand to nothing and their arguments are not
+ * evaluated:
+ *
+ *   FAIR_TRACE_SPAN("poll", "picoscope");                 // complete event from here to the end of the enclosing scope
+ *   FAIR_TRACE_EVENT("publish", "picoscope", begin, end); // complete event from std::chrono::steady_clock time points taken anyway
+ *   FAIR_TRACE_THREAD_NAME("TimingSource poller");        // track name of the calling thread
+ *
+ * Names and categories must be string literals, only the pointers are stored. Events go into a ring buffer per thread (the newest kCapacity events
+ * are kept), recording is lock- and allocation-free apart from registering a thread on its first event. `fair::trace::dump(path)` writes the events
+ * of all threads on request, at process exit they are written to the file named by the GR_DIGITIZERS_TRACE_FILE environment variable, if set.
+ */
+namespace fair::trace {
+
+#if defined(GR_DIGITIZERS_ENABLE_TRACING) && GR_DIGITIZERS_ENABLE_TRACING
+inline constexpr bool kEnabled = true;
+#else
+inline constexpr bool kEnabled = false;
+#endif
+
+[[nodiscard]] inline std::int64_t now() noexcept { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+[[nodiscard]] inline std::int64_t toNanoseconds(std::chrono::steady_clock::time_point time) noexcept { return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count(); }
+
+struct Event {
+    const char*  name     = nullptr;
+    const char*  category = nullptr;
+    std::int64_t begin    = 0; // [ns], steady_clock
+    std::int64_t end      = 0; // [ns], steady_clock
+};
+
+/**
+ * Single-producer ring of the events of one thread. Every slot field is a relaxed atomic, so a concurrent snapshot() is race free, events which may
+ * have been overwritten while copying are discarded.
+ */
+class ThreadRing {
+public:
+    static constexpr std::size_t kCapacity = 1UZ << 14UZ;
+
+private:
+    struct Slot {
+        std::atomic<const char*>  name{nullptr};
+        std::atomic<const char*>  category{nullptr};
+        std::atomic<std::int64_t> begin{0};
+        std::atomic<std::int64_t> end{0};
+    };
+    std::array<Slot, kCapacity> _slots{};
+    std::atomic<std::uint64_t>  _head{0UZ}; // number of events pushed so far
+    std::uint64_t               _threadId;
+    std::string                 _threadName; // guarded by the Registry mutex
+
+    friend class Registry;
+
+public:
+    explicit ThreadRing(std::uint64_t threadId) : _threadId(threadId) {}
+
+    void push(const char* name, const char* category, std::int64_t begin, std::int64_t end) noexcept {
+        const std::uint64_t head = _head.load(std::memory_order_relaxed);
+        Slot&               slot = _slots[head & (kCapacity - 1UZ)];
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.category.store(category, std::memory_order_relaxed);
+        slot.begin.store(begin, std::memory_order_relaxed);
+        slot.end.store(end, std::memory_order_relaxed);
+        _head.store(head + 1UZ, std::memory_order_release);
+    }
+
+    [[nodiscard]] std::vector<Event> snapshot() const {
+        const std::uint64_t head  = _head.load(std::memory_order_acquire);
+        const std::uint64_t first = head > kCapacity ? head - kCapacity : 0UZ;
+        std::vector<Event>  events;
+        events.reserve(head - first);
+        for (std::uint64_t i = first; i < head; ++i) {
+            const Slot& slot = _slots[i & (kCapacity - 1UZ)];
+            events.push_back({slot.name.load(std::memory_order_relaxed), slot.category.load(std::memory_order_relaxed), slot.begin.load(std::memory_order_relaxed), slot.end.load(std::memory_order_relaxed)});
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const std::uint64_t headAfter = _head.load(std::memory_order_relaxed);
+        const std::uint64_t valid     = headAfter + 1UZ > kCapacity ? headAfter + 1UZ - kCapacity : 0UZ; // the writer may be filling the slot of event `headAfter`
+        if (valid > first) {
+            events.erase(events.begin(), events.begin() + static_cast<std::ptrdiff_t>(std::min<std::uint64_t>(valid - first, events.size())));
+        }
+        return events;
+    }
+};
+
+class Registry {
+    std::mutex                               _mutex;
+    std::vector<std::shared_ptr<ThreadRing>> _rings; // kept after their threads exited, so short-lived threads still show up in the dump
+    std::int64_t                             _epoch = now();
+
+    Registry() = default;
+
+    static std::string escape(std::string_view text) {
+        std::string escaped;
+        for (const char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            escaped += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+        }
+        return escaped;
+    }
+
+public:
+    Registry(const Registry&)            = delete;
+    Registry& operator=(const Registry&) = delete;
+
+    ~Registry() {
+        if (const char* path = std::getenv("GR_DIGITIZERS_TRACE_FILE"); path != nullptr && *path != '\0') {
+            std::ignore = dump(path);
+        }
+    }
+
+    static Registry& instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    std::shared_ptr<ThreadRing> addThread() {
+        auto            ring = std::make_shared<ThreadRing>(static_cast<std::uint64_t>(::gettid()));
+        std::lock_guard lock(_mutex);
+        _rings.push_back(ring);
+        return ring;
+    }
+
+    void setThreadName(ThreadRing& ring, std::string_view name) {
+        std::lock_guard lock(_mutex);
+        ring._threadName = name;
+    }
+
+    [[nodiscard]] std::string toJson() {
+        std::lock_guard lock(_mutex);
+        const auto      pid       = static_cast<std::uint64_t>(::getpid());
+        std::string     json      = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool            next      = false;
+        const auto      separator = [&next] { return std::exchange(next, true) ? ",\n" : "\n"; };
+        for (const auto& ring : _rings) {
+            if (!ring->_threadName.empty()) {
+                json += std::format("{}{{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":{},\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}", separator(), pid, ring->_threadId, escape(ring->_threadName));
+            }
+            for (const Event& event : ring->snapshot()) {
+                json += std::format("{}{{\"ph\":\"X\",\"name\":\"{}\",\"cat\":\"{}\",\"pid\":{},\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}", separator(), escape(event.name ? event.name : ""), escape(event.category ? event.category : ""), pid, ring->_threadId, //
+                    static_cast<double>(event.begin - _epoch) * 1e-3, static_cast<double>(std::max<std::int64_t>(event.end - event.begin, 0)) * 1e-3);
+            }
+        }
+        json += "\n]}\n";
+        return json;
+    }
+
+    std::expected<void, std::string> dump(const std::filesystem::path& path) {
+        const std::string json = toJson();
+        std::ofstream     file(path, std::ios::binary | std::ios::trunc);
+        if (!file || !file.write(json.data(), static_cast<std::streamsize>(json.size()))) {
+            return std::unexpected(std::format("cannot write trace to {}", path.string()));
+        }
+        return {};
+    }
+};
+
+[[nodiscard]] inline ThreadRing& threadRing() {
+    thread_local const std::shared_ptr<ThreadRing> ring = Registry::instance().addThread();
+    return *ring;
+}
+
+inline void record(const char* name, const char* category, std::int64_t begin, std::int64_t end) noexcept { threadRing().push(name, category, begin, end); }
+
+inline void record(const char* name, const char* category, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end) noexcept { record(name, category, toNanoseconds(begin), toNanoseconds(end)); }
+
+inline void setThreadName(std::string_view name) { Registry::instance().setThreadName(threadRing(), name); }
+
+// writes the events of all threads recorded so far as Chrome trace-event JSON, an empty trace if tracing is compiled out
+inline std::expected<void, std::string> dump(const std::filesystem::path& path) { return Registry::instance().dump(path); }
+
+class Span {
+    const char*  _name;
+    const char*  _category;
+    std::int64_t _begin = now();
+
+public:
+    Span(const char* name, const char* category) noexcept : _name(name), _category(category) {}
+    Span(const Span&)            = delete;
+    Span& operator=(const Span&) = delete;
+    ~Span() { record(_name, _category, _begin, now()); }
+};
+
+} // namespace fair::trace
+
+#define FAIR_TRACE_CONCAT_IMPL(a, b) a##b
+#define FAIR_TRACE_CONCAT(a, b)      FAIR_TRACE_CONCAT_IMPL(a, b)
+
+#if defined(GR_DIGITIZERS_ENABLE_TRACING) && GR_DIGITIZERS_ENABLE_TRACING
+#define FAIR_TRACE_SPAN(name, category)              const ::fair::trace::Span FAIR_TRACE_CONCAT(fairTraceSpan, __COUNTER__)(name, category)
+#define FAIR_TRACE_EVENT(name, category, begin, end) ::fair::trace::record(name, category, begin, end)
+#define FAIR_TRACE_THREAD_NAME(name)                 ::fair::trace::setThreadName(name)
+#else
+#define FAIR_TRACE_SPAN(name, category)              static_cast<void>(0)
+#define FAIR_TRACE_EVENT(name, category, begin, end) static_cast<void>(sizeof((begin), (end))) // unevaluated, only marks the time points as used
+#define FAIR_TRACE_THREAD_NAME(name)                 static_cast<void>(0)
+#endif
+
+#endif // FAIR_TRACE_TRACE_HPP
@@ -0,0 +1,60 @@
+#include <boost/ut.hpp>
+
+#include <fair/trace/Trace.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+namespace fair::trace::test {
+
+const boost::ut::suite<"Trace"> TraceTests = [] {
+    using namespace boost::ut;
+
+    "ring keeps the newest events"_test = [] {
+        auto ring = std::make_unique<ThreadRing>(42UZ); // 512 kB, not on the stack
+        expect(ring->snapshot().empty());
+        for (std::int64_t i = 0; i < static_cast<std::int64_t>(ThreadRing::kCapacity + 10UZ); ++i) {
+            ring->push("event", "test", i, i + 1);
+        }
+        const auto events = ring->snapshot();
+        expect(le(events.size(), ThreadRing::kCapacity));
+        expect(ge(events.size(), ThreadRing::kCapacity - 1UZ));
+        expect(eq(events.back().begin, static_cast<std::int64_t>(ThreadRing::kCapacity + 9UZ)));
+        expect(eq(events.front().begin + static_cast<std::int64_t>(events.size()) - 1, events.back().begin));
+    };
+
+    "spans of all threads are dumped as JSON"_test = [] {
+        static_assert(kEnabled);
+        FAIR_TRACE_THREAD_NAME("qa_Trace main");
+        {
+            FAIR_TRACE_SPAN("outer", "test");
+            std::thread worker([] {
+                FAIR_TRACE_THREAD_NAME("qa_Trace worker");
+                FAIR_TRACE_SPAN("worker span", "test");
+            });
+            worker.join(); // the worker ring outlives its thread
+        }
+        const auto begin = std::chrono::steady_clock::now();
+        FAIR_TRACE_EVENT("explicit", "test", begin, begin + std::chrono::microseconds(5));
+
+        const std::filesystem::path path = std::filesystem::temp_directory_path() / "qa_Trace.json";
+        expect(dump(path).has_value());
+        std::stringstream json;
+        json << std::ifstream(path).rdbuf();
+        const std::string text = json.str();
+        expect(text.starts_with("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+        expect(text.contains("\"name\":\"outer\""));
+        expect(text.contains("\"name\":\"worker span\""));
+        expect(text.contains("\"name\":\"explicit\",\"cat\":\"test\""));
+        expect(text.contains("\"dur\":5.000"));
+        expect(text.contains("{\"name\":\"qa_Trace worker\"}"));
+        std::filesystem::remove(path);
+    };
+};
+
+} // namespace fair::trace::test
+
+int main() { /* tests are statically executed */ }